@@ -0,0 +1,509 @@
+// acia.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "acia.h"
+
+/* Cycles between looks at a ring when there is no character time to wait
+ * for: receiver polling without pacing, and retries while tx is full */
+#define ACIA_POLL_CYCLES 1000
+
+/* Rates for ACIA_CTRL_BAUD 1..15 with the standard 1.8432 MHz crystal */
+static const double acia_baud_rates[16] = {
+    0,    50,   75,   109.92, 134.58, 150,  300,  600,
+    1200, 1800, 2400, 3600,   4800,   7200, 9600, 19200,
+};
+
+static inline uint64_t acia_now(const acia_t *acia)
+{
+    return acia->cpu->clock.cycle_count;
+}
+
+/* CPU cycles per character (start, data, parity and stop bits), or 0 when
+ * the external clock is selected */
+static uint64_t char_cycles(const acia_t *acia)
+{
+    double baud = acia_baud_rates[ACIA_CTRL_BAUD(acia->control)];
+
+    if (baud == 0)
+        return 0;
+
+    unsigned bits = 1 + ACIA_CTRL_WORD_BITS(acia->control) +
+                    ((acia->command & ACIA_CMD_PARITY) ? 1 : 0) +
+                    ((acia->control & ACIA_CTRL_TWO_STOP) ? 2 : 1);
+    uint64_t cycles =
+        (uint64_t)(acia->cpu->clock.frequency * bits / baud + 0.5);
+
+    return cycles ? cycles : 1;
+}
+
+/* Interrupt Line */
+
+static bool irq_active(const acia_t *acia)
+{
+    if (!(acia->command & ACIA_CMD_DTR))
+        return false;
+
+    return (acia->rx_full && !(acia->command & ACIA_CMD_RX_IRQ_OFF)) ||
+           (!acia->tx_full &&
+            (acia->command & ACIA_CMD_TX_MASK) == ACIA_CMD_TX_IRQ);
+}
+
+static void update_irq(acia_t *acia)
+{
+    bool active = irq_active(acia);
+
+    if (active != acia->irq_asserted)
+    {
+        acia->irq_asserted = active;
+        cpu_set_irq_source(acia->cpu, acia->irq_source, active);
+    }
+}
+
+/* Status register as it stands, without pulling from rx */
+static uint8_t status_value(const acia_t *acia)
+{
+    uint8_t status = 0;
+
+    if (acia->rx_full)
+        status |= ACIA_STATUS_RDRF;
+    if (!acia->tx_full)
+        status |= ACIA_STATUS_TDRE;
+    if (irq_active(acia))
+        status |= ACIA_STATUS_IRQ;
+
+    return status;
+}
+
+/* Receiver and Transmitter */
+
+/* Take the next byte from rx if the data register is free and a character
+ * time has passed since the last one */
+static void rx_poll(acia_t *acia, uint64_t now)
+{
+    if (!(acia->command & ACIA_CMD_DTR) || acia->rx_full ||
+        now < acia->rx_ready)
+        return;
+
+    if (queue_dequeue(acia->rx, &acia->rx_data))
+    {
+        acia->rx_full = true;
+        acia->rx_ready = now + char_cycles(acia);
+    }
+}
+
+/* Move the waiting byte into the shift register once it is free */
+static void tx_shift(acia_t *acia, uint64_t now)
+{
+    if (!acia->tx_full || now < acia->tx_busy)
+        return;
+
+    if (!queue_enqueue(acia->tx, acia->tx_data))
+    {
+        acia->tx_busy = now + ACIA_POLL_CYCLES; // Host behind: hold the byte
+        return;
+    }
+
+    acia->tx_full = false;
+    acia->tx_busy = now + char_cycles(acia);
+}
+
+/* Scheduled Events */
+
+static void rx_event(void *context, uint64_t cycle);
+static void tx_event(void *context, uint64_t cycle);
+
+/* With receiver interrupts on, look at rx again when the next byte could
+ * arrive; without them, reads of the registers are enough */
+static void schedule_rx(acia_t *acia)
+{
+    uint64_t now = acia_now(acia);
+
+    cpu_cancel_event(acia->cpu, acia->rx_event);
+    acia->rx_event = SCHEDULER_NO_EVENT;
+
+    if ((acia->command & (ACIA_CMD_DTR | ACIA_CMD_RX_IRQ_OFF)) !=
+            ACIA_CMD_DTR ||
+        acia->rx_full)
+        return;
+
+    uint64_t cycle = acia->rx_ready;
+
+    if (cycle <= now)
+        cycle = now + ACIA_POLL_CYCLES;
+
+    acia->rx_event = cpu_schedule(acia->cpu, cycle, rx_event, acia);
+}
+
+/* Wake up when the waiting byte can enter the shift register */
+static void schedule_tx(acia_t *acia)
+{
+    cpu_cancel_event(acia->cpu, acia->tx_event);
+    acia->tx_event = SCHEDULER_NO_EVENT;
+
+    if (acia->tx_full)
+        acia->tx_event = cpu_schedule(acia->cpu, acia->tx_busy, tx_event, acia);
+}
+
+static void rx_event(void *context, uint64_t cycle)
+{
+    acia_t *acia = (acia_t *)context;
+
+    (void)cycle;
+    acia->rx_event = SCHEDULER_NO_EVENT;
+    rx_poll(acia, acia_now(acia));
+    schedule_rx(acia);
+    update_irq(acia);
+}
+
+static void tx_event(void *context, uint64_t cycle)
+{
+    acia_t *acia = (acia_t *)context;
+
+    (void)cycle;
+    acia->tx_event = SCHEDULER_NO_EVENT;
+    tx_shift(acia, acia_now(acia));
+    schedule_tx(acia);
+    update_irq(acia);
+}
+
+/* Register Access */
+
+static uint8_t acia_read(memory_t *mem, uint16_t addr)
+{
+    acia_t *acia = (acia_t *)mem->context;
+    uint64_t now = acia_now(acia);
+    uint8_t value;
+
+    rx_poll(acia, now);
+    tx_shift(acia, now);
+
+    switch (addr & 0x03)
+    {
+    case ACIA_DATA:
+        value = acia->rx_data;
+        acia->rx_full = false;
+        rx_poll(acia, now); // Unpaced: the next byte is there at once
+        schedule_rx(acia);
+        break;
+    case ACIA_STATUS:
+        value = status_value(acia);
+        break;
+    case ACIA_COMMAND:
+        value = acia->command;
+        break;
+    default: // ACIA_CONTROL
+        value = acia->control;
+        break;
+    }
+
+    update_irq(acia);
+
+    return value;
+}
+
+static void acia_write(memory_t *mem, uint16_t addr, uint8_t data)
+{
+    acia_t *acia = (acia_t *)mem->context;
+    uint64_t now = acia_now(acia);
+
+    switch (addr & 0x03)
+    {
+    case ACIA_DATA:
+        tx_shift(acia, now);
+        acia->tx_data = data; // Overwrites a byte still waiting, as on the chip
+        acia->tx_full = true;
+        tx_shift(acia, now);
+        schedule_tx(acia);
+        break;
+    case ACIA_STATUS:
+        // Programmed reset: clears command bits 4-0
+        acia->command &= 0xE0;
+        schedule_rx(acia);
+        break;
+    case ACIA_COMMAND:
+        acia->command = data;
+        rx_poll(acia, now);
+        schedule_rx(acia);
+        break;
+    default: // ACIA_CONTROL
+        acia->control = data;
+        break;
+    }
+
+    update_irq(acia);
+}
+
+/* Register values without side effects (memory views) */
+static uint8_t acia_peek(memory_t *mem, uint16_t addr)
+{
+    const acia_t *acia = (const acia_t *)mem->context;
+
+    switch (addr & 0x03)
+    {
+    case ACIA_DATA:
+        return acia->rx_data;
+    case ACIA_STATUS:
+        return status_value(acia);
+    case ACIA_COMMAND:
+        return acia->command;
+    default:
+        return acia->control;
+    }
+}
+
+/* Snapshots */
+
+/* Architectural state in a snapshot: no host pointers, no event ids, and
+ * deadlines relative to the CPU's cycle_count (modulo 2^64) */
+typedef struct
+{
+    uint64_t rx_ready;
+    uint64_t tx_busy;
+    uint8_t command, control;
+    uint8_t rx_data, tx_data;
+    bool rx_full, tx_full;
+} acia_state_t;
+
+static size_t acia_save_state(memory_t *mem, void *buffer, size_t size)
+{
+    const acia_t *acia = (const acia_t *)mem->context;
+    uint64_t now = acia_now(acia);
+    acia_state_t state;
+
+    if (size < sizeof(state))
+        return sizeof(state);
+
+    memset(&state, 0, sizeof(state)); // Padding too: saves compare equal
+    state.rx_ready = acia->rx_ready - now;
+    state.tx_busy = acia->tx_busy - now;
+    state.command = acia->command;
+    state.control = acia->control;
+    state.rx_data = acia->rx_data;
+    state.tx_data = acia->tx_data;
+    state.rx_full = acia->rx_full;
+    state.tx_full = acia->tx_full;
+
+    memcpy(buffer, &state, sizeof(state));
+    return sizeof(state);
+}
+
+/* Registers and both data registers come from the snapshot; the CPU, the
+ * rings, the IRQ line and the events stay this ACIA's own. Bytes already in
+ * the rings are host side and stay where they are. */
+static bool acia_restore_state(memory_t *mem, const void *buffer, size_t size)
+{
+    acia_t *acia = (acia_t *)mem->context;
+    uint64_t now = acia_now(acia);
+    acia_state_t state;
+
+    if (size != sizeof(state))
+        return false;
+
+    memcpy(&state, buffer, sizeof(state));
+    acia->rx_ready = now + state.rx_ready;
+    acia->tx_busy = now + state.tx_busy;
+    acia->command = state.command;
+    acia->control = state.control;
+    acia->rx_data = state.rx_data;
+    acia->tx_data = state.tx_data;
+    acia->rx_full = state.rx_full;
+    acia->tx_full = state.tx_full;
+
+    schedule_rx(acia);
+    schedule_tx(acia);
+    update_irq(acia);
+
+    return true;
+}
+
+/* Creates an ACIA attached to a CPU */
+memory_t *memory_create_acia(cpu_6502_t *cpu, queue_t *rx, queue_t *tx)
+{
+    if (!cpu || !rx || !tx)
+        return NULL;
+
+    acia_t *acia = calloc(1, sizeof(acia_t));
+
+    if (!acia)
+    {
+        fprintf(stderr, "memory_create_acia: Failed to allocate ACIA.\n");
+        return NULL;
+    }
+
+    memory_t *memory = malloc(sizeof(memory_t));
+
+    if (!memory)
+    {
+        fprintf(stderr, "memory_create_acia: Failed to allocate memory "
+                        "structure.\n");
+        free(acia);
+        return NULL;
+    }
+
+    acia->cpu = cpu;
+    acia->rx = rx;
+    acia->tx = tx;
+    acia->irq_source = cpu_add_irq_source(cpu);
+    acia->rx_event = SCHEDULER_NO_EVENT;
+    acia->tx_event = SCHEDULER_NO_EVENT;
+
+    memory->read = acia_read;
+    memory->write = acia_write;
+    memory->page_pointer = NULL; // Every access has side effects
+    memory->context = acia;
+    memory->peek = acia_peek;
+    memory->save_state = acia_save_state;
+    memory->restore_state = acia_restore_state;
+
+    acia_reset(memory);
+
+    return memory;
+}
+
+/* Cancels the ACIA's events, releases its IRQ line and frees it */
+void memory_destroy_acia(memory_t *mem)
+{
+    if (!mem)
+        return;
+
+    acia_t *acia = (acia_t *)mem->context;
+
+    if (acia)
+    {
+        cpu_cancel_event(acia->cpu, acia->rx_event);
+        cpu_cancel_event(acia->cpu, acia->tx_event);
+        cpu_set_irq_source(acia->cpu, acia->irq_source, false);
+        free(acia);
+    }
+
+    free(mem);
+}
+
+/* Applies the RESET line */
+void acia_reset(memory_t *mem)
+{
+    if (!mem)
+        return;
+
+    acia_t *acia = (acia_t *)mem->context;
+    uint64_t now = acia_now(acia);
+
+    acia->command = ACIA_CMD_RX_IRQ_OFF;
+    acia->control = 0;
+    acia->rx_full = false;
+    acia->rx_ready = now;
+    acia->tx_full = false;
+    acia->tx_busy = now;
+
+    schedule_rx(acia);
+    schedule_tx(acia);
+    update_irq(acia);
+}
+
+/* Console Port */
+
+typedef struct
+{
+    queue_t *rx;
+    queue_t *tx;
+    uint8_t output; // Last byte written, read back at OUTPUT_ADDR
+} console_t;
+
+static uint8_t console_read(memory_t *mem, uint16_t addr)
+{
+    console_t *console = (console_t *)mem->context;
+    uint8_t data;
+
+    if (addr != INPUT_ADDR)
+        return console->output;
+
+    return queue_dequeue(console->rx, &data) ? data : 0x00;
+}
+
+static void console_write(memory_t *mem, uint16_t addr, uint8_t data)
+{
+    console_t *console = (console_t *)mem->context;
+
+    if (addr != OUTPUT_ADDR)
+        return; // The input port is read-only
+
+    console->output = data;
+    queue_enqueue(console->tx, data);
+}
+
+static uint8_t console_peek(memory_t *mem, uint16_t addr)
+{
+    console_t *console = (console_t *)mem->context;
+    uint8_t data;
+
+    if (addr != INPUT_ADDR)
+        return console->output;
+
+    return queue_peek(console->rx, &data) ? data : 0x00;
+}
+
+/* The output latch is the only state; the rings are host side */
+static size_t console_save_state(memory_t *mem, void *buffer, size_t size)
+{
+    const console_t *console = (const console_t *)mem->context;
+
+    if (size >= 1)
+        *(uint8_t *)buffer = console->output;
+
+    return 1;
+}
+
+static bool console_restore_state(memory_t *mem, const void *buffer,
+                                  size_t size)
+{
+    console_t *console = (console_t *)mem->context;
+
+    if (size != 1)
+        return false;
+
+    console->output = *(const uint8_t *)buffer;
+    return true;
+}
+
+/* Creates a console port over a pair of rings */
+memory_t *memory_create_console(queue_t *rx, queue_t *tx)
+{
+    if (!rx || !tx)
+        return NULL;
+
+    console_t *console = calloc(1, sizeof(console_t));
+    memory_t *memory = malloc(sizeof(memory_t));
+
+    if (!console || !memory)
+    {
+        fprintf(stderr, "memory_create_console: Failed to allocate console "
+                        "port.\n");
+        free(console);
+        free(memory);
+        return NULL;
+    }
+
+    console->rx = rx;
+    console->tx = tx;
+
+    memory->read = console_read;
+    memory->write = console_write;
+    memory->page_pointer = NULL;
+    memory->context = console;
+    memory->peek = console_peek;
+    memory->save_state = console_save_state;
+    memory->restore_state = console_restore_state;
+
+    return memory;
+}
+
+/* Frees a console port */
+void memory_destroy_console(memory_t *mem)
+{
+    if (!mem)
+        return;
+
+    free(mem->context);
+    free(mem);
+}
@@ -0,0 +1,140 @@
+// acia.h
+#ifndef ACIA_H
+#define ACIA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "cpu_6502.h"
+#include "memory.h"
+#include "queue.h"
+
+/*
+ * MOS 6551 ACIA as a memory_t device.
+ *
+ * The four registers repeat every 4 bytes of whatever range the device is
+ * connected at. The receive and transmit FIFOs are the lock-free rings the
+ * device is created with: the host side feeds rx and drains tx from its own
+ * threads, the CPU thread is the other end of both.
+ *
+ * Transfers are paced by the cycle clock at the baud rate and character
+ * format in the control register, converted with the CPU frequency: the
+ * receiver takes at most one byte from rx per character time into the data
+ * register, and the transmitter hands a written byte to tx when it enters
+ * the shift register, then stays busy for one character time. Selecting the
+ * external clock (baud 0) turns the pacing off. When tx is full the
+ * transmitter holds the byte, as if the host had dropped CTS. Bytes wait in
+ * rx rather than overrunning a full data register.
+ *
+ * IRQ is level-triggered on one of the CPU's IRQ lines: RDRF with receiver
+ * interrupts enabled, or TDRE with transmitter control 01, both only while
+ * DTR is on. Status bit 7 mirrors the line instead of latching until the
+ * status is read. Not modelled: parity and framing errors, echo mode,
+ * break, and the modem lines (DSR and DCD read as asserted).
+ */
+
+#define ACIA_BASE_ADDR 0x8800 // Where emu65 maps the ACIA ($8800-$8803)
+
+/* Register offsets */
+#define ACIA_DATA 0x0    // Read: received byte (clears RDRF) / write: send
+#define ACIA_STATUS 0x1  // Read: status / write: programmed reset
+#define ACIA_COMMAND 0x2 // Command
+#define ACIA_CONTROL 0x3 // Control
+
+/* Status bits */
+#define ACIA_STATUS_PARITY 0x01
+#define ACIA_STATUS_FRAMING 0x02
+#define ACIA_STATUS_OVERRUN 0x04
+#define ACIA_STATUS_RDRF 0x08 // Receive data register full
+#define ACIA_STATUS_TDRE 0x10 // Transmit data register empty
+#define ACIA_STATUS_DCD 0x20  // 0 = carrier detected
+#define ACIA_STATUS_DSR 0x40  // 0 = data set ready
+#define ACIA_STATUS_IRQ 0x80
+
+/* Command bits */
+#define ACIA_CMD_DTR 0x01        // Data terminal ready: receiver and IRQs on
+#define ACIA_CMD_RX_IRQ_OFF 0x02 // Receiver interrupts disabled
+#define ACIA_CMD_TX_MASK 0x0C    // Transmitter control
+#define ACIA_CMD_TX_IRQ 0x04     // Transmitter control 01: TDRE interrupts
+#define ACIA_CMD_PARITY 0x20     // Parity bit on every character
+
+/* Control fields */
+#define ACIA_CTRL_BAUD(ctrl) ((ctrl) & 0x0F)          // 0 = external clock
+#define ACIA_CTRL_WORD_BITS(ctrl) (8 - (((ctrl) >> 5) & 0x03))
+#define ACIA_CTRL_TWO_STOP 0x80
+
+/* ACIA Structure */
+typedef struct
+{
+    cpu_6502_t *cpu; // Clock, scheduler and IRQ line
+    queue_t *rx;     // Host -> CPU
+    queue_t *tx;     // CPU -> host
+    int irq_source;  // CPU IRQ line, or -1 if none was free
+    bool irq_asserted;
+
+    uint8_t command, control;
+
+    /* Receiver */
+    uint8_t rx_data;
+    bool rx_full;      // RDRF
+    uint64_t rx_ready; // First cycle the next byte can arrive
+    uint32_t rx_event; // Poll of rx while receiver IRQs are on
+
+    /* Transmitter */
+    uint8_t tx_data;
+    bool tx_full;     // Byte waiting for the shift register (TDRE clear)
+    uint64_t tx_busy; // Cycle the shift register is free again
+    uint32_t tx_event;
+} acia_t;
+
+/**
+ * @brief Creates an ACIA attached to a CPU's clock, scheduler and IRQ input.
+ *
+ * @param cpu CPU the ACIA interrupts; must outlive the device.
+ * @param rx Ring the host fills with received bytes.
+ * @param tx Ring the host drains of transmitted bytes.
+ * @return Pointer to the device, or NULL on failure.
+ */
+memory_t *memory_create_acia(cpu_6502_t *cpu, queue_t *rx, queue_t *tx);
+
+/**
+ * @brief Cancels the ACIA's events, releases its IRQ line and frees it.
+ *
+ * @param mem Pointer to the device.
+ */
+void memory_destroy_acia(memory_t *mem);
+
+/**
+ * @brief Applies the RESET line: command $02, control $00, both data
+ * registers empty. Bytes already in the rings stay there.
+ *
+ * Call after cpu_reset(), which restarts cycle_count.
+ *
+ * @param mem Pointer to the device.
+ */
+void acia_reset(memory_t *mem);
+
+/*
+ * Console port: the bare input and output bytes at INPUT_ADDR and
+ * OUTPUT_ADDR that programs written before the ACIA use. A read of
+ * INPUT_ADDR takes the next byte from rx, or $00 if there is none; a write
+ * to OUTPUT_ADDR puts the byte on tx. No status, no pacing, no IRQ.
+ * Connect it over INPUT_ADDR..OUTPUT_ADDR.
+ */
+
+/**
+ * @brief Creates a console port over a pair of rings.
+ *
+ * @param rx Ring the host fills with input.
+ * @param tx Ring the host drains of output.
+ * @return Pointer to the device, or NULL on failure.
+ */
+memory_t *memory_create_console(queue_t *rx, queue_t *tx);
+
+/**
+ * @brief Frees a console port.
+ *
+ * @param mem Pointer to the device.
+ */
+void memory_destroy_console(memory_t *mem);
+
+#endif // ACIA_H
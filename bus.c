@@ -1,7 +1,78 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "bus.h"
 
+/* Rebuild one page table entry from the connected devices. The first
+ * device (in connection order) overlapping the page decides it: if it covers
+ * the whole page it owns it, otherwise the page is mixed. */
+static void bus_rebuild_page(bus_t *bus, int page)
+{
+    uint16_t page_start = (uint16_t)(page << 8);
+    uint16_t page_end = page_start | 0xFF;
+
+    bus->read_page[page] = NULL;
+    bus->write_page[page] = NULL;
+    bus->page_owner[page] = NULL;
+
+    for (int i = 0; i < bus->device_count; ++i)
+    {
+        bus_device_t *dev = &bus->devices[i];
+
+        if (dev->end_addr < page_start || dev->start_addr > page_end)
+            continue; // No overlap
+
+        if (dev->start_addr <= page_start && dev->end_addr >= page_end)
+        {
+            memory_t *mem = dev->device;
+
+            bus->page_owner[page] = dev;
+
+            if (mem->page_pointer)
+            {
+                bus->read_page[page] =
+                    mem->page_pointer(mem, page_start, false);
+                bus->write_page[page] =
+                    mem->page_pointer(mem, page_start, true);
+            }
+        }
+
+        break; // First overlapping device decides the page
+    }
+
+    // Plain storage in both directions, whatever the write watch does next
+    if (bus->read_page[page] && bus->write_page[page])
+        bus->plain_pages[page >> 5] |= 1u << (page & 31);
+    else
+        bus->plain_pages[page >> 5] &= ~(1u << (page & 31));
+
+    // Watched pages must take the slow path so the hook sees every write
+    if (bus->watched_pages[page >> 5] & (1u << (page & 31)))
+        bus->write_page[page] = NULL;
+
+    // Likewise for pages holding watchpoints, in their direction
+    if (bus->read_watch_pages[page >> 5] & (1u << (page & 31)))
+        bus->read_page[page] = NULL;
+    if (bus->write_watch_pages[page >> 5] & (1u << (page & 31)))
+        bus->write_page[page] = NULL;
+}
+
+/* Call the watch hook if addr, on a page with watchpoints, has one */
+static void bus_check_watchpoint(bus_t *bus, uint16_t addr, bool write)
+{
+    if (bus_watchpoint_is_set(bus, addr, write) && bus->watch_hook)
+        bus->watch_hook(bus->watch_hook_context, addr, write);
+}
+
+/* Rebuild the whole page table from the connected devices */
+static void bus_rebuild_page_table(bus_t *bus)
+{
+    for (int page = 0; page < BUS_PAGE_COUNT; ++page)
+    {
+        bus_rebuild_page(bus, page);
+    }
+}
+
 /* Creates and initializes a new bus */
 bus_t *bus_create(void)
 {
@@ -14,6 +85,17 @@ bus_t *bus_create(void)
     }
 
     bus->device_count = 0; // Initialize device count
+    memset(bus->watched_pages, 0, sizeof(bus->watched_pages));
+    memset(bus->plain_pages, 0, sizeof(bus->plain_pages));
+    bus->write_hook = NULL;
+    bus->write_hook_context = NULL;
+    memset(bus->read_watch, 0, sizeof(bus->read_watch));
+    memset(bus->write_watch, 0, sizeof(bus->write_watch));
+    memset(bus->read_watch_pages, 0, sizeof(bus->read_watch_pages));
+    memset(bus->write_watch_pages, 0, sizeof(bus->write_watch_pages));
+    bus->watch_hook = NULL;
+    bus->watch_hook_context = NULL;
+    bus_rebuild_page_table(bus);
     return bus;
 }
 
@@ -49,11 +131,98 @@ void bus_connect_device(bus_t *bus, memory_t *device, uint16_t start_addr,
     dev->device = device;
     dev->start_addr = start_addr;
     dev->end_addr = end_addr;
+
+    bus_rebuild_page_table(bus);
+}
+
+/* Installs the callback run after writes to watched pages */
+void bus_set_write_hook(bus_t *bus, bus_write_hook_t hook, void *context)
+{
+    if (!bus)
+        return;
+
+    bus->write_hook = hook;
+    bus->write_hook_context = context;
+}
+
+/* Starts or stops watching writes to a page */
+void bus_watch_page(bus_t *bus, uint8_t page, bool watch)
+{
+    if (!bus)
+        return;
+
+    if (watch)
+        bus->watched_pages[page >> 5] |= 1u << (page & 31);
+    else
+        bus->watched_pages[page >> 5] &= ~(1u << (page & 31));
+
+    bus_rebuild_page(bus, page);
+}
+
+/* Installs the callback run when an access hits a watchpoint */
+void bus_set_watch_hook(bus_t *bus, bus_watch_hook_t hook, void *context)
+{
+    if (!bus)
+        return;
+
+    bus->watch_hook = hook;
+    bus->watch_hook_context = context;
+}
+
+/* Sets or clears a read or write watchpoint */
+void bus_set_watchpoint(bus_t *bus, uint16_t addr, bool write, bool watch)
+{
+    if (!bus)
+        return;
+
+    uint32_t *bits = write ? bus->write_watch : bus->read_watch;
+    uint32_t *pages = write ? bus->write_watch_pages : bus->read_watch_pages;
+    uint8_t page = addr >> 8;
+    bool any = false;
+
+    if (watch)
+        bits[addr >> 5] |= 1u << (addr & 31);
+    else
+        bits[addr >> 5] &= ~(1u << (addr & 31));
+
+    // The page keeps the slow path while any of its 8 words is non-zero
+    for (int i = 0; i < 256 / 32; i++)
+        any = any || bits[(page << 3) + i] != 0;
+
+    if (any)
+        pages[page >> 5] |= 1u << (page & 31);
+    else
+        pages[page >> 5] &= ~(1u << (page & 31));
+
+    bus_rebuild_page(bus, page);
 }
 
-/* Reads a byte from a specific memory address via the bus */
-uint8_t bus_read(bus_t *bus, uint16_t addr)
+/* Clears every watchpoint */
+void bus_clear_watchpoints(bus_t *bus)
 {
+    if (!bus)
+        return;
+
+    memset(bus->read_watch, 0, sizeof(bus->read_watch));
+    memset(bus->write_watch, 0, sizeof(bus->write_watch));
+    memset(bus->read_watch_pages, 0, sizeof(bus->read_watch_pages));
+    memset(bus->write_watch_pages, 0, sizeof(bus->write_watch_pages));
+    bus_rebuild_page_table(bus);
+}
+
+/* Reads a byte through the owning device's handler */
+uint8_t bus_read_device(bus_t *bus, uint16_t addr)
+{
+    bus_device_t *owner = bus->page_owner[addr >> 8];
+    uint8_t page = addr >> 8;
+
+    if (bus->read_watch_pages[page >> 5] & (1u << (page & 31)))
+        bus_check_watchpoint(bus, addr, false);
+
+    if (owner)
+        return owner->device->read(owner->device, addr);
+
+    // Mixed or unmapped page: scan the devices in connection order
     for (int i = 0; i < bus->device_count; ++i)
     {
         bus_device_t *dev = &bus->devices[i];
@@ -68,19 +237,62 @@ uint8_t bus_read(bus_t *bus, uint16_t addr)
     return 0xFF;
 }
 
-/* Writes a byte to a specific memory address via the bus */
-void bus_write(bus_t *bus, uint16_t addr, uint8_t data)
+/* Reads a byte without device side effects */
+uint8_t bus_peek(bus_t *bus, uint16_t addr)
 {
-    for (int i = 0; i < bus->device_count; ++i)
+    if (bus->read_page[addr >> 8])
+        return bus->read_page[addr >> 8][addr & 0xFF];
+
+    bus_device_t *owner = bus->page_owner[addr >> 8];
+
+    // Mixed or unmapped page: first device in connection order
+    for (int i = 0; !owner && i < bus->device_count; ++i)
     {
-        bus_device_t *dev = &bus->devices[i];
+        if (addr >= bus->devices[i].start_addr &&
+            addr <= bus->devices[i].end_addr)
+            owner = &bus->devices[i];
+    }
 
-        if (addr >= dev->start_addr && addr <= dev->end_addr)
+    if (!owner)
+        return 0xFF;
+
+    memory_t *mem = owner->device;
+
+    return mem->peek ? mem->peek(mem, addr) : mem->read(mem, addr);
+}
+
+/* Writes a byte through the owning device's handler */
+void bus_write_device(bus_t *bus, uint16_t addr, uint8_t data)
+{
+    bus_device_t *owner = bus->page_owner[addr >> 8];
+
+    if (owner)
+    {
+        owner->device->write(owner->device, addr, data);
+    }
+    else
+    {
+        // Mixed or unmapped page: scan the devices in connection order
+        for (int i = 0; i < bus->device_count; ++i)
         {
-            dev->device->write(dev->device, addr, data);
-            return;
+            bus_device_t *dev = &bus->devices[i];
+
+            if (addr >= dev->start_addr && addr <= dev->end_addr)
+            {
+                dev->device->write(dev->device, addr, data);
+                break;
+            }
         }
     }
 
-    // If no device handles the address, do nothing or handle as needed
+    uint8_t page = addr >> 8;
+
+    if ((bus->watched_pages[page >> 5] & (1u << (page & 31))) &&
+        bus->write_hook)
+    {
+        bus->write_hook(bus->write_hook_context, addr);
+    }
+
+    if (bus->write_watch_pages[page >> 5] & (1u << (page & 31)))
+        bus_check_watchpoint(bus, addr, true);
 }
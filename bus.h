@@ -3,7 +3,17 @@
 
 #include "memory.h"
 
+/* bus_read/bus_write end up in every instruction body of the CPU engines;
+ * force them inline so the page table fast path survives however large
+ * those get */
+#if defined(__GNUC__) || defined(__clang__)
+#define BUS_INLINE inline __attribute__((always_inline))
+#else
+#define BUS_INLINE inline
+#endif
+
 #define MAX_DEVICES 16 // Adjust as needed
+#define BUS_PAGE_COUNT 256 // One page table entry per 256-byte page
 
 /* Bus Device Structure */
 typedef struct
@@ -13,11 +23,51 @@ typedef struct
     uint16_t end_addr;
 } bus_device_t;
 
+/* Called after a write lands on a watched page */
+typedef void (*bus_write_hook_t)(void *context, uint16_t addr);
+
+/* Called when an access hits a watchpoint */
+typedef void (*bus_watch_hook_t)(void *context, uint16_t addr, bool write);
+
+#define BUS_WATCH_WORDS (0x10000 / 32) // One bit per address
+
 /* Bus Structure */
 typedef struct bus
 {
     bus_device_t devices[MAX_DEVICES];
     int device_count;
+
+    /* Page table, rebuilt by bus_connect_device. For each page: a direct
+     * pointer to plain storage (NULL if accesses need the device handler),
+     * and the device that owns the whole page (NULL for unmapped pages and
+     * mixed pages shared by several devices, which fall back to a scan). */
+    uint8_t *read_page[BUS_PAGE_COUNT];
+    uint8_t *write_page[BUS_PAGE_COUNT];
+    bus_device_t *page_owner[BUS_PAGE_COUNT];
+
+    /* Write watch: pages with their bit set lose their direct write pointer,
+     * so every write to them takes bus_write_device, which calls write_hook
+     * after the device has stored the byte. */
+    uint32_t watched_pages[BUS_PAGE_COUNT / 32];
+    bus_write_hook_t write_hook;
+    void *write_hook_context;
+
+    /* Pages whose device gave direct pointers for both reads and writes,
+     * i.e. plain storage with no access side effects. Unaffected by the
+     * write watch. */
+    uint32_t plain_pages[BUS_PAGE_COUNT / 32];
+
+    /* Watchpoints: one bit per address for reads and one for writes. Pages
+     * holding any lose their direct pointer for that direction, so the
+     * inline fast path never looks at the bitmaps; the device path tests
+     * the page bit, then the address bit, and calls watch_hook on a hit.
+     * Unaffected by plain_pages, like the write watch. */
+    uint32_t read_watch[BUS_WATCH_WORDS];
+    uint32_t write_watch[BUS_WATCH_WORDS];
+    uint32_t read_watch_pages[BUS_PAGE_COUNT / 32];
+    uint32_t write_watch_pages[BUS_PAGE_COUNT / 32];
+    bus_watch_hook_t watch_hook;
+    void *watch_hook_context;
 } bus_t;
 
 /* Bus Interface Functions */
@@ -47,6 +97,112 @@ void bus_destroy(bus_t *bus);
 void bus_connect_device(bus_t *bus, memory_t *device, uint16_t start_addr,
                         uint16_t end_addr);
 
+/**
+ * @brief Installs the callback run after writes to watched pages.
+ *
+ * @param bus Pointer to the bus.
+ * @param hook Callback, or NULL to remove it.
+ * @param context Opaque pointer passed back to the callback.
+ */
+void bus_set_write_hook(bus_t *bus, bus_write_hook_t hook, void *context);
+
+/**
+ * @brief Starts or stops watching writes to a page.
+ *
+ * @param bus Pointer to the bus.
+ * @param page Page number (address >> 8).
+ * @param watch true to route writes to the page through the write hook.
+ */
+void bus_watch_page(bus_t *bus, uint8_t page, bool watch);
+
+/**
+ * @brief Installs the callback run when an access hits a watchpoint.
+ * cpu_init() points it at the CPU, which then stops with
+ * CPU_STOP_WATCHPOINT.
+ *
+ * @param bus Pointer to the bus.
+ * @param hook Callback, or NULL to remove it.
+ * @param context Opaque pointer passed back to the callback.
+ */
+void bus_set_watch_hook(bus_t *bus, bus_watch_hook_t hook, void *context);
+
+/**
+ * @brief Sets or clears a read or write watchpoint. Reads include the
+ * interpreters' opcode and operand fetches (the predecode and JIT engines
+ * fetch from their caches); bus_peek() never triggers one.
+ *
+ * @param bus Pointer to the bus.
+ * @param addr Address to watch.
+ * @param write true for writes, false for reads.
+ * @param watch true to set, false to clear.
+ */
+void bus_set_watchpoint(bus_t *bus, uint16_t addr, bool write, bool watch);
+
+/**
+ * @brief Clears every watchpoint.
+ *
+ * @param bus Pointer to the bus.
+ */
+void bus_clear_watchpoints(bus_t *bus);
+
+/**
+ * @brief Tells whether a read or write watchpoint is set at an address.
+ *
+ * @param bus Pointer to the bus.
+ * @param addr Address.
+ * @param write true for writes, false for reads.
+ * @return true if the watchpoint is set.
+ */
+static inline bool bus_watchpoint_is_set(const bus_t *bus, uint16_t addr,
+                                         bool write)
+{
+    const uint32_t *bits = write ? bus->write_watch : bus->read_watch;
+
+    return (bits[addr >> 5] & (1u << (addr & 31))) != 0;
+}
+
+/**
+ * @brief Tells whether a page is plain storage (see bus_t.plain_pages).
+ *
+ * @param bus Pointer to the bus.
+ * @param page Page number (address >> 8).
+ * @return true if accesses to the page have no device side effects.
+ */
+static inline bool bus_page_is_plain(const bus_t *bus, uint8_t page)
+{
+    return (bus->plain_pages[page >> 5] & (1u << (page & 31))) != 0;
+}
+
+/**
+ * @brief Reads a byte through the owning device's handler (page table slow
+ * path; use bus_read).
+ *
+ * @param bus Pointer to the bus.
+ * @param addr Memory address to read from.
+ * @return The byte read, or 0xFF if no device handles the address.
+ */
+uint8_t bus_read_device(bus_t *bus, uint16_t addr);
+
+/**
+ * @brief Writes a byte through the owning device's handler (page table slow
+ * path; use bus_write).
+ *
+ * @param bus Pointer to the bus.
+ * @param addr Memory address to write to.
+ * @param data Byte to be written.
+ */
+void bus_write_device(bus_t *bus, uint16_t addr, uint8_t data);
+
+/**
+ * @brief Reads a byte without device side effects, for debuggers and memory
+ * views (uses the device's peek hook when it has one).
+ *
+ * @param bus Pointer to the bus.
+ * @param addr Memory address to read from.
+ * @return The byte at addr, or 0xFF if no device handles the address.
+ */
+uint8_t bus_peek(bus_t *bus, uint16_t addr);
+
 /**
  * @brief Reads a byte from a specific memory address via the bus.
  *
@@ -54,7 +210,15 @@ void bus_connect_device(bus_t *bus, memory_t *device, uint16_t start_addr,
  * @param addr Memory address to read from.
  * @return The byte read from the specified memory address.
  */
-uint8_t bus_read(bus_t *bus, uint16_t addr);
+static BUS_INLINE uint8_t bus_read(bus_t *bus, uint16_t addr)
+{
+    uint8_t *page = bus->read_page[addr >> 8];
+
+    if (page)
+        return page[addr & 0xFF];
+
+    return bus_read_device(bus, addr);
+}
 
 /**
  * @brief Writes a byte to a specific memory address via the bus.
@@ -63,6 +227,14 @@ uint8_t bus_read(bus_t *bus, uint16_t addr);
  * @param addr Memory address to write to.
  * @param data Byte to be written.
  */
-void bus_write(bus_t *bus, uint16_t addr, uint8_t data);
+static BUS_INLINE void bus_write(bus_t *bus, uint16_t addr, uint8_t data)
+{
+    uint8_t *page = bus->write_page[addr >> 8];
+
+    if (page)
+        page[addr & 0xFF] = data;
+    else
+        bus_write_device(bus, addr, data);
+}
 
 #endif /* BUS_H */
@@ -1,7 +1,17 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L // clock_gettime
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <time.h>
 #include "cpu_6502.h"
+#include "decode_cache.h"
+#include "jit.h"
+#include "profiler.h"
+#include "trace.h"
 
 /* Internal Helper Functions */
 
@@ -10,49 +20,197 @@ void breakpoint_init(breakpoint_t *bp)
 {
     if (!bp)
         return;
+    memset(bp->bits, 0, sizeof(bp->bits));
     bp->count = 0;
 }
 
-/* Add Breakpoint */
+/* Add Breakpoint (adding one twice is harmless) */
 bool breakpoint_add(breakpoint_t *bp, uint16_t addr)
 {
-    if (!bp || bp->count >= MAX_BREAKPOINTS)
+    if (!bp)
         return false;
 
-    bp->addresses[bp->count++] = addr;
+    if (!breakpoint_check(bp, addr))
+    {
+        bp->bits[addr >> 5] |= 1u << (addr & 31);
+        bp->count++;
+    }
     return true;
 }
 
-/* Check Breakpoint */
-bool breakpoint_check(breakpoint_t *bp, uint16_t addr)
+/* Remove Breakpoint; false if there was none at addr */
+bool breakpoint_remove(breakpoint_t *bp, uint16_t addr)
 {
-    if (!bp)
+    if (!breakpoint_check(bp, addr))
         return false;
-    for (int i = 0; i < bp->count; i++)
+
+    bp->bits[addr >> 5] &= ~(1u << (addr & 31));
+    bp->count--;
+    return true;
+}
+
+/* Bus watch hook: note the access and stop at the next instruction
+ * boundary. Runs on the CPU thread, in the middle of an instruction. */
+static void watchpoint_hit(void *context, uint16_t addr, bool write)
+{
+    cpu_6502_t *cpu = (cpu_6502_t *)context;
+
+    cpu->watch_hit = true;
+    cpu->watch_write = write;
+    cpu->watch_addr = addr;
+    atomic_store_explicit(&cpu->attention, true, memory_order_relaxed);
+}
+
+/* Memory access for the instruction handlers. Forced inline so the page
+ * table fast path ends up in every case body however large the engines get;
+ * cpu_read() and cpu_write() are the out-of-line public versions. */
+static CPU_INLINE uint8_t read_byte(cpu_6502_t *cpu, uint16_t addr)
+{
+    return bus_read(cpu->bus, addr);
+}
+
+static CPU_INLINE void write_byte(cpu_6502_t *cpu, uint16_t addr, uint8_t data)
+{
+    bus_write(cpu->bus, addr, data);
+}
+
+/* Lazy Flags */
+
+/* While cpu_execute_instruction() or cpu_run_cycles() runs, N, Z, C and V
+ * are kept apart from reg.P: N and Z as the last result (flag_n, flag_z)
+ * and C and V as plain 0/1 bytes. Setting them is then a byte store instead
+ * of a read-modify-write of P, and most results are overwritten before
+ * anything looks at them. The full byte is only put together when P is
+ * read as a whole (PHP, BRK, interrupts) and when those functions return,
+ * so reg.P is exact for everything outside the core, the state display
+ * included; flags_unpack() picks up whatever was written to reg.P in
+ * between. The public set_flag() and get_flag() work on reg.P and are meant
+ * for that outside. */
+#define LAZY_FLAGS_MASK \
+    ((1 << FLAG_NEGATIVE) | (1 << FLAG_OVERFLOW) | (1 << FLAG_ZERO) | \
+     (1 << FLAG_CARRY))
+
+static CPU_INLINE bool flag_get(const cpu_6502_t *cpu, status_flag_t flag)
+{
+    switch (flag)
     {
-        if (bp->addresses[i] == addr)
-            return true;
+    case FLAG_NEGATIVE:
+        return (cpu->flag_n & 0x80) != 0;
+    case FLAG_ZERO:
+        return cpu->flag_z == 0;
+    case FLAG_CARRY:
+        return cpu->flag_c;
+    case FLAG_OVERFLOW:
+        return cpu->flag_v;
+    default:
+        return get_flag(cpu, flag);
     }
-    return false;
+}
+
+static CPU_INLINE void flag_set(cpu_6502_t *cpu, status_flag_t flag,
+                                bool value)
+{
+    switch (flag)
+    {
+    case FLAG_NEGATIVE:
+        cpu->flag_n = value ? 0x80 : 0x00;
+        break;
+    case FLAG_ZERO:
+        cpu->flag_z = value ? 0x00 : 0x01;
+        break;
+    case FLAG_CARRY:
+        cpu->flag_c = value;
+        break;
+    case FLAG_OVERFLOW:
+        cpu->flag_v = value;
+        break;
+    default:
+        set_flag(cpu, flag, value);
+        break;
+    }
+}
+
+/* N and Z from a result: the common case, two stores */
+static CPU_INLINE void set_nz(cpu_6502_t *cpu, uint8_t value)
+{
+    cpu->flag_n = value;
+    cpu->flag_z = value;
+}
+
+/* P as the 6502 would push it (without B and the unused bit forced) */
+static CPU_INLINE uint8_t status_read(const cpu_6502_t *cpu)
+{
+    return (cpu->reg.P & ~LAZY_FLAGS_MASK) | (cpu->flag_n & 0x80) |
+           (cpu->flag_v << FLAG_OVERFLOW) | ((cpu->flag_z == 0) << FLAG_ZERO) |
+           (cpu->flag_c << FLAG_CARRY);
+}
+
+/* Load the lazy flags from reg.P */
+static CPU_INLINE void flags_unpack(cpu_6502_t *cpu)
+{
+    cpu->flag_n = cpu->reg.P & 0x80;
+    cpu->flag_z = get_flag(cpu, FLAG_ZERO) ? 0x00 : 0x01;
+    cpu->flag_c = get_flag(cpu, FLAG_CARRY);
+    cpu->flag_v = get_flag(cpu, FLAG_OVERFLOW);
+}
+
+/* Write the lazy flags back into reg.P */
+static CPU_INLINE void flags_pack(cpu_6502_t *cpu)
+{
+    cpu->reg.P = status_read(cpu);
+}
+
+/* Replace P as a whole (PLP, RTI) */
+static CPU_INLINE void status_write(cpu_6502_t *cpu, uint8_t value)
+{
+    cpu->reg.P = value;
+    flags_unpack(cpu);
+}
+
+/* Compare two register sets field by field (the struct has padding) */
+static bool registers_equal(const cpu_registers_t *a, const cpu_registers_t *b)
+{
+    return a->A == b->A && a->X == b->X && a->Y == b->Y && a->PC == b->PC &&
+           a->SP == b->SP && a->P == b->P;
+}
+
+/* Idle Loops */
+
+static CPU_NOINLINE void idle_arrival(cpu_6502_t *cpu, uint16_t end);
+
+/* Taken jumps and branches set PC here. A short backward jump is the shape
+ * of a spin or polling loop, so it is reported to idle_arrival(); end is
+ * the address after the jumping instruction. */
+static CPU_INLINE void jump_to(cpu_6502_t *cpu, uint16_t target)
+{
+    uint16_t end = cpu->reg.PC;
+
+    cpu->reg.PC = target;
+
+    // Backward by 1..IDLE_MAX_LOOP_BYTES; a branch to itself + 2 is no loop.
+    // A tracer or profiler sees every iteration, so nothing is skipped.
+    if ((uint16_t)(end - target - 1) < IDLE_MAX_LOOP_BYTES &&
+        cpu->idle.enabled && !cpu->tracer && !cpu->profiler)
+        idle_arrival(cpu, end);
 }
 
 /* Fetch a byte from memory and increment PC */
-static inline uint8_t fetch_byte(cpu_6502_t *cpu)
+static CPU_INLINE uint8_t fetch_byte(cpu_6502_t *cpu)
 {
-    uint8_t byte = cpu_read(cpu, cpu->reg.PC);
+    uint8_t byte = read_byte(cpu, cpu->reg.PC);
     cpu->reg.PC++;
     return byte;
 }
 
 /* Fetch a word (two bytes) from memory (little endian) */
-static inline uint16_t fetch_word(cpu_6502_t *cpu)
+static CPU_INLINE uint16_t fetch_word(cpu_6502_t *cpu)
 {
     // Fetch low byte, increment PC
-    uint8_t low = cpu_read(cpu, cpu->reg.PC);
+    uint8_t low = read_byte(cpu, cpu->reg.PC);
     cpu->reg.PC = (cpu->reg.PC + 1) & 0xFFFF;
 
     // Fetch high byte, increment PC
-    uint8_t high = cpu_read(cpu, cpu->reg.PC);
+    uint8_t high = read_byte(cpu, cpu->reg.PC);
     cpu->reg.PC = (cpu->reg.PC + 1) & 0xFFFF;
 
     // Combine high and low bytes into a 16-bit address
@@ -61,28 +219,28 @@ static inline uint16_t fetch_word(cpu_6502_t *cpu)
 }
 
 /* Push a byte onto the stack */
-static inline void push_byte(cpu_6502_t *cpu, uint8_t value)
+static CPU_INLINE void push_byte(cpu_6502_t *cpu, uint8_t value)
 {
-    cpu_write(cpu, 0x0100 + cpu->reg.SP, value);
+    write_byte(cpu, 0x0100 + cpu->reg.SP, value);
     cpu->reg.SP--;
 }
 
 /* Pull a byte from the stack */
-static inline uint8_t pull_byte(cpu_6502_t *cpu)
+static CPU_INLINE uint8_t pull_byte(cpu_6502_t *cpu)
 {
     cpu->reg.SP++;
-    return cpu_read(cpu, 0x0100 + cpu->reg.SP);
+    return read_byte(cpu, 0x0100 + cpu->reg.SP);
 }
 
 /* Push a word onto the stack (high byte first) */
-static inline void push_word(cpu_6502_t *cpu, uint16_t value)
+static CPU_INLINE void push_word(cpu_6502_t *cpu, uint16_t value)
 {
     push_byte(cpu, (value >> 8) & 0xFF); // High byte
     push_byte(cpu, value & 0xFF);        // Low byte
 }
 
 /* Pull a word from the stack (low byte first) */
-static inline uint16_t pull_word(cpu_6502_t *cpu)
+static CPU_INLINE uint16_t pull_word(cpu_6502_t *cpu)
 {
     uint8_t low = pull_byte(cpu);
     uint8_t high = pull_byte(cpu);
@@ -92,42 +250,42 @@ static inline uint16_t pull_word(cpu_6502_t *cpu)
 /* Addressing Mode Functions */
 
 /* Immediate Addressing */
-static effective_address_t addr_immediate(cpu_6502_t *cpu)
+static CPU_INLINE effective_address_t addr_immediate(cpu_6502_t *cpu)
 {
     uint16_t addr = cpu->reg.PC++;
     return (effective_address_t){addr, false};
 }
 
 /* Zero Page Addressing */
-static effective_address_t addr_zero_page(cpu_6502_t *cpu)
+static CPU_INLINE effective_address_t addr_zero_page(cpu_6502_t *cpu)
 {
     uint8_t addr = fetch_byte(cpu);
     return (effective_address_t){addr, false};
 }
 
 /* Zero Page,X Addressing */
-static effective_address_t addr_zero_page_x(cpu_6502_t *cpu)
+static CPU_INLINE effective_address_t addr_zero_page_x(cpu_6502_t *cpu)
 {
     uint8_t addr = (fetch_byte(cpu) + cpu->reg.X) & 0xFF;
     return (effective_address_t){addr, false};
 }
 
 /* Zero Page,Y Addressing */
-static effective_address_t addr_zero_page_y(cpu_6502_t *cpu)
+static CPU_INLINE effective_address_t addr_zero_page_y(cpu_6502_t *cpu)
 {
     uint8_t addr = (fetch_byte(cpu) + cpu->reg.Y) & 0xFF;
     return (effective_address_t){addr, false};
 }
 
 /* Absolute Addressing */
-static effective_address_t addr_absolute(cpu_6502_t *cpu)
+static CPU_INLINE effective_address_t addr_absolute(cpu_6502_t *cpu)
 {
     uint16_t addr = fetch_word(cpu);
     return (effective_address_t){addr, false};
 }
 
 /* Absolute,X Addressing */
-static effective_address_t addr_absolute_x(cpu_6502_t *cpu)
+static CPU_INLINE effective_address_t addr_absolute_x(cpu_6502_t *cpu)
 {
     uint16_t base_address = fetch_word(cpu);
     uint16_t effective_address = base_address + cpu->reg.X;
@@ -136,7 +294,7 @@ static effective_address_t addr_absolute_x(cpu_6502_t *cpu)
 }
 
 /* Absolute,Y Addressing */
-static effective_address_t addr_absolute_y(cpu_6502_t *cpu)
+static CPU_INLINE effective_address_t addr_absolute_y(cpu_6502_t *cpu)
 {
     uint16_t base_address = fetch_word(cpu);
     uint16_t effective_address = base_address + cpu->reg.Y;
@@ -145,32 +303,32 @@ static effective_address_t addr_absolute_y(cpu_6502_t *cpu)
 }
 
 /* Indirect Addressing (for JMP) */
-static effective_address_t addr_indirect(cpu_6502_t *cpu)
+static CPU_INLINE effective_address_t addr_indirect(cpu_6502_t *cpu)
 {
     uint16_t ptr = fetch_word(cpu);
-    uint8_t low = cpu_read(cpu, ptr);
-    uint8_t high = cpu_read(cpu, (ptr & 0xFF00) |
+    uint8_t low = read_byte(cpu, ptr);
+    uint8_t high = read_byte(cpu, (ptr & 0xFF00) |
                                      ((ptr + 1) & 0x00FF)); // Simulate 6502 bug
     uint16_t addr = ((uint16_t)high << 8) | low;
     return (effective_address_t){addr, false};
 }
 
 /* Indexed Indirect (Indirect,X) Addressing */
-static effective_address_t addr_indirect_x(cpu_6502_t *cpu)
+static CPU_INLINE effective_address_t addr_indirect_x(cpu_6502_t *cpu)
 {
     uint8_t base = (fetch_byte(cpu) + cpu->reg.X) & 0xFF;
-    uint8_t low = cpu_read(cpu, base);
-    uint8_t high = cpu_read(cpu, (base + 1) & 0xFF);
+    uint8_t low = read_byte(cpu, base);
+    uint8_t high = read_byte(cpu, (base + 1) & 0xFF);
     uint16_t addr = ((uint16_t)high << 8) | low;
     return (effective_address_t){addr, false};
 }
 
 /* Indirect Indexed (Indirect),Y Addressing */
-static effective_address_t addr_indirect_y(cpu_6502_t *cpu)
+static CPU_INLINE effective_address_t addr_indirect_y(cpu_6502_t *cpu)
 {
     uint8_t base = fetch_byte(cpu);
-    uint8_t low = cpu_read(cpu, base);
-    uint8_t high = cpu_read(cpu, (base + 1) & 0xFF);
+    uint8_t low = read_byte(cpu, base);
+    uint8_t high = read_byte(cpu, (base + 1) & 0xFF);
     uint16_t base_address = ((uint16_t)high << 8) | low;
     uint16_t effective_address = base_address + cpu->reg.Y;
     bool page_crossed = (base_address & 0xFF00) != (effective_address & 0xFF00);
@@ -178,7 +336,7 @@ static effective_address_t addr_indirect_y(cpu_6502_t *cpu)
 }
 
 /* Relative Addressing */
-static effective_address_t addr_relative(cpu_6502_t *cpu)
+static CPU_INLINE effective_address_t addr_relative(cpu_6502_t *cpu)
 {
     int8_t offset = (int8_t)fetch_byte(cpu);
     uint16_t effective_address = cpu->reg.PC + offset;
@@ -189,17 +347,17 @@ static effective_address_t addr_relative(cpu_6502_t *cpu)
 /* Instruction Implementations */
 
 /* ADC (Add with Carry) with Decimal Mode */
-static void instr_adc(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_adc(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     effective_address_t ea = mode(cpu);
-    uint8_t value = cpu_read(cpu, ea.address);
+    uint8_t value = read_byte(cpu, ea.address);
     uint16_t sum;
 
-    if (get_flag(cpu, FLAG_DECIMAL))
+    if (flag_get(cpu, FLAG_DECIMAL))
     {
         /* Decimal mode */
         uint8_t al =
-            (cpu->reg.A & 0x0F) + (value & 0x0F) + get_flag(cpu, FLAG_CARRY);
+            (cpu->reg.A & 0x0F) + (value & 0x0F) + flag_get(cpu, FLAG_CARRY);
         uint8_t ah = (cpu->reg.A >> 4) + (value >> 4);
 
         if (al > 9)
@@ -211,26 +369,26 @@ static void instr_adc(cpu_6502_t *cpu, addressing_mode_func_t mode)
         if (ah > 9)
         {
             ah -= 10;
-            set_flag(cpu, FLAG_CARRY, true);
+            flag_set(cpu, FLAG_CARRY, true);
         }
         else
         {
-            set_flag(cpu, FLAG_CARRY, false);
+            flag_set(cpu, FLAG_CARRY, false);
         }
 
         cpu->reg.A = (ah << 4) | (al & 0x0F);
-        update_zero_and_negative_flags(cpu, cpu->reg.A);
+        set_nz(cpu, cpu->reg.A);
     }
     else
     {
         /* Binary mode */
-        sum = cpu->reg.A + value + get_flag(cpu, FLAG_CARRY);
-        set_flag(cpu, FLAG_CARRY, sum > 0xFF);
+        sum = cpu->reg.A + value + flag_get(cpu, FLAG_CARRY);
+        flag_set(cpu, FLAG_CARRY, sum > 0xFF);
         uint8_t result = sum & 0xFF;
-        set_flag(cpu, FLAG_OVERFLOW,
+        flag_set(cpu, FLAG_OVERFLOW,
                  (~(cpu->reg.A ^ value) & (cpu->reg.A ^ result) & 0x80) != 0);
         cpu->reg.A = result;
-        update_zero_and_negative_flags(cpu, cpu->reg.A);
+        set_nz(cpu, cpu->reg.A);
     }
 
     /* Add extra cycle if page boundary crossed (if applicable) */
@@ -241,11 +399,11 @@ static void instr_adc(cpu_6502_t *cpu, addressing_mode_func_t mode)
 }
 
 /* AND (Logical AND) */
-static void instr_and(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_and(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     effective_address_t ea = mode(cpu);
-    cpu->reg.A &= cpu_read(cpu, ea.address);
-    update_zero_and_negative_flags(cpu, cpu->reg.A);
+    cpu->reg.A &= read_byte(cpu, ea.address);
+    set_nz(cpu, cpu->reg.A);
 
     /* Add extra cycle if page boundary crossed (if applicable) */
     if (ea.page_crossed)
@@ -255,51 +413,47 @@ static void instr_and(cpu_6502_t *cpu, addressing_mode_func_t mode)
 }
 
 /* ASL (Arithmetic Shift Left) Memory Mode */
-static void instr_asl(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_asl(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     /* Get the effective address */
     effective_address_t ea = mode(cpu);
     uint16_t addr = ea.address;
 
     /* Read the value from memory */
-    uint8_t value = cpu_read(cpu, addr);
+    uint8_t value = read_byte(cpu, addr);
 
     /* Perform the shift left */
-    set_flag(cpu, FLAG_CARRY, (value & 0x80) != 0);
+    flag_set(cpu, FLAG_CARRY, (value & 0x80) != 0);
     value <<= 1;
 
     /* Write the result back to memory */
-    cpu_write(cpu, addr, value);
+    write_byte(cpu, addr, value);
 
     /* Update Zero and Negative flags */
-    update_zero_and_negative_flags(cpu, value);
+    set_nz(cpu, value);
 
-    /* Add extra cycle if page boundary crossed (if applicable) */
-    if (ea.page_crossed)
-    {
-        cpu->clock.cycle_count += 1;
-    }
+    /* Read-modify-write timing is fixed; no page-crossing penalty */
 }
 
 /* ASL Accumulator */
-static void instr_asl_accumulator(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_asl_accumulator(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     (void)mode; // Suppress unused parameter warning
-    set_flag(cpu, FLAG_CARRY, (cpu->reg.A & 0x80) != 0);
+    flag_set(cpu, FLAG_CARRY, (cpu->reg.A & 0x80) != 0);
     cpu->reg.A <<= 1;
-    update_zero_and_negative_flags(cpu, cpu->reg.A);
+    set_nz(cpu, cpu->reg.A);
 }
 
 /* BCC (Branch if Carry Clear) */
-static void instr_bcc(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_bcc(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     /* Get the effective address and page crossing info */
     effective_address_t ea = mode(cpu);
 
     /* Check if the Carry flag is clear */
-    if (!get_flag(cpu, FLAG_CARRY))
+    if (!flag_get(cpu, FLAG_CARRY))
     {
-        cpu->reg.PC = ea.address;
+        jump_to(cpu, ea.address);
 
         /* Add extra cycles */
         cpu->clock.cycle_count += 1;
@@ -312,13 +466,13 @@ static void instr_bcc(cpu_6502_t *cpu, addressing_mode_func_t mode)
 }
 
 /* BCS (Branch if Carry Set) */
-static void instr_bcs(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_bcs(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     effective_address_t ea = mode(cpu);
 
-    if (get_flag(cpu, FLAG_CARRY))
+    if (flag_get(cpu, FLAG_CARRY))
     {
-        cpu->reg.PC = ea.address;
+        jump_to(cpu, ea.address);
 
         cpu->clock.cycle_count += 1;
         if (ea.page_crossed)
@@ -329,13 +483,13 @@ static void instr_bcs(cpu_6502_t *cpu, addressing_mode_func_t mode)
 }
 
 /* BEQ (Branch if Equal) */
-static void instr_beq(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_beq(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     effective_address_t ea = mode(cpu);
 
-    if (get_flag(cpu, FLAG_ZERO))
+    if (flag_get(cpu, FLAG_ZERO))
     {
-        cpu->reg.PC = ea.address;
+        jump_to(cpu, ea.address);
 
         cpu->clock.cycle_count += 1;
         if (ea.page_crossed)
@@ -346,27 +500,27 @@ static void instr_beq(cpu_6502_t *cpu, addressing_mode_func_t mode)
 }
 
 /* BIT (Bit Test) */
-static void instr_bit(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_bit(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     effective_address_t ea = mode(cpu);
     uint16_t addr = ea.address;
 
-    uint8_t value = cpu_read(cpu, addr);
+    uint8_t value = read_byte(cpu, addr);
     uint8_t result = cpu->reg.A & value;
 
-    set_flag(cpu, FLAG_ZERO, (result == 0));
-    set_flag(cpu, FLAG_OVERFLOW, (value & 0x40) != 0);
-    set_flag(cpu, FLAG_NEGATIVE, (value & 0x80) != 0);
+    flag_set(cpu, FLAG_ZERO, (result == 0));
+    flag_set(cpu, FLAG_OVERFLOW, (value & 0x40) != 0);
+    flag_set(cpu, FLAG_NEGATIVE, (value & 0x80) != 0);
 }
 
 /* BMI (Branch if Minus) */
-static void instr_bmi(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_bmi(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     effective_address_t ea = mode(cpu);
 
-    if (get_flag(cpu, FLAG_NEGATIVE))
+    if (flag_get(cpu, FLAG_NEGATIVE))
     {
-        cpu->reg.PC = ea.address;
+        jump_to(cpu, ea.address);
 
         cpu->clock.cycle_count += 1;
         if (ea.page_crossed)
@@ -377,28 +531,28 @@ static void instr_bmi(cpu_6502_t *cpu, addressing_mode_func_t mode)
 }
 
 /* BNE (Branch if Not Equal) */
-static void instr_bne(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_bne(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     effective_address_t ea = mode(cpu);
-    if (!get_flag(cpu, FLAG_ZERO))
+    if (!flag_get(cpu, FLAG_ZERO))
     {
         cpu->clock.cycle_count += 1;
         if (ea.page_crossed)
         {
             cpu->clock.cycle_count += 1;
         }
-        cpu->reg.PC = ea.address;
+        jump_to(cpu, ea.address);
     }
 }
 
 /* BPL (Branch if Positive) */
-static void instr_bpl(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_bpl(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     effective_address_t ea = mode(cpu);
 
-    if (!get_flag(cpu, FLAG_NEGATIVE))
+    if (!flag_get(cpu, FLAG_NEGATIVE))
     {
-        cpu->reg.PC = ea.address;
+        jump_to(cpu, ea.address);
 
         cpu->clock.cycle_count += 1;
         if (ea.page_crossed)
@@ -409,25 +563,25 @@ static void instr_bpl(cpu_6502_t *cpu, addressing_mode_func_t mode)
 }
 
 /* BRK (Force Interrupt) */
-static void instr_brk(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_brk(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     (void)mode;
     cpu->reg.PC++;
     push_word(cpu, cpu->reg.PC);
-    set_flag(cpu, FLAG_BREAK, true);
-    push_byte(cpu, cpu->reg.P | 0x10); // Set Break flag
-    set_flag(cpu, FLAG_INTERRUPT, true);
-    cpu->reg.PC = cpu_read(cpu, 0xFFFE) | (cpu_read(cpu, 0xFFFF) << 8);
+    flag_set(cpu, FLAG_BREAK, true);
+    push_byte(cpu, status_read(cpu) | 0x10); // Set Break flag
+    flag_set(cpu, FLAG_INTERRUPT, true);
+    cpu->reg.PC = read_byte(cpu, 0xFFFE) | (read_byte(cpu, 0xFFFF) << 8);
 }
 
 /* BVC (Branch if Overflow Clear) */
-static void instr_bvc(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_bvc(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     effective_address_t ea = mode(cpu);
 
-    if (!get_flag(cpu, FLAG_OVERFLOW))
+    if (!flag_get(cpu, FLAG_OVERFLOW))
     {
-        cpu->reg.PC = ea.address;
+        jump_to(cpu, ea.address);
 
         cpu->clock.cycle_count += 1;
         if (ea.page_crossed)
@@ -438,13 +592,13 @@ static void instr_bvc(cpu_6502_t *cpu, addressing_mode_func_t mode)
 }
 
 /* BVS (Branch if Overflow Set) */
-static void instr_bvs(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_bvs(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     effective_address_t ea = mode(cpu);
 
-    if (get_flag(cpu, FLAG_OVERFLOW))
+    if (flag_get(cpu, FLAG_OVERFLOW))
     {
-        cpu->reg.PC = ea.address;
+        jump_to(cpu, ea.address);
 
         cpu->clock.cycle_count += 1;
         if (ea.page_crossed)
@@ -455,44 +609,44 @@ static void instr_bvs(cpu_6502_t *cpu, addressing_mode_func_t mode)
 }
 
 /* CLC (Clear Carry Flag) */
-static void instr_clc(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_clc(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     (void)mode;
-    set_flag(cpu, FLAG_CARRY, false);
+    flag_set(cpu, FLAG_CARRY, false);
 }
 
 /* CLD (Clear Decimal Mode) */
-static void instr_cld(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_cld(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     (void)mode;
-    set_flag(cpu, FLAG_DECIMAL, false);
+    flag_set(cpu, FLAG_DECIMAL, false);
 }
 
 /* CLI (Clear Interrupt Disable) */
-static void instr_cli(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_cli(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     (void)mode;
-    set_flag(cpu, FLAG_INTERRUPT, false);
+    flag_set(cpu, FLAG_INTERRUPT, false);
 }
 
 /* CLV (Clear Overflow Flag) */
-static void instr_clv(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_clv(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     (void)mode;
-    set_flag(cpu, FLAG_OVERFLOW, false);
+    flag_set(cpu, FLAG_OVERFLOW, false);
 }
 
 /* CMP (Compare Accumulator) */
-static void instr_cmp(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_cmp(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     effective_address_t ea = mode(cpu);
     uint16_t addr = ea.address;
 
-    uint8_t value = cpu_read(cpu, addr);
+    uint8_t value = read_byte(cpu, addr);
     uint8_t result = cpu->reg.A - value;
 
-    set_flag(cpu, FLAG_CARRY, cpu->reg.A >= value);
-    update_zero_and_negative_flags(cpu, result);
+    flag_set(cpu, FLAG_CARRY, cpu->reg.A >= value);
+    set_nz(cpu, result);
 
     if (ea.page_crossed)
     {
@@ -501,70 +655,70 @@ static void instr_cmp(cpu_6502_t *cpu, addressing_mode_func_t mode)
 }
 
 /* CPX (Compare X Register) */
-static void instr_cpx(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_cpx(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     effective_address_t ea = mode(cpu);
     uint16_t addr = ea.address;
 
-    uint8_t value = cpu_read(cpu, addr);
+    uint8_t value = read_byte(cpu, addr);
     uint8_t result = cpu->reg.X - value;
 
-    set_flag(cpu, FLAG_CARRY, cpu->reg.X >= value);
-    update_zero_and_negative_flags(cpu, result);
+    flag_set(cpu, FLAG_CARRY, cpu->reg.X >= value);
+    set_nz(cpu, result);
 }
 
 /* CPY (Compare Y Register) */
-static void instr_cpy(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_cpy(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     effective_address_t ea = mode(cpu);
     uint16_t addr = ea.address;
 
-    uint8_t value = cpu_read(cpu, addr);
+    uint8_t value = read_byte(cpu, addr);
     uint8_t result = cpu->reg.Y - value;
 
-    set_flag(cpu, FLAG_CARRY, cpu->reg.Y >= value);
-    update_zero_and_negative_flags(cpu, result);
+    flag_set(cpu, FLAG_CARRY, cpu->reg.Y >= value);
+    set_nz(cpu, result);
 }
 
 /* DEC (Decrement Memory) */
-static void instr_dec(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_dec(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     effective_address_t ea = mode(cpu);
     uint16_t addr = ea.address;
 
-    uint8_t value = cpu_read(cpu, addr);
+    uint8_t value = read_byte(cpu, addr);
     value--;
-    cpu_write(cpu, addr, value);
+    write_byte(cpu, addr, value);
 
-    update_zero_and_negative_flags(cpu, value);
+    set_nz(cpu, value);
 }
 
 /* DEX (Decrement X Register) */
-static void instr_dex(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_dex(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     (void)mode;
     cpu->reg.X--;
-    update_zero_and_negative_flags(cpu, cpu->reg.X);
+    set_nz(cpu, cpu->reg.X);
 }
 
 /* DEY (Decrement Y Register) */
-static void instr_dey(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_dey(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     (void)mode;
     cpu->reg.Y--;
-    update_zero_and_negative_flags(cpu, cpu->reg.Y);
+    set_nz(cpu, cpu->reg.Y);
 }
 
 /* EOR (Exclusive OR) */
-static void instr_eor(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_eor(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     effective_address_t ea = mode(cpu);
     uint16_t addr = ea.address;
 
-    uint8_t value = cpu_read(cpu, addr);
+    uint8_t value = read_byte(cpu, addr);
     cpu->reg.A ^= value;
 
-    update_zero_and_negative_flags(cpu, cpu->reg.A);
+    set_nz(cpu, cpu->reg.A);
 
     if (ea.page_crossed)
     {
@@ -573,43 +727,43 @@ static void instr_eor(cpu_6502_t *cpu, addressing_mode_func_t mode)
 }
 
 /* INC (Increment Memory) */
-static void instr_inc(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_inc(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     effective_address_t ea = mode(cpu);
     uint16_t addr = ea.address;
 
-    uint8_t value = cpu_read(cpu, addr);
+    uint8_t value = read_byte(cpu, addr);
     value++;
-    cpu_write(cpu, addr, value);
+    write_byte(cpu, addr, value);
 
-    update_zero_and_negative_flags(cpu, value);
+    set_nz(cpu, value);
 }
 
 /* INX (Increment X Register) */
-static void instr_inx(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_inx(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     (void)mode;
     cpu->reg.X++;
-    update_zero_and_negative_flags(cpu, cpu->reg.X);
+    set_nz(cpu, cpu->reg.X);
 }
 
 /* INY (Increment Y Register) */
-static void instr_iny(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_iny(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     (void)mode;
     cpu->reg.Y++;
-    update_zero_and_negative_flags(cpu, cpu->reg.Y);
+    set_nz(cpu, cpu->reg.Y);
 }
 
 /* JMP (Jump) */
-static void instr_jmp(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_jmp(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     effective_address_t ea = mode(cpu);
-    cpu->reg.PC = ea.address;
+    jump_to(cpu, ea.address);
 }
 
 /* JSR (Jump to Subroutine) */
-static void instr_jsr(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_jsr(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     effective_address_t ea = mode(cpu);
     uint16_t addr = ea.address;
@@ -622,11 +776,11 @@ static void instr_jsr(cpu_6502_t *cpu, addressing_mode_func_t mode)
 }
 
 /* LDA (Load Accumulator) */
-static void instr_lda(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_lda(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     effective_address_t ea = mode(cpu);
-    cpu->reg.A = cpu_read(cpu, ea.address);
-    update_zero_and_negative_flags(cpu, cpu->reg.A);
+    cpu->reg.A = read_byte(cpu, ea.address);
+    set_nz(cpu, cpu->reg.A);
 
     /* Cycle adjustment */
     if (ea.page_crossed)
@@ -636,13 +790,13 @@ static void instr_lda(cpu_6502_t *cpu, addressing_mode_func_t mode)
 }
 
 /* LDX (Load X Register) */
-static void instr_ldx(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_ldx(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     effective_address_t ea = mode(cpu);
     uint16_t addr = ea.address;
 
-    cpu->reg.X = cpu_read(cpu, addr);
-    update_zero_and_negative_flags(cpu, cpu->reg.X);
+    cpu->reg.X = read_byte(cpu, addr);
+    set_nz(cpu, cpu->reg.X);
 
     if (ea.page_crossed)
     {
@@ -651,13 +805,13 @@ static void instr_ldx(cpu_6502_t *cpu, addressing_mode_func_t mode)
 }
 
 /* LDY (Load Y Register) */
-static void instr_ldy(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_ldy(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     effective_address_t ea = mode(cpu);
     uint16_t addr = ea.address;
 
-    cpu->reg.Y = cpu_read(cpu, addr);
-    update_zero_and_negative_flags(cpu, cpu->reg.Y);
+    cpu->reg.Y = read_byte(cpu, addr);
+    set_nz(cpu, cpu->reg.Y);
 
     if (ea.page_crossed)
     {
@@ -666,32 +820,32 @@ static void instr_ldy(cpu_6502_t *cpu, addressing_mode_func_t mode)
 }
 
 /* LSR (Logical Shift Right) Memory Mode */
-static void instr_lsr(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_lsr(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     effective_address_t ea = mode(cpu);
     uint16_t addr = ea.address;
 
-    uint8_t value = cpu_read(cpu, addr);
+    uint8_t value = read_byte(cpu, addr);
 
-    set_flag(cpu, FLAG_CARRY, (value & 0x01) != 0);
+    flag_set(cpu, FLAG_CARRY, (value & 0x01) != 0);
     value >>= 1;
 
-    cpu_write(cpu, addr, value);
+    write_byte(cpu, addr, value);
 
-    update_zero_and_negative_flags(cpu, value);
+    set_nz(cpu, value);
 }
 
 /* LSR Accumulator */
-static void instr_lsr_accumulator(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_lsr_accumulator(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     (void)mode;
-    set_flag(cpu, FLAG_CARRY, cpu->reg.A & 0x01);
+    flag_set(cpu, FLAG_CARRY, cpu->reg.A & 0x01);
     cpu->reg.A >>= 1;
-    update_zero_and_negative_flags(cpu, cpu->reg.A);
+    set_nz(cpu, cpu->reg.A);
 }
 
 /* NOP (No Operation) */
-static void instr_nop(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_nop(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     (void)cpu;
     (void)mode;
@@ -699,15 +853,15 @@ static void instr_nop(cpu_6502_t *cpu, addressing_mode_func_t mode)
 }
 
 /* ORA (Logical Inclusive OR) */
-static void instr_ora(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_ora(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     effective_address_t ea = mode(cpu);
     uint16_t addr = ea.address;
 
-    uint8_t value = cpu_read(cpu, addr);
+    uint8_t value = read_byte(cpu, addr);
     cpu->reg.A |= value;
 
-    update_zero_and_negative_flags(cpu, cpu->reg.A);
+    set_nz(cpu, cpu->reg.A);
 
     if (ea.page_crossed)
     {
@@ -716,115 +870,115 @@ static void instr_ora(cpu_6502_t *cpu, addressing_mode_func_t mode)
 }
 
 /* PHA (Push Accumulator) */
-static void instr_pha(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_pha(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     (void)mode;
     push_byte(cpu, cpu->reg.A);
 }
 
 /* PHP (Push Processor Status) */
-static void instr_php(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_php(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     (void)mode;
-    push_byte(cpu, cpu->reg.P | 0x30); // Set Break and Unused flags
+    push_byte(cpu, status_read(cpu) | 0x30); // Set Break and Unused flags
 }
 
 /* PLA (Pull Accumulator) */
-static void instr_pla(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_pla(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     (void)mode;
     cpu->reg.A = pull_byte(cpu);
-    update_zero_and_negative_flags(cpu, cpu->reg.A);
+    set_nz(cpu, cpu->reg.A);
 }
 
 /* PLP (Pull Processor Status) */
-static void instr_plp(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_plp(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     (void)mode;
-    cpu->reg.P = (pull_byte(cpu) & 0xEF) | 0x20; // Clear Break flag, set Unused
+    status_write(cpu, (pull_byte(cpu) & 0xEF) | 0x20); // Clear B, set Unused
 }
 
 /* ROL (Rotate Left) Memory Mode */
-static void instr_rol(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_rol(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     effective_address_t ea = mode(cpu);
     uint16_t addr = ea.address;
 
-    uint8_t value = cpu_read(cpu, addr);
-    uint8_t carry_in = get_flag(cpu, FLAG_CARRY);
+    uint8_t value = read_byte(cpu, addr);
+    uint8_t carry_in = flag_get(cpu, FLAG_CARRY);
 
-    set_flag(cpu, FLAG_CARRY, (value & 0x80) != 0);
+    flag_set(cpu, FLAG_CARRY, (value & 0x80) != 0);
     value = (value << 1) | carry_in;
 
-    cpu_write(cpu, addr, value);
+    write_byte(cpu, addr, value);
 
-    update_zero_and_negative_flags(cpu, value);
+    set_nz(cpu, value);
 }
 
 /* ROL Accumulator */
-static void instr_rol_accumulator(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_rol_accumulator(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     (void)mode;
-    uint8_t carry = get_flag(cpu, FLAG_CARRY) ? 1 : 0;
-    set_flag(cpu, FLAG_CARRY, (cpu->reg.A & 0x80) != 0);
+    uint8_t carry = flag_get(cpu, FLAG_CARRY) ? 1 : 0;
+    flag_set(cpu, FLAG_CARRY, (cpu->reg.A & 0x80) != 0);
     cpu->reg.A = (cpu->reg.A << 1) | carry;
-    update_zero_and_negative_flags(cpu, cpu->reg.A);
+    set_nz(cpu, cpu->reg.A);
 }
 
 /* ROR (Rotate Right) Memory Mode */
-static void instr_ror(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_ror(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     effective_address_t ea = mode(cpu);
     uint16_t addr = ea.address;
 
-    uint8_t value = cpu_read(cpu, addr);
-    uint8_t carry_in = get_flag(cpu, FLAG_CARRY) << 7;
+    uint8_t value = read_byte(cpu, addr);
+    uint8_t carry_in = flag_get(cpu, FLAG_CARRY) << 7;
 
-    set_flag(cpu, FLAG_CARRY, (value & 0x01) != 0);
+    flag_set(cpu, FLAG_CARRY, (value & 0x01) != 0);
     value = (value >> 1) | carry_in;
 
-    cpu_write(cpu, addr, value);
+    write_byte(cpu, addr, value);
 
-    update_zero_and_negative_flags(cpu, value);
+    set_nz(cpu, value);
 }
 
 /* ROR Accumulator */
-static void instr_ror_accumulator(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_ror_accumulator(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     (void)mode;
-    uint8_t carry = get_flag(cpu, FLAG_CARRY) ? 0x80 : 0x00;
-    set_flag(cpu, FLAG_CARRY, cpu->reg.A & 0x01);
+    uint8_t carry = flag_get(cpu, FLAG_CARRY) ? 0x80 : 0x00;
+    flag_set(cpu, FLAG_CARRY, cpu->reg.A & 0x01);
     cpu->reg.A = (cpu->reg.A >> 1) | carry;
-    update_zero_and_negative_flags(cpu, cpu->reg.A);
+    set_nz(cpu, cpu->reg.A);
 }
 
 /* RTI (Return from Interrupt) */
-static void instr_rti(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_rti(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     (void)mode;
-    cpu->reg.P = pull_byte(cpu);
+    status_write(cpu, pull_byte(cpu));
     cpu->reg.PC = pull_word(cpu);
 }
 
 /* RTS (Return from Subroutine) */
-static void instr_rts(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_rts(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     (void)mode;
     cpu->reg.PC = pull_word(cpu) + 1;
 }
 
 /* SBC (Subtract with Carry) */
-static void instr_sbc(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_sbc(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     effective_address_t ea = mode(cpu);
     uint16_t addr = ea.address;
-    uint8_t value = cpu_read(cpu, addr);
+    uint8_t value = read_byte(cpu, addr);
     uint8_t carry =
-        get_flag(cpu, FLAG_CARRY) ? 0 : 1; // Inverted for subtraction
+        flag_get(cpu, FLAG_CARRY) ? 0 : 1; // Inverted for subtraction
 
     uint16_t diff;
 
-    if (get_flag(cpu, FLAG_DECIMAL))
+    if (flag_get(cpu, FLAG_DECIMAL))
     {
         // Implement Decimal mode subtraction here
         // For brevity, the BCD mode implementation is omitted
@@ -832,12 +986,12 @@ static void instr_sbc(cpu_6502_t *cpu, addressing_mode_func_t mode)
     else
     {
         diff = cpu->reg.A - value - carry;
-        set_flag(cpu, FLAG_CARRY, diff < 0x100);
+        flag_set(cpu, FLAG_CARRY, diff < 0x100);
         uint8_t result = diff & 0xFF;
-        set_flag(cpu, FLAG_OVERFLOW,
+        flag_set(cpu, FLAG_OVERFLOW,
                  ((cpu->reg.A ^ value) & (cpu->reg.A ^ result) & 0x80) != 0);
         cpu->reg.A = result;
-        update_zero_and_negative_flags(cpu, cpu->reg.A);
+        set_nz(cpu, cpu->reg.A);
     }
 
     if (ea.page_crossed)
@@ -847,98 +1001,98 @@ static void instr_sbc(cpu_6502_t *cpu, addressing_mode_func_t mode)
 }
 
 /* SEC (Set Carry Flag) */
-static void instr_sec(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_sec(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     (void)mode;
-    set_flag(cpu, FLAG_CARRY, true);
+    flag_set(cpu, FLAG_CARRY, true);
 }
 
 /* SED (Set Decimal Flag) */
-static void instr_sed(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_sed(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     (void)mode;
-    set_flag(cpu, FLAG_DECIMAL, true);
+    flag_set(cpu, FLAG_DECIMAL, true);
 }
 
 /* SEI (Set Interrupt Disable) */
-static void instr_sei(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_sei(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     (void)mode;
-    set_flag(cpu, FLAG_INTERRUPT, true);
+    flag_set(cpu, FLAG_INTERRUPT, true);
 }
 
 /* STA (Store Accumulator) */
-static void instr_sta(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_sta(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     effective_address_t ea = mode(cpu);
     uint16_t addr = ea.address;
 
-    cpu_write(cpu, addr, cpu->reg.A);
+    write_byte(cpu, addr, cpu->reg.A);
 }
 
 /* STX (Store X Register) */
-static void instr_stx(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_stx(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     effective_address_t ea = mode(cpu);
     uint16_t addr = ea.address;
 
-    cpu_write(cpu, addr, cpu->reg.X);
+    write_byte(cpu, addr, cpu->reg.X);
 }
 
 /* STY (Store Y Register) */
-static void instr_sty(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_sty(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     effective_address_t ea = mode(cpu);
     uint16_t addr = ea.address;
 
-    cpu_write(cpu, addr, cpu->reg.Y);
+    write_byte(cpu, addr, cpu->reg.Y);
 }
 
 /* TAX (Transfer Accumulator to X) */
-static void instr_tax(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_tax(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     (void)mode;
     cpu->reg.X = cpu->reg.A;
-    update_zero_and_negative_flags(cpu, cpu->reg.X);
+    set_nz(cpu, cpu->reg.X);
 }
 
 /* TAY (Transfer Accumulator to Y) */
-static void instr_tay(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_tay(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     (void)mode;
     cpu->reg.Y = cpu->reg.A;
-    update_zero_and_negative_flags(cpu, cpu->reg.Y);
+    set_nz(cpu, cpu->reg.Y);
 }
 
 /* TSX (Transfer Stack Pointer to X) */
-static void instr_tsx(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_tsx(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     (void)mode;
     cpu->reg.X = cpu->reg.SP;
-    update_zero_and_negative_flags(cpu, cpu->reg.X);
+    set_nz(cpu, cpu->reg.X);
 }
 
 /* TXA (Transfer X to Accumulator) */
-static void instr_txa(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_txa(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     (void)mode;
     cpu->reg.A = cpu->reg.X;
-    update_zero_and_negative_flags(cpu, cpu->reg.A);
+    set_nz(cpu, cpu->reg.A);
 }
 
 /* TXS (Transfer X to Stack Pointer) */
-static void instr_txs(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_txs(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     (void)mode;
     cpu->reg.SP = cpu->reg.X;
 }
 
 /* TYA (Transfer Y to Accumulator) */
-static void instr_tya(cpu_6502_t *cpu, addressing_mode_func_t mode)
+static CPU_INLINE void instr_tya(cpu_6502_t *cpu, addressing_mode_func_t mode)
 {
     (void)mode;
     cpu->reg.A = cpu->reg.Y;
-    update_zero_and_negative_flags(cpu, cpu->reg.A);
+    set_nz(cpu, cpu->reg.A);
 }
 
 /* Opcode Table Entry */
@@ -1076,7 +1230,7 @@ static void initialize_opcode_table()
     opcode_table[0xC5] =
         (opcode_entry_t){0xC5, "CMP", instr_cmp, addr_zero_page, 3, 2};
     opcode_table[0xD5] =
-        (opcode_entry_t){0xD5, "CMP", instr_cmp, addr_zero_page_x, 3, 2};
+        (opcode_entry_t){0xD5, "CMP", instr_cmp, addr_zero_page_x, 4, 2};
     opcode_table[0xCD] =
         (opcode_entry_t){0xCD, "CMP", instr_cmp, addr_absolute, 4, 3};
     opcode_table[0xDD] =
@@ -1108,7 +1262,7 @@ static void initialize_opcode_table()
     opcode_table[0xC6] =
         (opcode_entry_t){0xC6, "DEC", instr_dec, addr_zero_page, 5, 2};
     opcode_table[0xD6] =
-        (opcode_entry_t){0xD6, "DEC", instr_dec, addr_zero_page_x, 5, 2};
+        (opcode_entry_t){0xD6, "DEC", instr_dec, addr_zero_page_x, 6, 2};
     opcode_table[0xCE] =
         (opcode_entry_t){0xCE, "DEC", instr_dec, addr_absolute, 6, 3};
     opcode_table[0xDE] =
@@ -1142,9 +1296,9 @@ static void initialize_opcode_table()
     opcode_table[0xE6] =
         (opcode_entry_t){0xE6, "INC", instr_inc, addr_zero_page, 5, 2};
     opcode_table[0xF6] =
-        (opcode_entry_t){0xF6, "INC", instr_inc, addr_zero_page_x, 5, 2};
+        (opcode_entry_t){0xF6, "INC", instr_inc, addr_zero_page_x, 6, 2};
     opcode_table[0xEE] =
-        (opcode_entry_t){0xEE, "INC", instr_inc, addr_absolute, 7, 3};
+        (opcode_entry_t){0xEE, "INC", instr_inc, addr_absolute, 6, 3};
     opcode_table[0xFE] =
         (opcode_entry_t){0xFE, "INC", instr_inc, addr_absolute_x, 7, 3};
 
@@ -1214,7 +1368,7 @@ static void initialize_opcode_table()
     opcode_table[0x56] =
         (opcode_entry_t){0x56, "LSR", instr_lsr, addr_zero_page_x, 6, 2};
     opcode_table[0x4E] =
-        (opcode_entry_t){0x4E, "LSR", instr_lsr, addr_absolute, 7, 3};
+        (opcode_entry_t){0x4E, "LSR", instr_lsr, addr_absolute, 6, 3};
     opcode_table[0x5E] =
         (opcode_entry_t){0x5E, "LSR", instr_lsr, addr_absolute_x, 7, 3};
 
@@ -1259,7 +1413,7 @@ static void initialize_opcode_table()
     opcode_table[0x36] =
         (opcode_entry_t){0x36, "ROL", instr_rol, addr_zero_page_x, 6, 2};
     opcode_table[0x2E] =
-        (opcode_entry_t){0x2E, "ROL", instr_rol, addr_absolute, 7, 3};
+        (opcode_entry_t){0x2E, "ROL", instr_rol, addr_absolute, 6, 3};
     opcode_table[0x3E] =
         (opcode_entry_t){0x3E, "ROL", instr_rol, addr_absolute_x, 7, 3};
 
@@ -1271,7 +1425,7 @@ static void initialize_opcode_table()
     opcode_table[0x76] =
         (opcode_entry_t){0x76, "ROR", instr_ror, addr_zero_page_x, 6, 2};
     opcode_table[0x6E] =
-        (opcode_entry_t){0x6E, "ROR", instr_ror, addr_absolute, 7, 3};
+        (opcode_entry_t){0x6E, "ROR", instr_ror, addr_absolute, 6, 3};
     opcode_table[0x7E] =
         (opcode_entry_t){0x7E, "ROR", instr_ror, addr_absolute_x, 7, 3};
 
@@ -1289,7 +1443,7 @@ static void initialize_opcode_table()
     opcode_table[0xE5] =
         (opcode_entry_t){0xE5, "SBC", instr_sbc, addr_zero_page, 3, 2};
     opcode_table[0xF5] =
-        (opcode_entry_t){0xF5, "SBC", instr_sbc, addr_zero_page_x, 3, 2};
+        (opcode_entry_t){0xF5, "SBC", instr_sbc, addr_zero_page_x, 4, 2};
     opcode_table[0xED] =
         (opcode_entry_t){0xED, "SBC", instr_sbc, addr_absolute, 4, 3};
     opcode_table[0xFD] =
@@ -1361,6 +1515,390 @@ static void initialize_opcode_table()
     opcode_table[0x98] = (opcode_entry_t){0x98, "TYA", instr_tya, NULL, 2, 1};
 }
 
+/* Predecode Engine */
+
+/* Addressing modes for predecoded instructions. The decode cache already
+ * extracted the operand bytes and PC already points past the instruction,
+ * so these only combine cpu->decoded_operand with the registers; indirect
+ * modes still read their pointers from memory because those can change.
+ * execute_decoded() below inlines them like the switch engine does. */
+static CPU_INLINE effective_address_t pd_immediate(cpu_6502_t *cpu)
+{
+    return (effective_address_t){(uint16_t)(cpu->reg.PC - 1), false};
+}
+
+static CPU_INLINE effective_address_t pd_zero_page(cpu_6502_t *cpu)
+{
+    return (effective_address_t){cpu->decoded_operand & 0xFF, false};
+}
+
+static CPU_INLINE effective_address_t pd_zero_page_x(cpu_6502_t *cpu)
+{
+    uint8_t addr = (cpu->decoded_operand + cpu->reg.X) & 0xFF;
+    return (effective_address_t){addr, false};
+}
+
+static CPU_INLINE effective_address_t pd_zero_page_y(cpu_6502_t *cpu)
+{
+    uint8_t addr = (cpu->decoded_operand + cpu->reg.Y) & 0xFF;
+    return (effective_address_t){addr, false};
+}
+
+static CPU_INLINE effective_address_t pd_absolute(cpu_6502_t *cpu)
+{
+    return (effective_address_t){cpu->decoded_operand, false};
+}
+
+static CPU_INLINE effective_address_t pd_absolute_x(cpu_6502_t *cpu)
+{
+    uint16_t base_address = cpu->decoded_operand;
+    uint16_t effective_address = base_address + cpu->reg.X;
+    bool page_crossed = (base_address & 0xFF00) != (effective_address & 0xFF00);
+    return (effective_address_t){effective_address, page_crossed};
+}
+
+static CPU_INLINE effective_address_t pd_absolute_y(cpu_6502_t *cpu)
+{
+    uint16_t base_address = cpu->decoded_operand;
+    uint16_t effective_address = base_address + cpu->reg.Y;
+    bool page_crossed = (base_address & 0xFF00) != (effective_address & 0xFF00);
+    return (effective_address_t){effective_address, page_crossed};
+}
+
+static CPU_INLINE effective_address_t pd_indirect(cpu_6502_t *cpu)
+{
+    uint16_t ptr = cpu->decoded_operand;
+    uint8_t low = read_byte(cpu, ptr);
+    uint8_t high = read_byte(cpu, (ptr & 0xFF00) |
+                                     ((ptr + 1) & 0x00FF)); // Simulate 6502 bug
+    uint16_t addr = ((uint16_t)high << 8) | low;
+    return (effective_address_t){addr, false};
+}
+
+static CPU_INLINE effective_address_t pd_indirect_x(cpu_6502_t *cpu)
+{
+    uint8_t base = (cpu->decoded_operand + cpu->reg.X) & 0xFF;
+    uint8_t low = read_byte(cpu, base);
+    uint8_t high = read_byte(cpu, (base + 1) & 0xFF);
+    uint16_t addr = ((uint16_t)high << 8) | low;
+    return (effective_address_t){addr, false};
+}
+
+static CPU_INLINE effective_address_t pd_indirect_y(cpu_6502_t *cpu)
+{
+    uint8_t base = cpu->decoded_operand & 0xFF;
+    uint8_t low = read_byte(cpu, base);
+    uint8_t high = read_byte(cpu, (base + 1) & 0xFF);
+    uint16_t base_address = ((uint16_t)high << 8) | low;
+    uint16_t effective_address = base_address + cpu->reg.Y;
+    bool page_crossed = (base_address & 0xFF00) != (effective_address & 0xFF00);
+    return (effective_address_t){effective_address, page_crossed};
+}
+
+static CPU_INLINE effective_address_t pd_relative(cpu_6502_t *cpu)
+{
+    int8_t offset = (int8_t)(cpu->decoded_operand & 0xFF);
+    uint16_t effective_address = cpu->reg.PC + offset;
+    bool page_crossed = (cpu->reg.PC & 0xFF00) != (effective_address & 0xFF00);
+    return (effective_address_t){effective_address, page_crossed};
+}
+
+/* Per-opcode description handed to the decode cache */
+static decode_op_t decode_ops[256];
+
+/* Build decode_ops from the opcode table */
+static void initialize_decode_ops()
+{
+    for (int i = 0; i < 256; i++)
+    {
+        const opcode_entry_t *op = &opcode_table[i];
+
+        decode_ops[i].cacheable = op->execute != NULL;
+        decode_ops[i].length = op->bytes;
+        decode_ops[i].cycles = op->cycles;
+        decode_ops[i].ends_block =
+            op->addr_mode == addr_relative || i == 0x00 || i == 0x20 ||
+            i == 0x40 || i == 0x4C || i == 0x60 || i == 0x6C;
+    }
+}
+
+/* Data access of each opcode for the tracer (TRACE_ACCESS_*) */
+static uint8_t trace_access_kind[256];
+
+static void initialize_trace_access()
+{
+    static const char *const writes[] = {"STA", "STX", "STY", "ASL", "LSR",
+                                         "ROL", "ROR", "INC", "DEC"};
+
+    for (int i = 0; i < 256; i++)
+    {
+        const opcode_entry_t *op = &opcode_table[i];
+        addressing_mode_func_t mode = op->addr_mode;
+
+        trace_access_kind[i] = TRACE_ACCESS_NONE;
+
+        // Jumps take their absolute operand as the target, not as data
+        if (!op->execute || !mode || mode == addr_immediate ||
+            mode == addr_relative || mode == addr_indirect || i == 0x20 ||
+            i == 0x4C)
+            continue;
+
+        trace_access_kind[i] = TRACE_ACCESS_READ;
+
+        for (size_t w = 0; w < sizeof(writes) / sizeof(writes[0]); w++)
+            if (strcmp(op->mnemonic, writes[w]) == 0)
+                trace_access_kind[i] = TRACE_ACCESS_WRITE;
+    }
+}
+
+/* Switch Dispatch Engine */
+
+/* Every documented opcode with its handler and addressing mode. The mode is
+ * a suffix so each engine can paste its own family of addressing functions
+ * (addr_* fetch operands through PC, pd_* take them from the decode);
+ * "implied" stands for the modes that take no operand. */
+#define addr_implied NULL
+#define pd_implied NULL
+
+#define CPU_OPCODE_LIST(OP) \
+    OP(0x00, instr_brk, implied) \
+    OP(0x01, instr_ora, indirect_x) \
+    OP(0x05, instr_ora, zero_page) \
+    OP(0x06, instr_asl, zero_page) \
+    OP(0x08, instr_php, implied) \
+    OP(0x09, instr_ora, immediate) \
+    OP(0x0A, instr_asl_accumulator, implied) \
+    OP(0x0D, instr_ora, absolute) \
+    OP(0x0E, instr_asl, absolute) \
+    OP(0x10, instr_bpl, relative) \
+    OP(0x11, instr_ora, indirect_y) \
+    OP(0x15, instr_ora, zero_page_x) \
+    OP(0x16, instr_asl, zero_page_x) \
+    OP(0x18, instr_clc, implied) \
+    OP(0x19, instr_ora, absolute_y) \
+    OP(0x1D, instr_ora, absolute_x) \
+    OP(0x1E, instr_asl, absolute_x) \
+    OP(0x20, instr_jsr, absolute) \
+    OP(0x21, instr_and, indirect_x) \
+    OP(0x24, instr_bit, zero_page) \
+    OP(0x25, instr_and, zero_page) \
+    OP(0x26, instr_rol, zero_page) \
+    OP(0x28, instr_plp, implied) \
+    OP(0x29, instr_and, immediate) \
+    OP(0x2A, instr_rol_accumulator, implied) \
+    OP(0x2C, instr_bit, absolute) \
+    OP(0x2D, instr_and, absolute) \
+    OP(0x2E, instr_rol, absolute) \
+    OP(0x30, instr_bmi, relative) \
+    OP(0x31, instr_and, indirect_y) \
+    OP(0x35, instr_and, zero_page_x) \
+    OP(0x36, instr_rol, zero_page_x) \
+    OP(0x38, instr_sec, implied) \
+    OP(0x39, instr_and, absolute_y) \
+    OP(0x3D, instr_and, absolute_x) \
+    OP(0x3E, instr_rol, absolute_x) \
+    OP(0x40, instr_rti, implied) \
+    OP(0x41, instr_eor, indirect_x) \
+    OP(0x45, instr_eor, zero_page) \
+    OP(0x46, instr_lsr, zero_page) \
+    OP(0x48, instr_pha, implied) \
+    OP(0x49, instr_eor, immediate) \
+    OP(0x4A, instr_lsr_accumulator, implied) \
+    OP(0x4C, instr_jmp, absolute) \
+    OP(0x4D, instr_eor, absolute) \
+    OP(0x4E, instr_lsr, absolute) \
+    OP(0x50, instr_bvc, relative) \
+    OP(0x51, instr_eor, indirect_y) \
+    OP(0x55, instr_eor, zero_page_x) \
+    OP(0x56, instr_lsr, zero_page_x) \
+    OP(0x58, instr_cli, implied) \
+    OP(0x59, instr_eor, absolute_y) \
+    OP(0x5D, instr_eor, absolute_x) \
+    OP(0x5E, instr_lsr, absolute_x) \
+    OP(0x60, instr_rts, implied) \
+    OP(0x61, instr_adc, indirect_x) \
+    OP(0x65, instr_adc, zero_page) \
+    OP(0x66, instr_ror, zero_page) \
+    OP(0x68, instr_pla, implied) \
+    OP(0x69, instr_adc, immediate) \
+    OP(0x6A, instr_ror_accumulator, implied) \
+    OP(0x6C, instr_jmp, indirect) \
+    OP(0x6D, instr_adc, absolute) \
+    OP(0x6E, instr_ror, absolute) \
+    OP(0x70, instr_bvs, relative) \
+    OP(0x71, instr_adc, indirect_y) \
+    OP(0x75, instr_adc, zero_page_x) \
+    OP(0x76, instr_ror, zero_page_x) \
+    OP(0x78, instr_sei, implied) \
+    OP(0x79, instr_adc, absolute_y) \
+    OP(0x7D, instr_adc, absolute_x) \
+    OP(0x7E, instr_ror, absolute_x) \
+    OP(0x81, instr_sta, indirect_x) \
+    OP(0x84, instr_sty, zero_page) \
+    OP(0x85, instr_sta, zero_page) \
+    OP(0x86, instr_stx, zero_page) \
+    OP(0x88, instr_dey, implied) \
+    OP(0x8A, instr_txa, implied) \
+    OP(0x8C, instr_sty, absolute) \
+    OP(0x8D, instr_sta, absolute) \
+    OP(0x8E, instr_stx, absolute) \
+    OP(0x90, instr_bcc, relative) \
+    OP(0x91, instr_sta, indirect_y) \
+    OP(0x94, instr_sty, zero_page_x) \
+    OP(0x95, instr_sta, zero_page_x) \
+    OP(0x96, instr_stx, zero_page_y) \
+    OP(0x98, instr_tya, implied) \
+    OP(0x99, instr_sta, absolute_y) \
+    OP(0x9A, instr_txs, implied) \
+    OP(0x9D, instr_sta, absolute_x) \
+    OP(0xA0, instr_ldy, immediate) \
+    OP(0xA1, instr_lda, indirect_x) \
+    OP(0xA2, instr_ldx, immediate) \
+    OP(0xA4, instr_ldy, zero_page) \
+    OP(0xA5, instr_lda, zero_page) \
+    OP(0xA6, instr_ldx, zero_page) \
+    OP(0xA8, instr_tay, implied) \
+    OP(0xA9, instr_lda, immediate) \
+    OP(0xAA, instr_tax, implied) \
+    OP(0xAC, instr_ldy, absolute) \
+    OP(0xAD, instr_lda, absolute) \
+    OP(0xAE, instr_ldx, absolute) \
+    OP(0xB0, instr_bcs, relative) \
+    OP(0xB1, instr_lda, indirect_y) \
+    OP(0xB4, instr_ldy, zero_page_x) \
+    OP(0xB5, instr_lda, zero_page_x) \
+    OP(0xB6, instr_ldx, zero_page_y) \
+    OP(0xB8, instr_clv, implied) \
+    OP(0xB9, instr_lda, absolute_y) \
+    OP(0xBA, instr_tsx, implied) \
+    OP(0xBC, instr_ldy, absolute_x) \
+    OP(0xBD, instr_lda, absolute_x) \
+    OP(0xBE, instr_ldx, absolute_y) \
+    OP(0xC0, instr_cpy, immediate) \
+    OP(0xC1, instr_cmp, indirect_x) \
+    OP(0xC4, instr_cpy, zero_page) \
+    OP(0xC5, instr_cmp, zero_page) \
+    OP(0xC6, instr_dec, zero_page) \
+    OP(0xC8, instr_iny, implied) \
+    OP(0xC9, instr_cmp, immediate) \
+    OP(0xCA, instr_dex, implied) \
+    OP(0xCC, instr_cpy, absolute) \
+    OP(0xCD, instr_cmp, absolute) \
+    OP(0xCE, instr_dec, absolute) \
+    OP(0xD0, instr_bne, relative) \
+    OP(0xD1, instr_cmp, indirect_y) \
+    OP(0xD5, instr_cmp, zero_page_x) \
+    OP(0xD6, instr_dec, zero_page_x) \
+    OP(0xD8, instr_cld, implied) \
+    OP(0xD9, instr_cmp, absolute_y) \
+    OP(0xDD, instr_cmp, absolute_x) \
+    OP(0xDE, instr_dec, absolute_x) \
+    OP(0xE0, instr_cpx, immediate) \
+    OP(0xE1, instr_sbc, indirect_x) \
+    OP(0xE4, instr_cpx, zero_page) \
+    OP(0xE5, instr_sbc, zero_page) \
+    OP(0xE6, instr_inc, zero_page) \
+    OP(0xE8, instr_inx, implied) \
+    OP(0xE9, instr_sbc, immediate) \
+    OP(0xEA, instr_nop, implied) \
+    OP(0xEB, instr_sbc, immediate) \
+    OP(0xEC, instr_cpx, absolute) \
+    OP(0xED, instr_sbc, absolute) \
+    OP(0xEE, instr_inc, absolute) \
+    OP(0xF0, instr_beq, relative) \
+    OP(0xF1, instr_sbc, indirect_y) \
+    OP(0xF5, instr_sbc, zero_page_x) \
+    OP(0xF6, instr_inc, zero_page_x) \
+    OP(0xF8, instr_sed, implied) \
+    OP(0xF9, instr_sbc, absolute_y) \
+    OP(0xFD, instr_sbc, absolute_x) \
+    OP(0xFE, instr_inc, absolute_x)
+
+/* Execute one already-fetched opcode through a 256-way switch. Every case
+ * names its handler and addressing mode as compile-time constants, so the
+ * compiler can inline both into the case body instead of making the two
+ * indirect calls the table engine needs. Semantics are shared with the table
+ * engine because the very same instr_* and addr_* functions are used, and
+ * base cycles come from the same opcode table. */
+#define SWITCH_OP(code, instr, mode)                          \
+    case code:                                                \
+        instr(cpu, addr_##mode);                              \
+        cpu->clock.cycle_count += opcode_table[code].cycles;  \
+        return CPU_SUCCESS;
+
+static cpu_status_t execute_opcode_switch(cpu_6502_t *cpu, uint8_t opcode)
+{
+    switch (opcode)
+    {
+        CPU_OPCODE_LIST(SWITCH_OP)
+    default:
+        fprintf(stderr, "Invalid opcode 0x%02X at PC: $%04X\n", opcode,
+                cpu->reg.PC - 1);
+        return CPU_ERROR_INVALID_OPCODE;
+    }
+}
+
+#undef SWITCH_OP
+
+/* Execute one predecoded instruction. The same switch again, but with the
+ * pd_* addressing modes inlined: no opcode or operand fetch is left. Only
+ * valid opcodes are ever decoded, so there is no default case. */
+#define PREDECODED_OP(code, instr, mode) \
+    case code:                           \
+        instr(cpu, pd_##mode);           \
+        break;
+
+static CPU_INLINE void execute_decoded(cpu_6502_t *cpu,
+                                       const decoded_insn_t *insn)
+{
+    cpu->reg.PC = insn->next_pc;
+    cpu->decoded_operand = insn->operand;
+
+    switch (insn->opcode)
+    {
+        CPU_OPCODE_LIST(PREDECODED_OP)
+    }
+
+    cpu->clock.cycle_count += insn->cycles;
+}
+
+#undef PREDECODED_OP
+
+/* JIT Handlers */
+
+/* One out-of-line function per opcode for translated code to call: the
+ * predecoded case body again, as a function of the CPU alone. The operand
+ * kind tells the translator which addresses the opcode can reach. */
+#define JIT_OPERAND_implied JIT_OPERAND_NONE
+#define JIT_OPERAND_immediate JIT_OPERAND_NONE
+#define JIT_OPERAND_relative JIT_OPERAND_NONE
+#define JIT_OPERAND_zero_page JIT_OPERAND_ZERO_PAGE
+#define JIT_OPERAND_zero_page_x JIT_OPERAND_ZERO_PAGE
+#define JIT_OPERAND_zero_page_y JIT_OPERAND_ZERO_PAGE
+#define JIT_OPERAND_absolute JIT_OPERAND_ABSOLUTE
+#define JIT_OPERAND_indirect JIT_OPERAND_ABSOLUTE // Only reads the pointer
+#define JIT_OPERAND_absolute_x JIT_OPERAND_INDEXED
+#define JIT_OPERAND_absolute_y JIT_OPERAND_INDEXED
+#define JIT_OPERAND_indirect_x JIT_OPERAND_POINTER
+#define JIT_OPERAND_indirect_y JIT_OPERAND_POINTER
+
+#define JIT_HANDLER(code, instr, mode)              \
+    static void jit_op_##code(cpu_6502_t *cpu)      \
+    {                                               \
+        instr(cpu, pd_##mode);                      \
+    }
+
+CPU_OPCODE_LIST(JIT_HANDLER)
+
+#undef JIT_HANDLER
+
+#define JIT_OP(code, instr, mode) \
+    [code] = {jit_op_##code, JIT_OPERAND_##mode},
+
+static const jit_op_t jit_ops[256] = {CPU_OPCODE_LIST(JIT_OP)};
+
+#undef JIT_OP
+
 /* CPU Interface Implementations */
 
 /* Initialize the CPU */
@@ -1376,6 +1914,7 @@ cpu_status_t cpu_init(cpu_6502_t *cpu)
     cpu->reg.PC = 0x0000;
     cpu->reg.SP = 0xFD;  // Stack pointer starts at 0xFD (real 6502 behavior)
     cpu->reg.P = 0x34;
+    flags_unpack(cpu);
 
     // Initialize clock (default 1 MHz)
     if (clock_init(&cpu->clock, 1e6) != 0) // 1 MHz
@@ -1389,16 +1928,14 @@ cpu_status_t cpu_init(cpu_6502_t *cpu)
     {
         return CPU_ERROR_INVALID_ARGUMENT;
     }
+    bus_set_watch_hook(cpu->bus, watchpoint_hit, cpu);
 
     // Initialize I/O queues
     queue_init(&cpu->input_queue);
     queue_init(&cpu->output_queue);
 
     // Initialize mutexes and condition variables
-    if (pthread_mutex_init(&cpu->input_queue_mutex, NULL) != 0 ||
-        pthread_mutex_init(&cpu->output_queue_mutex, NULL) != 0 ||
-        pthread_mutex_init(&cpu->interrupt_mutex, NULL) != 0 ||
-        pthread_mutex_init(&cpu->pause_mutex, NULL) != 0)
+    if (pthread_mutex_init(&cpu->pause_mutex, NULL) != 0)
     {
         fprintf(stderr, "Failed to initialize mutexes.\n");
         return CPU_ERROR_INVALID_ARGUMENT;
@@ -1410,18 +1947,51 @@ cpu_status_t cpu_init(cpu_6502_t *cpu)
         return CPU_ERROR_INVALID_ARGUMENT;
     }
 
-    // Initialize interrupt flags
-    cpu->IRQ_pending = false;
-    cpu->NMI_pending = false;
+    if (pthread_mutex_init(&cpu->idle_mutex, NULL) != 0 ||
+        pthread_cond_init(&cpu->idle_cond, NULL) != 0)
+    {
+        fprintf(stderr, "Failed to initialize idle wait.\n");
+        return CPU_ERROR_INVALID_ARGUMENT;
+    }
 
-    // Initialize pause flag
-    cpu->paused = false;
+    // Initialize interrupt flags, IRQ sources and the event timeline
+    atomic_init(&cpu->IRQ_pending, false);
+    atomic_init(&cpu->NMI_pending, false);
+    atomic_init(&cpu->irq_sources, 0);
+    cpu->irq_sources_claimed = 0;
+    scheduler_init(&cpu->scheduler);
+
+    // Initialize pause and run control flags
+    atomic_init(&cpu->paused, false);
+    atomic_init(&cpu->stop_requested, false);
+    atomic_init(&cpu->attention, false);
+    cpu->stop_reason = CPU_STOP_BUDGET;
+    cpu->watch_hit = false;
+    cpu->watch_write = false;
+    cpu->watch_addr = 0;
+
+    // Idle-loop skipping is on until cpu_set_idle_skip() turns it off
+    memset(&cpu->idle, 0, sizeof(cpu->idle));
+    cpu->idle.enabled = true;
+    atomic_init(&cpu->idle_waiting, false);
 
     // Initialize debug mode
     cpu->debug_mode = false;
+    cpu->tracer = NULL;
+    cpu->profiler = NULL;
+    cpu->pc_history_enabled = false;
+    cpu->pc_history_count = 0;
+
+    // Default to the table engine; cpu_set_engine() selects another one
+    cpu->engine = CPU_ENGINE_TABLE;
+    cpu->decode_cache = NULL;
+    cpu->jit = NULL;
+    cpu->decoded_operand = 0;
 
     // Initialize opcode table
     initialize_opcode_table();
+    initialize_decode_ops();
+    initialize_trace_access();
 
     // Initialize performance metrics
     cpu->performance_percent = 0.0;
@@ -1434,35 +2004,13 @@ cpu_status_t cpu_init(cpu_6502_t *cpu)
 /* Read a byte from memory */
 uint8_t cpu_read(cpu_6502_t *cpu, uint16_t addr)
 {
-    if (addr == INPUT_ADDR)
-    {
-        uint8_t data;
-        pthread_mutex_lock(&cpu->input_queue_mutex);
-        if (queue_dequeue(&cpu->input_queue, &data))
-        {
-            pthread_mutex_unlock(&cpu->input_queue_mutex);
-            return data;
-        }
-        pthread_mutex_unlock(&cpu->input_queue_mutex);
-        return 0x00; // No data available
-    }
-
-    return bus_read(cpu->bus, addr);
+    return read_byte(cpu, addr);
 }
 
 /* Write a byte to memory */
 void cpu_write(cpu_6502_t *cpu, uint16_t addr, uint8_t data)
 {
-    if (addr == OUTPUT_ADDR)
-    {
-        pthread_mutex_lock(&cpu->output_queue_mutex);
-        queue_enqueue(&cpu->output_queue, data);
-        pthread_mutex_unlock(&cpu->output_queue_mutex);
-    }
-    else
-    {
-        bus_write(cpu->bus, addr, data);
-    }
+    write_byte(cpu, addr, data);
 }
 
 /* Destroy the CPU and Free Resources */
@@ -1475,11 +2023,16 @@ void cpu_destroy(cpu_6502_t *cpu)
         queue_destroy(&cpu->output_queue);
 
         // Destroy mutexes and condition variables
-        pthread_mutex_destroy(&cpu->input_queue_mutex);
-        pthread_mutex_destroy(&cpu->output_queue_mutex);
-        pthread_mutex_destroy(&cpu->interrupt_mutex);
         pthread_mutex_destroy(&cpu->pause_mutex);
         pthread_cond_destroy(&cpu->pause_cond);
+        pthread_mutex_destroy(&cpu->idle_mutex);
+        pthread_cond_destroy(&cpu->idle_cond);
+
+        // Destroy the JIT, then the decode cache (unhooks it from the bus)
+        jit_destroy(cpu->jit);
+        cpu->jit = NULL;
+        decode_cache_destroy(cpu->decode_cache);
+        cpu->decode_cache = NULL;
 
         // Destroy clock
         clock_destroy(&cpu->clock);
@@ -1508,18 +2061,28 @@ void cpu_reset(cpu_6502_t *cpu)
     uint8_t high = cpu_read(cpu, 0xFFFD);
     cpu->reg.PC = ((uint16_t)high << 8) | (uint16_t)low;
 
-    // Reset clock cycle count
-    cpu->clock.cycle_count = 0;
-
-    // Clear interrupt flags
-    pthread_mutex_lock(&cpu->interrupt_mutex);
-    cpu->IRQ_pending = false;
-    cpu->NMI_pending = false;
-    pthread_mutex_unlock(&cpu->interrupt_mutex);
+    // Restart the clock; the reset sequence itself takes 7 cycles. Pending
+    // events keep the cycles they had left
+    uint64_t old_cycle = cpu->clock.cycle_count;
+    clock_reset(&cpu->clock);
+    cpu->clock.cycle_count = 7;
+    scheduler_rebase(&cpu->scheduler, old_cycle, cpu->clock.cycle_count);
+
+    // Clear interrupt and run control flags
+    atomic_store(&cpu->IRQ_pending, false);
+    atomic_store(&cpu->NMI_pending, false);
+    atomic_store(&cpu->stop_requested, false);
+    cpu->stop_reason = CPU_STOP_BUDGET;
+    cpu->watch_hit = false; // The vector fetch does not count
+
+    // Forget any loop seen before the reset, and the instructions run
+    cpu->idle.armed = false;
+    cpu->idle.pending = false;
+    cpu->pc_history_count = 0;
 
     // Clear pause flag and wake up any waiting threads
     pthread_mutex_lock(&cpu->pause_mutex);
-    cpu->paused = false;
+    atomic_store(&cpu->paused, false);
     pthread_cond_broadcast(&cpu->pause_cond);
     pthread_mutex_unlock(&cpu->pause_mutex);
 }
@@ -1590,152 +2153,915 @@ cpu_status_t cpu_load_program(cpu_6502_t *cpu, const char *filename,
     return CPU_SUCCESS;
 }
 
-/* Execute a single CPU instruction with breakpoint checking and interrupt
- * handling */
-cpu_status_t cpu_execute_instruction(cpu_6502_t *cpu, breakpoint_t *bp)
-{
-    if (!cpu)
-        return CPU_ERROR_INVALID_ARGUMENT;
-
-    /* Pause Handling */
-    pthread_mutex_lock(&cpu->pause_mutex);
+/* Idle Loops (continued) */
+
+/* Opcodes an idle loop may contain: anything that writes memory or the
+ * stack could be what ends the wait, so it never counts as idle */
+static bool idle_opcode_allowed(const opcode_entry_t *op)
+{
+    instruction_func_t f = op->execute;
+
+    return f && f != instr_sta && f != instr_stx && f != instr_sty &&
+           f != instr_inc && f != instr_dec && f != instr_asl &&
+           f != instr_lsr && f != instr_rol && f != instr_ror &&
+           f != instr_pha && f != instr_php && f != instr_pla &&
+           f != instr_plp && f != instr_jsr && f != instr_rts &&
+           f != instr_rti && f != instr_brk;
+}
+
+/* Check that an instruction's data read, if any, has no side effects and
+ * can only change through someone else's write: plain storage, or the
+ * console port's INPUT_ADDR while the input queue is empty. Registers are
+ * those of the loop's fixed point, so indexed addresses are the ones every
+ * iteration uses. */
+static bool idle_read_is_quiet(cpu_6502_t *cpu, const opcode_entry_t *op,
+                               uint16_t operand)
+{
+    addressing_mode_func_t mode = op->addr_mode;
+    uint16_t addr;
+
+    if (op->execute == instr_jmp && mode == addr_absolute)
+        return true; // Jumps read no data
+    else if (mode == addr_zero_page)
+        addr = operand & 0xFF;
+    else if (mode == addr_zero_page_x)
+        addr = (operand + cpu->reg.X) & 0xFF;
+    else if (mode == addr_zero_page_y)
+        addr = (operand + cpu->reg.Y) & 0xFF;
+    else if (mode == addr_absolute)
+        addr = operand;
+    else if (mode == addr_absolute_x)
+        addr = (uint16_t)(operand + cpu->reg.X);
+    else if (mode == addr_absolute_y)
+        addr = (uint16_t)(operand + cpu->reg.Y);
+    else if (mode == addr_indirect || mode == addr_indirect_x ||
+             mode == addr_indirect_y)
+        return false; // Not worth following pointers for
+    else
+        return true; // Implied, accumulator, immediate, relative
 
-    while (cpu->paused)
+    if (addr == INPUT_ADDR)
     {
-        pthread_cond_wait(&cpu->pause_cond, &cpu->pause_mutex);
+        cpu->idle.polls_input = true;
+        return queue_is_empty(&cpu->input_queue);
     }
 
-    pthread_mutex_unlock(&cpu->pause_mutex);
+    return bus_page_is_plain(cpu->bus, addr >> 8);
+}
 
-    /* Interrupt Handling */
-    pthread_mutex_lock(&cpu->interrupt_mutex);
-    bool handle_nmi = cpu->NMI_pending;
-    bool handle_irq = cpu->IRQ_pending && !get_flag(cpu, FLAG_INTERRUPT);
+/* Walk the loop body [head, end) and check that none of it can change
+ * anything by itself */
+static bool idle_body_is_quiet(cpu_6502_t *cpu, uint16_t head, uint16_t end)
+{
+    uint16_t addr = head;
 
-    if (handle_nmi)
-    {
-        cpu->NMI_pending = false;
-    }
+    cpu->idle.polls_input = false;
 
-    if (handle_irq)
+    if (!bus_page_is_plain(cpu->bus, head >> 8) ||
+        !bus_page_is_plain(cpu->bus, (uint16_t)(end - 1) >> 8))
+        return false; // Reading device code again could have side effects
+
+    while (addr != end)
     {
-        cpu->IRQ_pending = false;
-    }
+        if ((uint16_t)(end - addr) > IDLE_MAX_LOOP_BYTES)
+            return false; // Instruction boundaries do not meet end
 
-    pthread_mutex_unlock(&cpu->interrupt_mutex);
+        const opcode_entry_t *op = &opcode_table[bus_read(cpu->bus, addr)];
 
-    if (handle_nmi || handle_irq)
-    {
-        /* Push PC and P to stack */
-        push_word(cpu, cpu->reg.PC);
-        push_byte(cpu, cpu->reg.P);
+        if (!idle_opcode_allowed(op))
+            return false;
 
-        /* Set Interrupt Disable flag */
-        set_flag(cpu, FLAG_INTERRUPT, handle_irq ? true : false);
+        uint16_t operand = 0;
 
-        /* Set PC to interrupt vector */
-        if (handle_nmi)
-        {
-            uint16_t vector =
-                cpu_read(cpu, 0xFFFA) | (cpu_read(cpu, 0xFFFB) << 8);
-            cpu->reg.PC = vector;
-        }
-        else if (handle_irq)
-        {
-            uint16_t vector =
-                cpu_read(cpu, 0xFFFE) | (cpu_read(cpu, 0xFFFF) << 8);
-            cpu->reg.PC = vector;
-        }
+        if (op->bytes > 1)
+            operand = bus_read(cpu->bus, (uint16_t)(addr + 1));
+        if (op->bytes > 2)
+            operand |= bus_read(cpu->bus, (uint16_t)(addr + 2)) << 8;
+
+        if (!idle_read_is_quiet(cpu, op, operand))
+            return false;
 
-        /* Increment cycle count for interrupt handling */
-        cpu->clock.cycle_count += 7; // Typical cycles for interrupt
+        addr += op->bytes;
     }
 
-    /* Wait for the next cycle */
-    clock_wait_next_cycle(&cpu->clock);
+    return true;
+}
 
-    /* Fetch the next opcode */
-    uint8_t opcode = fetch_byte(cpu);
-    opcode_entry_t *op = &opcode_table[opcode];
+/* A short backward jump has just landed on PC. Two arrivals in a row at the
+ * same head through the same jump with identical registers mean one
+ * iteration changed nothing; if the body cannot change anything either,
+ * every further iteration is the same and the loop only waits for the
+ * outside world. The fast-forward itself happens at the next attention
+ * poll, on an instruction boundary. */
+static CPU_NOINLINE void idle_arrival(cpu_6502_t *cpu, uint16_t end)
+{
+    cpu_registers_t regs = cpu->reg;
 
-    /* Debug Mode: Print PC and Opcode */
-    if (cpu->debug_mode)
+    regs.P = status_read(cpu);
+
+    if (!cpu->idle.armed || cpu->idle.head != cpu->reg.PC ||
+        cpu->idle.end != end || !registers_equal(&regs, &cpu->idle.regs))
     {
-        printf("PC: $%04X  Opcode: $%02X (%s)\n", cpu->reg.PC - 1, opcode,
-               op->mnemonic ? op->mnemonic : "UNKNOWN");
+        cpu->idle.armed = true;
+        cpu->idle.head = cpu->reg.PC;
+        cpu->idle.end = end;
+        cpu->idle.regs = regs;
+        cpu->idle.cycle = cpu->clock.cycle_count;
+        return;
     }
 
-    /* Check for Breakpoint */
-    if (bp && breakpoint_check(bp, cpu->reg.PC - 1))
+    if (idle_body_is_quiet(cpu, cpu->idle.head, end))
     {
-        printf("Breakpoint hit at PC: $%04X\n", cpu->reg.PC - 1);
-        /* Optionally, pause execution or enter debug mode */
+        cpu->idle.period = cpu->clock.cycle_count - cpu->idle.cycle;
+        cpu->idle.pending = true;
+        atomic_store(&cpu->attention, true);
     }
 
-    /* Execute the Instruction */
-    if (op->execute)
-    {
-        if (op->addr_mode)
-            op->execute(cpu, op->addr_mode);
-        else
-            op->execute(cpu, NULL);
+    cpu->idle.cycle = cpu->clock.cycle_count;
+}
 
-        return CPU_SUCCESS;
-    }
-    else
+/* Block outside real-time mode until attention is raised, input arrives
+ * for a loop polling it, or IDLE_WAIT_MS pass. Returns true if nothing
+ * happened. */
+static bool idle_wait(cpu_6502_t *cpu)
+{
+    struct timespec deadline;
+    bool woken = false;
+
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += IDLE_WAIT_MS * 1000000L;
+    deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+    deadline.tv_nsec %= 1000000000L;
+
+    pthread_mutex_lock(&cpu->idle_mutex);
+    atomic_store(&cpu->idle_waiting, true); // Pairs with cpu_wake()
+
+    for (;;)
     {
-        fprintf(stderr, "Invalid opcode 0x%02X at PC: $%04X\n", opcode,
-                cpu->reg.PC - 1);
-        return CPU_ERROR_INVALID_OPCODE;
+        woken = atomic_load(&cpu->attention) ||
+                (cpu->idle.polls_input && !queue_is_empty(&cpu->input_queue));
+
+        if (woken || pthread_cond_timedwait(&cpu->idle_cond, &cpu->idle_mutex,
+                                            &deadline) == ETIMEDOUT)
+            break;
     }
-}
 
-/* Set Clock Frequency */
-void cpu_set_clock_frequency(cpu_6502_t *cpu, double frequency)
-{
-    if (!cpu || frequency <= 0.0)
-        return;
+    atomic_store(&cpu->idle_waiting, false);
+    pthread_mutex_unlock(&cpu->idle_mutex);
 
-    pthread_mutex_lock(&cpu->pause_mutex);
-    cpu->clock.frequency = frequency;
-    cpu->clock.cycle_duration = 1.0 / frequency;
-    clock_reset(&cpu->clock); // Reset the clock to apply new frequency
-    pthread_mutex_unlock(&cpu->pause_mutex);
+    return !woken;
 }
 
-/* Print CPU State (for debugging purposes) */
-void cpu_print_state(const cpu_6502_t *cpu)
+/* Skip the whole iterations of the idle loop at PC that fit before
+ * end_cycle (the end of the cpu_run_cycles() budget) and the next
+ * scheduled event, as if they had run; the last partial iteration is
+ * emulated so the slice ends, and the event fires, on the very cycle it
+ * would have without the skip. In real-time mode the clock then sleeps the
+ * skipped time away; in the other modes, which never sleep, the CPU first
+ * blocks in idle_wait() unless an event is due within the slice. */
+static void idle_fast_forward(cpu_6502_t *cpu, uint64_t end_cycle)
 {
-    if (!cpu)
-        return;
+    uint64_t limit = end_cycle;
+    bool event_due = cpu->scheduler.next_cycle < end_cycle;
 
-    printf(
-        "A: 0x%02X  X: 0x%02X  Y: 0x%02X  PC: 0x%04X  SP: 0x%02X  P: 0x%02X\n",
-        cpu->reg.A, cpu->reg.X, cpu->reg.Y, cpu->reg.PC, cpu->reg.SP,
-        cpu->reg.P);
-}
+    cpu->idle.pending = false;
 
-/* Enable or Disable Debug Mode */
-void cpu_set_debug_mode(cpu_6502_t *cpu, bool enabled)
-{
-    if (!cpu)
-        return;
+    if (event_due)
+        limit = cpu->scheduler.next_cycle;
 
-    cpu->debug_mode = enabled;
-}
+    if (cpu->reg.PC != cpu->idle.head || cpu->idle.period == 0 ||
+        cpu->clock.cycle_count >= limit)
+        return; // An interrupt got in first, or the slice is over
 
-/* Interrupt Handling Functions */
+    /* Stay short of limit: the instruction at PC still runs */
+    uint64_t iterations =
+        (limit - cpu->clock.cycle_count - 1) / cpu->idle.period;
 
-/* Inject an IRQ into the CPU */
-void cpu_inject_IRQ(cpu_6502_t *cpu)
-{
-    if (!cpu)
+    if (iterations == 0)
         return;
 
-    pthread_mutex_lock(&cpu->interrupt_mutex);
-    cpu->IRQ_pending = true;
-    pthread_mutex_unlock(&cpu->interrupt_mutex);
-}
+    if (cpu->idle.polls_input && !queue_is_empty(&cpu->input_queue))
+        return; // The next iteration sees the input
+
+    if (cpu->clock.mode != CLOCK_MODE_REALTIME && !event_due &&
+        !idle_wait(cpu))
+        return; // Woken: let the loop see what changed
+
+    uint64_t cycles = iterations * cpu->idle.period;
+
+    cpu->clock.cycle_count += cycles;
+    cpu->idle.cycle += cycles;
+    cpu->idle.skips++;
+    cpu->idle.skipped_cycles += cycles;
+}
+
+/* Take a pending NMI or IRQ: push PC and P, set I and jump through the
+ * vector. An NMI is taken first; an IRQ stays pending while I is set. */
+static void service_interrupts(cpu_6502_t *cpu)
+{
+    uint16_t vector_addr;
+
+    if (atomic_exchange(&cpu->NMI_pending, false))
+    {
+        vector_addr = 0xFFFA;
+    }
+    else if (!get_flag(cpu, FLAG_INTERRUPT) &&
+             (atomic_load(&cpu->irq_sources) ||
+              atomic_exchange(&cpu->IRQ_pending, false)))
+    {
+        vector_addr = 0xFFFE;
+    }
+    else
+    {
+        return;
+    }
+
+    /* Push PC and P to stack */
+    push_word(cpu, cpu->reg.PC);
+    push_byte(cpu, status_read(cpu));
+
+    /* Set Interrupt Disable flag */
+    set_flag(cpu, FLAG_INTERRUPT, true);
+
+    /* The handler may change what a loop waits on */
+    cpu->idle.armed = false;
+
+    /* Set PC to interrupt vector */
+    cpu->reg.PC =
+        cpu_read(cpu, vector_addr) | (cpu_read(cpu, vector_addr + 1) << 8);
+
+    /* Increment cycle count for interrupt handling */
+    cpu->clock.cycle_count += 7; // Interrupt sequence: 7 cycles
+
+    if (cpu->profiler)
+        profiler_interrupt(cpu->profiler, vector_addr == 0xFFFA, cpu->reg.PC,
+                           cpu->reg.SP, 7);
+}
+
+/* Execute an already-fetched opcode on the selected engine */
+static inline cpu_status_t execute_opcode(cpu_6502_t *cpu, uint8_t opcode)
+{
+    if (cpu->engine != CPU_ENGINE_TABLE)
+        return execute_opcode_switch(cpu, opcode);
+
+    opcode_entry_t *op = &opcode_table[opcode];
+
+    if (!op->execute)
+    {
+        fprintf(stderr, "Invalid opcode 0x%02X at PC: $%04X\n", opcode,
+                cpu->reg.PC - 1);
+        return CPU_ERROR_INVALID_OPCODE;
+    }
+
+    op->execute(cpu, op->addr_mode);
+    cpu->clock.cycle_count += op->cycles;
+    return CPU_SUCCESS;
+}
+
+/* Print the instruction about to execute (debug mode only) */
+static void print_debug_opcode(cpu_6502_t *cpu, uint8_t opcode)
+{
+    const char *mnemonic = opcode_table[opcode].mnemonic;
+
+    printf("PC: $%04X  Opcode: $%02X (%s)\n", cpu->reg.PC - 1, opcode,
+           mnemonic ? mnemonic : "UNKNOWN");
+}
+
+/* Tracing */
+
+/* bus_peek() with the page table fast path */
+static CPU_INLINE uint8_t trace_peek(bus_t *bus, uint16_t addr)
+{
+    const uint8_t *page = bus->read_page[addr >> 8];
+
+    return page ? page[addr & 0xFF] : bus_peek(bus, addr);
+}
+
+/* Start the record of the instruction whose opcode was just fetched: the
+ * registers before it, and the data address its mode will compute, worked
+ * out by peeking so the trace causes no accesses of its own */
+static trace_record_t *trace_begin(cpu_6502_t *cpu, uint8_t opcode)
+{
+    trace_record_t *record = tracer_append(cpu->tracer);
+    bus_t *bus = cpu->bus;
+    uint16_t pc = (uint16_t)(cpu->reg.PC - 1);
+
+    flags_pack(cpu);
+
+    record->cycle = cpu->clock.cycle_count;
+    record->pc = pc;
+    record->opcode = opcode;
+    record->a = cpu->reg.A;
+    record->x = cpu->reg.X;
+    record->y = cpu->reg.Y;
+    record->p = cpu->reg.P;
+    record->sp = cpu->reg.SP;
+    record->access = trace_access_kind[opcode];
+    record->addr = 0;
+    record->value = 0;
+
+    if (record->access == TRACE_ACCESS_NONE)
+        return record;
+
+    addressing_mode_func_t mode = opcode_table[opcode].addr_mode;
+    uint8_t low = trace_peek(bus, (uint16_t)(pc + 1));
+    uint16_t word = low | (uint16_t)(trace_peek(bus, (uint16_t)(pc + 2)) << 8);
+
+    if (mode == addr_zero_page)
+        record->addr = low;
+    else if (mode == addr_zero_page_x)
+        record->addr = (uint8_t)(low + cpu->reg.X);
+    else if (mode == addr_zero_page_y)
+        record->addr = (uint8_t)(low + cpu->reg.Y);
+    else if (mode == addr_absolute)
+        record->addr = word;
+    else if (mode == addr_absolute_x)
+        record->addr = (uint16_t)(word + cpu->reg.X);
+    else if (mode == addr_absolute_y)
+        record->addr = (uint16_t)(word + cpu->reg.Y);
+    else
+    {
+        // (zp,X) and (zp),Y: the pointer wraps within page zero
+        uint8_t base = (mode == addr_indirect_x) ? (uint8_t)(low + cpu->reg.X)
+                                                 : low;
+        uint16_t pointer = trace_peek(bus, base) |
+                           (uint16_t)(trace_peek(bus, (uint8_t)(base + 1)) << 8);
+
+        record->addr = (mode == addr_indirect_x)
+                           ? pointer
+                           : (uint16_t)(pointer + cpu->reg.Y);
+    }
+
+    return record;
+}
+
+/* Finish the record once the instruction has run */
+static void trace_end(cpu_6502_t *cpu, trace_record_t *record)
+{
+    if (record->access != TRACE_ACCESS_NONE)
+        record->value = trace_peek(cpu->bus, record->addr);
+}
+
+/* Execute a single CPU instruction with breakpoint checking and interrupt
+ * handling. A breakpoint at the PC stops before the instruction, as in
+ * cpu_run_cycles(): cpu->stop_reason says whether it ran. */
+cpu_status_t cpu_execute_instruction(cpu_6502_t *cpu, breakpoint_t *bp)
+{
+    if (!cpu)
+        return CPU_ERROR_INVALID_ARGUMENT;
+
+    /* Pause Handling */
+    if (atomic_load(&cpu->paused))
+    {
+        pthread_mutex_lock(&cpu->pause_mutex);
+
+        while (atomic_load(&cpu->paused))
+        {
+            pthread_cond_wait(&cpu->pause_cond, &cpu->pause_mutex);
+        }
+
+        pthread_mutex_unlock(&cpu->pause_mutex);
+    }
+
+    flags_unpack(cpu);
+
+    /* Due events, then Interrupt Handling */
+    if (cpu->clock.cycle_count >= cpu->scheduler.next_cycle)
+        scheduler_run_due(&cpu->scheduler, cpu->clock.cycle_count);
+
+    service_interrupts(cpu);
+
+    if (bp && breakpoint_check(bp, cpu->reg.PC))
+    {
+        cpu->stop_reason = CPU_STOP_BREAKPOINT;
+        flags_pack(cpu);
+        return CPU_SUCCESS;
+    }
+    cpu->stop_reason = CPU_STOP_BUDGET;
+
+    /* Fetch the next opcode */
+    uint16_t pc = cpu->reg.PC;
+    uint8_t opcode = fetch_byte(cpu);
+    trace_record_t *record = cpu->tracer ? trace_begin(cpu, opcode) : NULL;
+
+    /* Debug Mode: Print PC and Opcode */
+    if (cpu->debug_mode)
+    {
+        print_debug_opcode(cpu, opcode);
+    }
+
+    if (cpu->pc_history_enabled)
+        cpu->pc_history[cpu->pc_history_count++ & (CPU_PC_HISTORY - 1)] = pc;
+
+    /* Execute the Instruction */
+    uint64_t start = cpu->clock.cycle_count;
+    cpu_status_t status = execute_opcode(cpu, opcode);
+
+    if (record)
+        trace_end(cpu, record);
+
+    if (cpu->profiler)
+        profiler_count(cpu->profiler, pc, opcode,
+                       (uint32_t)(cpu->clock.cycle_count - start), cpu->reg.PC,
+                       cpu->reg.SP);
+
+    flags_pack(cpu);
+
+    /* Throttle to the clock frequency (only at quantum boundaries) */
+    clock_throttle(&cpu->clock);
+
+    return status;
+}
+
+/* Handle a raised attention flag. Returns false if cpu_run_cycles() must
+ * stop before the next instruction. */
+static bool handle_attention(cpu_6502_t *cpu, uint64_t end_cycle)
+{
+    /* Clear first so a flag raised from now on is seen on the next poll */
+    atomic_store(&cpu->attention, false);
+
+    if (atomic_exchange(&cpu->stop_requested, false))
+    {
+        cpu->stop_reason = CPU_STOP_REQUESTED;
+        return false;
+    }
+
+    if (cpu->watch_hit)
+    {
+        cpu->watch_hit = false;
+        cpu->stop_reason = CPU_STOP_WATCHPOINT;
+        return false;
+    }
+
+    if (atomic_load(&cpu->paused))
+    {
+        /* Stay raised so the next call returns at once while paused */
+        atomic_store(&cpu->attention, true);
+        cpu->stop_reason = CPU_STOP_PAUSED;
+        return false;
+    }
+
+    service_interrupts(cpu);
+
+    /* Before re-raising for a masked IRQ, which is no reason to stay
+     * awake */
+    if (cpu->idle.pending)
+        idle_fast_forward(cpu, end_cycle);
+
+    /* A masked IRQ stays pending; keep polling until I is cleared */
+    if (atomic_load(&cpu->IRQ_pending) || atomic_load(&cpu->irq_sources))
+    {
+        atomic_store(&cpu->attention, true);
+    }
+
+    return true;
+}
+
+/* Checks made before every instruction by both run loops: due events,
+ * attention flag and breakpoints. Returns false, with cpu->stop_reason set,
+ * if the loop must return without executing the instruction at PC. */
+static inline bool run_loop_continue(cpu_6502_t *cpu, breakpoint_t *bp,
+                                     bool *first_instruction,
+                                     uint64_t end_cycle)
+{
+    /* Events first, so an interrupt they raise is taken at this boundary */
+    if (cpu->clock.cycle_count >= cpu->scheduler.next_cycle)
+        scheduler_run_due(&cpu->scheduler, cpu->clock.cycle_count);
+
+    if (atomic_load_explicit(&cpu->attention, memory_order_relaxed))
+    {
+        uint16_t pc = cpu->reg.PC;
+
+        if (!handle_attention(cpu, end_cycle))
+            return false;
+
+        // An interrupt taken here left the instruction the call resumes at
+        if (cpu->reg.PC != pc)
+            *first_instruction = false;
+    }
+
+    if (bp && !*first_instruction && breakpoint_check(bp, cpu->reg.PC))
+    {
+        cpu->stop_reason = CPU_STOP_BREAKPOINT;
+        return false;
+    }
+    *first_instruction = false;
+
+    return true;
+}
+
+/* Check whether a breakpoint lies in [first, last] (a block: a few dozen
+ * bytes at most) */
+static bool breakpoint_in_range(const breakpoint_t *bp, uint16_t first,
+                                uint16_t last)
+{
+    for (uint32_t addr = first; addr <= last; addr++)
+    {
+        if (breakpoint_check(bp, (uint16_t)addr))
+            return true;
+    }
+
+    return false;
+}
+
+/* A watchpoint hit by the last instruction of the budget has not been seen
+ * at a boundary yet: report it rather than let the next call drop it */
+static inline void report_last_watch_hit(cpu_6502_t *cpu)
+{
+    if (cpu->watch_hit && cpu->stop_reason == CPU_STOP_BUDGET)
+    {
+        cpu->watch_hit = false;
+        cpu->stop_reason = CPU_STOP_WATCHPOINT;
+    }
+}
+
+/* cpu_run_cycles() for the predecode and JIT engines. Kept apart from the
+ * interpreter loop so neither pays for the other's state in the hot path. */
+static CPU_NOINLINE cpu_status_t
+run_cycles_predecoded(cpu_6502_t *cpu, uint64_t end_cycle, breakpoint_t *bp)
+{
+    decode_cache_t *cache = cpu->decode_cache;
+    jit_t *jit = (cpu->engine == CPU_ENGINE_JIT) ? cpu->jit : NULL;
+    decoded_block_t *block = NULL;
+    int block_index = 0; // Next instruction in block
+    bool first_instruction = true;
+    cpu_status_t status = CPU_SUCCESS;
+
+    do
+    {
+        if (!run_loop_continue(cpu, bp, &first_instruction, end_cycle))
+            break;
+
+        /* Stay in the current block while execution falls through it; a
+         * taken branch, an interrupt or a write to the block's bytes sends
+         * us back to the lookup */
+        if (!block || !block->valid || block_index >= block->count ||
+            (block_index > 0 &&
+             block->insns[block_index - 1].next_pc != cpu->reg.PC))
+        {
+            block = decode_cache_lookup(cache, cpu->bus, cpu->reg.PC);
+            block_index = 0;
+
+            /* Hot blocks run as host code, unless a breakpoint needs the
+             * loop to see each instruction; it exits at the same
+             * boundaries this loop would stop at, including the next
+             * scheduled event */
+            if (jit && block &&
+                (!bp || !breakpoint_in_range(bp, block->start, block->end)) &&
+                jit_run_block(jit, cpu, block,
+                              end_cycle < cpu->scheduler.next_cycle
+                                  ? end_cycle
+                                  : cpu->scheduler.next_cycle))
+            {
+                block = NULL; // May have left mid-block; look up PC again
+                clock_throttle(&cpu->clock);
+                continue;
+            }
+        }
+
+        if (block)
+        {
+            execute_decoded(cpu, &block->insns[block_index++]);
+        }
+        else
+        {
+            /* Nothing cacheable here (device page or invalid opcode) */
+            status = execute_opcode_switch(cpu, fetch_byte(cpu));
+        }
+
+        /* Wall time is only consulted when a quantum boundary is reached */
+        clock_throttle(&cpu->clock);
+
+        if (status != CPU_SUCCESS)
+        {
+            cpu->stop_reason = CPU_STOP_ERROR;
+            break;
+        }
+    } while (cpu->clock.cycle_count < end_cycle);
+
+    return status;
+}
+
+/* Run instructions until at least `budget` cycles have elapsed or a stop
+ * condition fires, throttling to the clock frequency once per clock
+ * quantum. No lock is taken; the reason for returning is left in
+ * cpu->stop_reason. A breakpoint at the PC the call starts from is ignored
+ * so execution can resume. A watchpoint stops the call after the
+ * instruction that hit it. */
+cpu_status_t cpu_run_cycles(cpu_6502_t *cpu, uint64_t budget, breakpoint_t *bp)
+{
+    if (!cpu)
+        return CPU_ERROR_INVALID_ARGUMENT;
+
+    uint64_t end_cycle = cpu->clock.cycle_count + budget;
+    bool first_instruction = true;
+    cpu_status_t status = CPU_SUCCESS;
+
+    if (bp && bp->count == 0)
+        bp = NULL; // Nothing to check
+
+    cpu->stop_reason = CPU_STOP_BUDGET;
+    cpu->watch_hit = false; // Hits outside a run are not reported
+    flags_unpack(cpu);
+
+    /* Debug mode, tracing, profiling and the PC history always go through
+     * the interpreter */
+    if ((cpu->engine == CPU_ENGINE_PREDECODE ||
+         cpu->engine == CPU_ENGINE_JIT) && !cpu->debug_mode && !cpu->tracer &&
+        !cpu->profiler && !cpu->pc_history_enabled)
+    {
+        status = run_cycles_predecoded(cpu, end_cycle, bp);
+        flags_pack(cpu);
+        report_last_watch_hit(cpu);
+        return status;
+    }
+
+    do
+    {
+        if (!run_loop_continue(cpu, bp, &first_instruction, end_cycle))
+            break;
+
+        uint16_t pc = cpu->reg.PC;
+        uint8_t opcode = fetch_byte(cpu);
+        trace_record_t *record =
+            cpu->tracer ? trace_begin(cpu, opcode) : NULL;
+
+        if (cpu->debug_mode)
+        {
+            print_debug_opcode(cpu, opcode);
+        }
+
+        if (cpu->pc_history_enabled)
+            cpu->pc_history[cpu->pc_history_count++ & (CPU_PC_HISTORY - 1)] =
+                pc;
+
+        uint64_t start = cpu->clock.cycle_count;
+
+        status = execute_opcode(cpu, opcode);
+
+        if (record)
+            trace_end(cpu, record);
+
+        if (cpu->profiler)
+            profiler_count(cpu->profiler, pc, opcode,
+                           (uint32_t)(cpu->clock.cycle_count - start),
+                           cpu->reg.PC, cpu->reg.SP);
+
+        /* Wall time is only consulted when a quantum boundary is reached */
+        clock_throttle(&cpu->clock);
+
+        if (status != CPU_SUCCESS)
+        {
+            cpu->stop_reason = CPU_STOP_ERROR;
+            break;
+        }
+    } while (cpu->clock.cycle_count < end_cycle);
+
+    flags_pack(cpu);
+    report_last_watch_hit(cpu);
+    return status;
+}
+
+/* Run cpu and reference side by side, `slice` cycles at a time, comparing
+ * registers and cycle counts after every slice. Both must start from the
+ * same state with the same memory contents; the reference is normally on
+ * the table engine, which is the behaviour every other engine must match.
+ * Stops at the first divergence, at a stop or error on either side, or once
+ * `budget` cycles have run. A slice of 1 compares after every instruction. */
+cpu_status_t cpu_run_differential(cpu_6502_t *cpu, cpu_6502_t *reference,
+                                  uint64_t budget, uint64_t slice,
+                                  cpu_divergence_t *divergence)
+{
+    if (!cpu || !reference || !divergence || slice == 0)
+        return CPU_ERROR_INVALID_ARGUMENT;
+
+    uint64_t end_cycle = reference->clock.cycle_count + budget;
+    cpu_status_t status = CPU_SUCCESS;
+
+    divergence->diverged = false;
+
+    while (reference->clock.cycle_count < end_cycle)
+    {
+        uint16_t slice_pc = reference->reg.PC;
+        cpu_status_t expected = cpu_run_cycles(reference, slice, NULL);
+        status = cpu_run_cycles(cpu, slice, NULL);
+
+        if (expected != status ||
+            !registers_equal(&cpu->reg, &reference->reg) ||
+            cpu->clock.cycle_count != reference->clock.cycle_count)
+        {
+            divergence->diverged = true;
+            divergence->slice_pc = slice_pc;
+            divergence->expected = reference->reg;
+            divergence->actual = cpu->reg;
+            divergence->expected_cycles = reference->clock.cycle_count;
+            divergence->actual_cycles = cpu->clock.cycle_count;
+            break;
+        }
+
+        if (status != CPU_SUCCESS ||
+            reference->stop_reason != CPU_STOP_BUDGET)
+            break;
+    }
+
+    return status;
+}
+
+/* Ask a running cpu_run_cycles() to return before its next instruction */
+void cpu_request_stop(cpu_6502_t *cpu)
+{
+    if (!cpu)
+        return;
+
+    atomic_store(&cpu->stop_requested, true);
+    atomic_store(&cpu->attention, true);
+    cpu_wake(cpu);
+}
+
+/* Turn idle-loop detection and fast-forwarding on or off */
+void cpu_set_idle_skip(cpu_6502_t *cpu, bool enabled)
+{
+    if (!cpu)
+        return;
+
+    cpu->idle.enabled = enabled;
+    cpu->idle.armed = false;
+    cpu->idle.pending = false;
+}
+
+/* Wake a CPU blocked in an idle loop so it sees what just changed */
+void cpu_wake(cpu_6502_t *cpu)
+{
+    if (!cpu)
+        return;
+
+    /* Order the caller's store (attention, input) before the check; pairs
+     * with the store of idle_waiting in idle_wait() */
+    atomic_thread_fence(memory_order_seq_cst);
+
+    if (atomic_load(&cpu->idle_waiting))
+    {
+        pthread_mutex_lock(&cpu->idle_mutex);
+        pthread_cond_signal(&cpu->idle_cond);
+        pthread_mutex_unlock(&cpu->idle_mutex);
+    }
+}
+
+/* Set Clock Frequency */
+void cpu_set_clock_frequency(cpu_6502_t *cpu, double frequency)
+{
+    if (!cpu || frequency <= 0.0)
+        return;
+
+    pthread_mutex_lock(&cpu->pause_mutex);
+    // The cycle count goes on: the scheduler and the devices keep absolute
+    // deadlines in it
+    clock_set_frequency(&cpu->clock, frequency);
+    pthread_mutex_unlock(&cpu->pause_mutex);
+}
+
+/* Set Clock Mode (real-time, turbo or virtual time) */
+void cpu_set_clock_mode(cpu_6502_t *cpu, clock_mode_t mode)
+{
+    if (!cpu)
+        return;
+
+    pthread_mutex_lock(&cpu->pause_mutex);
+    clock_set_mode(&cpu->clock, mode);
+    pthread_mutex_unlock(&cpu->pause_mutex);
+}
+
+/* Print CPU State (for debugging purposes) */
+void cpu_print_state(const cpu_6502_t *cpu)
+{
+    if (!cpu)
+        return;
+
+    printf(
+        "A: 0x%02X  X: 0x%02X  Y: 0x%02X  PC: 0x%04X  SP: 0x%02X  P: 0x%02X\n",
+        cpu->reg.A, cpu->reg.X, cpu->reg.Y, cpu->reg.PC, cpu->reg.SP,
+        cpu->reg.P);
+}
+
+/* Enable or Disable Debug Mode */
+void cpu_set_debug_mode(cpu_6502_t *cpu, bool enabled)
+{
+    if (!cpu)
+        return;
+
+    cpu->debug_mode = enabled;
+}
+
+/* Start or Stop Tracing */
+void cpu_set_tracer(cpu_6502_t *cpu, struct tracer *tracer)
+{
+    if (!cpu)
+        return;
+
+    cpu->tracer = tracer;
+    cpu->idle.armed = false; // No skip found before tracing started
+    cpu->idle.pending = false;
+}
+
+/* Start or Stop Profiling */
+void cpu_set_profiler(cpu_6502_t *cpu, struct profiler *profiler)
+{
+    if (!cpu)
+        return;
+
+    cpu->profiler = profiler;
+    cpu->idle.armed = false; // No skip found before counting started
+    cpu->idle.pending = false;
+}
+
+/* Start or Stop Keeping the Last Instruction Addresses */
+void cpu_set_pc_history(cpu_6502_t *cpu, bool enabled)
+{
+    if (!cpu)
+        return;
+
+    cpu->pc_history_enabled = enabled;
+    cpu->pc_history_count = 0;
+}
+
+/* Copy the Last Instruction Addresses, Newest First */
+int cpu_get_pc_history(const cpu_6502_t *cpu, uint16_t *pcs, int max)
+{
+    if (!cpu || !pcs)
+        return 0;
+
+    int count = 0;
+    uint32_t kept = cpu->pc_history_count < CPU_PC_HISTORY
+                        ? cpu->pc_history_count
+                        : CPU_PC_HISTORY;
+
+    while (count < max && (uint32_t)count < kept)
+    {
+        pcs[count] = cpu->pc_history[(cpu->pc_history_count - 1 - count) &
+                                     (CPU_PC_HISTORY - 1)];
+        count++;
+    }
+
+    return count;
+}
+
+/* Mnemonic of an Opcode ("???" for undefined ones) */
+const char *cpu_opcode_mnemonic(uint8_t opcode)
+{
+    return opcode_table[opcode].mnemonic ? opcode_table[opcode].mnemonic
+                                         : "???";
+}
+
+/* Select the Instruction Dispatch Engine */
+cpu_status_t cpu_set_engine(cpu_6502_t *cpu, cpu_engine_t engine)
+{
+    if (!cpu)
+        return CPU_ERROR_INVALID_ARGUMENT;
+
+    switch (engine)
+    {
+    case CPU_ENGINE_JIT:
+        if (!JIT_AVAILABLE)
+            return CPU_ERROR_INVALID_ARGUMENT; // No code generator for this host
+        // fall through
+    case CPU_ENGINE_PREDECODE:
+        if (!cpu->decode_cache)
+        {
+            cpu->decode_cache = decode_cache_create(decode_ops);
+            if (!cpu->decode_cache)
+                return CPU_ERROR_MEMORY_OVERFLOW;
+        }
+        if (engine == CPU_ENGINE_JIT && !cpu->jit)
+        {
+            cpu->jit = jit_create(jit_ops, cpu->decode_cache);
+            if (!cpu->jit)
+                return CPU_ERROR_MEMORY_OVERFLOW;
+        }
+        cpu->engine = engine;
+        return CPU_SUCCESS;
+    case CPU_ENGINE_TABLE:
+    case CPU_ENGINE_SWITCH:
+        // Stop watching code pages; nothing is cached while unused
+        decode_cache_flush(cpu->decode_cache);
+        cpu->engine = engine;
+        return CPU_SUCCESS;
+    default:
+        return CPU_ERROR_INVALID_ARGUMENT;
+    }
+}
+
+/* Interrupt Handling Functions */
+
+/* Inject an IRQ into the CPU */
+void cpu_inject_IRQ(cpu_6502_t *cpu)
+{
+    if (!cpu)
+        return;
+
+    atomic_store(&cpu->IRQ_pending, true);
+    atomic_store(&cpu->attention, true);
+    cpu_wake(cpu);
+}
 
 /* Inject an NMI into the CPU */
 void cpu_inject_NMI(cpu_6502_t *cpu)
@@ -1743,9 +3069,73 @@ void cpu_inject_NMI(cpu_6502_t *cpu)
     if (!cpu)
         return;
 
-    pthread_mutex_lock(&cpu->interrupt_mutex);
-    cpu->NMI_pending = true;
-    pthread_mutex_unlock(&cpu->interrupt_mutex);
+    atomic_store(&cpu->NMI_pending, true);
+    atomic_store(&cpu->attention, true);
+    cpu_wake(cpu);
+}
+
+/* Claim one of the level-triggered IRQ lines; -1 if all are taken */
+int cpu_add_irq_source(cpu_6502_t *cpu)
+{
+    if (!cpu)
+        return -1;
+
+    for (int source = 0; source < CPU_IRQ_SOURCES; source++)
+    {
+        if (!(cpu->irq_sources_claimed & (1u << source)))
+        {
+            cpu->irq_sources_claimed |= 1u << source;
+            return source;
+        }
+    }
+
+    return -1;
+}
+
+/* Assert or release a claimed IRQ line. IRQ is taken, whenever I is clear,
+ * for as long as any line is asserted; the handler must make the device
+ * release it. */
+void cpu_set_irq_source(cpu_6502_t *cpu, int source, bool asserted)
+{
+    if (!cpu || source < 0 || source >= CPU_IRQ_SOURCES)
+        return;
+
+    if (asserted)
+    {
+        atomic_fetch_or(&cpu->irq_sources, 1u << source);
+        atomic_store(&cpu->attention, true);
+        cpu_wake(cpu);
+    }
+    else
+    {
+        atomic_fetch_and(&cpu->irq_sources, ~(1u << source));
+    }
+}
+
+/* Event Scheduling Functions */
+
+/* Schedule a callback at an absolute cycle_count */
+uint32_t cpu_schedule(cpu_6502_t *cpu, uint64_t cycle,
+                      scheduler_callback_t callback, void *context)
+{
+    if (!cpu)
+        return SCHEDULER_NO_EVENT;
+
+    uint64_t previous = cpu->scheduler.next_cycle;
+    uint32_t id = scheduler_add(&cpu->scheduler, cycle, callback, context);
+
+    /* Scheduled from inside an instruction: make translated code return at
+     * the next boundary so the new bound is seen */
+    if (cpu->scheduler.next_cycle < previous)
+        atomic_store(&cpu->attention, true);
+
+    return id;
+}
+
+/* Remove a pending event */
+bool cpu_cancel_event(cpu_6502_t *cpu, uint32_t id)
+{
+    return cpu && scheduler_cancel(&cpu->scheduler, id);
 }
 
 /* Pause the CPU Execution */
@@ -1754,9 +3144,9 @@ void cpu_pause(cpu_6502_t *cpu)
     if (!cpu)
         return;
 
-    pthread_mutex_lock(&cpu->pause_mutex);
-    cpu->paused = true;
-    pthread_mutex_unlock(&cpu->pause_mutex);
+    atomic_store(&cpu->paused, true);
+    atomic_store(&cpu->attention, true);
+    cpu_wake(cpu);
 }
 
 /* Resume the CPU Execution */
@@ -1766,7 +3156,7 @@ void cpu_resume(cpu_6502_t *cpu)
         return;
 
     pthread_mutex_lock(&cpu->pause_mutex);
-    cpu->paused = false;
+    atomic_store(&cpu->paused, false);
     pthread_cond_broadcast(&cpu->pause_cond);
     pthread_mutex_unlock(&cpu->pause_mutex);
 }
@@ -1779,7 +3169,7 @@ void handle_all_opcodes(cpu_6502_t *cpu, breakpoint_t *bp)
     while (status == CPU_SUCCESS)
     {
         status = cpu_execute_instruction(cpu, bp);
-        if (status != CPU_SUCCESS)
+        if (status != CPU_SUCCESS || cpu->stop_reason == CPU_STOP_BREAKPOINT)
             break;
     }
 }
@@ -3,16 +3,38 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdatomic.h>
 #include <pthread.h>
 #include "cpu_clock.h"
 #include "queue.h"
 #include "bus.h"
+#include "scheduler.h"
+
+/* Addressing modes, instruction handlers and the helpers they use are forced
+ * inline so the switch engines get one flat case body per opcode; the table
+ * engine still takes their addresses and uses the out-of-line copies.
+ * CPU_NOINLINE keeps the run loops of different engines from being merged
+ * into one function. */
+#if defined(__GNUC__) || defined(__clang__)
+#define CPU_INLINE inline __attribute__((always_inline))
+#define CPU_NOINLINE __attribute__((noinline))
+#else
+#define CPU_INLINE inline
+#define CPU_NOINLINE
+#endif
 
 /* Constants */
-#define INPUT_ADDR  0xD011  // Input address for keyboard
-#define OUTPUT_ADDR 0xD012  // Output address for serial output
+#define INPUT_ADDR  0xD011  // Console port input (see memory_create_console)
+#define OUTPUT_ADDR 0xD012  // Console port output
+
+#define BREAKPOINT_WORDS (0x10000 / 32) // One bit per address
+
+#define CPU_IRQ_SOURCES 32   // Level-triggered IRQ lines devices can claim
 
-#define MAX_BREAKPOINTS 16   // Maximum number of breakpoints
+#define IDLE_MAX_LOOP_BYTES 16 // Longest loop body checked for idling
+#define IDLE_WAIT_MS 10        // Longest idle block outside real-time mode
+
+#define CPU_PC_HISTORY 8 // Instruction addresses kept (power of two)
 
 /* Status Register Flags */
 typedef enum
@@ -35,28 +57,65 @@ typedef enum
     CPU_ERROR_MEMORY_OVERFLOW,
     CPU_ERROR_INVALID_OPCODE,
     CPU_ERROR_FILE_NOT_FOUND,
-    CPU_ERROR_READ_FAILED
+    CPU_ERROR_READ_FAILED,
+    CPU_ERROR_WRITE_FAILED
 } cpu_status_t;
 
-/* Breakpoint Structure */
+/* Reasons cpu_run_cycles() Returned */
+typedef enum
+{
+    CPU_STOP_BUDGET = 0, // Cycle budget used up
+    CPU_STOP_REQUESTED,  // cpu_request_stop() was called
+    CPU_STOP_PAUSED,     // cpu_pause() is in effect
+    CPU_STOP_BREAKPOINT, // PC reached a breakpoint (instruction not executed)
+    CPU_STOP_WATCHPOINT, // A watched address was accessed (see watch_addr)
+    CPU_STOP_ERROR       // Instruction failed; see the returned status
+} cpu_stop_reason_t;
+
+/* Execution Engines */
+typedef enum
+{
+    CPU_ENGINE_TABLE = 0, // Function-pointer dispatch through the opcode table
+    CPU_ENGINE_SWITCH,    // 256-way switch with addressing modes inlined
+    CPU_ENGINE_PREDECODE, // Cached basic blocks with operands predecoded
+    CPU_ENGINE_JIT        // Hot blocks translated to host code (jit.h)
+} cpu_engine_t;
+
+struct decode_cache; // decode_cache.h
+struct jit;          // jit.h
+struct tracer;       // trace.h
+struct profiler;     // profiler.h
+
+/* Breakpoint Structure: one bit per address, so any number of them costs
+ * the same single bit test per instruction, and nothing when count is 0 */
 typedef struct {
-    uint16_t addresses[MAX_BREAKPOINTS];
+    uint32_t bits[BREAKPOINT_WORDS];
     int count;
 } breakpoint_t;
 
+/* CPU Registers */
+typedef struct
+{
+    uint8_t A;   // Accumulator
+    uint8_t X;   // X Index Register
+    uint8_t Y;   // Y Index Register
+    uint16_t PC; // Program Counter
+    uint8_t SP;  // Stack Pointer
+    uint8_t P;   // Processor Status
+} cpu_registers_t;
+
 /* CPU Structure Representing the 6502 CPU State */
 typedef struct
 {
     /* CPU Registers */
-    struct
-    {
-        uint8_t A;   // Accumulator
-        uint8_t X;   // X Index Register
-        uint8_t Y;   // Y Index Register
-        uint16_t PC; // Program Counter
-        uint8_t SP;  // Stack Pointer
-        uint8_t P;   // Processor Status
-    } reg;
+    cpu_registers_t reg;
+
+    /* N, Z, C and V while the core runs; reg.P holds them otherwise (see
+     * "Lazy Flags" in cpu_6502.c) */
+    uint8_t flag_n; // N is bit 7 of the last result
+    uint8_t flag_z; // Z is set when this is zero
+    uint8_t flag_c; // C, 0 or 1
+    uint8_t flag_v; // V, 0 or 1
 
     /* Bus reference */
     bus_t *bus;
@@ -69,29 +128,96 @@ typedef struct
     double render_time;         // Render time in seconds
     double actual_fps;          // Calculated frames per second
 
-    /* Queues for I/O */
-    queue_t input_queue;
-    queue_t output_queue;
-    pthread_mutex_t input_queue_mutex;
-    pthread_mutex_t output_queue_mutex;
-    pthread_cond_t output_queue_cond;
+    /* Queues for I/O (lock-free, one producer and one consumer each) */
+    queue_t input_queue;  // Input thread -> CPU thread
+    queue_t output_queue; // CPU thread -> serial output thread
+
+    /* Interrupt flags (set from any thread) */
+    atomic_bool IRQ_pending;
+    atomic_bool NMI_pending;
 
-    /* Interrupt flags */
-    bool IRQ_pending;
-    bool NMI_pending;
+    /* Level-triggered IRQ: one bit per source claimed with
+     * cpu_add_irq_source(); IRQ is asserted while any bit is set */
+    atomic_uint irq_sources;
+    uint32_t irq_sources_claimed;
 
-    /* Mutex for Interrupt Handling */
-    pthread_mutex_t interrupt_mutex;
+    /* Cycle-scheduled device events (CPU thread only) */
+    scheduler_t scheduler;
 
     /* Pause Control */
-    bool paused;
+    atomic_bool paused;
     pthread_mutex_t pause_mutex;
     pthread_cond_t pause_cond;
 
+    /* Run Control: any thread that sets IRQ_pending, NMI_pending, paused or
+     * stop_requested also raises attention, which is the only flag
+     * cpu_run_cycles() polls per instruction */
+    atomic_bool stop_requested;
+    atomic_bool attention;
+    cpu_stop_reason_t stop_reason; // Why the last cpu_run_cycles() returned
+
+    /* Watchpoints (bus_set_watchpoint on cpu->bus): the access that hit
+     * one, reported as CPU_STOP_WATCHPOINT once its instruction is done */
+    bool watch_hit;
+    bool watch_write; // The access was a write
+    uint16_t watch_addr;
+
     /* Debug Mode Flag */
     bool debug_mode;
+
+    /* Execution trace (cpu_set_tracer), or NULL */
+    struct tracer *tracer;
+
+    /* Cycle profiler (cpu_set_profiler), or NULL */
+    struct profiler *profiler;
+
+    /* Addresses of the last instructions run, while pc_history_enabled
+     * (cpu_set_pc_history); the newest is at pc_history_count - 1 */
+    bool pc_history_enabled;
+    uint16_t pc_history[CPU_PC_HISTORY];
+    uint32_t pc_history_count;
+
+    /* Instruction dispatch engine */
+    cpu_engine_t engine;
+
+    /* Idle-loop detection and fast-forward (CPU thread only) */
+    struct
+    {
+        bool enabled;            // cpu_set_idle_skip(); on by default
+        bool armed;              // head/end/regs/cycle describe an arrival
+        bool pending;            // Idle loop found; fast-forward at next poll
+        bool polls_input;        // The loop reads INPUT_ADDR
+        uint16_t head;           // Target of the last short backward jump
+        uint16_t end;            // Address after the jumping instruction
+        cpu_registers_t regs;    // State at the last arrival at head
+        uint64_t cycle;          // cycle_count at that arrival
+        uint64_t period;         // Cycles per iteration of the idle loop
+        uint64_t skips;          // Fast-forwards so far
+        uint64_t skipped_cycles; // Cycles accounted without emulating them
+    } idle;
+
+    /* Wakes an idle CPU blocked outside real-time mode (cpu_wake) */
+    atomic_bool idle_waiting;
+    pthread_mutex_t idle_mutex;
+    pthread_cond_t idle_cond;
+
+    /* Predecode and JIT engine state (allocated when first selected) */
+    struct decode_cache *decode_cache;
+    struct jit *jit;
+    uint16_t decoded_operand; // Operand of the predecoded instruction
 } cpu_6502_t;
 
+/* Where cpu_run_differential() saw two CPUs disagree */
+typedef struct
+{
+    bool diverged;             // false if the whole budget ran in agreement
+    uint16_t slice_pc;         // Reference PC at the start of the bad slice
+    cpu_registers_t expected;  // Reference state after the slice
+    cpu_registers_t actual;    // State of the CPU under test
+    uint64_t expected_cycles;
+    uint64_t actual_cycles;
+} cpu_divergence_t;
+
 /* Addressing Structure */
 typedef struct {
     uint16_t address;
@@ -110,31 +236,53 @@ void cpu_destroy(cpu_6502_t *cpu);
 void cpu_reset(cpu_6502_t *cpu);
 cpu_status_t cpu_load_program(cpu_6502_t *cpu, const char *filename, uint16_t addr);
 cpu_status_t cpu_execute_instruction(cpu_6502_t *cpu, breakpoint_t *bp);
+cpu_status_t cpu_run_cycles(cpu_6502_t *cpu, uint64_t budget, breakpoint_t *bp);
+void cpu_request_stop(cpu_6502_t *cpu);
 void cpu_set_clock_frequency(cpu_6502_t *cpu, double frequency);
+void cpu_set_clock_mode(cpu_6502_t *cpu, clock_mode_t mode);
 void cpu_print_state(const cpu_6502_t *cpu);
 void cpu_set_debug_mode(cpu_6502_t *cpu, bool enabled);
+void cpu_set_tracer(cpu_6502_t *cpu, struct tracer *tracer);
+void cpu_set_profiler(cpu_6502_t *cpu, struct profiler *profiler);
+void cpu_set_pc_history(cpu_6502_t *cpu, bool enabled);
+int cpu_get_pc_history(const cpu_6502_t *cpu, uint16_t *pcs, int max);
+const char *cpu_opcode_mnemonic(uint8_t opcode);
+cpu_status_t cpu_set_engine(cpu_6502_t *cpu, cpu_engine_t engine);
+void cpu_set_idle_skip(cpu_6502_t *cpu, bool enabled);
+void cpu_wake(cpu_6502_t *cpu);
+cpu_status_t cpu_run_differential(cpu_6502_t *cpu, cpu_6502_t *reference,
+                                  uint64_t budget, uint64_t slice,
+                                  cpu_divergence_t *divergence);
 
 /* Interrupt Handling Functions */
 void cpu_inject_IRQ(cpu_6502_t *cpu);
 void cpu_inject_NMI(cpu_6502_t *cpu);
+int cpu_add_irq_source(cpu_6502_t *cpu);
+void cpu_set_irq_source(cpu_6502_t *cpu, int source, bool asserted);
+
+/* Event Scheduling Functions (CPU thread, or before it starts) */
+uint32_t cpu_schedule(cpu_6502_t *cpu, uint64_t cycle,
+                      scheduler_callback_t callback, void *context);
+bool cpu_cancel_event(cpu_6502_t *cpu, uint32_t id);
 
 /* Pause Control Functions */
 void cpu_pause(cpu_6502_t *cpu);
 void cpu_resume(cpu_6502_t *cpu);
 
-// Funções utilitárias para testes e manipulação de flags
-static inline void set_flag(cpu_6502_t *cpu, status_flag_t flag, bool value) {
+// Funções utilitárias para testes e manipulação de flags (operam em reg.P,
+// válido sempre que a CPU não está executando)
+static CPU_INLINE void set_flag(cpu_6502_t *cpu, status_flag_t flag, bool value) {
     if (value)
         cpu->reg.P |= (1 << flag);
     else
         cpu->reg.P &= ~(1 << flag);
 }
 
-static inline bool get_flag(const cpu_6502_t *cpu, status_flag_t flag) {
+static CPU_INLINE bool get_flag(const cpu_6502_t *cpu, status_flag_t flag) {
     return (cpu->reg.P >> flag) & 1;
 }
 
-static inline void update_zero_and_negative_flags(cpu_6502_t *cpu, uint8_t value) {
+static CPU_INLINE void update_zero_and_negative_flags(cpu_6502_t *cpu, uint8_t value) {
     set_flag(cpu, FLAG_ZERO, value == 0);
     set_flag(cpu, FLAG_NEGATIVE, (value & 0x80) != 0);
 }
@@ -142,6 +290,12 @@ static inline void update_zero_and_negative_flags(cpu_6502_t *cpu, uint8_t value
 // Funções de breakpoint
 void breakpoint_init(breakpoint_t *bp);
 bool breakpoint_add(breakpoint_t *bp, uint16_t addr);
-bool breakpoint_check(breakpoint_t *bp, uint16_t addr);
+bool breakpoint_remove(breakpoint_t *bp, uint16_t addr);
+
+/* Check Breakpoint: inline, it runs before every instruction */
+static inline bool breakpoint_check(const breakpoint_t *bp, uint16_t addr)
+{
+    return bp && (bp->bits[addr >> 5] & (1u << (addr & 31))) != 0;
+}
 
 #endif /* CPU_6502_H */
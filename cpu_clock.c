@@ -1,4 +1,8 @@
 // cpu_clock.c
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L // clock_nanosleep, CLOCK_MONOTONIC
+#endif
+
 #include <time.h>
 #include <stdlib.h>
 #include "cpu_clock.h"
@@ -6,6 +10,7 @@
 #ifdef _WIN32
 #include <Windows.h>
 #else
+#include <errno.h>
 #include <unistd.h>
 #endif
 
@@ -36,6 +41,20 @@ static double get_current_time(clock_platform_data_t *data)
 #endif
 }
 
+/* Recompute the quantum in cycles from a time quantum */
+static void update_quantum(cpu_clock_t *clock)
+{
+    if (clock->quantum_time > 0.0)
+    {
+        double cycles = clock->quantum_time * clock->frequency;
+        clock->quantum_cycles = cycles < 1.0 ? 1 : (uint64_t)cycles;
+    }
+
+    clock->next_sync_cycle = clock->mode == CLOCK_MODE_REALTIME
+                                 ? clock->cycle_count + clock->quantum_cycles
+                                 : UINT64_MAX; // No sync points at all
+}
+
 /* Initialize the clock */
 int clock_init(cpu_clock_t *clock, double frequency)
 {
@@ -46,6 +65,11 @@ int clock_init(cpu_clock_t *clock, double frequency)
     clock->cycle_count = 0;
     clock->cycle_duration = 1.0 / frequency;
     clock->elapsed_time = 0.0;
+    clock->mode = CLOCK_MODE_REALTIME;
+    clock->quantum_time = CLOCK_DEFAULT_QUANTUM;
+    clock->quantum_cycles = 0;
+    clock->time_base = 0.0;
+    clock->drift = (clock_drift_stats_t){0};
     clock->platform_data = malloc(sizeof(clock_platform_data_t));
 
     if (!clock->platform_data)
@@ -60,6 +84,8 @@ int clock_init(cpu_clock_t *clock, double frequency)
     clock_gettime(CLOCK_MONOTONIC, &data->start_time);
 #endif
 
+    update_quantum(clock);
+
     return 0;
 }
 
@@ -73,62 +99,207 @@ void clock_destroy(cpu_clock_t *clock)
     }
 }
 
-/* Wait until the next cycle */
+/* Sleep until `target` seconds after the clock's start time: an
+ * absolute-deadline sleep up to CLOCK_SPIN_TAIL before it, then spin */
+static void sleep_until(clock_platform_data_t *data, double target)
+{
+    double sleep_target = target - CLOCK_SPIN_TAIL;
+
+#ifdef _WIN32
+    // Sleep() has millisecond granularity; leave the rest to the spin
+    double remaining = sleep_target - get_current_time(data);
+
+    if (remaining >= 0.001)
+    {
+        Sleep((DWORD)(remaining * 1000.0));
+    }
+#else
+    if (sleep_target > get_current_time(data))
+    {
+        struct timespec deadline = data->start_time;
+        double whole = (double)(time_t)sleep_target;
+
+        deadline.tv_sec += (time_t)sleep_target;
+        deadline.tv_nsec += (long)((sleep_target - whole) * 1e9);
+        if (deadline.tv_nsec >= 1000000000L)
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline,
+                               NULL) == EINTR)
+        {
+            // Interrupted by a signal; the deadline is absolute, so retry
+        }
+    }
+#endif
+
+    // Spin-wait the short tail for accuracy below the sleep granularity
+    while (get_current_time(data) < target)
+    {
+    }
+}
+
+/* Count one cycle and throttle if a quantum boundary was reached */
 void clock_wait_next_cycle(cpu_clock_t *clock)
 {
     if (!clock || !clock->platform_data)
         return;
 
-    clock_platform_data_t *data = (clock_platform_data_t *)clock->platform_data;
+    clock->cycle_count++;
+    clock_throttle(clock);
+}
 
-    // Calculate the expected time for the next cycle
-    double expected_time = (clock->cycle_count + 1) * clock->cycle_duration;
-    double current_time = get_current_time(data);
+/* Sleep until wall time catches up with cycle_count and record the drift */
+void clock_sync(cpu_clock_t *clock)
+{
+    if (!clock || !clock->platform_data)
+        return;
 
-    // Calculate the remaining time to wait
-    double sleep_time = expected_time - current_time;
+    clock_platform_data_t *data = (clock_platform_data_t *)clock->platform_data;
 
-    // Ensure sleep_time is not negative
-    if (sleep_time < 0)
-        sleep_time = 0;
+    double emulated_time = clock->cycle_count * clock->cycle_duration;
 
-    // Sleep for the remaining time
-    if (sleep_time > 0)
+    if (clock->mode != CLOCK_MODE_REALTIME)
     {
-#ifdef _WIN32
-        // Convert sleep_time to milliseconds
-        DWORD sleep_ms = (DWORD)(sleep_time * 1000.0);
+        // Turbo and virtual time never wait for (or even read) wall time
+        clock->elapsed_time = emulated_time;
+        clock->next_sync_cycle = UINT64_MAX;
+        return;
+    }
 
-        if (sleep_ms > 0)
-        {
-            Sleep(sleep_ms);
-        }
-        else
-        {
-            // Sleep(0) yields the rest of the thread's time slice
-            Sleep(0);
-        }
-#else
-        struct timespec ts;
+    double target = clock->time_base + emulated_time;
+    double now = get_current_time(data);
 
-        ts.tv_sec = (time_t)sleep_time;
-        ts.tv_nsec = (long)((sleep_time - ts.tv_sec) * 1e9);
+    if (now < target)
+    {
+        sleep_until(data, target);
+        now = get_current_time(data);
+    }
+    else
+    {
+        clock->drift.late_syncs++;
+    }
 
-        if (ts.tv_sec > 0 || ts.tv_nsec > 0)
-        {
-            nanosleep(&ts, NULL);
-        }
-        else
-        {
-            // Yield to other threads
-            sched_yield();
-        }
-#endif
+    double drift = now - target;
+
+    if (drift > CLOCK_MAX_LAG)
+    {
+        // Too far behind (host stall, paused UI, debugger): move the time
+        // base instead of running flat out until real time is caught up
+        clock->time_base += drift;
+        clock->drift.rebases++;
+    }
+    else
+    {
+        clock->drift.syncs++;
+        clock->drift.last_drift = drift;
+        clock->drift.total_drift += drift;
+        if (drift > clock->drift.max_drift)
+            clock->drift.max_drift = drift;
     }
 
-    // Update elapsed time and increment the cycle count
-    clock->elapsed_time = expected_time;
-    clock->cycle_count++;
+    clock->elapsed_time = emulated_time;
+    update_quantum(clock);
+}
+
+/* Change the frequency, keeping the current cycle at the current time */
+void clock_set_frequency(cpu_clock_t *clock, double frequency)
+{
+    if (!clock || frequency <= 0.0)
+        return;
+
+    double emulated_time = clock->cycle_count * clock->cycle_duration;
+
+    clock->frequency = frequency;
+    clock->cycle_duration = 1.0 / frequency;
+    clock->time_base +=
+        emulated_time - clock->cycle_count * clock->cycle_duration;
+    update_quantum(clock);
+}
+
+/* Set the sync quantum in seconds of emulated time */
+void clock_set_quantum_time(cpu_clock_t *clock, double seconds)
+{
+    if (!clock || seconds <= 0.0)
+        return;
+
+    clock->quantum_time = seconds;
+    update_quantum(clock);
+}
+
+/* Set the sync quantum in cycles */
+void clock_set_quantum_cycles(cpu_clock_t *clock, uint64_t cycles)
+{
+    if (!clock || cycles == 0)
+        return;
+
+    clock->quantum_time = 0.0;
+    clock->quantum_cycles = cycles;
+    update_quantum(clock);
+}
+
+/* Start pacing from here: the current cycle maps to the current time */
+static void anchor_time_base(cpu_clock_t *clock)
+{
+    clock_platform_data_t *data = (clock_platform_data_t *)clock->platform_data;
+
+    clock->time_base =
+        get_current_time(data) - clock->cycle_count * clock->cycle_duration;
+}
+
+/* Select real-time, turbo or virtual-time pacing */
+void clock_set_mode(cpu_clock_t *clock, clock_mode_t mode)
+{
+    if (!clock || !clock->platform_data)
+        return;
+
+    if (mode == CLOCK_MODE_REALTIME && clock->mode != CLOCK_MODE_REALTIME)
+        anchor_time_base(clock);
+
+    clock->mode = mode;
+    update_quantum(clock);
+}
+
+/* Move the cycle count, pacing on from the current time */
+void clock_set_cycle(cpu_clock_t *clock, uint64_t cycle)
+{
+    if (!clock || !clock->platform_data)
+        return;
+
+    clock->cycle_count = cycle;
+    clock->elapsed_time = cycle * clock->cycle_duration;
+    anchor_time_base(clock);
+    update_quantum(clock);
+}
+
+/* Seconds on the clock's timeline */
+double clock_get_time(cpu_clock_t *clock)
+{
+    if (!clock || !clock->platform_data)
+        return 0.0;
+
+    if (clock->mode == CLOCK_MODE_VIRTUAL)
+        return clock->cycle_count * clock->cycle_duration;
+
+    return get_current_time((clock_platform_data_t *)clock->platform_data);
+}
+
+/* Short display name of a clock mode */
+const char *clock_mode_name(clock_mode_t mode)
+{
+    switch (mode)
+    {
+    case CLOCK_MODE_REALTIME:
+        return "Real";
+    case CLOCK_MODE_TURBO:
+        return "Turbo";
+    case CLOCK_MODE_VIRTUAL:
+        return "Virtual";
+    default:
+        return "?";
+    }
 }
 
 /* Reset the clock */
@@ -139,6 +310,8 @@ void clock_reset(cpu_clock_t *clock)
 
     clock->cycle_count = 0;
     clock->elapsed_time = 0.0;
+    clock->time_base = 0.0;
+    clock->drift = (clock_drift_stats_t){0};
     clock_platform_data_t *data = (clock_platform_data_t *)clock->platform_data;
 
 #ifdef _WIN32
@@ -146,4 +319,6 @@ void clock_reset(cpu_clock_t *clock)
 #else
     clock_gettime(CLOCK_MONOTONIC, &data->start_time);
 #endif
+
+    update_quantum(clock);
 }
@@ -3,6 +3,31 @@
 
 #include <stdint.h>
 
+/* Throttling defaults */
+#define CLOCK_DEFAULT_QUANTUM  0.001   // Sync to wall time every 1 ms of emulated time
+#define CLOCK_SPIN_TAIL        0.00005 // Spin the last 50 us instead of sleeping
+#define CLOCK_MAX_LAG          0.1     // Rebase instead of bursting when this far behind
+
+/* Clock Modes */
+typedef enum
+{
+    CLOCK_MODE_REALTIME = 0, // Paced to wall time at the configured frequency
+    CLOCK_MODE_TURBO,        // Never sleeps; cycles are counted, time is wall time
+    CLOCK_MODE_VIRTUAL       // Never sleeps; time is derived from cycle_count only
+} clock_mode_t;
+
+/* Drift statistics: wall time minus target time at each sync point, in
+ * seconds (positive means emulation was late) */
+typedef struct
+{
+    uint64_t syncs;      // Sync points reached
+    uint64_t late_syncs; // Syncs that found emulation already behind
+    uint64_t rebases;    // Syncs that gave up catching up (lag > CLOCK_MAX_LAG)
+    double last_drift;   // Drift at the most recent sync
+    double max_drift;    // Largest drift seen
+    double total_drift;  // Sum of drifts (mean = total_drift / syncs)
+} clock_drift_stats_t;
+
 /* Clock structure */
 typedef struct
 {
@@ -11,6 +36,15 @@ typedef struct
     double cycle_duration; // Duration of one cycle in seconds
     double elapsed_time;   // Elapsed time in seconds
     void *platform_data;   // Pointer to platform-specific data
+    clock_mode_t mode;     // Pacing mode
+
+    /* Throttling: wall time is only consulted once cycle_count reaches
+     * next_sync_cycle, i.e. once per quantum (never outside real-time mode) */
+    double quantum_time;      // Quantum in seconds (0 when set in cycles)
+    uint64_t quantum_cycles;  // Quantum in cycles
+    uint64_t next_sync_cycle; // Cycle count of the next sync point
+    double time_base;         // Wall time that corresponds to cycle 0
+    clock_drift_stats_t drift;
 } cpu_clock_t;
 
 /* CPU Clock Configurations */
@@ -27,9 +61,42 @@ int clock_init(cpu_clock_t *clock, double frequency);
 /* Destroy the clock */
 void clock_destroy(cpu_clock_t *clock);
 
-/* Wait until the next cycle */
+/* Count one cycle and throttle if a quantum boundary was reached */
 void clock_wait_next_cycle(cpu_clock_t *clock);
 
+/* Sleep until wall time catches up with cycle_count (no cycle is added) */
+void clock_sync(cpu_clock_t *clock);
+
+/* Throttle only if cycle_count has reached the next sync point */
+static inline void clock_throttle(cpu_clock_t *clock)
+{
+    if (clock->cycle_count >= clock->next_sync_cycle)
+        clock_sync(clock);
+}
+
+/* Change the frequency; the quantum in cycles follows a time quantum */
+void clock_set_frequency(cpu_clock_t *clock, double frequency);
+
+/* Set the sync quantum in seconds of emulated time (e.g. 0.001) */
+void clock_set_quantum_time(cpu_clock_t *clock, double seconds);
+
+/* Set the sync quantum in cycles (e.g. 20000) */
+void clock_set_quantum_cycles(cpu_clock_t *clock, uint64_t cycles);
+
+/* Select real-time, turbo or virtual-time pacing */
+void clock_set_mode(cpu_clock_t *clock, clock_mode_t mode);
+
+/* Move cycle_count (restoring a snapshot); the new cycle maps to the
+ * current time, so real-time pacing neither sleeps nor bursts */
+void clock_set_cycle(cpu_clock_t *clock, uint64_t cycle);
+
+/* Seconds on the clock's timeline: wall time in real-time and turbo modes,
+ * cycle_count / frequency in virtual-time mode */
+double clock_get_time(cpu_clock_t *clock);
+
+/* Short display name of a clock mode */
+const char *clock_mode_name(clock_mode_t mode);
+
 /* Reset the clock */
 void clock_reset(cpu_clock_t *clock);
 
@@ -0,0 +1,87 @@
+// cpu_view.c
+#include <string.h>
+#include "cpu_view.h"
+#include "bus.h"
+
+#define CPU_VIEW_FRESH 4u // Set in middle while its slot has not been read
+#define CPU_VIEW_INDEX 3u
+
+_Static_assert(CPU_VIEW_HISTORY <= CPU_PC_HISTORY,
+               "the CPU keeps fewer instructions than the view shows");
+
+/* Initializes the buffer */
+void cpu_view_init(cpu_view_buffer_t *buffer)
+{
+    memset(buffer->slots, 0, sizeof(buffer->slots));
+    buffer->back = 0;
+    atomic_init(&buffer->middle, 1);
+    buffer->front = 2;
+    buffer->sequence = 0;
+}
+
+/* Fills in the CPU part of a view */
+void cpu_view_capture(cpu_view_t *view, cpu_6502_t *cpu, uint16_t page_addr)
+{
+    view->reg = cpu->reg;
+    view->cycle_count = cpu->clock.cycle_count;
+
+    view->input = bus_peek(cpu->bus, INPUT_ADDR);
+    view->output = bus_peek(cpu->bus, OUTPUT_ADDR);
+    view->opcode = bus_peek(cpu->bus, cpu->reg.PC);
+
+    for (int i = 0; i < CPU_VIEW_STACK; i++)
+        view->stack[i] =
+            bus_peek(cpu->bus, 0x0100 + ((cpu->reg.SP + i + 1) & 0xFF));
+
+    view->clock_mode = cpu->clock.mode;
+    view->performance_percent = cpu->performance_percent;
+    view->drift = cpu->clock.drift.last_drift;
+
+    // Instructions the CPU did not record show as $0000
+    int kept = cpu_get_pc_history(cpu, view->history, CPU_VIEW_HISTORY);
+
+    for (int i = kept; i < CPU_VIEW_HISTORY; i++)
+        view->history[i] = 0;
+
+    view->stop_reason = cpu->stop_reason;
+    view->watch_addr = cpu->watch_addr;
+    view->watch_write = cpu->watch_write;
+
+    view->page_addr = page_addr;
+    for (int i = 0; i < CPU_VIEW_PAGE_SIZE; i++)
+        view->page[i] = bus_peek(cpu->bus, (uint16_t)(page_addr + i));
+}
+
+/* Returns the writer's slot */
+cpu_view_t *cpu_view_back(cpu_view_buffer_t *buffer)
+{
+    return &buffer->slots[buffer->back];
+}
+
+/* Hands the back slot over to the reader */
+void cpu_view_publish(cpu_view_buffer_t *buffer)
+{
+    buffer->slots[buffer->back].sequence = ++buffer->sequence;
+
+    // Release the slot's contents; take back whichever slot was in the
+    // middle, read or not (an unread one is simply superseded)
+    unsigned old = atomic_exchange_explicit(
+        &buffer->middle, buffer->back | CPU_VIEW_FRESH, memory_order_acq_rel);
+
+    buffer->back = old & CPU_VIEW_INDEX;
+}
+
+/* Returns the latest published view */
+const cpu_view_t *cpu_view_acquire(cpu_view_buffer_t *buffer)
+{
+    if (atomic_load_explicit(&buffer->middle, memory_order_relaxed) &
+        CPU_VIEW_FRESH)
+    {
+        unsigned old = atomic_exchange_explicit(
+            &buffer->middle, buffer->front, memory_order_acq_rel);
+
+        buffer->front = old & CPU_VIEW_INDEX;
+    }
+
+    return &buffer->slots[buffer->front];
+}
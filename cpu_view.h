@@ -0,0 +1,119 @@
+// cpu_view.h
+#ifndef CPU_VIEW_H
+#define CPU_VIEW_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "cpu_6502.h"
+
+/*
+ * What the interface shows of the machine, published by the thread that
+ * runs the CPU.
+ *
+ * The emulation thread captures a cpu_view_t between slices, when reg.P is
+ * up to date and nothing else touches the CPU, and the render thread draws
+ * from the latest one it has acquired instead of reading the live CPU. The
+ * capture only peeks the bus, so showing the I/O ports consumes nothing.
+ *
+ * Views go through a triple buffer: the writer fills the back slot and swaps
+ * it with the middle one, the reader swaps the middle slot with its front
+ * one when a fresh view is there. Both sides are a single atomic exchange,
+ * so neither ever waits for the other, and the front slot stays untouched
+ * until the reader asks for the next view. One writer and one reader.
+ */
+
+#define CPU_VIEW_PAGE_SIZE 128 // Bytes of memory copied into a view
+#define CPU_VIEW_STACK 5       // Stack bytes above SP
+#define CPU_VIEW_HISTORY 5     // Most recent instruction addresses, up to
+                               // CPU_PC_HISTORY
+
+/* Snapshot of the machine */
+typedef struct
+{
+    uint64_t sequence; // Increases with every publish
+
+    cpu_registers_t reg;
+    uint64_t cycle_count;
+
+    uint8_t input, output; // INPUT_ADDR and OUTPUT_ADDR, peeked
+    uint8_t opcode;        // At PC
+
+    uint8_t stack[CPU_VIEW_STACK];       // stack[0] is the byte at SP + 1
+    uint16_t history[CPU_VIEW_HISTORY]; // history[0] is the latest
+
+    /* Clock */
+    clock_mode_t clock_mode;
+    double performance_percent;
+    double drift; // Last drift in seconds (real-time mode)
+
+    bool paused;
+
+    /* Debugger */
+    cpu_stop_reason_t stop_reason; // Of the last slice
+    uint16_t watch_addr;           // Access that hit a watchpoint
+    bool watch_write;
+    int breakpoints; // Breakpoints set
+    int watchpoints; // Watchpoints set
+
+    uint16_t page_addr; // First address of page
+    uint8_t page[CPU_VIEW_PAGE_SIZE];
+} cpu_view_t;
+
+/* Triple Buffer */
+typedef struct
+{
+    cpu_view_t slots[3];
+    atomic_uint middle; // Slot index, plus CPU_VIEW_FRESH when unread
+    unsigned back;      // Writer's slot
+    unsigned front;     // Reader's slot
+    uint64_t sequence;  // Writer's publish count
+} cpu_view_buffer_t;
+
+/**
+ * @brief Initializes the buffer. Until the first publish the reader sees a
+ * zeroed view with sequence 0.
+ *
+ * @param buffer Pointer to the buffer.
+ */
+void cpu_view_init(cpu_view_buffer_t *buffer);
+
+/**
+ * @brief Fills in the CPU part of a view: registers, cycles, ports, next
+ * opcode, stack, the last instructions run (cpu_set_pc_history), clock and
+ * the page at page_addr. Reads the bus with bus_peek() only. Call from the
+ * thread running the CPU, between slices.
+ *
+ * paused, breakpoints and watchpoints are left for the caller.
+ *
+ * @param view View to fill in.
+ * @param cpu CPU to capture.
+ * @param page_addr First address of the memory page to copy.
+ */
+void cpu_view_capture(cpu_view_t *view, cpu_6502_t *cpu, uint16_t page_addr);
+
+/**
+ * @brief Returns the writer's slot, to be filled in and then published.
+ *
+ * @param buffer Pointer to the buffer.
+ * @return The back slot.
+ */
+cpu_view_t *cpu_view_back(cpu_view_buffer_t *buffer);
+
+/**
+ * @brief Hands the back slot over to the reader (writer only).
+ *
+ * @param buffer Pointer to the buffer.
+ */
+void cpu_view_publish(cpu_view_buffer_t *buffer);
+
+/**
+ * @brief Returns the latest published view (reader only). The view stays
+ * valid until the next call.
+ *
+ * @param buffer Pointer to the buffer.
+ * @return The front slot.
+ */
+const cpu_view_t *cpu_view_acquire(cpu_view_buffer_t *buffer);
+
+#endif // CPU_VIEW_H
@@ -0,0 +1,240 @@
+// decode_cache.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "decode_cache.h"
+
+#define CODE_PAGE_BIT(page) (1u << ((page) & 31))
+#define CODE_BYTE_BIT(addr) (1u << ((addr) & 31))
+
+/* Check whether a page holds cached code */
+static inline bool is_code_page(const decode_cache_t *cache, uint8_t page)
+{
+    return (cache->code_pages[page >> 5] & CODE_PAGE_BIT(page)) != 0;
+}
+
+/* Mark a page as holding cached code and start watching its writes */
+static void add_code_page(decode_cache_t *cache, uint8_t page)
+{
+    if (is_code_page(cache, page))
+        return;
+
+    cache->code_pages[page >> 5] |= CODE_PAGE_BIT(page);
+    bus_watch_page(cache->bus, page, true);
+}
+
+/* Bus write hook: a watched page was written */
+static void decode_cache_write_hook(void *context, uint16_t addr)
+{
+    decode_cache_invalidate((decode_cache_t *)context, addr);
+}
+
+/* Reset the bookkeeping without touching any bus */
+static void decode_cache_clear(decode_cache_t *cache)
+{
+    memset(cache->block_at, 0xFF, sizeof(cache->block_at));
+    memset(cache->code_pages, 0, sizeof(cache->code_pages));
+    memset(cache->code_bytes, 0, sizeof(cache->code_bytes));
+    cache->used = 0;
+    cache->free_list = DECODE_NO_BLOCK;
+}
+
+/* Creates an empty decode cache */
+decode_cache_t *decode_cache_create(const decode_op_t *ops)
+{
+    if (!ops)
+        return NULL;
+
+    decode_cache_t *cache = malloc(sizeof(decode_cache_t));
+
+    if (!cache)
+    {
+        fprintf(stderr, "decode_cache_create: Failed to allocate cache.\n");
+        return NULL;
+    }
+
+    cache->ops = ops;
+    cache->bus = NULL;
+    memset(&cache->stats, 0, sizeof(cache->stats));
+    decode_cache_clear(cache);
+
+    return cache;
+}
+
+/* Stops watching the bus and frees the cache */
+void decode_cache_destroy(decode_cache_t *cache)
+{
+    if (!cache)
+        return;
+
+    decode_cache_flush(cache);
+
+    if (cache->bus && cache->bus->write_hook_context == cache)
+        bus_set_write_hook(cache->bus, NULL, NULL);
+
+    free(cache);
+}
+
+/* Drops every block and stops watching the bus */
+void decode_cache_flush(decode_cache_t *cache)
+{
+    if (!cache)
+        return;
+
+    if (cache->bus)
+    {
+        for (int page = 0; page < BUS_PAGE_COUNT; page++)
+        {
+            if (is_code_page(cache, (uint8_t)page))
+                bus_watch_page(cache->bus, (uint8_t)page, false);
+        }
+    }
+
+    decode_cache_clear(cache);
+    cache->stats.flushes++;
+}
+
+/* Drops the blocks whose bytes include addr */
+void decode_cache_invalidate(decode_cache_t *cache, uint16_t addr)
+{
+    if (!cache || !(cache->code_bytes[addr >> 5] & CODE_BYTE_BIT(addr)))
+        return; // Data that merely shares a page with code
+
+    // Only blocks starting this close below addr can reach it
+    uint16_t first = (addr >= DECODE_BLOCK_MAX_BYTES - 1)
+                         ? (uint16_t)(addr - (DECODE_BLOCK_MAX_BYTES - 1))
+                         : 0;
+
+    for (uint32_t start = first; start <= addr; start++)
+    {
+        uint16_t index = cache->block_at[start];
+
+        if (index == DECODE_NO_BLOCK || cache->blocks[index].end < addr)
+            continue;
+
+        decoded_block_t *block = &cache->blocks[index];
+
+        block->valid = false;
+        cache->block_at[start] = DECODE_NO_BLOCK;
+        cache->stats.invalidations++;
+
+        block->next_free = cache->free_list;
+        cache->free_list = index;
+    }
+
+    // The page stays watched: self-modifying code tends to rewrite and re-run
+    // the same block, and re-watching costs a page table rebuild each time
+}
+
+/* Attach the cache to a bus, dropping anything decoded from another one. The
+ * old bus is left alone: it may already have been destroyed. */
+static void decode_cache_bind(decode_cache_t *cache, bus_t *bus)
+{
+    decode_cache_clear(cache);
+    cache->stats.flushes++;
+    cache->bus = bus;
+    bus_set_write_hook(bus, decode_cache_write_hook, cache);
+}
+
+/* Read a code byte through the page table; false if the page has no plain
+ * storage behind it */
+static inline bool read_code_byte(const bus_t *bus, uint32_t addr,
+                                  uint8_t *byte)
+{
+    if (addr > 0xFFFF)
+        return false; // Never decode across the end of the address space
+
+    const uint8_t *page = bus->read_page[addr >> 8];
+
+    if (!page)
+        return false;
+
+    *byte = page[addr & 0xFF];
+    return true;
+}
+
+/* Decode a block at pc into a fresh pool slot */
+static decoded_block_t *decode_block(decode_cache_t *cache, uint16_t pc)
+{
+    if (cache->free_list == DECODE_NO_BLOCK &&
+        cache->used == DECODE_CACHE_BLOCKS)
+        decode_cache_flush(cache);
+
+    uint16_t index = (cache->free_list != DECODE_NO_BLOCK) ? cache->free_list
+                                                           : cache->used;
+    decoded_block_t *block = &cache->blocks[index];
+    uint32_t addr = pc;
+
+    block->count = 0;
+
+    while (block->count < DECODE_BLOCK_MAX_INSNS)
+    {
+        uint8_t opcode, low = 0, high = 0;
+
+        if (!read_code_byte(cache->bus, addr, &opcode))
+            break;
+
+        const decode_op_t *op = &cache->ops[opcode];
+
+        if (!op->cacheable)
+            break;
+
+        if (addr + op->length - pc > DECODE_BLOCK_MAX_BYTES)
+            break;
+
+        if ((op->length > 1 && !read_code_byte(cache->bus, addr + 1, &low)) ||
+            (op->length > 2 && !read_code_byte(cache->bus, addr + 2, &high)))
+            break;
+
+        decoded_insn_t *insn = &block->insns[block->count++];
+        insn->opcode = opcode;
+        insn->operand = (uint16_t)(low | (high << 8));
+        insn->next_pc = (uint16_t)(addr + op->length);
+        insn->cycles = op->cycles;
+
+        addr += op->length;
+
+        if (op->ends_block || addr > 0xFFFF)
+            break;
+    }
+
+    if (block->count == 0)
+        return NULL;
+
+    if (index == cache->free_list)
+        cache->free_list = block->next_free;
+    else
+        cache->used++;
+    cache->stats.blocks_decoded++;
+
+    block->start = pc;
+    block->end = (uint16_t)(addr - 1);
+    block->valid = true;
+    block->hits = 0;
+    block->native = NULL; // Any old translation described other bytes
+    cache->block_at[pc] = index;
+
+    for (uint32_t a = block->start; a <= block->end; a++)
+        cache->code_bytes[a >> 5] |= CODE_BYTE_BIT(a);
+
+    // Watch the (at most two) pages the block covers
+    add_code_page(cache, block->start >> 8);
+    add_code_page(cache, block->end >> 8);
+
+    return block;
+}
+
+/* Returns the block starting at pc, decoding it on a miss */
+decoded_block_t *decode_cache_lookup(decode_cache_t *cache, bus_t *bus,
+                                     uint16_t pc)
+{
+    if (cache->bus != bus)
+        decode_cache_bind(cache, bus);
+
+    uint16_t index = cache->block_at[pc];
+
+    if (index != DECODE_NO_BLOCK)
+        return &cache->blocks[index];
+
+    return decode_block(cache, pc);
+}
@@ -0,0 +1,136 @@
+// decode_cache.h
+#ifndef DECODE_CACHE_H
+#define DECODE_CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "cpu_6502.h"
+
+/*
+ * Predecoded basic-block cache.
+ *
+ * A block is a straight-line run of instructions starting at some PC, with
+ * opcode and operand bytes already extracted. It
+ * ends at the first control transfer, at an opcode that cannot be cached, or
+ * once it would grow past DECODE_BLOCK_MAX_INSNS instructions or
+ * DECODE_BLOCK_MAX_BYTES bytes.
+ *
+ * Blocks are only built from pages the bus maps to plain storage (a direct
+ * read pointer), so decoding never has device side effects. Every page that
+ * holds cached code is watched on the bus; a write to it invalidates exactly
+ * the blocks whose bytes cover the written address, which keeps
+ * self-modifying code correct. A per-byte code bitmap lets writes to data
+ * sharing a page with code return at once; otherwise the blocks to drop are
+ * found by scanning block_at over the DECODE_BLOCK_MAX_BYTES start addresses
+ * that can reach the written byte. Invalidated blocks go back to the pool;
+ * only when the pool runs dry is the whole cache flushed.
+ */
+
+#define DECODE_BLOCK_MAX_INSNS 32 // Longest straight-line run per block
+#define DECODE_BLOCK_MAX_BYTES 64 // Most bytes a block may span
+#define DECODE_CACHE_BLOCKS 2048  // Block pool size
+#define DECODE_NO_BLOCK 0xFFFF    // Empty slot in block_at / page lists
+
+/* Per-opcode description supplied by the CPU core */
+typedef struct
+{
+    bool cacheable;  // false for opcodes the core does not implement
+    bool ends_block; // Control transfer (branch, jump, ...)
+    uint8_t length;  // Instruction length in bytes
+    uint8_t cycles;  // Base cycles
+} decode_op_t;
+
+/* One predecoded instruction; the core dispatches on the opcode with its
+ * handler and addressing mode resolved at compile time */
+typedef struct
+{
+    uint16_t operand; // Operand bytes, little endian
+    uint16_t next_pc; // Address of the following instruction
+    uint8_t opcode;
+    uint8_t cycles;   // Base cycles
+} decoded_insn_t;
+
+/* A straight-line run of predecoded instructions */
+typedef struct
+{
+    uint16_t start;     // PC of the first instruction
+    uint16_t end;       // Address of the last byte of the last instruction
+    uint16_t next_free; // Free list link while the block is unused
+    uint8_t count;      // Instructions in insns[]
+    bool valid;         // Cleared when a write hits the block
+    uint16_t hits;      // Entries so far, for the JIT's hotness test
+    void *native;       // Translated host code (jit.h), or NULL
+    decoded_insn_t insns[DECODE_BLOCK_MAX_INSNS];
+} decoded_block_t;
+
+/* Cache statistics */
+typedef struct
+{
+    uint64_t blocks_decoded; // Blocks built
+    uint64_t invalidations;  // Blocks dropped by writes to their bytes
+    uint64_t flushes;        // Whole-cache flushes (pool exhausted, rebind)
+} decode_cache_stats_t;
+
+/* Decode Cache Structure */
+typedef struct decode_cache
+{
+    const decode_op_t *ops; // 256 entries, owned by the CPU core
+    bus_t *bus;             // Bus the cache reads from and watches
+
+    uint16_t block_at[0x10000];               // Block starting at each PC
+    uint32_t code_pages[BUS_PAGE_COUNT / 32]; // Pages holding cached code
+    uint32_t code_bytes[0x10000 / 32];        // Bytes covered by some block
+
+    uint16_t used;      // Blocks ever handed out from the pool
+    uint16_t free_list; // Invalidated blocks ready for reuse
+    decode_cache_stats_t stats;
+    decoded_block_t blocks[DECODE_CACHE_BLOCKS];
+} decode_cache_t;
+
+/**
+ * @brief Creates an empty decode cache.
+ *
+ * @param ops Per-opcode table (256 entries) that must outlive the cache.
+ * @return Pointer to the cache or NULL on failure.
+ */
+decode_cache_t *decode_cache_create(const decode_op_t *ops);
+
+/**
+ * @brief Stops watching the bus and frees the cache.
+ *
+ * @param cache Pointer to the cache.
+ */
+void decode_cache_destroy(decode_cache_t *cache);
+
+/**
+ * @brief Returns the block starting at pc, decoding it on a miss.
+ *
+ * Binds the cache to bus first if it was bound to a different one.
+ *
+ * @param cache Pointer to the cache.
+ * @param bus Bus to decode from.
+ * @param pc Address of the first instruction.
+ * @return The block, or NULL if nothing at pc can be cached.
+ */
+decoded_block_t *decode_cache_lookup(decode_cache_t *cache, bus_t *bus,
+                                     uint16_t pc);
+
+/**
+ * @brief Drops every block and stops watching the bus.
+ *
+ * @param cache Pointer to the cache.
+ */
+void decode_cache_flush(decode_cache_t *cache);
+
+/**
+ * @brief Drops the blocks whose bytes include addr.
+ *
+ * Called from the bus write hook; also usable after memory was changed
+ * behind the bus's back.
+ *
+ * @param cache Pointer to the cache.
+ * @param addr Address that was written.
+ */
+void decode_cache_invalidate(decode_cache_t *cache, uint16_t addr);
+
+#endif // DECODE_CACHE_H
@@ -1,7 +1,18 @@
 // event_queue.c
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L // clock_gettime
+#endif
+
 #include <stdlib.h>
+#include <time.h>
 #include "event_queue.h"
 
+#if (EVENT_QUEUE_CAPACITY & (EVENT_QUEUE_CAPACITY - 1)) != 0
+#error "EVENT_QUEUE_CAPACITY must be a power of two"
+#endif
+
+#define EVENT_QUEUE_MASK (EVENT_QUEUE_CAPACITY - 1)
+
 // Create a new event queue
 EventQueue *event_queue_create()
 {
@@ -10,67 +21,163 @@ EventQueue *event_queue_create()
     if (!queue)
         return NULL;
 
-    queue->head = queue->tail = NULL;
+    // Slot i is free for the producer that claims position i
+    for (size_t i = 0; i < EVENT_QUEUE_CAPACITY; i++)
+    {
+        atomic_init(&queue->cells[i].sequence, i);
+    }
+
+    atomic_init(&queue->enqueue_pos, 0);
+    queue->dequeue_pos = 0;
+    atomic_init(&queue->consumer_waiting, false);
     pthread_mutex_init(&queue->mutex, NULL);
     pthread_cond_init(&queue->cond, NULL);
 
     return queue;
 }
 
-// Enqueue a new event
+// Enqueue a new event; fails instead of blocking when the ring is full
 bool event_queue_enqueue(EventQueue *queue, Event event)
 {
     if (!queue)
         return false;
 
-    EventNode *node = malloc(sizeof(EventNode));
-
-    if (!node)
-        return false;
-    node->event = event;
-    node->next = NULL;
+    size_t pos = atomic_load_explicit(&queue->enqueue_pos,
+                                      memory_order_relaxed);
+    EventCell *cell;
 
-    pthread_mutex_lock(&queue->mutex);
-
-    if (queue->tail)
+    for (;;)
     {
-        queue->tail->next = node;
-        queue->tail = node;
+        cell = &queue->cells[pos & EVENT_QUEUE_MASK];
+        size_t seq = atomic_load_explicit(&cell->sequence,
+                                          memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+        if (diff == 0)
+        {
+            // Slot is free: try to claim this position
+            if (atomic_compare_exchange_weak_explicit(
+                    &queue->enqueue_pos, &pos, pos + 1, memory_order_relaxed,
+                    memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            return false; // Queue full, consumer is a lap behind
+        }
+        else
+        {
+            // Another producer took this position; reload and retry
+            pos = atomic_load_explicit(&queue->enqueue_pos,
+                                       memory_order_relaxed);
+        }
     }
-    else
+
+    cell->event = event;
+    atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+
+    // Pairs with the fence in event_queue_dequeue_timed: either the consumer
+    // sees this event before parking, or we see its waiting flag
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&queue->consumer_waiting, memory_order_relaxed))
     {
-        queue->head = queue->tail = node;
+        pthread_mutex_lock(&queue->mutex);
+        pthread_cond_signal(&queue->cond);
+        pthread_mutex_unlock(&queue->mutex);
     }
 
-    pthread_cond_signal(&queue->cond);
-    pthread_mutex_unlock(&queue->mutex);
     return true;
 }
 
-// Dequeue an event; blocks if the queue is empty
-bool event_queue_dequeue(EventQueue *queue, Event *event)
+// Check whether the next slot holds a published event (consumer side)
+static bool event_queue_ready(EventQueue *queue)
+{
+    EventCell *cell = &queue->cells[queue->dequeue_pos & EVENT_QUEUE_MASK];
+
+    return atomic_load_explicit(&cell->sequence, memory_order_acquire) ==
+           queue->dequeue_pos + 1;
+}
+
+// Dequeue an event if one is available, never blocks
+bool event_queue_try_dequeue(EventQueue *queue, Event *event)
 {
     if (!queue || !event)
         return false;
 
+    if (!event_queue_ready(queue))
+        return false;
+
+    size_t pos = queue->dequeue_pos;
+    EventCell *cell = &queue->cells[pos & EVENT_QUEUE_MASK];
+
+    *event = cell->event;
+
+    // Hand the slot back to producers for the next lap
+    atomic_store_explicit(&cell->sequence, pos + EVENT_QUEUE_CAPACITY,
+                          memory_order_release);
+    queue->dequeue_pos = pos + 1;
+
+    return true;
+}
+
+// Park the consumer until an event is published or the deadline passes.
+// A NULL deadline waits indefinitely.
+static void event_queue_park(EventQueue *queue, const struct timespec *deadline)
+{
     pthread_mutex_lock(&queue->mutex);
+    atomic_store_explicit(&queue->consumer_waiting, true,
+                          memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
 
-    while (queue->head == NULL)
+    int rc = 0;
+    while (!event_queue_ready(queue) && rc == 0)
     {
-        pthread_cond_wait(&queue->cond, &queue->mutex);
+        if (deadline)
+            rc = pthread_cond_timedwait(&queue->cond, &queue->mutex, deadline);
+        else
+            rc = pthread_cond_wait(&queue->cond, &queue->mutex);
     }
 
-    EventNode *node = queue->head;
-    *event = node->event;
-    queue->head = node->next;
+    atomic_store_explicit(&queue->consumer_waiting, false,
+                          memory_order_relaxed);
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+// Dequeue an event, waiting at most timeout_ms for one to arrive
+bool event_queue_dequeue_timed(EventQueue *queue, Event *event,
+                               unsigned int timeout_ms)
+{
+    if (!queue || !event)
+        return false;
+
+    if (event_queue_try_dequeue(queue, event))
+        return true;
 
-    if (queue->head == NULL)
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L)
     {
-        queue->tail = NULL;
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
     }
 
-    pthread_mutex_unlock(&queue->mutex);
-    free(node);
+    event_queue_park(queue, &deadline);
+
+    return event_queue_try_dequeue(queue, event);
+}
+
+// Dequeue an event; blocks if the queue is empty
+bool event_queue_dequeue(EventQueue *queue, Event *event)
+{
+    if (!queue || !event)
+        return false;
+
+    while (!event_queue_try_dequeue(queue, event))
+    {
+        event_queue_park(queue, NULL);
+    }
 
     return true;
 }
@@ -81,11 +188,7 @@ bool event_queue_is_empty(EventQueue *queue)
     if (!queue)
         return true;
 
-    pthread_mutex_lock(&queue->mutex);
-    bool empty = (queue->head == NULL);
-    pthread_mutex_unlock(&queue->mutex);
-
-    return empty;
+    return !event_queue_ready(queue);
 }
 
 // Destroy the event queue
@@ -94,17 +197,6 @@ void event_queue_destroy(EventQueue *queue)
     if (!queue)
         return;
 
-    pthread_mutex_lock(&queue->mutex);
-    EventNode *current = queue->head;
-
-    while (current)
-    {
-        EventNode *tmp = current;
-        current = current->next;
-        free(tmp);
-    }
-
-    pthread_mutex_unlock(&queue->mutex);
     pthread_mutex_destroy(&queue->mutex);
     pthread_cond_destroy(&queue->cond);
     free(queue);
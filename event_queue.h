@@ -3,7 +3,9 @@
 #define EVENT_QUEUE_H
 
 #include <stdint.h>
+#include <stddef.h>
 #include <stdbool.h>
+#include <stdatomic.h>
 #include <pthread.h>
 
 // Define event types
@@ -35,27 +37,46 @@ typedef struct
     } data;
 } Event;
 
-// Node structure for the event queue
-typedef struct EventNode
+// Capacity of the event ring, must be a power of two
+#define EVENT_QUEUE_CAPACITY 256
+#define EVENT_QUEUE_CACHE_LINE 64
+
+// One ring slot; the sequence number says whether it is free or published
+typedef struct
 {
+    atomic_size_t sequence;
     Event event;
-    struct EventNode *next;
-} EventNode;
+} EventCell;
 
-// EventQueue structure
+// EventQueue: bounded multi-producer/single-consumer ring.
+// Any number of threads may enqueue without locks; only one thread may
+// dequeue. The ring is allocated once with the queue, so posting an event
+// never touches the allocator.
 typedef struct
 {
-    EventNode *head;
-    EventNode *tail;
+    atomic_size_t enqueue_pos; // Claimed by producers with CAS
+    uint8_t pad_producers[EVENT_QUEUE_CACHE_LINE - sizeof(atomic_size_t)];
+
+    size_t dequeue_pos; // Owned by the consumer
+    atomic_bool consumer_waiting;
+    uint8_t pad_consumer[EVENT_QUEUE_CACHE_LINE - sizeof(size_t) -
+                         sizeof(atomic_bool)];
+
+    EventCell cells[EVENT_QUEUE_CAPACITY];
+
+    // Only used to park the consumer when the ring is empty
     pthread_mutex_t mutex;
     pthread_cond_t cond;
 } EventQueue;
 
 // Function prototypes
 EventQueue *event_queue_create();
-bool event_queue_enqueue(EventQueue *queue, Event event);
-bool event_queue_dequeue(EventQueue *queue, Event *event);
-bool event_queue_is_empty(EventQueue *queue);
+bool event_queue_enqueue(EventQueue *queue, Event event); // false when full
+bool event_queue_dequeue(EventQueue *queue, Event *event); // blocks
+bool event_queue_try_dequeue(EventQueue *queue, Event *event);
+bool event_queue_dequeue_timed(EventQueue *queue, Event *event,
+                               unsigned int timeout_ms);
+bool event_queue_is_empty(EventQueue *queue); // consumer side
 void event_queue_destroy(EventQueue *queue);
 
 #endif // EVENT_QUEUE_H
@@ -0,0 +1,442 @@
+// headless.c
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L // clock_gettime, nanosleep
+#endif
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "headless.h"
+#include "acia.h"
+#include "bus.h"
+#include "cpu_6502.h"
+#include "monitored.h"
+#include "profiler.h"
+#include "queue.h"
+#include "trace.h"
+#include "via6522.h"
+
+/* The Machine */
+
+typedef struct
+{
+    cpu_6502_t *cpu;
+    memory_t *ram;
+    memory_t *via;
+    memory_t *acia;
+    memory_t *console;
+} machine_t;
+
+/* Tear down whatever machine_create() got to */
+static void machine_destroy(machine_t *machine)
+{
+    // Devices first: they cancel their events on the CPU
+    memory_destroy_via(machine->via);
+    memory_destroy_acia(machine->acia);
+    memory_destroy_console(machine->console);
+
+    if (machine->cpu)
+    {
+        cpu_destroy(machine->cpu);
+        free(machine->cpu);
+    }
+
+    if (machine->ram)
+        memory_destroy_monitored_ram(machine->ram);
+}
+
+/* Same devices and map as the interactive emulator */
+static bool machine_create(machine_t *machine)
+{
+    memset(machine, 0, sizeof(*machine));
+
+    machine->cpu = malloc(sizeof(cpu_6502_t));
+
+    if (!machine->cpu || cpu_init(machine->cpu) != CPU_SUCCESS)
+    {
+        fprintf(stderr, "Failed to initialize CPU.\n");
+        free(machine->cpu);
+        machine->cpu = NULL;
+        return false;
+    }
+
+    cpu_6502_t *cpu = machine->cpu;
+
+    cpu_set_engine(cpu, CPU_ENGINE_SWITCH);
+    cpu_set_clock_mode(cpu, CLOCK_MODE_VIRTUAL); // Never sleep
+
+    machine->ram = memory_create_monitored_ram(0x10000, cpu);
+    machine->via = memory_create_via(cpu);
+    machine->acia =
+        memory_create_acia(cpu, &cpu->input_queue, &cpu->output_queue);
+    machine->console =
+        memory_create_console(&cpu->input_queue, &cpu->output_queue);
+
+    if (!machine->ram || !machine->via || !machine->acia || !machine->console)
+    {
+        fprintf(stderr, "Failed to create devices.\n");
+        machine_destroy(machine);
+        return false;
+    }
+
+    // I/O first: the first device mapped at an address owns it
+    bus_connect_device(cpu->bus, machine->via, VIA_BASE_ADDR,
+                       VIA_BASE_ADDR + 0x0F);
+    bus_connect_device(cpu->bus, machine->acia, ACIA_BASE_ADDR,
+                       ACIA_BASE_ADDR + 0x03);
+    bus_connect_device(cpu->bus, machine->console, INPUT_ADDR, OUTPUT_ADDR);
+    bus_connect_device(cpu->bus, machine->ram, 0x0000, 0xFFFF);
+
+    return true;
+}
+
+/* Serial I/O */
+
+/* Feed stdin to the CPU until end of file. The queue's only producer. */
+static void *stdin_reader(void *arg)
+{
+    cpu_6502_t *cpu = (cpu_6502_t *)arg;
+    uint8_t buffer[256];
+    ssize_t count;
+
+    while ((count = read(STDIN_FILENO, buffer, sizeof(buffer))) > 0)
+    {
+        for (ssize_t i = 0; i < count; i++)
+        {
+            const uint8_t crlf[2] = {'\r', '\n'};
+            const uint8_t *bytes = (buffer[i] == '\n') ? crlf : &buffer[i];
+            size_t n = (buffer[i] == '\n') ? 2 : 1;
+            size_t done = 0;
+
+            // Wait for the program to make room rather than drop input
+            while ((done += queue_enqueue_n(&cpu->input_queue, bytes + done,
+                                            n - done)) < n)
+            {
+                struct timespec delay = {0, 1000000L}; // 1 ms
+
+                cpu_wake(cpu);
+                nanosleep(&delay, NULL);
+            }
+        }
+
+        cpu_wake(cpu);
+    }
+
+    return NULL;
+}
+
+/* Move everything the CPU has sent to stdout's buffer */
+static void drain_output(cpu_6502_t *cpu)
+{
+    uint8_t batch[QUEUE_SIZE];
+    size_t count;
+
+    while ((count = queue_dequeue_n(&cpu->output_queue, batch,
+                                    sizeof(batch))) > 0)
+        fwrite(batch, 1, count, stdout);
+}
+
+static double monotonic_ms(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1e6;
+}
+
+/* Profiling */
+
+/* Write a profile report to a file, if asked for */
+static bool write_profile(const profiler_t *profiler, const char *path,
+                          bool folded)
+{
+    if (!path)
+        return true;
+
+    FILE *file = fopen(path, "w");
+
+    if (!file)
+    {
+        perror("Error creating profile file");
+        return false;
+    }
+
+    if (folded)
+        profiler_write_folded(profiler, file);
+    else
+        profiler_report(profiler, file, 0);
+
+    if (fclose(file) != 0)
+    {
+        perror("Error writing profile file");
+        return false;
+    }
+
+    return true;
+}
+
+/* Argument Parsing */
+
+static void print_usage(void)
+{
+    fprintf(stderr,
+            "Usage: emu65 --headless ROM [--load ADDR] [--start ADDR]\n"
+            "                            [--exit-pc ADDR] [--exit-on-status]\n"
+            "                            [--max-cycles N] [--trace FILE]\n"
+            "                            [--profile FILE] [--profile-folded FILE]\n"
+            "\n"
+            "  --load ADDR       Load address (default $C000)\n"
+            "  --start ADDR      Start here instead of at the reset vector\n"
+            "  --exit-pc ADDR    Stop when PC reaches ADDR\n"
+            "  --exit-on-status  Stop on a write to the test status ($6001)\n"
+            "  --max-cycles N    Stop after N cycles\n"
+            "  --trace FILE      Record every instruction to FILE\n"
+            "  --profile FILE    Write a cycle profile to FILE\n"
+            "  --profile-folded FILE\n"
+            "                    Write folded call stacks to FILE, for\n"
+            "                    flamegraph tools\n"
+            "\n"
+            "Exit codes: 0 exit PC reached or test status $00, 1 test status\n"
+            "not $00, 2 cycle budget used up, 3 error.\n");
+}
+
+/* Parses the arguments after "--headless" */
+bool headless_parse_args(int argc, char *argv[], headless_options_t *options)
+{
+    memset(options, 0, sizeof(*options));
+    options->load_address = 0xC000;
+
+    for (int i = 0; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        uint64_t value;
+
+        if (arg[0] != '-' && !options->rom_path)
+        {
+            options->rom_path = arg;
+            continue;
+        }
+
+        if (strcmp(arg, "--exit-on-status") == 0)
+        {
+            options->exit_on_status = true;
+            continue;
+        }
+
+        if (strcmp(arg, "--trace") == 0 && i + 1 < argc)
+        {
+            options->trace_path = argv[++i];
+            continue;
+        }
+
+        if (strcmp(arg, "--profile") == 0 && i + 1 < argc)
+        {
+            options->profile_path = argv[++i];
+            continue;
+        }
+
+        if (strcmp(arg, "--profile-folded") == 0 && i + 1 < argc)
+        {
+            options->folded_path = argv[++i];
+            continue;
+        }
+
+        bool is_address = strcmp(arg, "--load") == 0 ||
+                          strcmp(arg, "--start") == 0 ||
+                          strcmp(arg, "--exit-pc") == 0;
+
+        if ((!is_address && strcmp(arg, "--max-cycles") != 0) ||
+            i + 1 == argc ||
+            !trace_parse_number(argv[++i],
+                                is_address ? 0xFFFF : UINT64_MAX, &value))
+        {
+            fprintf(stderr, "Invalid argument: %s\n", arg);
+            print_usage();
+            return false;
+        }
+
+        if (strcmp(arg, "--load") == 0)
+            options->load_address = (uint16_t)value;
+        else if (strcmp(arg, "--start") == 0)
+        {
+            options->has_start = true;
+            options->start_pc = (uint16_t)value;
+        }
+        else if (strcmp(arg, "--exit-pc") == 0)
+        {
+            options->has_exit_pc = true;
+            options->exit_pc = (uint16_t)value;
+        }
+        else
+            options->max_cycles = value;
+    }
+
+    if (!options->rom_path)
+    {
+        print_usage();
+        return false;
+    }
+
+    return true;
+}
+
+/* The Run */
+
+/* Builds the machine, runs it and tears it down */
+int headless_run(const headless_options_t *options)
+{
+    machine_t machine;
+
+    if (!options || !machine_create(&machine))
+        return HEADLESS_EXIT_ERROR;
+
+    cpu_6502_t *cpu = machine.cpu;
+    monitored_ram_t *ram = (monitored_ram_t *)machine.ram->context;
+
+    ram->stop_on_test_status = options->exit_on_status;
+
+    // Load, point the reset vector at the image and reset the machine
+    if (cpu_load_program(cpu, options->rom_path, options->load_address) !=
+        CPU_SUCCESS)
+    {
+        fprintf(stderr, "Failed to load binary %s.\n", options->rom_path);
+        machine_destroy(&machine);
+        return HEADLESS_EXIT_ERROR;
+    }
+
+    cpu_reset(cpu);
+    via_reset(machine.via);
+    acia_reset(machine.acia);
+
+    if (options->has_start)
+        cpu->reg.PC = options->start_pc;
+
+    tracer_t *tracer = NULL;
+
+    if (options->trace_path)
+    {
+        tracer = tracer_create(options->trace_path);
+
+        if (!tracer)
+        {
+            machine_destroy(&machine);
+            return HEADLESS_EXIT_ERROR;
+        }
+        cpu_set_tracer(cpu, tracer);
+    }
+
+    profiler_t *profiler = NULL;
+
+    if (options->profile_path || options->folded_path)
+    {
+        if (!(profiler = profiler_create()))
+        {
+            if (tracer)
+            {
+                cpu_set_tracer(cpu, NULL);
+                tracer_destroy(tracer);
+            }
+            machine_destroy(&machine);
+            return HEADLESS_EXIT_ERROR;
+        }
+        cpu_set_profiler(cpu, profiler);
+    }
+
+    breakpoint_t exit_bp;
+    breakpoint_init(&exit_bp);
+    if (options->has_exit_pc)
+        breakpoint_add(&exit_bp, options->exit_pc);
+
+    // stdout only sees whole batches; stdin is fed on its own thread
+    setvbuf(stdout, NULL, _IOFBF, 1 << 16);
+
+    pthread_t reader;
+    bool reading = pthread_create(&reader, NULL, stdin_reader, cpu) == 0;
+
+    uint64_t start = cpu->clock.cycle_count;
+    double last_flush = monotonic_ms();
+    int code = HEADLESS_EXIT_ERROR;
+
+    for (;;)
+    {
+        uint64_t slice = HEADLESS_SLICE_CYCLES;
+
+        // A slice does not stop on a breakpoint at the PC it starts from
+        if (options->has_exit_pc && cpu->reg.PC == options->exit_pc)
+        {
+            code = HEADLESS_EXIT_PASS;
+            break;
+        }
+
+        if (options->max_cycles)
+        {
+            uint64_t used = cpu->clock.cycle_count - start;
+
+            if (used >= options->max_cycles)
+            {
+                code = HEADLESS_EXIT_TIMEOUT;
+                break;
+            }
+
+            if (options->max_cycles - used < slice)
+                slice = options->max_cycles - used;
+        }
+
+        cpu_status_t status = cpu_run_cycles(cpu, slice, &exit_bp);
+
+        drain_output(cpu);
+
+        if (status != CPU_SUCCESS || cpu->stop_reason == CPU_STOP_ERROR)
+        {
+            fprintf(stderr, "CPU error at PC $%04X.\n", cpu->reg.PC);
+            break;
+        }
+
+        if (cpu->stop_reason == CPU_STOP_REQUESTED && ram->test_status >= 0)
+        {
+            code = (ram->test_status == 0x00) ? HEADLESS_EXIT_PASS
+                                              : HEADLESS_EXIT_FAIL;
+            break;
+        }
+
+        double now = monotonic_ms();
+
+        if (now - last_flush >= HEADLESS_FLUSH_MS)
+        {
+            fflush(stdout);
+            last_flush = now;
+        }
+    }
+
+    fflush(stdout);
+
+    if (tracer)
+    {
+        cpu_set_tracer(cpu, NULL);
+        if (tracer_destroy(tracer) != CPU_SUCCESS)
+            code = HEADLESS_EXIT_ERROR;
+    }
+
+    if (profiler)
+    {
+        cpu_set_profiler(cpu, NULL);
+        if (!write_profile(profiler, options->profile_path, false) ||
+            !write_profile(profiler, options->folded_path, true))
+            code = HEADLESS_EXIT_ERROR;
+        profiler_destroy(profiler);
+    }
+
+    // read() is a cancellation point; the reader holds no locks there
+    if (reading)
+    {
+        pthread_cancel(reader);
+        pthread_join(reader, NULL);
+    }
+
+    machine_destroy(&machine);
+
+    return code;
+}
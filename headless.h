@@ -0,0 +1,75 @@
+// headless.h
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Batch runs without the curses interface.
+ *
+ * The machine is the interactive one (monitored RAM, VIA, ACIA and console
+ * port) but the CPU runs on the calling thread in virtual-time mode, serial
+ * output goes to a fully buffered stdout and serial input comes from stdin
+ * (a line feed is sent as CR LF, like the Enter key in the interface). No
+ * window, render thread or interface lock is involved.
+ *
+ * With --trace, every instruction is recorded to a trace file (trace.h).
+ * With --profile or --profile-folded, the run is profiled (profiler.h) and
+ * the report written once it ends.
+ *
+ * The run ends when PC reaches the exit address, when a byte is written to
+ * MONITORED_ADDR_TEST_STATUS (if asked for: programs that probe memory
+ * write there too), or when the cycle budget is used up, and the process
+ * exit code tells which.
+ */
+
+/* Exit codes */
+#define HEADLESS_EXIT_PASS 0    // Exit PC reached, or test status $00
+#define HEADLESS_EXIT_FAIL 1    // Non-zero test status
+#define HEADLESS_EXIT_TIMEOUT 2 // Cycle budget used up
+#define HEADLESS_EXIT_ERROR 3   // Bad arguments, load failure or CPU error
+
+#define HEADLESS_SLICE_CYCLES 100000 // Cycles run between output drains
+#define HEADLESS_FLUSH_MS 50         // Longest stdout holds output back
+
+/* Batch Run Options */
+typedef struct
+{
+    const char *rom_path;
+    uint16_t load_address;
+    bool has_start;      // Start at start_pc instead of the reset vector
+    uint16_t start_pc;
+    bool has_exit_pc;    // Stop when PC reaches exit_pc
+    uint16_t exit_pc;
+    bool exit_on_status; // Stop on a write to MONITORED_ADDR_TEST_STATUS
+    uint64_t max_cycles; // 0 = no budget
+    const char *trace_path; // Record an execution trace (trace.h), or NULL
+    const char *profile_path; // Write a text profile (profiler.h), or NULL
+    const char *folded_path;  // Write folded call stacks, or NULL
+} headless_options_t;
+
+/**
+ * @brief Parses the arguments after "--headless".
+ *
+ * Usage: ROM [--load ADDR] [--start ADDR] [--exit-pc ADDR] [--exit-on-status]
+ *            [--max-cycles N] [--trace FILE] [--profile FILE]
+ *            [--profile-folded FILE]
+ * Numbers are decimal, 0x-prefixed or $-prefixed hexadecimal.
+ *
+ * @param argc Number of arguments.
+ * @param argv Arguments, ROM path first.
+ * @param options Filled in on success.
+ * @return true on success; false after printing the usage to stderr.
+ */
+bool headless_parse_args(int argc, char *argv[], headless_options_t *options);
+
+/**
+ * @brief Builds the machine, runs it and tears it down.
+ *
+ * @param options Run options.
+ * @return One of the HEADLESS_EXIT_* codes.
+ */
+int headless_run(const headless_options_t *options);
+
+#endif // HEADLESS_H
@@ -0,0 +1,369 @@
+// jit.c
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE // MAP_ANONYMOUS
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "jit.h"
+
+#if JIT_AVAILABLE
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* Signature of translated code: returns at the first exit condition */
+typedef void (*jit_native_t)(cpu_6502_t *cpu, uint64_t end_cycle,
+                             const bool *valid);
+
+/* Largest translation of one block: prologue and epilogue plus at most 80
+ * bytes per instruction (see jit_translate) */
+#define JIT_MAX_BLOCK_CODE (32 + DECODE_BLOCK_MAX_INSNS * 80)
+
+/* Room for the exit jumps of one block (three per instruction boundary) */
+#define JIT_MAX_EXITS (3 * DECODE_BLOCK_MAX_INSNS)
+
+/* attention is polled with a plain byte compare */
+_Static_assert(sizeof(atomic_bool) == 1, "atomic_bool must be one byte");
+
+/* Host code buffer being filled */
+typedef struct
+{
+    uint8_t *p;
+    uint8_t *exits[JIT_MAX_EXITS]; // rel32 fields to point at the epilogue
+    int exit_count;
+} jit_emitter_t;
+
+static void emit8(jit_emitter_t *e, uint8_t value)
+{
+    *e->p++ = value;
+}
+
+static void emit16(jit_emitter_t *e, uint16_t value)
+{
+    memcpy(e->p, &value, sizeof(value));
+    e->p += sizeof(value);
+}
+
+static void emit32(jit_emitter_t *e, uint32_t value)
+{
+    memcpy(e->p, &value, sizeof(value));
+    e->p += sizeof(value);
+}
+
+static void emit64(jit_emitter_t *e, uint64_t value)
+{
+    memcpy(e->p, &value, sizeof(value));
+    e->p += sizeof(value);
+}
+
+/* jcc rel32 to the epilogue, patched by emit_epilogue */
+static void emit_exit_jump(jit_emitter_t *e, uint8_t condition)
+{
+    emit8(e, 0x0F);
+    emit8(e, condition);
+    e->exits[e->exit_count++] = e->p;
+    emit32(e, 0);
+}
+
+#define JCC_JAE 0x83
+#define JCC_JE 0x84
+#define JCC_JNE 0x85
+
+/* Register use: rbx = cpu, r12 = end_cycle, r13 = &block->valid, all
+ * callee-saved so they survive the handler calls */
+static void emit_prologue(jit_emitter_t *e)
+{
+    emit8(e, 0x53);                                 // push rbx
+    emit8(e, 0x41); emit8(e, 0x54);                 // push r12
+    emit8(e, 0x41); emit8(e, 0x55);                 // push r13
+    emit8(e, 0x48); emit8(e, 0x89); emit8(e, 0xFB); // mov rbx, rdi
+    emit8(e, 0x49); emit8(e, 0x89); emit8(e, 0xF4); // mov r12, rsi
+    emit8(e, 0x49); emit8(e, 0x89); emit8(e, 0xD5); // mov r13, rdx
+}
+
+static void emit_epilogue(jit_emitter_t *e)
+{
+    for (int i = 0; i < e->exit_count; i++)
+    {
+        uint32_t rel = (uint32_t)(e->p - (e->exits[i] + 4));
+        memcpy(e->exits[i], &rel, sizeof(rel));
+    }
+
+    emit8(e, 0x41); emit8(e, 0x5D); // pop r13
+    emit8(e, 0x41); emit8(e, 0x5C); // pop r12
+    emit8(e, 0x5B);                 // pop rbx
+    emit8(e, 0xC3);                 // ret
+}
+
+/* mov word [rbx + offset], value (9 bytes) */
+static void emit_store16(jit_emitter_t *e, size_t offset, uint16_t value)
+{
+    emit8(e, 0x66); emit8(e, 0xC7); emit8(e, 0x83);
+    emit32(e, (uint32_t)offset);
+    emit16(e, value);
+}
+
+/* Checks made before every instruction but the first (37 bytes): the same
+ * ones, in the same order, the interpreter loop makes */
+static void emit_boundary_checks(jit_emitter_t *e)
+{
+    // cmp [rbx + cycle_count], r12 ; jae exit
+    emit8(e, 0x4C); emit8(e, 0x39); emit8(e, 0xA3);
+    emit32(e, (uint32_t)offsetof(cpu_6502_t, clock.cycle_count));
+    emit_exit_jump(e, JCC_JAE);
+
+    // cmp byte [rbx + attention], 0 ; jne exit
+    emit8(e, 0x80); emit8(e, 0xBB);
+    emit32(e, (uint32_t)offsetof(cpu_6502_t, attention));
+    emit8(e, 0x00);
+    emit_exit_jump(e, JCC_JNE);
+
+    // cmp byte [r13], 0 ; je exit
+    emit8(e, 0x41); emit8(e, 0x80); emit8(e, 0x7D); emit8(e, 0x00);
+    emit8(e, 0x00);
+    emit_exit_jump(e, JCC_JE);
+}
+
+/* One instruction (at most 41 bytes) */
+static void emit_instruction(jit_emitter_t *e, const decoded_insn_t *insn,
+                             jit_handler_t handler, bool has_operand)
+{
+    emit_store16(e, offsetof(cpu_6502_t, reg.PC), insn->next_pc);
+
+    if (has_operand)
+        emit_store16(e, offsetof(cpu_6502_t, decoded_operand), insn->operand);
+
+    emit8(e, 0x48); emit8(e, 0x89); emit8(e, 0xDF); // mov rdi, rbx
+    emit8(e, 0x48); emit8(e, 0xB8);                 // mov rax, handler
+    emit64(e, (uint64_t)(uintptr_t)handler);
+    emit8(e, 0xFF); emit8(e, 0xD0);                 // call rax
+
+    // add qword [rbx + cycle_count], cycles
+    emit8(e, 0x48); emit8(e, 0x83); emit8(e, 0x83);
+    emit32(e, (uint32_t)offsetof(cpu_6502_t, clock.cycle_count));
+    emit8(e, insn->cycles);
+}
+
+/* Whether an address range touches a page that is not plain storage */
+static bool range_has_io(const bus_t *bus, uint16_t first, uint16_t last)
+{
+    return !bus_page_is_plain(bus, first >> 8) ||
+           !bus_page_is_plain(bus, last >> 8);
+}
+
+/* Whether an operand can be seen, before running, to reach an address with
+ * side effects */
+static bool operand_reaches_io(const bus_t *bus, jit_operand_t kind,
+                               uint16_t operand)
+{
+    switch (kind)
+    {
+    case JIT_OPERAND_ZERO_PAGE:
+    case JIT_OPERAND_POINTER:
+        return !bus_page_is_plain(bus, 0x00);
+    case JIT_OPERAND_ABSOLUTE:
+        return range_has_io(bus, operand, operand);
+    case JIT_OPERAND_INDEXED:
+        return range_has_io(bus, operand, (uint16_t)(operand + 0xFF));
+    default:
+        return false;
+    }
+}
+
+/* Make [start, start + length) of the arena writable or executable */
+static bool arena_protect(jit_t *jit, uint8_t *start, size_t length,
+                          bool writable)
+{
+    uintptr_t mask = ~(uintptr_t)(jit->page_size - 1);
+    uintptr_t first = (uintptr_t)start & mask;
+    uintptr_t end = ((uintptr_t)start + length + jit->page_size - 1) & mask;
+    int prot = writable ? (PROT_READ | PROT_WRITE) : (PROT_READ | PROT_EXEC);
+
+    return mprotect((void *)first, end - first, prot) == 0;
+}
+
+/* Translate a block; false if not even its first instruction qualifies */
+static bool jit_translate(jit_t *jit, decoded_block_t *block)
+{
+    const bus_t *bus = jit->cache->bus;
+    int count = 0;
+
+    // Only the leading instructions whose accesses are side-effect free
+    while (count < block->count)
+    {
+        const decoded_insn_t *insn = &block->insns[count];
+        const jit_op_t *op = &jit->ops[insn->opcode];
+
+        if (!op->handler)
+            break;
+
+        if (operand_reaches_io(bus, op->operand, insn->operand))
+        {
+            jit->stats.io_stops++;
+            break;
+        }
+
+        count++;
+    }
+
+    if (count == 0)
+        return false;
+
+    if (jit->arena_used + JIT_MAX_BLOCK_CODE > JIT_ARENA_SIZE)
+        jit_reset(jit);
+
+    uint8_t *code = jit->arena + jit->arena_used;
+
+    if (!arena_protect(jit, code, JIT_MAX_BLOCK_CODE, true))
+        return false;
+
+    jit_emitter_t e = {.p = code, .exit_count = 0};
+
+    uint16_t addr = block->start;
+
+    emit_prologue(&e);
+
+    for (int i = 0; i < count; i++)
+    {
+        const decoded_insn_t *insn = &block->insns[i];
+
+        if (i > 0)
+            emit_boundary_checks(&e);
+
+        // One-byte instructions have no operand to store
+        emit_instruction(&e, insn, jit->ops[insn->opcode].handler,
+                         (uint16_t)(insn->next_pc - addr) > 1);
+        addr = insn->next_pc;
+    }
+
+    emit_epilogue(&e);
+
+    size_t length = (size_t)(e.p - code);
+
+    if (!arena_protect(jit, code, JIT_MAX_BLOCK_CODE, false))
+        return false;
+
+    __builtin___clear_cache((char *)code, (char *)e.p);
+
+    jit->arena_used += (length + 15) & ~(size_t)15; // Keep entries aligned
+    jit->stats.blocks_translated++;
+    block->native = code;
+
+    return true;
+}
+
+/* Creates a translator with an empty arena */
+jit_t *jit_create(const jit_op_t *ops, decode_cache_t *cache)
+{
+    if (!ops || !cache)
+        return NULL;
+
+    jit_t *jit = malloc(sizeof(jit_t));
+
+    if (!jit)
+    {
+        fprintf(stderr, "jit_create: Failed to allocate JIT.\n");
+        return NULL;
+    }
+
+    jit->arena = mmap(NULL, JIT_ARENA_SIZE, PROT_READ | PROT_EXEC,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (jit->arena == MAP_FAILED)
+    {
+        fprintf(stderr, "jit_create: Failed to map the code arena.\n");
+        free(jit);
+        return NULL;
+    }
+
+    jit->ops = ops;
+    jit->cache = cache;
+    jit->arena_used = 0;
+    jit->page_size = (size_t)sysconf(_SC_PAGESIZE);
+    memset(&jit->stats, 0, sizeof(jit->stats));
+
+    return jit;
+}
+
+/* Frees the arena and the JIT */
+void jit_destroy(jit_t *jit)
+{
+    if (!jit)
+        return;
+
+    munmap(jit->arena, JIT_ARENA_SIZE);
+    free(jit);
+}
+
+/* Drops every translation and empties the arena */
+void jit_reset(jit_t *jit)
+{
+    if (!jit)
+        return;
+
+    for (int i = 0; i < DECODE_CACHE_BLOCKS; i++)
+    {
+        jit->cache->blocks[i].native = NULL;
+        jit->cache->blocks[i].hits = 0;
+    }
+
+    jit->arena_used = 0;
+    jit->stats.arena_resets++;
+}
+
+/* Runs a block as host code, translating it first once it is hot */
+bool jit_run_block(jit_t *jit, cpu_6502_t *cpu, decoded_block_t *block,
+                   uint64_t end_cycle)
+{
+    if (!block->native)
+    {
+        if (block->hits < JIT_HOT_THRESHOLD)
+        {
+            block->hits++;
+            return false;
+        }
+
+        block->hits = 0; // Count up again before retrying a failed attempt
+
+        if (!jit_translate(jit, block))
+            return false;
+    }
+
+    ((jit_native_t)block->native)(cpu, end_cycle, &block->valid);
+    jit->stats.native_runs++;
+
+    return true;
+}
+
+#else // !JIT_AVAILABLE
+
+/* No code generator for this host */
+jit_t *jit_create(const jit_op_t *ops, decode_cache_t *cache)
+{
+    (void)ops;
+    (void)cache;
+    return NULL;
+}
+
+void jit_destroy(jit_t *jit)
+{
+    (void)jit;
+}
+
+void jit_reset(jit_t *jit)
+{
+    (void)jit;
+}
+
+bool jit_run_block(jit_t *jit, cpu_6502_t *cpu, decoded_block_t *block,
+                   uint64_t end_cycle)
+{
+    (void)jit;
+    (void)cpu;
+    (void)block;
+    (void)end_cycle;
+    return false;
+}
+
+#endif // JIT_AVAILABLE
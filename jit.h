@@ -0,0 +1,126 @@
+// jit.h
+#ifndef JIT_H
+#define JIT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "cpu_6502.h"
+#include "decode_cache.h"
+
+/*
+ * Block translator for x86-64 Linux hosts.
+ *
+ * Works on top of the decode cache: once a decoded block has been entered
+ * JIT_HOT_THRESHOLD times it is translated into host code in an mmap'd
+ * arena. The host code is call-threaded: for every 6502 instruction it
+ * stores PC and the predecoded operand into the CPU structure, calls the
+ * core's handler for that opcode (the very code the interpreter runs) and
+ * adds the base cycles. The interpreter therefore stays the reference for
+ * what each instruction does; the translation only removes the dispatch.
+ *
+ * No 6502 state is kept in host registers, so the CPU structure is exact
+ * whenever the host code returns. Between instructions it returns if the
+ * cycle budget is used up, attention is raised (interrupts, stop, pause) or
+ * the block was invalidated by a write to its own bytes, which gives the
+ * same instruction boundaries the interpreter loop stops at. Translation
+ * stops before any instruction whose operand can be seen to reach a page
+ * with side effects (device pages, the monitored RAM page); those run in
+ * the interpreter. Accesses whose target is only
+ * known at run time go through the same handlers and helpers as always.
+ *
+ * Invalidation is the decode cache's: a write that drops a block also drops
+ * its translation, because a re-decoded block starts without one. The arena
+ * is reset, dropping every translation, when it fills up.
+ */
+
+#if defined(__x86_64__) && defined(__linux__)
+#define JIT_AVAILABLE 1
+#else
+#define JIT_AVAILABLE 0 // jit_create() always fails
+#endif
+
+#define JIT_HOT_THRESHOLD 16         // Block entries before translation
+#define JIT_ARENA_SIZE (4u << 20)    // Executable memory for translations
+
+/* What an instruction's operand addresses, as far as is known before it
+ * runs */
+typedef enum
+{
+    JIT_OPERAND_NONE = 0,  // No memory operand (implied, immediate, branch)
+    JIT_OPERAND_ZERO_PAGE, // Somewhere in page 0
+    JIT_OPERAND_ABSOLUTE,  // Exactly the operand address
+    JIT_OPERAND_INDEXED,   // Operand address plus X or Y (up to +$FF)
+    JIT_OPERAND_POINTER    // Through a zero-page pointer: unknown target
+} jit_operand_t;
+
+/* Executes one instruction with PC and cpu->decoded_operand already set */
+typedef void (*jit_handler_t)(cpu_6502_t *cpu);
+
+/* Per-opcode description supplied by the CPU core */
+typedef struct
+{
+    jit_handler_t handler; // NULL for opcodes the core does not implement
+    jit_operand_t operand;
+} jit_op_t;
+
+/* JIT statistics */
+typedef struct
+{
+    uint64_t blocks_translated; // Translations emitted
+    uint64_t native_runs;       // Times translated code was entered
+    uint64_t io_stops;          // Translations cut short before an I/O access
+    uint64_t arena_resets;      // Times the arena filled up and was emptied
+} jit_stats_t;
+
+/* JIT Structure */
+typedef struct jit
+{
+    const jit_op_t *ops;   // 256 entries, owned by the CPU core
+    decode_cache_t *cache; // Cache whose blocks carry the translations
+
+    uint8_t *arena;    // Executable memory (read/execute except while emitting)
+    size_t arena_used; // Bytes handed out so far
+    size_t page_size;  // Host page size, for mprotect()
+    jit_stats_t stats;
+} jit_t;
+
+/**
+ * @brief Creates a translator with an empty arena.
+ *
+ * @param ops Per-opcode table (256 entries) that must outlive the JIT.
+ * @param cache Decode cache the translated blocks come from.
+ * @return Pointer to the JIT, or NULL on failure or when JIT_AVAILABLE is 0.
+ */
+jit_t *jit_create(const jit_op_t *ops, decode_cache_t *cache);
+
+/**
+ * @brief Frees the arena and the JIT.
+ *
+ * @param jit Pointer to the JIT.
+ */
+void jit_destroy(jit_t *jit);
+
+/**
+ * @brief Drops every translation and empties the arena.
+ *
+ * @param jit Pointer to the JIT.
+ */
+void jit_reset(jit_t *jit);
+
+/**
+ * @brief Runs a block as host code, translating it first once it is hot.
+ *
+ * The block must start at cpu->reg.PC and contain no breakpoint.
+ *
+ * @param jit Pointer to the JIT.
+ * @param cpu CPU to run.
+ * @param block Block just looked up at PC.
+ * @param end_cycle Cycle count at which to return early.
+ * @return true if host code ran at least one instruction; false if the
+ *         caller must interpret the block.
+ */
+bool jit_run_block(jit_t *jit, cpu_6502_t *cpu, decoded_block_t *block,
+                   uint64_t end_cycle);
+
+#endif // JIT_H
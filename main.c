@@ -14,6 +14,7 @@
 #include <ctype.h>   // For isprint
 #include <curses.h>  // For UI
 #include <pthread.h> // For multithreading
+#include <stdarg.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -55,8 +56,6 @@ volatile bool display_help = false;
 volatile bool input_paused = false;
 
 /* Emulation State */
-uint16_t instruction_history[INSTRUCTION_HISTORY_SIZE];
-int history_index = 0;
 int fps = DEFAULT_FPS;
 
 /* Current Binary Configuration */
@@ -65,9 +64,46 @@ char current_binary_path_user[256] = "roms/hello.bin";
 /* Set the load address for the functional test binary (0x0400 or 0x0600) */
 uint16_t current_load_address_user = 0xC000;
 
+/* Devices on the bus, reset along with the CPU */
+static memory_t *via_device = NULL;
+static memory_t *acia_device = NULL;
+static memory_t *console_device = NULL;
+
+/* The machine as the last load left it; F5 goes back to it */
+static cpu_snapshot_t power_on;
+
 // Tracks which 128-byte "page" we are showing in the Memory Window
 static uint16_t memory_view_page = 0;
 
+// What the render thread draws, published by the emulation thread
+static cpu_view_buffer_t cpu_view;
+
+// Breakpoints and watchpoints belong to the emulation thread; the input
+// thread hands it one edit at a time through pending_edit_*
+static breakpoint_t breakpoints;
+static int watchpoint_count = 0;
+static BreakEditType pending_edit_type;
+static uint16_t pending_edit_addr;
+static atomic_bool edit_pending;
+
+// Recorded history for F9, kept by the emulation thread. Typed input waits
+// in serial_input until that thread logs it; timeline_stale asks it to start
+// over after the machine was changed from outside.
+static timeline_t *timeline = NULL;
+static queue_t serial_input;
+static atomic_bool timeline_stale;
+static TravelType pending_travel_type;
+static uint64_t pending_travel_cycle;
+static atomic_bool travel_pending;
+static atomic_bool discard_output; // Set while a replay prints again
+
+// The clock belongs to the emulation thread too; F4 hands it a new mode or
+// frequency through pending_clock_*
+static bool pending_clock_is_mode;
+static clock_mode_t pending_clock_mode;
+static double pending_clock_frequency;
+static atomic_bool clock_pending;
+
 /******************************************************************************
  *                              Timer Functions                               *
  ******************************************************************************/
@@ -390,8 +426,23 @@ int display_prompt(const char *prompt_title, const char *prompt_message,
  *                         Main Program Entry Point                           *
  ******************************************************************************/
 
-int main()
+int main(int argc, char *argv[])
 {
+    // Batch runs never touch curses
+    if (argc > 1 && strcmp(argv[1], "--headless") == 0)
+    {
+        headless_options_t options;
+
+        if (!headless_parse_args(argc - 2, argv + 2, &options))
+            return HEADLESS_EXIT_ERROR;
+
+        return headless_run(&options);
+    }
+
+    // So do the trace tools
+    if (argc > 1 && strcmp(argv[1], "--trace") == 0)
+        return trace_tool(argc - 2, argv + 2);
+
     // Initialize curses mode for UI
     initscr();
 
@@ -479,9 +530,11 @@ int main()
         return EXIT_FAILURE;
     }
 
-    // Initialize CPU queues
-    queue_init(&cpu->input_queue);
-    queue_init(&cpu->output_queue);
+    // The interactive emulator runs on the switch-dispatch engine
+    cpu_set_engine(cpu, CPU_ENGINE_SWITCH);
+
+    // The CPU window lists the last instructions run
+    cpu_set_pc_history(cpu, true);
 
     // Assign the Bus to the CPU
     cpu->bus = bus;
@@ -498,10 +551,35 @@ int main()
         return EXIT_FAILURE;
     }
 
+    // Create the I/O devices and connect them first: the first device
+    // mapped at an address owns it, so their registers take precedence over
+    // the RAM. The ACIA and the console port share the serial queues.
+    via_device = memory_create_via(cpu);
+    acia_device =
+        memory_create_acia(cpu, &cpu->input_queue, &cpu->output_queue);
+    console_device =
+        memory_create_console(&cpu->input_queue, &cpu->output_queue);
+
+    if (!via_device || !acia_device || !console_device)
+    {
+        fprintf(stderr, "Failed to create I/O devices.\n");
+        cleanup(cpu, monitored_ram, bus);
+        endwin();
+        return EXIT_FAILURE;
+    }
+
+    bus_connect_device(bus, via_device, VIA_BASE_ADDR, VIA_BASE_ADDR + 0x0F);
+    bus_connect_device(bus, acia_device, ACIA_BASE_ADDR, ACIA_BASE_ADDR + 0x03);
+    bus_connect_device(bus, console_device, INPUT_ADDR, OUTPUT_ADDR);
+
     /* Connect the Monitored RAM to the Bus
        Map over the full address space */
     bus_connect_device(bus, monitored_ram, 0x0000, 0xFFFF);
 
+    // Typed input, on its way to the CPU
+    queue_init(&serial_input);
+    atomic_init(&timeline_stale, false);
+
     // Initialize Memory to Zero
     monitored_ram_t *ram_context = (monitored_ram_t *)(monitored_ram->context);
     memset(ram_context->data, 0, ram_context->size);
@@ -516,6 +594,26 @@ int main()
         return EXIT_FAILURE;
     }
 
+    // Schedule the demo interrupts on the CPU's timeline, in emulated time
+    cpu_schedule(cpu, (uint64_t)(IRQ_DEMO_SECONDS * cpu->clock.frequency),
+                 inject_IRQ_event, cpu);
+    cpu_schedule(cpu, (uint64_t)(NMI_DEMO_SECONDS * cpu->clock.frequency),
+                 inject_NMI_event, cpu);
+
+    // Record a history to travel back in; the emulator runs without one
+    timeline = timeline_create(cpu, 0, 0);
+
+    if (!timeline)
+        fprintf(stderr, "Failed to create the timeline; F9 is disabled.\n");
+
+    // The emulation thread publishes the views the render thread draws
+    cpu_view_init(&cpu_view);
+    breakpoint_init(&breakpoints);
+    atomic_init(&edit_pending, false);
+    atomic_init(&travel_pending, false);
+    atomic_init(&clock_pending, false);
+    atomic_init(&discard_output, false);
+
     // Start Threads for Interface Rendering, Emulation Loop, and Serial I/O
     pthread_t interface_thread, emulation_thread, input_thread, output_thread;
     pthread_create(&interface_thread, NULL, render_interface, cpu);
@@ -523,18 +621,12 @@ int main()
     pthread_create(&input_thread, NULL, serial_input_thread, cpu);
     pthread_create(&output_thread, NULL, serial_output_thread, cpu);
 
-    // Create Threads for Interrupt Injection
-    pthread_t irq_thread, nmi_thread;
-    pthread_create(&irq_thread, NULL, inject_IRQ_thread, cpu);
-    pthread_create(&nmi_thread, NULL, inject_NMI_thread, cpu);
 
     // Wait for Threads to Finish
     pthread_join(interface_thread, NULL);
     pthread_join(emulation_thread, NULL);
     pthread_join(input_thread, NULL);
     pthread_join(output_thread, NULL);
-    pthread_join(irq_thread, NULL);
-    pthread_join(nmi_thread, NULL);
 
     // Clean Up Resources
     cleanup(cpu, monitored_ram, bus);
@@ -575,12 +667,25 @@ int load_binary(cpu_6502_t *cpu, const char *path, uint16_t load_address)
     cpu_write(cpu, 0xFFFC, load_address & 0xFF);        // Low byte
     cpu_write(cpu, 0xFFFD, (load_address >> 8) & 0xFF); // High byte
 
-    // Reset the CPU to initialize the PC from the reset vector
+    // Reset the CPU to initialize the PC from the reset vector, and the
+    // devices on the same RESET line
     cpu_reset(cpu);
 
-    // Clear the CPU's output queue
+    if (via_device)
+        via_reset(via_device);
+    if (acia_device)
+        acia_reset(acia_device);
+
+    // Clear the CPU's output queue. Once the serial output thread runs,
+    // callers hold the interface lock, which keeps that thread out of it.
     queue_clear(&cpu->output_queue);
 
+    // Keep this state for reset; without it, reset loads the file again
+    cpu_snapshot_save(cpu, &power_on);
+
+    // The recorded history led somewhere else
+    atomic_store(&timeline_stale, true);
+
     // Update global variables for tracking
     strncpy(current_binary_path_user, path,
             sizeof(current_binary_path_user) - 1);
@@ -593,14 +698,77 @@ int load_binary(cpu_6502_t *cpu, const char *path, uint16_t load_address)
     return 0;
 }
 
+/******************************************************************************
+ *                          Interface Snapshots                               *
+ ******************************************************************************/
+
+#define RENDER_FIELD_SIZE 24
+
+/* A value in the CPU window, where it goes and what it reads */
+typedef struct
+{
+    int y, x, width; // Cleared to width when redrawn
+    bool passive;    // Redrawn along with the others, never a reason to draw
+    char text[RENDER_FIELD_SIZE];
+} render_field_t;
+
+/* Values in the CPU window */
+enum
+{
+    FIELD_PC,
+    FIELD_SP,
+    FIELD_CYCLES,
+    FIELD_A,
+    FIELD_X,
+    FIELD_Y,
+    FIELD_FLAGS,
+    FIELD_INPUT,
+    FIELD_OUTPUT,
+    FIELD_NEXT,
+    FIELD_PERF,
+    FIELD_MODE,
+    FIELD_RENDER,
+    FIELD_FPS,
+    FIELD_DRIFT,
+    FIELD_STATUS,
+    FIELD_BREAKS,
+    FIELD_STACK, // CPU_VIEW_STACK entries
+    FIELD_HISTORY = FIELD_STACK + CPU_VIEW_STACK,
+    CPU_FIELD_COUNT = FIELD_HISTORY + INSTRUCTION_HISTORY_SIZE
+};
+
+// What the CPU and memory windows show right now. Only the render thread
+// touches these; until a snapshot is valid its window is drawn in full.
+// (A cpu_view_t is what the machine looks like; these are what the screen
+// looks like.)
+static render_field_t cpu_shown[CPU_FIELD_COUNT];
+static bool cpu_shown_valid = false;
+static uint8_t memory_shown[BYTES_PER_PAGE];
+static uint16_t memory_shown_addr = 0;
+static bool memory_shown_valid = false;
+
+/* Fill in a field of the next snapshot */
+static void set_field(render_field_t *field, int y, int x, int width,
+                      const char *format, ...)
+{
+    va_list args;
+
+    field->y = y;
+    field->x = x;
+    field->width = width;
+    field->passive = false;
+
+    va_start(args, format);
+    vsnprintf(field->text, sizeof(field->text), format, args);
+    va_end(args);
+}
+
 /**
- * @brief Display the CPU state in the main window.
- *
- * @param cpu Pointer to the CPU structure.
+ * @brief Draw the parts of the CPU window that never change: border, title,
+ * labels and the function key legend. Call with the interface locked.
  */
-void print_cpu_state(cpu_6502_t *cpu)
+static void draw_cpu_frame(void)
 {
-    lock_interface(); // Lock for safe window update
     werase(cpu_window);
     box(cpu_window, 0, 0);
 
@@ -609,116 +777,39 @@ void print_cpu_state(cpu_6502_t *cpu)
     mvwprintw(cpu_window, 0, 2, " CPU State ");
     wattroff(cpu_window, COLOR_PAIR(1) | A_BOLD);
 
-    // Line 1: PC, SP, Cycles, Stack, and History labels
     // Labels: in light gray
     wattron(cpu_window, COLOR_PAIR(1) | A_DIM);
+
+    // Line 1: PC, SP, Cycles, Stack, and History
     mvwprintw(cpu_window, 1, 2, "PC: ");
     mvwprintw(cpu_window, 1, 18, "SP: ");
     mvwprintw(cpu_window, 1, 34, "Cycles: ");
     mvwprintw(cpu_window, 1, 59, "Stack:     History:");
-    wattroff(cpu_window, COLOR_PAIR(1) | A_DIM);
 
-    // Values: in cyan
-    wattron(cpu_window, COLOR_PAIR(2));
-    mvwprintw(cpu_window, 1, 6, "0x%04X", cpu->reg.PC);
-    mvwprintw(cpu_window, 1, 22, "0x%02X", cpu->reg.SP);
-    mvwprintw(cpu_window, 1, 42, "%llu", cpu->clock.cycle_count);
-    wattroff(cpu_window, COLOR_PAIR(2));
-
-    // Line 2: A, X, Y labels
-    wattron(cpu_window, COLOR_PAIR(1) | A_DIM);
+    // Line 2: A, X, Y
     mvwprintw(cpu_window, 2, 2, "A:  ");
     mvwprintw(cpu_window, 2, 18, "X:  ");
     mvwprintw(cpu_window, 2, 34, "Y:  ");
-    wattroff(cpu_window, COLOR_PAIR(1) | A_DIM);
-
-    // Line 2: A, X, Y values
-    wattron(cpu_window, COLOR_PAIR(2));
-    mvwprintw(cpu_window, 2, 6, "0x%02X", cpu->reg.A);
-    mvwprintw(cpu_window, 2, 22, "0x%02X", cpu->reg.X);
-    mvwprintw(cpu_window, 2, 38, "0x%02X", cpu->reg.Y);
-    wattroff(cpu_window, COLOR_PAIR(2));
-
-    // Stack and History values starting from line 2
-    for (int i = 0; i < INSTRUCTION_HISTORY_SIZE; i++)
-    {
-        int line = 2 + i;
-        // Stack value
-        uint8_t stack_value =
-            cpu_read(cpu, 0x0100 + ((cpu->reg.SP + i + 1) & 0xFF));
-        wattron(cpu_window, COLOR_PAIR(2));
-        mvwprintw(cpu_window, line, 59, "%d: $%02X", i + 1, stack_value);
-        wattroff(cpu_window, COLOR_PAIR(2));
-
-        // History value
-        int idx = (history_index - i - 1 + INSTRUCTION_HISTORY_SIZE) %
-                  INSTRUCTION_HISTORY_SIZE;
-        uint16_t history_pc = instruction_history[idx];
-        wattron(cpu_window, COLOR_PAIR(2));
-        mvwprintw(cpu_window, line, 70, "%d: $%04X", i + 1, history_pc);
-        wattroff(cpu_window, COLOR_PAIR(2));
-    }
 
-    // Line 3: Flags labels
-    wattron(cpu_window, COLOR_PAIR(1) | A_DIM);
+    // Line 3: Flags
     mvwprintw(cpu_window, 3, 2, "Flags: N V - B D I Z C");
-    wattroff(cpu_window, COLOR_PAIR(1) | A_DIM);
-
-    // Line 4: Flags values
-    wattron(cpu_window, COLOR_PAIR(2));
-    mvwprintw(cpu_window, 4, 2, "       %d %d %d %d %d %d %d %d",
-              (cpu->reg.P & (1 << FLAG_NEGATIVE)) ? 1 : 0,
-              (cpu->reg.P & (1 << FLAG_OVERFLOW)) ? 1 : 0,
-              (cpu->reg.P & (1 << FLAG_UNUSED)) ? 1 : 0,
-              (cpu->reg.P & (1 << FLAG_BREAK)) ? 1 : 0,
-              (cpu->reg.P & (1 << FLAG_DECIMAL)) ? 1 : 0,
-              (cpu->reg.P & (1 << FLAG_INTERRUPT)) ? 1 : 0,
-              (cpu->reg.P & (1 << FLAG_ZERO)) ? 1 : 0,
-              (cpu->reg.P & (1 << FLAG_CARRY)) ? 1 : 0);
-    wattroff(cpu_window, COLOR_PAIR(2));
 
     // Line 5: I/O ports and next instruction
-    uint8_t input_port = cpu_read(cpu, INPUT_ADDR);
-    uint8_t output_port = cpu_read(cpu, OUTPUT_ADDR);
-    uint8_t opcode = cpu_read(cpu, cpu->reg.PC);
-    const char *mnemonic = opcode_to_mnemonic(opcode);
-
-    // Labels: in light gray
-    wattron(cpu_window, COLOR_PAIR(1) | A_DIM);
     mvwprintw(cpu_window, 5, 2, "I/O In: ");
     mvwprintw(cpu_window, 5, 15, "Out: ");
     mvwprintw(cpu_window, 5, 25, "Next Instr: ");
-    wattroff(cpu_window, COLOR_PAIR(1) | A_DIM);
 
-    // Values: in cyan
-    wattron(cpu_window, COLOR_PAIR(2));
-    mvwprintw(cpu_window, 5, 10, "$%02X", input_port);
-    mvwprintw(cpu_window, 5, 20, "$%02X", output_port);
-    mvwprintw(cpu_window, 5, 37, "%s", mnemonic);
-    wattroff(cpu_window, COLOR_PAIR(2));
-
-    // Line 6: Display Performance, Render Time, and Actual FPS
-    wattron(cpu_window, COLOR_PAIR(1) | A_DIM);
-    mvwprintw(cpu_window, 6, 2, "Performance: ");
-    mvwprintw(cpu_window, 6, 25, "Render Time: ");
-    mvwprintw(cpu_window, 6, 48, "FPS: ");
-    wattroff(cpu_window, COLOR_PAIR(1) | A_DIM);
+    // Line 6: Performance, Clock Mode, Render Time, FPS and Drift
+    mvwprintw(cpu_window, 6, 2, "Perf: ");
+    mvwprintw(cpu_window, 6, 28, "Render: ");
+    mvwprintw(cpu_window, 6, 46, "FPS: ");
+    mvwprintw(cpu_window, 6, 60, "Drift: ");
 
-    // Display percentage and other values
-    wattron(cpu_window, COLOR_PAIR(2));
-    mvwprintw(cpu_window, 6, 15, "%.1f%%", cpu->performance_percent);
-    mvwprintw(cpu_window, 6, 38, "%.3f ms", cpu->render_time * 1000);
-    mvwprintw(cpu_window, 6, 53, "%.1f", cpu->actual_fps);
-    wattroff(cpu_window, COLOR_PAIR(2));
-
-    // Line 7: Emulator status
-    wattron(cpu_window, COLOR_PAIR(1) | A_DIM);
+    // Line 7: Emulator status and debugger
     mvwprintw(cpu_window, 7, 2, "Emulator Status: ");
-    wattroff(cpu_window, COLOR_PAIR(1) | A_DIM);
+    mvwprintw(cpu_window, 7, 50, "Break/Watch: ");
 
-    wattron(cpu_window, COLOR_PAIR(2));
-    mvwprintw(cpu_window, 7, 19, "%s", emulator_paused ? "Paused" : "Running");
-    wattroff(cpu_window, COLOR_PAIR(2));
+    wattroff(cpu_window, COLOR_PAIR(1) | A_DIM);
 
     // Line 8: Function keys
     /* Distribute the function keys evenly across the 80 columns */
@@ -726,15 +817,15 @@ void print_cpu_state(cpu_6502_t *cpu)
     int line_y = 8;    // Starting y position
 
     // Space between function keys
-    const int spacing[] = {9, 14, 10, 7, 11, 7, 9, 10};
+    const int spacing[] = {9, 8, 9, 7, 10, 7, 9, 8, 10};
 
     struct // Define keys and their descriptions
     {
         char *key;
         char *description;
-    } func_keys[] = {{"F1:", "Help"}, {"F2:", "Run/Pause"}, {"F3:", "Load"},
-                     {"F4:", "Hz"},   {"F5:", "Reset"},     {"F6:", "PC"},
-                     {"F7:", "Step"}, {"F10:", "Quit"}};
+    } func_keys[] = {{"F1:", "Help"}, {"F2:", "Run"},   {"F3:", "Load"},
+                     {"F4:", "Hz"},   {"F5:", "Reset"}, {"F6:", "PC"},
+                     {"F7:", "Step"}, {"F8:", "Brk"},   {"F10:", "Quit"}};
 
     int num_keys = sizeof(func_keys) / sizeof(func_keys[0]);
 
@@ -753,49 +844,169 @@ void print_cpu_state(cpu_6502_t *cpu)
 
         current_x += spacing[i];
     }
+}
+
+/**
+ * @brief Display the CPU state in the main window.
+ *
+ * Only the values that differ from what is on screen are drawn, and when
+ * none does the interface lock is not even taken.
+ *
+ * @param cpu Pointer to the CPU structure (render timings only).
+ * @param view Latest view published by the emulation thread.
+ */
+void print_cpu_state(cpu_6502_t *cpu, const cpu_view_t *view)
+{
+    render_field_t next[CPU_FIELD_COUNT];
+    uint8_t p = view->reg.P;
+
+    // Build the next snapshot without holding the interface lock
+    set_field(&next[FIELD_PC], 1, 6, 6, "0x%04X", view->reg.PC);
+    set_field(&next[FIELD_SP], 1, 22, 4, "0x%02X", view->reg.SP);
+    set_field(&next[FIELD_CYCLES], 1, 42, 16, "%llu",
+              (unsigned long long)view->cycle_count);
+    set_field(&next[FIELD_A], 2, 6, 4, "0x%02X", view->reg.A);
+    set_field(&next[FIELD_X], 2, 22, 4, "0x%02X", view->reg.X);
+    set_field(&next[FIELD_Y], 2, 38, 4, "0x%02X", view->reg.Y);
+    set_field(&next[FIELD_FLAGS], 4, 9, 15, "%d %d %d %d %d %d %d %d",
+              (p & (1 << FLAG_NEGATIVE)) ? 1 : 0,
+              (p & (1 << FLAG_OVERFLOW)) ? 1 : 0,
+              (p & (1 << FLAG_UNUSED)) ? 1 : 0,
+              (p & (1 << FLAG_BREAK)) ? 1 : 0,
+              (p & (1 << FLAG_DECIMAL)) ? 1 : 0,
+              (p & (1 << FLAG_INTERRUPT)) ? 1 : 0,
+              (p & (1 << FLAG_ZERO)) ? 1 : 0,
+              (p & (1 << FLAG_CARRY)) ? 1 : 0);
+
+    set_field(&next[FIELD_INPUT], 5, 10, 3, "$%02X", view->input);
+    set_field(&next[FIELD_OUTPUT], 5, 20, 3, "$%02X", view->output);
+    set_field(&next[FIELD_NEXT], 5, 37, 8, "%s",
+              opcode_to_mnemonic(view->opcode));
+
+    set_field(&next[FIELD_PERF], 6, 8, 9, "%.1f%%", view->performance_percent);
+    set_field(&next[FIELD_MODE], 6, 18, 10, "[%s]",
+              clock_mode_name(view->clock_mode));
+    set_field(&next[FIELD_RENDER], 6, 36, 10, "%.3f ms",
+              cpu->render_time * 1000);
+    set_field(&next[FIELD_FPS], 6, 51, 9, "%.1f", cpu->actual_fps);
+    if (view->clock_mode == CLOCK_MODE_REALTIME)
+        set_field(&next[FIELD_DRIFT], 6, 67, 12, "%.2f ms",
+                  view->drift * 1000);
+    else
+        set_field(&next[FIELD_DRIFT], 6, 67, 12, "-");
+    if (!view->paused)
+        set_field(&next[FIELD_STATUS], 7, 19, 30, "Running");
+    else if (view->stop_reason == CPU_STOP_BREAKPOINT)
+        set_field(&next[FIELD_STATUS], 7, 19, 30, "Paused at breakpoint");
+    else if (view->stop_reason == CPU_STOP_WATCHPOINT)
+        set_field(&next[FIELD_STATUS], 7, 19, 30, "Paused: %s $%04X",
+                  view->watch_write ? "write" : "read", view->watch_addr);
+    else
+        set_field(&next[FIELD_STATUS], 7, 19, 30, "Paused");
+    set_field(&next[FIELD_BREAKS], 7, 63, 15, "%d / %d", view->breakpoints,
+              view->watchpoints);
+
+    // The renderer's own timings change every frame: showing them is never
+    // a reason to draw one
+    next[FIELD_RENDER].passive = true;
+    next[FIELD_FPS].passive = true;
+
+    // Stack and History values starting from line 2
+    for (int i = 0; i < CPU_VIEW_STACK; i++)
+        set_field(&next[FIELD_STACK + i], 2 + i, 59, 10, "%d: $%02X", i + 1,
+                  view->stack[i]);
+    for (int i = 0; i < INSTRUCTION_HISTORY_SIZE; i++)
+        set_field(&next[FIELD_HISTORY + i], 2 + i, 70, 9, "%d: $%04X", i + 1,
+                  view->history[i]);
+
+    // Compare with what is on screen
+    bool full = !cpu_shown_valid;
+    bool dirty = full;
+
+    for (int i = 0; i < CPU_FIELD_COUNT && !dirty; i++)
+        dirty = !next[i].passive && strcmp(next[i].text, cpu_shown[i].text);
+
+    if (!dirty)
+        return;
+
+    lock_interface(); // Lock for safe window update
+
+    if (full)
+        draw_cpu_frame();
+
+    // Values: in cyan, padded over whatever was there before
+    wattron(cpu_window, COLOR_PAIR(2));
+    for (int i = 0; i < CPU_FIELD_COUNT; i++)
+    {
+        if (full || strcmp(next[i].text, cpu_shown[i].text))
+            mvwprintw(cpu_window, next[i].y, next[i].x, "%-*.*s",
+                      next[i].width, next[i].width, next[i].text);
+    }
+    wattroff(cpu_window, COLOR_PAIR(2));
 
     // Refresh the window to apply changes
     wrefresh(cpu_window);
     unlock_interface(); // Unlock after update
+
+    memcpy(cpu_shown, next, sizeof(cpu_shown));
+    cpu_shown_valid = true;
 }
 
 /**
- * @brief Display 8 lines of memory with 16 bytes each, starting at start_addr.
- * Example format:
+ * @brief Display 8 lines of memory with 16 bytes each: the page copied into
+ * the view. Example format:
  *   F000:00,00,00,00,00,00,00,00,00,00,00,00,00,00,00,00
+ *
+ * Only the bytes that changed are drawn, or every line when the view moved
+ * to another page; when nothing changed the window is left alone.
  */
-void print_memory_contents(cpu_6502_t *cpu, uint16_t start_addr)
+void print_memory_contents(const cpu_view_t *view)
 {
+    const uint8_t *page = view->page;
+    uint16_t start_addr = view->page_addr;
+
+    bool full = !memory_shown_valid || start_addr != memory_shown_addr;
+
+    if (!full && memcmp(page, memory_shown, sizeof(memory_shown)) == 0)
+        return;
+
     lock_interface();
-    werase(memory_window);
-    box(memory_window, 0, 0);
-    mvwprintw(memory_window, 0, 2, " Memory View ");
+
+    if (!memory_shown_valid)
+    {
+        werase(memory_window);
+        box(memory_window, 0, 0);
+        mvwprintw(memory_window, 0, 2, " Memory View ");
+    }
 
     // Print 8 lines of 16 bytes each => 128 bytes total
     for (int line = 0; line < MEMORY_LINES; line++)
     {
         // 'line * BYTES_PER_LINE' will step in increments of 16
         uint16_t addr_line = start_addr + (line * BYTES_PER_LINE);
-        mvwprintw(memory_window, line + 1, 2, "%04X:", addr_line);
-        int col_x = 7;
+
+        if (full)
+            mvwprintw(memory_window, line + 1, 2, "%04X:", addr_line);
 
         for (int b = 0; b < BYTES_PER_LINE; b++)
         {
-            uint8_t value = bus_read(cpu->bus, addr_line + b);
-            mvwprintw(memory_window, line + 1, col_x, "%02X", value);
+            int i = line * BYTES_PER_LINE + b;
+            int col_x = 7 + b * 3; // Two digits and a comma per byte
 
-            col_x += 2;
+            if (full || page[i] != memory_shown[i])
+                mvwprintw(memory_window, line + 1, col_x, "%02X", page[i]);
 
-            if (b < BYTES_PER_LINE - 1)
-            {
-                mvwaddch(memory_window, line + 1, col_x, ',');
-                col_x += 1;
-            }
+            if (!memory_shown_valid && b < BYTES_PER_LINE - 1)
+                mvwaddch(memory_window, line + 1, col_x + 2, ',');
         }
     }
 
     wrefresh(memory_window);
     unlock_interface();
+
+    memcpy(memory_shown, page, sizeof(memory_shown));
+    memory_shown_addr = start_addr;
+    memory_shown_valid = true;
 }
 
 /**
@@ -851,7 +1062,7 @@ void *serial_input_thread(void *arg)
             {
                 // Adjust clock speed
                 input_paused = true;
-                prompt_adjust_clock(cpu);
+                prompt_adjust_clock();
                 input_paused = false;
             }
             else if (ch == KEY_F(5))
@@ -873,33 +1084,48 @@ void *serial_input_thread(void *arg)
                 step_mode = true;
                 step_instruction = true;
             }
+            else if (ch == KEY_F(8))
+            {
+                // Toggle a breakpoint or watchpoint
+                input_paused = true;
+                prompt_breakpoint();
+                input_paused = false;
+            }
+            else if (ch == KEY_F(9))
+            {
+                // Step back, reverse continue or go to a cycle
+                input_paused = true;
+                prompt_time_travel();
+                input_paused = false;
+            }
             else if (ch == KEY_F(10))
             {
                 emulator_exit = true; // Exit emulator
             }
             else if (ch == '\n' || ch == '\r')
             {
-                // Send the input buffer content to the CPU input queue
+                // Send the input buffer content on to the CPU; the
+                // emulation thread moves it to the input queue
                 for (int i = 0; i <= current_line; i++)
                 {
-                    // Enqueue each character in the line
-                    for (int j = 0; j < (int)strlen(input_buffer[i]); j++)
-                    {
-                        queue_enqueue(&cpu->input_queue,
-                                      (uint8_t)input_buffer[i][j]);
-                    }
+                    // Enqueue the characters of the line in one go
+                    queue_enqueue_n(&serial_input,
+                                    (const uint8_t *)input_buffer[i],
+                                    strlen(input_buffer[i]));
 
                     // Send newline between lines
                     if (i < current_line)
                     {
-                        queue_enqueue(&cpu->input_queue,
+                        queue_enqueue(&serial_input,
                                       (uint8_t)'\n'); // Newline between lines
                     }
                 }
 
-                // Send \r\n to the CPU input queue
-                queue_enqueue(&cpu->input_queue, (uint8_t)'\r');
-                queue_enqueue(&cpu->input_queue, (uint8_t)'\n');
+                // Send \r\n to the CPU
+                queue_enqueue_n(&serial_input, (const uint8_t *)"\r\n", 2);
+
+                // The emulation thread forwards it after the current slice
+                // and wakes the CPU if it is blocked in an idle input loop
 
                 // Clear the input buffer and window
                 memset(input_buffer, 0, sizeof(input_buffer));
@@ -1029,7 +1255,7 @@ void *serial_input_thread(void *arg)
  */
 void *serial_output_thread(void *arg)
 {
-    uint8_t byte;
+    uint8_t batch[QUEUE_SIZE];
     int output_x = 1, output_y = 1; // Start position inside the border
     int max_x = SERIAL_OUTPUT_WINDOW_WIDTH - 2;
     int max_y = SERIAL_OUTPUT_WINDOW_HEIGHT - 2;
@@ -1038,48 +1264,34 @@ void *serial_output_thread(void *arg)
     // Main output loop
     while (!emulator_exit)
     {
-        lock_interface(); // Lock before accessing the queue
+        // Sleep until the CPU publishes output; the timeout only bounds how
+        // long it takes to notice emulator_exit
+        if (!queue_wait(&cpu->output_queue, OUTPUT_WAIT_MS))
+            continue;
+
+        lock_interface();
 
-        // Process bytes in the output queue
-        while (queue_dequeue(&cpu->output_queue, &byte))
+        // Drain everything available, then refresh the window once
+        size_t count;
+        while ((count = queue_dequeue_n(&cpu->output_queue, batch,
+                                        sizeof(batch))) > 0)
         {
-            if (byte == '\r')
-            {
-                // Carriage return: move to the start of the line
-                output_x = 1;
-            }
-            else if (byte == '\n')
+            // Output a time travel replays was shown the first time
+            if (atomic_load(&discard_output))
+                continue;
+
+            for (size_t i = 0; i < count; i++)
             {
-                // Newline: move to the next line
-                output_x = 1;
-                output_y++;
+                uint8_t byte = batch[i];
 
-                // Scroll the window content if we exceed the last row
-                if (output_y > max_y)
+                if (byte == '\r')
                 {
-                    output_y = max_y;
-
-                    // Scroll all lines up by copying them directly
-                    for (int y = 1; y < max_y; y++)
-                    {
-                        char buffer[max_x + 1];
-                        mvwinnstr(serial_output_window, y + 1, 1, buffer,
-                                  max_x);
-                        mvwaddnstr(serial_output_window, y, 1, buffer, max_x);
-                    }
-
-                    // Clear the last line for new text
-                    mvwhline(serial_output_window, max_y, 1, ' ', max_x);
+                    // Carriage return: move to the start of the line
+                    output_x = 1;
                 }
-            }
-            else
-            {
-                // Print regular characters
-                mvwaddch(serial_output_window, output_y, output_x++, byte);
-
-                // Wrap text if it exceeds the window width
-                if (output_x > max_x)
+                else if (byte == '\n')
                 {
+                    // Newline: move to the next line
                     output_x = 1;
                     output_y++;
 
@@ -1088,7 +1300,7 @@ void *serial_output_thread(void *arg)
                     {
                         output_y = max_y;
 
-                        // Scroll all lines up
+                        // Scroll all lines up by copying them directly
                         for (int y = 1; y < max_y; y++)
                         {
                             char buffer[max_x + 1];
@@ -1102,16 +1314,43 @@ void *serial_output_thread(void *arg)
                         mvwhline(serial_output_window, max_y, 1, ' ', max_x);
                     }
                 }
-            }
+                else
+                {
+                    // Print regular characters
+                    mvwaddch(serial_output_window, output_y, output_x++, byte);
 
-            // Refresh the window after processing each byte
-            wrefresh(serial_output_window);
-        }
+                    // Wrap text if it exceeds the window width
+                    if (output_x > max_x)
+                    {
+                        output_x = 1;
+                        output_y++;
 
-        unlock_interface(); // Unlock after processing
+                        // Scroll the window content if we exceed the last row
+                        if (output_y > max_y)
+                        {
+                            output_y = max_y;
+
+                            // Scroll all lines up
+                            for (int y = 1; y < max_y; y++)
+                            {
+                                char buffer[max_x + 1];
+                                mvwinnstr(serial_output_window, y + 1, 1,
+                                          buffer, max_x);
+                                mvwaddnstr(serial_output_window, y, 1, buffer,
+                                           max_x);
+                            }
+
+                            // Clear the last line for new text
+                            mvwhline(serial_output_window, max_y, 1, ' ',
+                                     max_x);
+                        }
+                    }
+                }
+            }
+        }
 
-        // Sleep for a short duration to avoid busy-waiting
-        usleep(10000); // 10 ms
+        wrefresh(serial_output_window);
+        unlock_interface();
     }
 
     return NULL;
@@ -1125,25 +1364,24 @@ void *serial_output_thread(void *arg)
 void inject_IRQ(cpu_6502_t *cpu)
 {
     printf("Injecting IRQ...\n");
-    cpu_inject_IRQ(cpu);
+
+    // Logged, so replays take it on the same cycle
+    if (timeline)
+        timeline_interrupt(timeline, false);
+    else
+        cpu_inject_IRQ(cpu);
 }
 
 /**
- * @brief Inject an IRQ after a specific delay.
+ * @brief Scheduled event that injects the demo IRQ.
  *
- * @param arg Pointer to the CPU structure.
- * @return NULL
+ * @param context Pointer to the CPU structure.
+ * @param cycle Cycle the event was scheduled for.
  */
-void *inject_IRQ_thread(void *arg)
+void inject_IRQ_event(void *context, uint64_t cycle)
 {
-    cpu_6502_t *cpu = (cpu_6502_t *)arg;
-
-    // Wait for 5 seconds before injecting IRQ
-    sleep(5);
-
-    inject_IRQ(cpu);
-
-    return NULL;
+    (void)cycle;
+    inject_IRQ((cpu_6502_t *)context);
 }
 
 /**
@@ -1154,25 +1392,23 @@ void *inject_IRQ_thread(void *arg)
 void inject_NMI(cpu_6502_t *cpu)
 {
     printf("Injecting NMI...\n");
-    cpu_inject_NMI(cpu);
+
+    if (timeline)
+        timeline_interrupt(timeline, true);
+    else
+        cpu_inject_NMI(cpu);
 }
 
 /**
- * @brief Inject an NMI after a specific delay.
+ * @brief Scheduled event that injects the demo NMI.
  *
- * @param arg Pointer to the CPU structure.
- * @return NULL
+ * @param context Pointer to the CPU structure.
+ * @param cycle Cycle the event was scheduled for.
  */
-void *inject_NMI_thread(void *arg)
+void inject_NMI_event(void *context, uint64_t cycle)
 {
-    cpu_6502_t *cpu = (cpu_6502_t *)arg;
-
-    // Wait for 10 seconds before injecting NMI
-    sleep(10);
-
-    inject_NMI(cpu);
-
-    return NULL;
+    (void)cycle;
+    inject_NMI((cpu_6502_t *)context);
 }
 
 /**
@@ -1203,14 +1439,15 @@ void *render_interface(void *arg)
             // Measure render time
             double render_start = get_current_time();
 
-            // Update CPU state display
-            print_cpu_state(cpu);
+            // Draw from the latest published view, never the live CPU
+            const cpu_view_t *view = cpu_view_acquire(&cpu_view);
 
-            // Calculate memory_start_addr from memory_view_page
-            uint16_t memory_start_addr = memory_view_page * BYTES_PER_PAGE;
+            // Update CPU state display; both windows skip the lock and the
+            // refresh when nothing they show has changed
+            print_cpu_state(cpu, view);
 
             // Update Memory window
-            print_memory_contents(cpu, memory_start_addr);
+            print_memory_contents(view);
 
             double render_end = get_current_time();
 
@@ -1241,6 +1478,7 @@ void *emulator_loop(void *arg)
     uint64_t last_cycle_count =
         cpu->clock.cycle_count;            // Track last cycle count
     double last_time = get_current_time(); // Track last timestamp
+    double last_publish = 0.0;             // Last view for the interface
 
     // We'll track the block number that the PC is in so if PC is e.g. 200,
     // that's in block 1 if block size=128; because 200/128 = 1
@@ -1249,18 +1487,27 @@ void *emulator_loop(void *arg)
         // Check if the emulator needs to reset
         if (emulator_reset)
         {
-            // Ensure the current binary and address are valid
-            if (current_binary_path_user[0] != '\0' &&
-                current_load_address_user != 0)
+            // Go back to the state the last load left, or load it again.
+            // The serial output thread drains the output queue under the
+            // interface lock, so holding it makes this thread its consumer
+            // for the clear.
+            lock_interface();
+
+            bool restored =
+                cpu_snapshot_restore(cpu, &power_on) == CPU_SUCCESS ||
+                (current_binary_path_user[0] != '\0' &&
+                 current_load_address_user != 0 &&
+                 load_binary(cpu, current_binary_path_user,
+                             current_load_address_user) == 0);
+
+            if (restored)
+                queue_clear(&cpu->output_queue);
+
+            unlock_interface();
+
+            if (restored)
             {
-                // Reload the last loaded binary
-                if (load_binary(cpu, current_binary_path_user,
-                                current_load_address_user) != 0)
-                {
-                    fprintf(stderr, "Failed to reload binary during reset.\n");
-                    emulator_exit = true;
-                    break;
-                }
+                atomic_store(&timeline_stale, true);
 
                 // Reset timing variables
                 last_cycle_count = cpu->clock.cycle_count;
@@ -1272,7 +1519,9 @@ void *emulator_loop(void *arg)
             }
             else
             {
-                fprintf(stderr, "No binary loaded to reset.\n");
+                fprintf(stderr, "Failed to reset the program.\n");
+                emulator_exit = true;
+                break;
             }
 
             // Also reset the memory_view_page to 0
@@ -1284,11 +1533,45 @@ void *emulator_loop(void *arg)
             step_mode = false;
         }
 
+        // Apply a breakpoint edit from the interface
+        if (atomic_load(&edit_pending))
+        {
+            apply_breakpoint_edit(cpu);
+            atomic_store(&edit_pending, false);
+        }
+
+        // Apply a clock change from the interface
+        if (atomic_load(&clock_pending))
+        {
+            apply_clock_change(cpu);
+            atomic_store(&clock_pending, false);
+        }
+
+        // Start the history over from here after outside changes
+        if (timeline && atomic_exchange(&timeline_stale, false))
+            timeline_start(timeline);
+
+        // Carry out a time travel from the interface
+        if (atomic_load(&travel_pending))
+        {
+            apply_time_travel(cpu);
+            atomic_store(&travel_pending, false);
+        }
+
+        forward_serial_input(cpu);
+
         // Execute instructions if not paused or in step mode
         if (!emulator_paused || (step_mode && step_instruction))
         {
-            // Execute the next instruction
-            if (cpu_execute_instruction(cpu, NULL) != CPU_SUCCESS)
+            // Run one instruction per step, otherwise a slice of about one
+            // millisecond of emulated time; cpu_run_cycles() throttles to
+            // the clock frequency at each clock quantum
+            uint64_t budget = 1;
+
+            if (!step_mode && cpu->clock.frequency > SLICE_HZ)
+                budget = (uint64_t)(cpu->clock.frequency / SLICE_HZ);
+
+            if (cpu_run_cycles(cpu, budget, &breakpoints) != CPU_SUCCESS)
             {
                 fprintf(stderr, "Error: Invalid opcode at 0x%04X\n",
                         cpu->reg.PC);
@@ -1296,8 +1579,19 @@ void *emulator_loop(void *arg)
                 break;
             }
 
-            // Update instruction history
-            update_instruction_history(cpu->reg.PC);
+            // Checkpoint on the way
+            if (timeline)
+                timeline_tick(timeline);
+
+            // Breakpoints and watchpoints pause in step mode: F7 steps on
+            // from there, F2 resumes
+            if (cpu->stop_reason == CPU_STOP_BREAKPOINT ||
+                cpu->stop_reason == CPU_STOP_WATCHPOINT)
+            {
+                emulator_paused = true;
+                step_mode = true;
+                step_instruction = false;
+            }
 
             // Check if in step mode
             if (step_mode)
@@ -1305,9 +1599,6 @@ void *emulator_loop(void *arg)
                 step_instruction = false; // Wait for the next step command
             }
 
-            // Wait according to clock frequency
-            clock_wait_next_cycle(&cpu->clock);
-
             // ================================================================
             // NEW: Adjust memory_view_page so that
             // if PC is in block X, we show that block
@@ -1352,9 +1643,23 @@ void *emulator_loop(void *arg)
                 last_time = current_time;
             }
         }
+        else
+        {
+            // Nothing to run until resumed or stepped; the UI polls keys
+            // every 10 ms anyway
+            usleep(10000);
+        }
+
+        // Between slices reg.P is current and the CPU is ours: show it to
+        // the interface, at a bounded rate so long runs do not pay for it.
+        // Paused, this also picks up changes made from the input thread.
+        double now = get_current_time();
 
-        // Small sleep to prevent high CPU usage
-        usleep(100);
+        if ((now - last_publish) * 1000.0 >= VIEW_PUBLISH_MS)
+        {
+            publish_cpu_view(cpu);
+            last_publish = now;
+        }
     }
 
     return NULL;
@@ -1376,13 +1681,22 @@ void cleanup(cpu_6502_t *cpu, memory_t *ram, bus_t *bus)
     delwin(serial_input_window);
     endwin();
 
+    // Destroy the devices (they cancel their events on the CPU first)
+    memory_destroy_via(via_device);
+    via_device = NULL;
+    memory_destroy_acia(acia_device);
+    acia_device = NULL;
+    memory_destroy_console(console_device);
+    console_device = NULL;
+
+    cpu_snapshot_free(&power_on);
+    timeline_destroy(timeline);
+    timeline = NULL;
+    queue_destroy(&serial_input);
+
     // Destroy the CPU
     cpu_destroy(cpu);
 
-    // Destroy the queues associated with the CPU
-    queue_destroy(&cpu->input_queue);
-    queue_destroy(&cpu->output_queue);
-
     // Destroy the monitored RAM
     memory_destroy_monitored_ram(ram);
 
@@ -1394,14 +1708,21 @@ void cleanup(cpu_6502_t *cpu, memory_t *ram, bus_t *bus)
 }
 
 /**
- * @brief Update the instruction history buffer.
+ * @brief Publish the CPU state for the render thread.
  *
- * @param pc The current program counter.
+ * @param cpu Pointer to the CPU structure.
  */
-void update_instruction_history(uint16_t pc)
+void publish_cpu_view(cpu_6502_t *cpu)
 {
-    instruction_history[history_index] = pc;
-    history_index = (history_index + 1) % INSTRUCTION_HISTORY_SIZE;
+    cpu_view_t *view = cpu_view_back(&cpu_view);
+
+    cpu_view_capture(view, cpu, memory_view_page * BYTES_PER_PAGE);
+
+    view->paused = emulator_paused;
+    view->breakpoints = breakpoints.count;
+    view->watchpoints = watchpoint_count;
+
+    cpu_view_publish(&cpu_view);
 }
 
 /**
@@ -1466,17 +1787,16 @@ void prompt_load_binary(cpu_6502_t *cpu)
 
 /**
  * @brief Prompt the user to adjust the CPU clock speed.
- *
- * @param cpu Pointer to the CPU structure.
  */
-void prompt_adjust_clock(cpu_6502_t *cpu)
+void prompt_adjust_clock(void)
 {
     input_paused = true; // Pause input
 
     char input[32] = {0};
     int ch = display_prompt(
         "Adjust Clock",
-        "Enter new clock speed in Hz (1e6 for 1 MHz):", FLOATING_POINT,
+        "Enter new clock speed in Hz (1e6 for 1 MHz),\n"
+        "or a mode: realtime, turbo, virtual:", ALPHANUMERIC,
         input, sizeof(input));
 
     if (ch == 27) // ESC key was pressed
@@ -1487,24 +1807,55 @@ void prompt_adjust_clock(cpu_6502_t *cpu)
 
     double new_clock_speed = atof(input);
 
+    // Clock modes keep the current frequency
+    bool is_mode = strcmp(input, "realtime") == 0 ||
+                   strcmp(input, "turbo") == 0 ||
+                   strcmp(input, "virtual") == 0;
+
     // Validate the new clock speed
-    if (new_clock_speed > 0)
-    {
-        lock_interface();
-        cpu_set_clock_frequency(cpu, new_clock_speed);
-        unlock_interface();
-    }
-    else
+    if (!is_mode && new_clock_speed <= 0)
     {
         // Display error message
         display_prompt(
             "Error", "Invalid clock speed entered.\nPress any key to continue.",
             ALPHANUMERIC, NULL, 0);
+        input_paused = false;
+        return;
     }
 
+    // The emulation thread takes a change within one pass of its loop
+    while (atomic_load(&clock_pending) && !emulator_exit)
+        usleep(1000);
+
+    pending_clock_is_mode = is_mode;
+    pending_clock_mode = input[0] == 'r'   ? CLOCK_MODE_REALTIME
+                         : input[0] == 't' ? CLOCK_MODE_TURBO
+                                           : CLOCK_MODE_VIRTUAL;
+    pending_clock_frequency = new_clock_speed;
+    atomic_store(&clock_pending, true);
+
     input_paused = false;
 }
 
+/**
+ * @brief Apply the change prompt_adjust_clock() handed over.
+ *
+ * @param cpu Pointer to the CPU structure.
+ */
+void apply_clock_change(cpu_6502_t *cpu)
+{
+    if (pending_clock_is_mode)
+    {
+        cpu_set_clock_mode(cpu, pending_clock_mode);
+        return;
+    }
+
+    cpu_set_clock_frequency(cpu, pending_clock_frequency);
+
+    // Devices time themselves from the frequency
+    atomic_store(&timeline_stale, true);
+}
+
 /**
  * @brief Prompt the user to set the PC (Program Counter) value.
  *
@@ -1534,6 +1885,8 @@ void prompt_set_pc(cpu_6502_t *cpu)
         lock_interface();
         cpu->reg.PC = new_pc; // Update the Program Counter in the CPU
         unlock_interface();
+
+        atomic_store(&timeline_stale, true);
     }
     else
     {
@@ -1545,6 +1898,235 @@ void prompt_set_pc(cpu_6502_t *cpu)
     input_paused = false;
 }
 
+/**
+ * @brief Prompt the user for a breakpoint or watchpoint to toggle.
+ */
+void prompt_breakpoint(void)
+{
+    input_paused = true; // Pause input
+
+    char input[16] = {0};
+    int ch = display_prompt(
+        "Breakpoints",
+        "An address toggles a breakpoint (e.g., C003);\n"
+        "R or W and an address toggles a read or write\n"
+        "watchpoint (e.g., W 0200); clear removes all:",
+        ALPHANUMERIC, input, sizeof(input));
+
+    if (ch == 27) // ESC key was pressed
+    {
+        input_paused = false;
+        return;
+    }
+
+    BreakEditType type = BREAK_EDIT_EXEC;
+    const char *text = input;
+    uint16_t addr = 0;
+
+    if (strcmp(input, "clear") == 0)
+        type = BREAK_EDIT_CLEAR;
+    else if (toupper((unsigned char)input[0]) == 'R' ||
+             toupper((unsigned char)input[0]) == 'W')
+    {
+        type = (toupper((unsigned char)input[0]) == 'R') ? BREAK_EDIT_READ
+                                                          : BREAK_EDIT_WRITE;
+        text++;
+    }
+
+    if (type != BREAK_EDIT_CLEAR && sscanf(text, " %hx", &addr) != 1)
+    {
+        // Display error message
+        display_prompt("Error",
+                       "Invalid address.\nPress any key to continue.",
+                       ALPHANUMERIC, NULL, 0);
+        input_paused = false;
+        return;
+    }
+
+    // The emulation thread takes an edit within one pass of its loop
+    while (atomic_load(&edit_pending) && !emulator_exit)
+        usleep(1000);
+
+    pending_edit_type = type;
+    pending_edit_addr = addr;
+    atomic_store(&edit_pending, true);
+
+    input_paused = false;
+}
+
+/**
+ * @brief Apply the edit prompt_breakpoint() handed over.
+ *
+ * @param cpu Pointer to the CPU structure.
+ */
+void apply_breakpoint_edit(cpu_6502_t *cpu)
+{
+    uint16_t addr = pending_edit_addr;
+
+    switch (pending_edit_type)
+    {
+    case BREAK_EDIT_EXEC:
+        if (!breakpoint_remove(&breakpoints, addr))
+            breakpoint_add(&breakpoints, addr);
+        break;
+    case BREAK_EDIT_READ:
+    case BREAK_EDIT_WRITE:
+    {
+        bool write = pending_edit_type == BREAK_EDIT_WRITE;
+        bool set = !bus_watchpoint_is_set(cpu->bus, addr, write);
+
+        bus_set_watchpoint(cpu->bus, addr, write, set);
+        watchpoint_count += set ? 1 : -1;
+        break;
+    }
+    case BREAK_EDIT_CLEAR:
+        breakpoint_init(&breakpoints);
+        bus_clear_watchpoints(cpu->bus);
+        watchpoint_count = 0;
+        break;
+    }
+}
+
+/**
+ * @brief Prompt the user for a step back, a reverse continue or a cycle to
+ *        go to.
+ */
+void prompt_time_travel(void)
+{
+    input_paused = true; // Pause input
+
+    if (!timeline)
+    {
+        display_prompt("Error",
+                       "Time travel is not available.\n"
+                       "Press any key to continue.",
+                       ALPHANUMERIC, NULL, 0);
+        input_paused = false;
+        return;
+    }
+
+    char input[24] = {0};
+    int ch = display_prompt(
+        "Time Travel",
+        "B steps back one instruction, R runs back to\n"
+        "the last breakpoint or watchpoint stop, or a\n"
+        "cycle number goes to that cycle:",
+        ALPHANUMERIC, input, sizeof(input));
+
+    if (ch == 27) // ESC key was pressed
+    {
+        input_paused = false;
+        return;
+    }
+
+    TravelType type = TRAVEL_GOTO;
+    unsigned long long cycle = 0;
+    char *end = input;
+
+    if (toupper((unsigned char)input[0]) == 'B' && input[1] == '\0')
+        type = TRAVEL_STEP_BACK;
+    else if (toupper((unsigned char)input[0]) == 'R' && input[1] == '\0')
+        type = TRAVEL_REVERSE;
+    else if (isdigit((unsigned char)input[0]))
+        cycle = strtoull(input, &end, 10);
+
+    if (type == TRAVEL_GOTO && (end == input || *end != '\0'))
+    {
+        // Display error message
+        display_prompt("Error",
+                       "Invalid entry.\nPress any key to continue.",
+                       ALPHANUMERIC, NULL, 0);
+        input_paused = false;
+        return;
+    }
+
+    // The emulation thread takes a request within one pass of its loop
+    while (atomic_load(&travel_pending) && !emulator_exit)
+        usleep(1000);
+
+    pending_travel_type = type;
+    pending_travel_cycle = cycle;
+    atomic_store(&travel_pending, true);
+
+    input_paused = false;
+}
+
+/**
+ * @brief Carry out the request prompt_time_travel() handed over.
+ *
+ * @param cpu Pointer to the CPU structure.
+ */
+void apply_time_travel(cpu_6502_t *cpu)
+{
+    cpu_status_t status = CPU_SUCCESS;
+    bool found = true;
+
+    // The replay prints again what is already on screen
+    atomic_store(&discard_output, true);
+
+    switch (pending_travel_type)
+    {
+    case TRAVEL_STEP_BACK:
+        status = timeline_step_back(timeline);
+        break;
+    case TRAVEL_REVERSE:
+        status = timeline_reverse_continue(timeline, &breakpoints, &found);
+        break;
+    case TRAVEL_GOTO:
+        status = timeline_goto(timeline, pending_travel_cycle);
+        break;
+    }
+
+    // The output thread drains the queue under the interface lock, so
+    // holding it makes this thread the only consumer while it clears
+    lock_interface();
+    queue_clear(&cpu->output_queue);
+    atomic_store(&discard_output, false);
+    unlock_interface();
+
+    if (status == CPU_ERROR_INVALID_ARGUMENT)
+        fprintf(stderr, "Cycle %llu is no longer recorded.\n",
+                (unsigned long long)pending_travel_cycle);
+    else if (status != CPU_SUCCESS)
+        fprintf(stderr, "Time travel failed at 0x%04X.\n", cpu->reg.PC);
+    else if (!found)
+        fprintf(stderr, "No earlier stop recorded.\n");
+
+    // Pause where it landed, in step mode as at a breakpoint
+    emulator_paused = true;
+    step_mode = true;
+    step_instruction = false;
+    memory_view_page = cpu->reg.PC / BYTES_PER_PAGE;
+}
+
+/**
+ * @brief Hand the typed serial input to the CPU's input ring.
+ *
+ * @param cpu Pointer to the CPU structure.
+ */
+void forward_serial_input(cpu_6502_t *cpu)
+{
+    uint8_t byte;
+    bool forwarded = false;
+
+    // What does not fit waits for the program to read some
+    while (queue_peek(&serial_input, &byte))
+    {
+        bool sent = timeline ? timeline_send_input(timeline, &byte, 1) == 1
+                             : queue_enqueue(&cpu->input_queue, byte);
+
+        if (!sent)
+            break;
+
+        queue_dequeue(&serial_input, &byte);
+        forwarded = true;
+    }
+
+    // Wake the CPU if it is blocked in an idle input loop
+    if (forwarded)
+        cpu_wake(cpu);
+}
+
 /**
  * @brief Display the help menu with key assignments in two columns.
  */
@@ -1554,10 +2136,11 @@ void display_help_menu(void)
 
     // Help menu message
     const char *help_message =
-        "F1  - Help                    F5  - Reset Emulator\n"
-        "F2  - Run/Pause               F6  - Set PC\n"
-        "F3  - Load Binary             F7  - Step\n"
-        "F4  - Adjust Clock            F10 - Quit Emulator\n\n"
+        "F1  - Help                    F6  - Set PC\n"
+        "F2  - Run/Pause               F7  - Step\n"
+        "F3  - Load Binary             F8  - Breakpoints\n"
+        "F4  - Adjust Clock            F9  - Time Travel\n"
+        "F5  - Reset Emulator          F10 - Quit Emulator\n\n"
         "Press any key to return.";
 
     // Display the help menu without input handling
@@ -20,9 +20,16 @@
 
 #include "bus.h"       // Bus system
 #include "cpu_6502.h"  // CPU emulation
+#include "cpu_view.h"  // State snapshots for the interface
 #include "memory.h"    // Memory management
 #include "monitored.h" // Monitored memory
 #include "queue.h"     // Input/output queues
+#include "via6522.h"   // 6522 VIA
+#include "acia.h"      // 6551 ACIA and console port
+#include "headless.h"  // Batch runs without the interface
+#include "snapshot.h"  // Save states
+#include "timeline.h"  // Reverse execution
+#include "trace.h"     // Execution traces
 
 /******************************************************************************
  *                             Macro Definitions                              *
@@ -42,15 +49,20 @@
 #define SERIAL_INPUT_WINDOW_WIDTH 80
 
 // We will display 128 bytes per page, each line with 16 bytes and 8 lines
-#define BYTES_PER_PAGE   128
+#define BYTES_PER_PAGE   CPU_VIEW_PAGE_SIZE
 #define BYTES_PER_LINE   16
 #define MEMORY_LINES     8   // Because 8 lines * 16 bytes = 128
 
 /* Emulation parameters */
 #define DEFAULT_FPS 10
-#define INSTRUCTION_HISTORY_SIZE 5
+#define INSTRUCTION_HISTORY_SIZE CPU_VIEW_HISTORY
+#define VIEW_PUBLISH_MS 20 // Shortest time between two published CPU views
+#define SLICE_HZ 1000 // Emulation slices per second of emulated time
+#define OUTPUT_WAIT_MS 50 // Longest the output thread sleeps between exit checks
 #define INPUT_MAX_LINES 3
 #define INPUT_MAX_COLS 78
+#define IRQ_DEMO_SECONDS 5.0  // Emulated time of the demo IRQ
+#define NMI_DEMO_SECONDS 10.0 // Emulated time of the demo NMI
 
 /* Key Definitions */
 #ifndef KEY_ESC
@@ -79,8 +91,6 @@ extern volatile bool display_help;
 extern volatile bool input_paused;
 
 /* Emulation State */
-extern uint16_t instruction_history[INSTRUCTION_HISTORY_SIZE];
-extern int history_index;
 extern int fps;
 
 /* Current Binary Configuration */
@@ -95,6 +105,23 @@ typedef enum
     FLOATING_POINT
 } InputType;
 
+/* Debugger edits made from the interface (F8) */
+typedef enum
+{
+    BREAK_EDIT_EXEC = 1, // Toggle an execution breakpoint
+    BREAK_EDIT_READ,     // Toggle a read watchpoint
+    BREAK_EDIT_WRITE,    // Toggle a write watchpoint
+    BREAK_EDIT_CLEAR     // Remove them all
+} BreakEditType;
+
+/* Time travel requests made from the interface (F9) */
+typedef enum
+{
+    TRAVEL_STEP_BACK = 1, // Back one instruction
+    TRAVEL_REVERSE,       // Back to the last breakpoint or watchpoint stop
+    TRAVEL_GOTO           // To a given cycle
+} TravelType;
+
 /******************************************************************************
  *                             Opcodes Constants                              *
  ******************************************************************************/
@@ -342,21 +369,23 @@ int display_prompt(const char *prompt_title, const char *prompt_message,
 double get_current_time(void);
 
 /**
- * @brief Display the CPU state in the CPU window.
+ * @brief Display the CPU state in the CPU window, drawing only the values
+ * that changed since the last call.
  *
- * @param cpu Pointer to the CPU structure.
+ * @param cpu Pointer to the CPU structure (render timings only).
+ * @param view Latest view published by the emulation thread.
  */
-void print_cpu_state(cpu_6502_t *cpu);
+void print_cpu_state(cpu_6502_t *cpu, const cpu_view_t *view);
 
 /**
- * @brief Display 8 lines of memory with 16 bytes each, starting at start_addr.
- * Example format:
+ * @brief Display 8 lines of memory with 16 bytes each: the page copied into
+ * the view. Example format:
  *   F000:00,00,00,00,00,00,00,00,00,00,00,00,00,00,00,00
+ * Only bytes that changed since the last call are drawn.
  *
- * @param cpu Pointer to the CPU structure.
- * @param start_addr Memory address.
+ * @param view Latest view published by the emulation thread.
  */
-void print_memory_contents(cpu_6502_t *cpu, uint16_t start_addr);
+void print_memory_contents(const cpu_view_t *view);
 
 /**
  * @brief Thread function for handling serial input and key events.
@@ -382,12 +411,12 @@ void *serial_output_thread(void *arg);
 void inject_IRQ(cpu_6502_t *cpu);
 
 /**
- * @brief Thread function for injecting IRQ after a delay.
+ * @brief Scheduled event that injects the demo IRQ.
  *
- * @param arg Pointer to the CPU structure.
- * @return NULL
+ * @param context Pointer to the CPU structure.
+ * @param cycle Cycle the event was scheduled for.
  */
-void *inject_IRQ_thread(void *arg);
+void inject_IRQ_event(void *context, uint64_t cycle);
 
 /**
  * @brief Inject an NMI interrupt into the CPU.
@@ -397,12 +426,12 @@ void *inject_IRQ_thread(void *arg);
 void inject_NMI(cpu_6502_t *cpu);
 
 /**
- * @brief Thread function for injecting NMI after a delay.
+ * @brief Scheduled event that injects the demo NMI.
  *
- * @param arg Pointer to the CPU structure.
- * @return NULL
+ * @param context Pointer to the CPU structure.
+ * @param cycle Cycle the event was scheduled for.
  */
-void *inject_NMI_thread(void *arg);
+void inject_NMI_event(void *context, uint64_t cycle);
 
 /**
  * @brief Thread function for rendering the interface.
@@ -430,15 +459,17 @@ void *emulator_loop(void *arg);
 void cleanup(cpu_6502_t *cpu, memory_t *ram, bus_t *bus);
 
 /**
- * @brief Update the instruction history buffer.
+ * @brief Publish the CPU state, the instruction history and the viewed
+ * memory page for the render thread. Emulation thread only.
  *
- * @param pc The current program counter.
+ * @param cpu Pointer to the CPU structure.
  */
-void update_instruction_history(uint16_t pc);
+void publish_cpu_view(cpu_6502_t *cpu);
 
 /**
  * @brief Load a binary file into the CPU memory, set reset vector, and reset
- * CPU.
+ * CPU. Clears the serial output queue, so once the serial output thread
+ * runs, call it with the interface lock held.
  *
  * @param cpu Pointer to the CPU structure.
  * @param path Path to the binary file.
@@ -455,11 +486,18 @@ int load_binary(cpu_6502_t *cpu, const char *path, uint16_t load_address);
 void prompt_load_binary(cpu_6502_t *cpu);
 
 /**
- * @brief Prompt the user to adjust the CPU clock speed.
+ * @brief Prompt the user to adjust the CPU clock speed. The change is
+ * handed to the emulation thread like a breakpoint edit.
+ */
+void prompt_adjust_clock(void);
+
+/**
+ * @brief Apply the change prompt_adjust_clock() handed over. Emulation
+ * thread only.
  *
  * @param cpu Pointer to the CPU structure.
  */
-void prompt_adjust_clock(cpu_6502_t *cpu);
+void apply_clock_change(cpu_6502_t *cpu);
 
 /**
  * @brief Prompt the user to set the PC (Program Counter) value.
@@ -468,6 +506,43 @@ void prompt_adjust_clock(cpu_6502_t *cpu);
  */
 void prompt_set_pc(cpu_6502_t *cpu);
 
+/**
+ * @brief Prompt the user for a breakpoint or watchpoint to toggle. The edit
+ * is handed to the emulation thread, which applies it between slices.
+ */
+void prompt_breakpoint(void);
+
+/**
+ * @brief Apply the edit prompt_breakpoint() handed over. Emulation thread
+ * only.
+ *
+ * @param cpu Pointer to the CPU structure.
+ */
+void apply_breakpoint_edit(cpu_6502_t *cpu);
+
+/**
+ * @brief Prompt the user for a step back, a reverse continue or a cycle to
+ * go to. The request is handed to the emulation thread like a breakpoint
+ * edit.
+ */
+void prompt_time_travel(void);
+
+/**
+ * @brief Carry out the request prompt_time_travel() handed over and pause
+ * there. Emulation thread only.
+ *
+ * @param cpu Pointer to the CPU structure.
+ */
+void apply_time_travel(cpu_6502_t *cpu);
+
+/**
+ * @brief Hand the typed serial input to the CPU's input ring, through the
+ * timeline so replays see it again. Emulation thread only.
+ *
+ * @param cpu Pointer to the CPU structure.
+ */
+void forward_serial_input(cpu_6502_t *cpu);
+
 /**
  * @brief Display the help menu with key assignments.
  */
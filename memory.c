@@ -23,6 +23,18 @@ static void ram_write(memory_t *memory, uint16_t addr, uint8_t data)
     ram->data[addr] = data;
 }
 
+/* RAM Page Pointer Function: every in-range page is plain storage */
+static uint8_t *ram_page_pointer(memory_t *memory, uint16_t addr, bool write)
+{
+    (void)write; // Reads and writes have no side effects
+    ram_memory_t *ram = (ram_memory_t *)memory->context;
+
+    if ((size_t)addr + 0x100 > ram->size)
+        return NULL; // Page is (partly) out of bounds; keep the checks
+
+    return &ram->data[addr];
+}
+
 /* Create RAM */
 memory_t *memory_create_ram(size_t size)
 {
@@ -51,7 +63,11 @@ memory_t *memory_create_ram(size_t size)
     ram->size = size;
     memory->read = ram_read;
     memory->write = ram_write;
+    memory->page_pointer = ram_page_pointer;
     memory->context = ram;
+    memory->peek = NULL;
+    memory->save_state = NULL;
+    memory->restore_state = NULL;
 
     return memory;
 }
@@ -3,6 +3,7 @@
 #define MEMORY_H
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <stdlib.h>
 
 /* Memory Interface */
@@ -10,7 +11,30 @@ typedef struct memory
 {
     uint8_t (*read)(struct memory *memory, uint16_t addr);
     void (*write)(struct memory *memory, uint16_t addr, uint8_t data);
+
+    /* Optional: pointer to the byte at `addr` (the start of a 256-byte page)
+     * that the bus may read (write == false) or write (write == true)
+     * directly for the whole page, or NULL if every access to that page must
+     * go through read/write. Leave the hook NULL for pure I/O devices. */
+    uint8_t *(*page_pointer)(struct memory *memory, uint16_t addr, bool write);
+
     void *context; // Pointer to custom data (e.g., RAM, ROM, IO devices)
+
+    /* Optional: read without side effects, for debuggers and memory views.
+     * Leave NULL when read itself has none. */
+    uint8_t (*peek)(struct memory *memory, uint16_t addr);
+
+    /* Optional: device state for snapshots (snapshot.h) beyond the storage
+     * page_pointer exposes. save_state returns the size of the state and
+     * copies it to buffer if it fits in size bytes; restore_state takes it
+     * back, or returns false if it does not belong to this kind of device.
+     * The state holds architectural fields only, with cycles relative to
+     * cycle_count: no host pointers or scheduler event ids, so saving the
+     * same state twice gives the same bytes. Leave both NULL for plain
+     * storage. */
+    size_t (*save_state)(struct memory *memory, void *buffer, size_t size);
+    bool (*restore_state)(struct memory *memory, const void *buffer,
+                          size_t size);
 } memory_t;
 
 /* RAM Memory Structure */
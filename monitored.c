@@ -19,6 +19,13 @@ static uint8_t monitored_ram_read(memory_t *mem, uint16_t addr)
     return ram->data[addr & (ram->size - 1)];
 }
 
+static void monitored_ram_send(monitored_ram_t *ram, const char *message)
+{
+    // Push the whole message to serial output in one bulk enqueue
+    queue_enqueue_n(&ram->cpu->output_queue, (const uint8_t *)message,
+                    strlen(message));
+}
+
 static void monitored_ram_write(memory_t *mem, uint16_t addr, uint8_t data)
 {
     // Check if the memory structure or context is NULL
@@ -41,21 +48,19 @@ static void monitored_ram_write(memory_t *mem, uint16_t addr, uint8_t data)
             break;
 
         case MONITORED_ADDR_TEST_STATUS:
+            ram->test_status = data;
+            if (ram->stop_on_test_status)
+            {
+                cpu_request_stop(ram->cpu);
+            }
+
             if (data == 0x00)
             {
-                const char *message = "6502 FUNCTIONAL TEST PASSED\n";
-                for (size_t i = 0; message[i] != '\0'; i++)
-                {
-                    queue_enqueue(&ram->cpu->output_queue, (uint8_t)message[i]);
-                }
+                monitored_ram_send(ram, "6502 FUNCTIONAL TEST PASSED\n");
             }
             else
             {
-                const char *message = "6502 FUNCTIONAL TEST FAILED\n";
-                for (size_t i = 0; message[i] != '\0'; i++)
-                {
-                    queue_enqueue(&ram->cpu->output_queue, (uint8_t)message[i]);
-                }
+                monitored_ram_send(ram, "6502 FUNCTIONAL TEST FAILED\n");
             }
             break;
 
@@ -63,22 +68,14 @@ static void monitored_ram_write(memory_t *mem, uint16_t addr, uint8_t data)
             // Display additional test results
             if (data == 0x00)
             {
-                const char *message = "ADDITIONAL TEST PASSED\n";
-                for (size_t i = 0; message[i] != '\0'; i++)
-                {
-                    queue_enqueue(&ram->cpu->output_queue, (uint8_t)message[i]);
-                }
+                monitored_ram_send(ram, "ADDITIONAL TEST PASSED\n");
             }
             else
             {
                 char formatted_message[100];
                 snprintf(formatted_message, sizeof(formatted_message),
                          "ADDITIONAL TEST FAILED: CODE 0x%02X\n", data);
-                for (size_t i = 0; formatted_message[i] != '\0'; i++)
-                {
-                    queue_enqueue(&ram->cpu->output_queue,
-                                  (uint8_t)formatted_message[i]);
-                }
+                monitored_ram_send(ram, formatted_message);
             }
             break;
 
@@ -88,6 +85,22 @@ static void monitored_ram_write(memory_t *mem, uint16_t addr, uint8_t data)
     }
 }
 
+static uint8_t *monitored_ram_page_pointer(memory_t *mem, uint16_t addr,
+                                           bool write)
+{
+    monitored_ram_t *ram = (monitored_ram_t *)mem->context;
+
+    // Pages smaller than the mirror size would wrap inside the page
+    if (ram->size < 0x100)
+        return NULL;
+
+    // Writes to the page holding the monitored addresses need the handler
+    if (write && (addr >> 8) == (MONITORED_ADDR_OUTPUT_CHAR >> 8))
+        return NULL;
+
+    return &ram->data[addr & (ram->size - 1)];
+}
+
 memory_t *memory_create_monitored_ram(size_t size, cpu_6502_t *cpu)
 {
     // Check if the size is a power of two
@@ -125,6 +138,8 @@ memory_t *memory_create_monitored_ram(size_t size, cpu_6502_t *cpu)
     memset(ram->data, 0, size);
     ram->size = size;
     ram->cpu = cpu;
+    ram->test_status = -1;
+    ram->stop_on_test_status = false;
 
     // Create the memory structure
     memory_t *memory = malloc(sizeof(memory_t));
@@ -142,7 +157,11 @@ memory_t *memory_create_monitored_ram(size_t size, cpu_6502_t *cpu)
     // Initialize the memory structure
     memory->read = monitored_ram_read;
     memory->write = monitored_ram_write;
+    memory->page_pointer = monitored_ram_page_pointer;
     memory->context = ram;
+    memory->peek = NULL;
+    memory->save_state = NULL;
+    memory->restore_state = NULL;
 
     return memory;
 }
@@ -3,6 +3,7 @@
 
 #include <stddef.h>   // For size_t
 #include <stdint.h>   // For uint8_t, uint16_t
+#include <stdbool.h>  // For bool
 #include "cpu_6502.h" // Include the CPU structure
 #include "memory.h"   // Include the memory interface
 
@@ -22,6 +23,10 @@ typedef struct
     size_t size;     /**< Size of the memory in bytes. */
     cpu_6502_t *cpu; /**< Pointer to the CPU structure for interacting with the
                         output queue. */
+    int test_status; /**< Last byte written to MONITORED_ADDR_TEST_STATUS, or
+                        -1 if none was. */
+    bool stop_on_test_status; /**< Request a CPU stop when the test status
+                                 is written (batch runs). */
 } monitored_ram_t;
 
 /**
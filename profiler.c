@@ -0,0 +1,349 @@
+// profiler.c
+#include <stdlib.h>
+#include <string.h>
+#include "profiler.h"
+
+#define CHILD_SLOTS (PROFILER_MAX_NODES * 2) // Power of two, half full at most
+
+/* Lifetime */
+
+/* Creates an empty profiler */
+profiler_t *profiler_create(void)
+{
+    profiler_t *profiler = calloc(1, sizeof(*profiler));
+
+    if (!profiler)
+        goto fail;
+
+    profiler->nodes = malloc(PROFILER_MAX_NODES * sizeof(profile_node_t));
+    profiler->children = malloc(CHILD_SLOTS * sizeof(uint32_t));
+
+    if (!profiler->nodes || !profiler->children)
+        goto fail;
+
+    profiler_reset(profiler);
+    return profiler;
+
+fail:
+    fprintf(stderr, "profiler_create: Failed to allocate profiler.\n");
+    profiler_destroy(profiler);
+    return NULL;
+}
+
+/* Frees a profiler */
+void profiler_destroy(profiler_t *profiler)
+{
+    if (!profiler)
+        return;
+
+    free(profiler->nodes);
+    free(profiler->children);
+    free(profiler);
+}
+
+/* Clears every count and the shadow stack */
+void profiler_reset(profiler_t *profiler)
+{
+    if (!profiler)
+        return;
+
+    memset(profiler->pc, 0, sizeof(profiler->pc));
+    memset(profiler->opcode, 0, sizeof(profiler->opcode));
+    memset(profiler->children, 0, CHILD_SLOTS * sizeof(uint32_t));
+    profiler->instructions = 0;
+    profiler->cycles = 0;
+    profiler->entry_cycles = 0;
+
+    profiler->nodes[0] = (profile_node_t){0, 0, PROFILER_FRAME_ROOT, 1, 0};
+    profiler->node_count = 1;
+
+    profiler->stack[0] = (profile_frame_t){0, 0};
+    profiler->depth = 1;
+    profiler->current = 0;
+}
+
+/* Shadow Stack */
+
+/* The node for a frame called from parent, created if new. Returns parent
+ * itself once the tree is full. */
+static uint32_t child_node(profiler_t *profiler, uint32_t parent,
+                           uint8_t kind, uint16_t entry)
+{
+    uint32_t key = (uint32_t)kind << 16 | entry;
+    uint32_t slot = (parent * 2654435761u ^ key * 40503u) & (CHILD_SLOTS - 1);
+
+    for (;; slot = (slot + 1) & (CHILD_SLOTS - 1))
+    {
+        uint32_t index = profiler->children[slot];
+
+        if (index == 0)
+            break;
+
+        const profile_node_t *node = &profiler->nodes[index - 1];
+
+        if (node->parent == parent && node->kind == kind &&
+            node->entry == entry)
+            return index - 1;
+    }
+
+    if (profiler->node_count == PROFILER_MAX_NODES)
+        return parent;
+
+    uint32_t index = profiler->node_count++;
+
+    profiler->nodes[index] = (profile_node_t){parent, entry, kind, 0, 0};
+    profiler->children[slot] = index + 1;
+    return index;
+}
+
+/* Enter a frame that returns once SP is back at return_sp */
+static void push_frame(profiler_t *profiler, uint8_t kind, uint16_t entry,
+                       uint8_t return_sp)
+{
+    if (profiler->depth == PROFILER_STACK_DEPTH)
+        return; // Counted in the deepest frame
+
+    uint32_t node = child_node(profiler, profiler->current, kind, entry);
+
+    profiler->nodes[node].calls++;
+    profiler->stack[profiler->depth++] = (profile_frame_t){node, return_sp};
+    profiler->current = node;
+}
+
+/* Leave every frame whose return address is now off the stack */
+static void pop_frames(profiler_t *profiler, uint8_t sp)
+{
+    while (profiler->depth > 1 &&
+           profiler->stack[profiler->depth - 1].sp <= sp)
+        profiler->depth--;
+
+    profiler->current = profiler->stack[profiler->depth - 1].node;
+}
+
+/* Follows a call, return or interrupt */
+void profiler_flow(profiler_t *profiler, uint8_t opcode, uint16_t pc,
+                   uint8_t sp)
+{
+    switch (opcode)
+    {
+    case 0x20: // JSR pushed the return address
+        push_frame(profiler, PROFILER_FRAME_CALL, pc, (uint8_t)(sp + 2));
+        break;
+    case 0x00: // BRK pushed it and P
+        push_frame(profiler, PROFILER_FRAME_BRK, pc, (uint8_t)(sp + 3));
+        break;
+    default: // RTS, RTI
+        pop_frames(profiler, sp);
+        break;
+    }
+}
+
+/* Counts an interrupt entry */
+void profiler_interrupt(profiler_t *profiler, bool nmi, uint16_t handler,
+                        uint8_t sp, uint32_t cycles)
+{
+    push_frame(profiler, nmi ? PROFILER_FRAME_NMI : PROFILER_FRAME_IRQ,
+               handler, (uint8_t)(sp + 3));
+
+    profiler->cycles += cycles;
+    profiler->entry_cycles += cycles;
+    profiler->nodes[profiler->current].self_cycles += cycles;
+}
+
+/* Reports */
+
+/* Works out every node's inclusive cycles */
+uint64_t *profiler_inclusive_cycles(const profiler_t *profiler)
+{
+    uint64_t *inclusive = malloc(profiler->node_count * sizeof(uint64_t));
+
+    if (!inclusive)
+        return NULL;
+
+    for (uint32_t i = 0; i < profiler->node_count; i++)
+        inclusive[i] = profiler->nodes[i].self_cycles;
+
+    // Children are created after their parents: one backward pass adds
+    // every subtree into its root
+    for (uint32_t i = profiler->node_count - 1; i > 0; i--)
+        inclusive[profiler->nodes[i].parent] += inclusive[i];
+
+    return inclusive;
+}
+
+/* Name of a frame: "root", "sub_C010", "irq_FF40"... */
+static void frame_name(const profile_node_t *node, char *buffer, size_t size)
+{
+    static const char *const prefixes[] = {"root", "sub", "irq", "nmi", "brk"};
+
+    if (node->kind == PROFILER_FRAME_ROOT)
+        snprintf(buffer, size, "root");
+    else
+        snprintf(buffer, size, "%s_%04X", prefixes[node->kind], node->entry);
+}
+
+/* Writes a node's frames, callers first */
+static void write_chain(const profiler_t *profiler, uint32_t node,
+                        const char *separator, FILE *file)
+{
+    uint32_t chain[PROFILER_STACK_DEPTH]; // No deeper than the stack
+    int length = 0;
+    char name[16];
+
+    // Walk up to the root, then print back down
+    for (uint32_t n = node; n != 0; n = profiler->nodes[n].parent)
+        chain[length++] = n;
+
+    fprintf(file, "root");
+    while (length > 0)
+    {
+        frame_name(&profiler->nodes[chain[--length]], name, sizeof(name));
+        fprintf(file, "%s%s", separator, name);
+    }
+}
+
+/* Share of the total, in percent */
+static double percent(uint64_t part, uint64_t total)
+{
+    return total ? 100.0 * (double)part / (double)total : 0.0;
+}
+
+/* Sort helpers: indices by descending cycles */
+static const profile_count_t *sort_counts;
+static const uint64_t *sort_cycles;
+
+static int by_count_cycles(const void *a, const void *b)
+{
+    uint64_t x = sort_counts[*(const uint32_t *)a].cycles;
+    uint64_t y = sort_counts[*(const uint32_t *)b].cycles;
+
+    return (x < y) - (x > y);
+}
+
+static int by_inclusive_cycles(const void *a, const void *b)
+{
+    uint64_t x = sort_cycles[*(const uint32_t *)a];
+    uint64_t y = sort_cycles[*(const uint32_t *)b];
+
+    return (x < y) - (x > y);
+}
+
+/* Indices of the entries with any instructions, most cycles first */
+static uint32_t sorted_counts(const profile_count_t *counts, uint32_t count,
+                              uint32_t *order)
+{
+    uint32_t used = 0;
+
+    for (uint32_t i = 0; i < count; i++)
+        if (counts[i].instructions)
+            order[used++] = i;
+
+    sort_counts = counts;
+    qsort(order, used, sizeof(*order), by_count_cycles);
+    return used;
+}
+
+/* Writes the text report */
+void profiler_report(const profiler_t *profiler, FILE *file, int rows)
+{
+    if (!profiler || !file)
+        return;
+
+    if (rows <= 0)
+        rows = PROFILER_REPORT_ROWS;
+
+    uint64_t total = profiler->cycles;
+    uint32_t *order = malloc(65536 * sizeof(uint32_t)); // >= node_count
+    uint64_t *inclusive = profiler_inclusive_cycles(profiler);
+
+    if (!order || !inclusive)
+    {
+        fprintf(stderr, "profiler_report: Out of memory.\n");
+        free(order);
+        free(inclusive);
+        return;
+    }
+
+    fprintf(file,
+            "Profile: %llu instructions, %llu cycles (%llu in interrupt "
+            "entries), %u call chains\n",
+            (unsigned long long)profiler->instructions,
+            (unsigned long long)total,
+            (unsigned long long)profiler->entry_cycles,
+            (unsigned)profiler->node_count);
+
+    uint32_t used = sorted_counts(profiler->pc, 65536, order);
+
+    fprintf(file, "\nHottest addresses:\n"
+                  "  PC     Instructions        Cycles      %%\n");
+
+    for (uint32_t i = 0; i < used && i < (uint32_t)rows; i++)
+    {
+        const profile_count_t *count = &profiler->pc[order[i]];
+
+        fprintf(file, "  $%04X  %12llu  %12llu  %5.1f\n", (unsigned)order[i],
+                (unsigned long long)count->instructions,
+                (unsigned long long)count->cycles,
+                percent(count->cycles, total));
+    }
+
+    used = sorted_counts(profiler->opcode, 256, order);
+
+    fprintf(file, "\nOpcodes:\n"
+                  "  Op   Name  Instructions        Cycles      %%\n");
+
+    for (uint32_t i = 0; i < used && i < (uint32_t)rows; i++)
+    {
+        const profile_count_t *count = &profiler->opcode[order[i]];
+
+        fprintf(file, "  $%02X  %-4s  %12llu  %12llu  %5.1f\n",
+                (unsigned)order[i], cpu_opcode_mnemonic((uint8_t)order[i]),
+                (unsigned long long)count->instructions,
+                (unsigned long long)count->cycles,
+                percent(count->cycles, total));
+    }
+
+    for (uint32_t i = 0; i < profiler->node_count; i++)
+        order[i] = i;
+    sort_cycles = inclusive;
+    qsort(order, profiler->node_count, sizeof(*order), by_inclusive_cycles);
+
+    fprintf(file, "\nCall graph by inclusive cycles:\n"
+                  "     Inclusive      %%          Self       Calls  "
+                  "Chain\n");
+
+    for (uint32_t i = 0; i < profiler->node_count && i < (uint32_t)rows; i++)
+    {
+        const profile_node_t *node = &profiler->nodes[order[i]];
+
+        fprintf(file, "  %12llu  %5.1f  %12llu  %10llu  ",
+                (unsigned long long)inclusive[order[i]],
+                percent(inclusive[order[i]], total),
+                (unsigned long long)node->self_cycles,
+                (unsigned long long)node->calls);
+
+        write_chain(profiler, order[i], " > ", file);
+        fputc('\n', file);
+    }
+
+    free(order);
+    free(inclusive);
+}
+
+/* Writes the call chains in folded-stack format */
+void profiler_write_folded(const profiler_t *profiler, FILE *file)
+{
+    if (!profiler || !file)
+        return;
+
+    for (uint32_t i = 0; i < profiler->node_count; i++)
+    {
+        const profile_node_t *node = &profiler->nodes[i];
+
+        if (!node->self_cycles)
+            continue;
+
+        write_chain(profiler, i, ";", file);
+        fprintf(file, " %llu\n", (unsigned long long)node->self_cycles);
+    }
+}
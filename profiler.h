@@ -0,0 +1,195 @@
+// profiler.h
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "cpu_6502.h"
+
+/*
+ * Cycle profiler.
+ *
+ * With a profiler set (cpu_set_profiler), the CPU counts every instruction
+ * it executes and the cycles it took, by address (a 64K-entry array) and by
+ * opcode (256 entries). Interrupt entry cycles are counted against the
+ * handler.
+ *
+ * It also keeps a shadow stack of the guest's calls: JSR, BRK and interrupt
+ * entries push a frame, RTS and RTI pop the frames they return from. Frames
+ * are matched by stack pointer rather than one per return, so code that
+ * pushes a return address and jumps with RTS, or drops frames with TXS,
+ * keeps the shadow stack in step. Each distinct chain of frames is a node
+ * of a calling-context tree holding the cycles spent in it; a node's
+ * inclusive cycles are its own plus its children's.
+ *
+ * profiler_report() writes a text report: totals, hottest addresses,
+ * opcodes, and the call tree by inclusive cycles. profiler_write_folded()
+ * writes one line per call chain, "root;sub_C010;sub_C200 1234", the input
+ * of flamegraph.pl and compatible tools.
+ *
+ * Profiling goes through the interpreter, like tracing; the predecoded and
+ * JIT engines have no profiling code at all, so with no profiler set they
+ * run exactly as before and the interpreter pays one pointer test per
+ * instruction. Idle loops are not fast-forwarded while a profiler is set:
+ * their iterations are counted like any others.
+ */
+
+#define PROFILER_STACK_DEPTH 256    // Shadow stack frames; deeper calls are
+                                    // counted in the deepest frame
+#define PROFILER_MAX_NODES 65536    // Call chains kept; later ones are
+                                    // counted in their caller
+#define PROFILER_REPORT_ROWS 20     // Rows per table in the text report
+
+/* Kind of frame */
+#define PROFILER_FRAME_ROOT 0
+#define PROFILER_FRAME_CALL 1 // JSR
+#define PROFILER_FRAME_IRQ 2
+#define PROFILER_FRAME_NMI 3
+#define PROFILER_FRAME_BRK 4
+
+/* Counts for one address or opcode */
+typedef struct
+{
+    uint64_t instructions;
+    uint64_t cycles;
+} profile_count_t;
+
+/* A call chain: its caller's chain plus one frame */
+typedef struct
+{
+    uint32_t parent; // Node index; the root is its own parent
+    uint16_t entry;  // Address called or vectored to
+    uint8_t kind;    // PROFILER_FRAME_*
+    uint64_t calls;
+    uint64_t self_cycles;
+} profile_node_t;
+
+/* A frame on the shadow stack */
+typedef struct
+{
+    uint32_t node;
+    uint8_t sp; // SP once the frame has returned
+} profile_frame_t;
+
+/* Profiler */
+typedef struct profiler
+{
+    profile_count_t pc[65536];
+    profile_count_t opcode[256];
+    uint64_t instructions, cycles;
+    uint64_t entry_cycles; // Interrupt entries, included in cycles
+
+    /* Calling-context tree; node 0 is the root */
+    profile_node_t *nodes;
+    uint32_t node_count;
+    uint32_t *children; // Hash of (parent, kind, entry) to node index + 1
+
+    /* Shadow stack; stack[0] is the root frame */
+    profile_frame_t stack[PROFILER_STACK_DEPTH];
+    int depth;
+    uint32_t current; // Node of the top frame
+} profiler_t;
+
+/**
+ * @brief Creates an empty profiler.
+ *
+ * @return Pointer to the profiler, or NULL on failure.
+ */
+profiler_t *profiler_create(void);
+
+/**
+ * @brief Frees a profiler. Detach it from the CPU first.
+ *
+ * @param profiler Pointer to the profiler.
+ */
+void profiler_destroy(profiler_t *profiler);
+
+/**
+ * @brief Clears every count and the shadow stack.
+ *
+ * @param profiler Pointer to the profiler.
+ */
+void profiler_reset(profiler_t *profiler);
+
+/**
+ * @brief Follows a change of control flow: a call, return or interrupt.
+ * Called by profiler_count() for BRK, JSR, RTI and RTS.
+ *
+ * @param profiler Pointer to the profiler.
+ * @param opcode The instruction that ran.
+ * @param pc PC after it.
+ * @param sp SP after it.
+ */
+void profiler_flow(profiler_t *profiler, uint8_t opcode, uint16_t pc,
+                   uint8_t sp);
+
+/**
+ * @brief Counts an interrupt entry: pushes a frame for the handler and
+ * counts the entry cycles against it. CPU thread only.
+ *
+ * @param profiler Pointer to the profiler.
+ * @param nmi true for an NMI, false for an IRQ.
+ * @param handler Address vectored to.
+ * @param sp SP after the entry pushed PC and P.
+ * @param cycles Cycles the entry took.
+ */
+void profiler_interrupt(profiler_t *profiler, bool nmi, uint16_t handler,
+                        uint8_t sp, uint32_t cycles);
+
+/**
+ * @brief Counts an executed instruction. CPU thread only.
+ *
+ * @param profiler Pointer to the profiler.
+ * @param pc Address of the instruction.
+ * @param opcode Its opcode.
+ * @param cycles Cycles it took.
+ * @param next_pc PC after it.
+ * @param sp SP after it.
+ */
+static inline void profiler_count(profiler_t *profiler, uint16_t pc,
+                                  uint8_t opcode, uint32_t cycles,
+                                  uint16_t next_pc, uint8_t sp)
+{
+    profiler->pc[pc].instructions++;
+    profiler->pc[pc].cycles += cycles;
+    profiler->opcode[opcode].instructions++;
+    profiler->opcode[opcode].cycles += cycles;
+    profiler->instructions++;
+    profiler->cycles += cycles;
+    profiler->nodes[profiler->current].self_cycles += cycles;
+
+    // BRK $00, JSR $20, RTI $40 and RTS $60 are the only opcodes with
+    // these bits clear
+    if ((opcode & 0x9F) == 0)
+        profiler_flow(profiler, opcode, next_pc, sp);
+}
+
+/**
+ * @brief Works out every node's cycles plus those of the chains it called.
+ *
+ * @param profiler Pointer to the profiler.
+ * @return Array of node_count inclusive cycle counts, to be freed by the
+ * caller, or NULL on failure.
+ */
+uint64_t *profiler_inclusive_cycles(const profiler_t *profiler);
+
+/**
+ * @brief Writes the text report.
+ *
+ * @param profiler Pointer to the profiler.
+ * @param file Where it goes.
+ * @param rows Rows per table (0 for PROFILER_REPORT_ROWS).
+ */
+void profiler_report(const profiler_t *profiler, FILE *file, int rows);
+
+/**
+ * @brief Writes the call chains in folded-stack format, one
+ * "frame;frame;... cycles" line per chain with cycles of its own.
+ *
+ * @param profiler Pointer to the profiler.
+ * @param file Where it goes.
+ */
+void profiler_write_folded(const profiler_t *profiler, FILE *file);
+
+#endif // PROFILER_H
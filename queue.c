@@ -1,78 +1,222 @@
-#include <pthread.h>
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L // clock_gettime
+#endif
+
+#include <string.h>
+#include <time.h>
 #include "queue.h"
 
 /* Initialize the queue */
 void queue_init(queue_t *q)
 {
-    q->head = 0;
-    q->tail = 0;
-    q->count = 0;
+    atomic_init(&q->tail, 0);
+    atomic_init(&q->head, 0);
+    q->head_cache = 0;
+    q->tail_cache = 0;
+
+    atomic_init(&q->consumer_waiting, false);
+    pthread_mutex_init(&q->wait_mutex, NULL);
+    pthread_cond_init(&q->wait_cond, NULL);
+}
+
+/* Publish a new tail and wake the consumer if it is parked */
+static void queue_publish(queue_t *q, size_t tail)
+{
+    atomic_store_explicit(&q->tail, tail, memory_order_release);
+
+    // Pairs with the fence in queue_wait: either the consumer sees the new
+    // tail before sleeping, or we see its waiting flag here
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&q->consumer_waiting, memory_order_relaxed))
+    {
+        pthread_mutex_lock(&q->wait_mutex);
+        pthread_cond_signal(&q->wait_cond);
+        pthread_mutex_unlock(&q->wait_mutex);
+    }
+}
+
+/* Copy n bytes into the ring starting at a free-running index */
+static void ring_copy_in(queue_t *q, size_t index, const uint8_t *bytes,
+                         size_t n)
+{
+    size_t offset = index & QUEUE_MASK;
+    size_t first = QUEUE_SIZE - offset;
+
+    if (first > n)
+        first = n;
+
+    memcpy(&q->data[offset], bytes, first);
+    memcpy(q->data, bytes + first, n - first);
+}
+
+/* Copy n bytes out of the ring starting at a free-running index */
+static void ring_copy_out(queue_t *q, size_t index, uint8_t *bytes, size_t n)
+{
+    size_t offset = index & QUEUE_MASK;
+    size_t first = QUEUE_SIZE - offset;
+
+    if (first > n)
+        first = n;
 
-    pthread_mutex_init(&q->mutex, NULL);
+    memcpy(bytes, &q->data[offset], first);
+    memcpy(bytes + first, q->data, n - first);
+}
+
+/* Enqueue up to n bytes */
+size_t queue_enqueue_n(queue_t *q, const uint8_t *bytes, size_t n)
+{
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    size_t space = QUEUE_SIZE - (tail - q->head_cache);
+
+    // Only look at the consumer's index when the cached view is too full
+    if (space < n)
+    {
+        q->head_cache = atomic_load_explicit(&q->head, memory_order_acquire);
+        space = QUEUE_SIZE - (tail - q->head_cache);
+    }
+
+    if (n > space)
+        n = space;
+    if (n == 0)
+        return 0; // Queue full
+
+    ring_copy_in(q, tail, bytes, n);
+    queue_publish(q, tail + n);
+
+    return n;
 }
 
 /* Enqueue a byte */
 bool queue_enqueue(queue_t *q, uint8_t byte)
 {
-    pthread_mutex_lock(&q->mutex);
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
 
-    if (q->count == QUEUE_SIZE)
+    if (tail - q->head_cache == QUEUE_SIZE)
     {
-        pthread_mutex_unlock(&q->mutex);
-        return false; // Queue full
+        q->head_cache = atomic_load_explicit(&q->head, memory_order_acquire);
+        if (tail - q->head_cache == QUEUE_SIZE)
+            return false; // Queue full
     }
 
-    q->data[q->tail] = byte;
-    q->tail = (q->tail + 1) % QUEUE_SIZE;
-    q->count++;
-
-    pthread_mutex_unlock(&q->mutex);
+    q->data[tail & QUEUE_MASK] = byte;
+    queue_publish(q, tail + 1);
 
     return true;
 }
 
+/* Dequeue up to max bytes */
+size_t queue_dequeue_n(queue_t *q, uint8_t *bytes, size_t max)
+{
+    size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    size_t available = q->tail_cache - head;
+
+    // Only look at the producer's index when the cached view runs short
+    if (available < max)
+    {
+        q->tail_cache = atomic_load_explicit(&q->tail, memory_order_acquire);
+        available = q->tail_cache - head;
+    }
+
+    if (max > available)
+        max = available;
+    if (max == 0)
+        return 0; // Queue empty
+
+    ring_copy_out(q, head, bytes, max);
+    atomic_store_explicit(&q->head, head + max, memory_order_release);
+
+    return max;
+}
+
 /* Dequeue a byte */
 bool queue_dequeue(queue_t *q, uint8_t *byte)
 {
-    pthread_mutex_lock(&q->mutex);
+    size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
 
-    if (q->count == 0)
+    if (head == q->tail_cache)
     {
-        pthread_mutex_unlock(&q->mutex);
-        return false; // Queue empty
+        q->tail_cache = atomic_load_explicit(&q->tail, memory_order_acquire);
+        if (head == q->tail_cache)
+            return false; // Queue empty
     }
 
-    *byte = q->data[q->head];
-    q->head = (q->head + 1) % QUEUE_SIZE;
-    q->count--;
-
-    pthread_mutex_unlock(&q->mutex);
+    *byte = q->data[head & QUEUE_MASK];
+    atomic_store_explicit(&q->head, head + 1, memory_order_release);
 
     return true;
 }
 
-/* Check if queue is empty */
-bool queue_is_empty(queue_t *q)
+/* Read the next byte without consuming it */
+bool queue_peek(queue_t *q, uint8_t *byte)
 {
-    pthread_mutex_lock(&q->mutex);
+    size_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
 
-    bool empty = (q->count == 0);
+    if (head == tail)
+        return false; // Queue empty
+
+    *byte = q->data[head & QUEUE_MASK];
+    return true;
+}
 
-    pthread_mutex_unlock(&q->mutex);
+/* Number of bytes currently queued */
+size_t queue_count(queue_t *q)
+{
+    size_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+
+    // A reader outside both sides can see head move past its tail snapshot
+    return (tail - head <= QUEUE_SIZE) ? tail - head : 0;
+}
 
-    return empty;
+/* Check if queue is empty */
+bool queue_is_empty(queue_t *q)
+{
+    return queue_count(q) == 0;
 }
 
 /* Clear the queue */
 void queue_clear(queue_t *q)
 {
-    pthread_mutex_lock(&q->mutex);
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+
+    q->tail_cache = tail;
+    atomic_store_explicit(&q->head, tail, memory_order_release);
+}
+
+/* Block until data is queued or the timeout elapses */
+bool queue_wait(queue_t *q, unsigned int timeout_ms)
+{
+    size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+
+    if (atomic_load_explicit(&q->tail, memory_order_acquire) != head)
+        return true;
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&q->wait_mutex);
+    atomic_store_explicit(&q->consumer_waiting, true, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+
+    int rc = 0;
+    while (atomic_load_explicit(&q->tail, memory_order_acquire) == head &&
+           rc == 0)
+    {
+        rc = pthread_cond_timedwait(&q->wait_cond, &q->wait_mutex, &deadline);
+    }
 
-    q->head = 0;
-    q->tail = 0;
-    q->count = 0;
+    atomic_store_explicit(&q->consumer_waiting, false, memory_order_relaxed);
+    pthread_mutex_unlock(&q->wait_mutex);
 
-    pthread_mutex_unlock(&q->mutex);
+    return atomic_load_explicit(&q->tail, memory_order_acquire) != head;
 }
 
 /* Destroy the queue */
@@ -81,5 +225,6 @@ void queue_destroy(queue_t *q)
     if (!q)
         return;
 
-    pthread_mutex_destroy(&q->mutex);
+    pthread_cond_destroy(&q->wait_cond);
+    pthread_mutex_destroy(&q->wait_mutex);
 }
@@ -2,35 +2,87 @@
 #define QUEUE_H
 
 #include <stdint.h>
+#include <stddef.h>
 #include <stdbool.h>
+#include <stdatomic.h>
 #include <pthread.h>
 
-#define QUEUE_SIZE 1024
+/*
+ * Single-producer/single-consumer byte ring.
+ *
+ * Exactly one thread may enqueue and exactly one thread may dequeue; no locks
+ * are taken on either side. head and tail are free-running counters masked
+ * into the buffer, so the capacity must be a power of two. Each side keeps
+ * its index on its own cache line, along with a cached copy of the other
+ * side's index, so the hot path only touches shared state when the cached
+ * view says the ring is full (producer) or empty (consumer).
+ *
+ * A consumer that runs out of data can block in queue_wait(). The producer
+ * only pays for a wakeup when the consumer has announced it is waiting,
+ * which can only happen while the ring is empty.
+ */
+
+#define QUEUE_SIZE 1024 // Capacity in bytes, must be a power of two
+#define QUEUE_MASK (QUEUE_SIZE - 1)
+#define QUEUE_CACHE_LINE 64
+
+#if (QUEUE_SIZE & QUEUE_MASK) != 0
+#error "QUEUE_SIZE must be a power of two"
+#endif
 
 typedef struct
 {
+    // Producer side
+    atomic_size_t tail;     // Next slot to write
+    size_t head_cache;      // Producer's last view of head
+    uint8_t pad_producer[QUEUE_CACHE_LINE - sizeof(atomic_size_t) -
+                         sizeof(size_t)];
+
+    // Consumer side
+    atomic_size_t head;     // Next slot to read
+    size_t tail_cache;      // Consumer's last view of tail
+    uint8_t pad_consumer[QUEUE_CACHE_LINE - sizeof(atomic_size_t) -
+                         sizeof(size_t)];
+
     uint8_t data[QUEUE_SIZE];
-    int head;
-    int tail;
-    int count;
-    pthread_mutex_t mutex;
+
+    // Consumer wakeup, only touched when the ring runs empty
+    atomic_bool consumer_waiting;
+    pthread_mutex_t wait_mutex;
+    pthread_cond_t wait_cond;
 } queue_t;
 
 /* Initialize the queue */
 void queue_init(queue_t *q);
 
-/* Enqueue a byte */
+/* Enqueue a byte (producer only) */
 bool queue_enqueue(queue_t *q, uint8_t byte);
 
-/* Dequeue a byte */
+/* Enqueue up to n bytes, returns how many fit (producer only) */
+size_t queue_enqueue_n(queue_t *q, const uint8_t *bytes, size_t n);
+
+/* Dequeue a byte (consumer only) */
 bool queue_dequeue(queue_t *q, uint8_t *byte);
 
+/* Dequeue up to max bytes, returns how many were read (consumer only) */
+size_t queue_dequeue_n(queue_t *q, uint8_t *bytes, size_t max);
+
+/* Read the next byte without consuming it (consumer only) */
+bool queue_peek(queue_t *q, uint8_t *byte);
+
+/* Number of bytes currently queued (a snapshot) */
+size_t queue_count(queue_t *q);
+
 /* Check if queue is empty */
 bool queue_is_empty(queue_t *q);
 
-/* Clear the queue */
+/* Drop everything queued (consumer only, or while the consumer is idle) */
 void queue_clear(queue_t *q);
 
+/* Block the consumer until data is queued or timeout_ms elapses.
+   Returns true if the queue is non-empty (consumer only) */
+bool queue_wait(queue_t *q, unsigned int timeout_ms);
+
 /* Destroy the queue */
 void queue_destroy(queue_t *q);
 
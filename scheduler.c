@@ -0,0 +1,163 @@
+// scheduler.c
+#include <string.h>
+#include "scheduler.h"
+
+/* Whether event a is due before event b */
+static inline bool event_before(const scheduled_event_t *a,
+                                const scheduled_event_t *b)
+{
+    return a->cycle < b->cycle || (a->cycle == b->cycle && a->order < b->order);
+}
+
+static void swap_events(scheduler_t *scheduler, int i, int j)
+{
+    scheduled_event_t tmp = scheduler->heap[i];
+    scheduler->heap[i] = scheduler->heap[j];
+    scheduler->heap[j] = tmp;
+}
+
+static void sift_up(scheduler_t *scheduler, int i)
+{
+    while (i > 0)
+    {
+        int parent = (i - 1) / 2;
+
+        if (!event_before(&scheduler->heap[i], &scheduler->heap[parent]))
+            break;
+
+        swap_events(scheduler, i, parent);
+        i = parent;
+    }
+}
+
+static void sift_down(scheduler_t *scheduler, int i)
+{
+    for (;;)
+    {
+        int first = i;
+        int left = 2 * i + 1;
+        int right = left + 1;
+
+        if (left < scheduler->count &&
+            event_before(&scheduler->heap[left], &scheduler->heap[first]))
+            first = left;
+        if (right < scheduler->count &&
+            event_before(&scheduler->heap[right], &scheduler->heap[first]))
+            first = right;
+
+        if (first == i)
+            break;
+
+        swap_events(scheduler, i, first);
+        i = first;
+    }
+}
+
+/* Refresh the cached cycle of the earliest event */
+static inline void update_next_cycle(scheduler_t *scheduler)
+{
+    scheduler->next_cycle =
+        scheduler->count ? scheduler->heap[0].cycle : UINT64_MAX;
+}
+
+/* Remove the event at heap index i */
+static void remove_at(scheduler_t *scheduler, int i)
+{
+    scheduler->count--;
+
+    if (i != scheduler->count)
+    {
+        scheduler->heap[i] = scheduler->heap[scheduler->count];
+        sift_up(scheduler, i);
+        sift_down(scheduler, i);
+    }
+
+    update_next_cycle(scheduler);
+}
+
+/* Empties the timeline */
+void scheduler_init(scheduler_t *scheduler)
+{
+    if (!scheduler)
+        return;
+
+    memset(scheduler, 0, sizeof(*scheduler));
+    scheduler->next_cycle = UINT64_MAX;
+    scheduler->next_id = SCHEDULER_NO_EVENT + 1;
+}
+
+/* Schedules a callback at an absolute cycle */
+uint32_t scheduler_add(scheduler_t *scheduler, uint64_t cycle,
+                       scheduler_callback_t callback, void *context)
+{
+    if (!scheduler || !callback || scheduler->count == SCHEDULER_MAX_EVENTS)
+        return SCHEDULER_NO_EVENT;
+
+    uint32_t id = scheduler->next_id++;
+
+    if (scheduler->next_id == SCHEDULER_NO_EVENT)
+        scheduler->next_id++; // Skip the reserved id on wrap-around
+
+    scheduler->heap[scheduler->count] = (scheduled_event_t){
+        .cycle = cycle,
+        .order = scheduler->next_order++,
+        .id = id,
+        .callback = callback,
+        .context = context,
+    };
+
+    sift_up(scheduler, scheduler->count++);
+    update_next_cycle(scheduler);
+
+    return id;
+}
+
+/* Removes a pending event */
+bool scheduler_cancel(scheduler_t *scheduler, uint32_t id)
+{
+    if (!scheduler || id == SCHEDULER_NO_EVENT)
+        return false;
+
+    for (int i = 0; i < scheduler->count; i++)
+    {
+        if (scheduler->heap[i].id == id)
+        {
+            remove_at(scheduler, i);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* Runs every event due at or before now, earliest first */
+void scheduler_run_due(scheduler_t *scheduler, uint64_t now)
+{
+    while (scheduler->count && scheduler->heap[0].cycle <= now)
+    {
+        scheduled_event_t event = scheduler->heap[0];
+
+        // Off the heap before the callback, which may schedule again
+        remove_at(scheduler, 0);
+        event.callback(event.context, event.cycle);
+    }
+}
+
+/* Moves every pending event to a new time base */
+void scheduler_rebase(scheduler_t *scheduler, uint64_t old_now,
+                      uint64_t new_now)
+{
+    if (!scheduler)
+        return;
+
+    // Monotonic in cycle, so the heap order still holds
+    for (int i = 0; i < scheduler->count; i++)
+    {
+        scheduled_event_t *event = &scheduler->heap[i];
+        uint64_t left = (event->cycle > old_now) ? event->cycle - old_now : 0;
+
+        event->cycle = new_now + left;
+    }
+
+    update_next_cycle(scheduler);
+}
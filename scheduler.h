@@ -0,0 +1,102 @@
+// scheduler.h
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Cycle-scheduled event timeline.
+ *
+ * Devices and timers register callbacks keyed by an absolute cycle_count.
+ * The events live in a binary min-heap ordered by cycle (ties in the order
+ * they were scheduled), and next_cycle caches the earliest one, so the CPU
+ * only compares cycle_count against it between instructions and pays
+ * nothing else while no event is due. A due event is run on the CPU thread
+ * at the first instruction boundary at or after its cycle; its callback may
+ * schedule further events, including periodic ones relative to the cycle it
+ * was due at, which keeps timers free of drift.
+ *
+ * The scheduler is owned by the CPU thread and takes no locks.
+ */
+
+#define SCHEDULER_MAX_EVENTS 64 // Events that can be pending at once
+#define SCHEDULER_NO_EVENT 0    // Never returned as an event id
+
+/* Called when an event is due; cycle is the cycle it was scheduled for */
+typedef void (*scheduler_callback_t)(void *context, uint64_t cycle);
+
+/* One pending event */
+typedef struct
+{
+    uint64_t cycle; // Absolute cycle_count the event is due at
+    uint64_t order; // Scheduling order, to break ties
+    uint32_t id;    // Handle for scheduler_cancel()
+    scheduler_callback_t callback;
+    void *context;
+} scheduled_event_t;
+
+/* Scheduler Structure */
+typedef struct scheduler
+{
+    uint64_t next_cycle; // Cycle of the earliest event, UINT64_MAX if none
+    int count;           // Events in heap[]
+    uint32_t next_id;
+    uint64_t next_order;
+    scheduled_event_t heap[SCHEDULER_MAX_EVENTS];
+} scheduler_t;
+
+/**
+ * @brief Empties the timeline.
+ *
+ * @param scheduler Pointer to the scheduler.
+ */
+void scheduler_init(scheduler_t *scheduler);
+
+/**
+ * @brief Schedules a callback at an absolute cycle.
+ *
+ * A cycle already in the past is run at the next instruction boundary.
+ *
+ * @param scheduler Pointer to the scheduler.
+ * @param cycle Absolute cycle_count the event is due at.
+ * @param callback Function to call.
+ * @param context Argument for the callback.
+ * @return Event id, or SCHEDULER_NO_EVENT if the timeline is full.
+ */
+uint32_t scheduler_add(scheduler_t *scheduler, uint64_t cycle,
+                       scheduler_callback_t callback, void *context);
+
+/**
+ * @brief Removes a pending event.
+ *
+ * @param scheduler Pointer to the scheduler.
+ * @param id Event id from scheduler_add().
+ * @return true if the event was pending.
+ */
+bool scheduler_cancel(scheduler_t *scheduler, uint32_t id);
+
+/**
+ * @brief Runs every event due at or before now, earliest first.
+ *
+ * Events the callbacks schedule at or before now run in the same call.
+ *
+ * @param scheduler Pointer to the scheduler.
+ * @param now Current cycle_count.
+ */
+void scheduler_run_due(scheduler_t *scheduler, uint64_t now);
+
+/**
+ * @brief Moves every pending event from one time base to another, keeping
+ *        the cycles left until it is due.
+ *
+ * Used when cycle_count restarts (CPU reset); events already due stay due.
+ *
+ * @param scheduler Pointer to the scheduler.
+ * @param old_now cycle_count before the restart.
+ * @param new_now cycle_count after the restart.
+ */
+void scheduler_rebase(scheduler_t *scheduler, uint64_t old_now,
+                      uint64_t new_now);
+
+#endif // SCHEDULER_H
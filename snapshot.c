@@ -0,0 +1,382 @@
+// snapshot.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "snapshot.h"
+#include "bus.h"
+#include "decode_cache.h"
+
+/* Building */
+
+/* Make room for size more bytes; returns where they go, or NULL */
+static uint8_t *snapshot_grow(cpu_snapshot_t *snapshot, size_t size)
+{
+    if (snapshot->size + size > snapshot->capacity)
+    {
+        size_t capacity = snapshot->capacity ? snapshot->capacity : 4096;
+
+        while (capacity < snapshot->size + size)
+            capacity *= 2;
+
+        uint8_t *data = realloc(snapshot->data, capacity);
+
+        if (!data)
+            return NULL;
+
+        snapshot->data = data;
+        snapshot->capacity = capacity;
+    }
+
+    uint8_t *at = snapshot->data + snapshot->size;
+
+    snapshot->size += size;
+    return at;
+}
+
+/* Append a record header and room for its payload */
+static uint8_t *snapshot_add_record(cpu_snapshot_t *snapshot, uint8_t type,
+                                    uint8_t device, uint16_t addr,
+                                    uint32_t length)
+{
+    snapshot_record_t record = {type, device, addr, length};
+    uint8_t *at = snapshot_grow(snapshot, sizeof(record) + length);
+
+    if (!at)
+        return NULL;
+
+    memcpy(at, &record, sizeof(record));
+    return at + sizeof(record);
+}
+
+/* Pages that lie wholly inside a device's range */
+static void device_pages(const bus_device_t *dev, unsigned *first,
+                         unsigned *last)
+{
+    *first = (dev->start_addr + SNAPSHOT_PAGE_SIZE - 1) / SNAPSHOT_PAGE_SIZE;
+    *last = ((unsigned)dev->end_addr + 1) / SNAPSHOT_PAGE_SIZE; // Exclusive
+}
+
+/* Captures the machine into a snapshot */
+cpu_status_t cpu_snapshot_save(cpu_6502_t *cpu, cpu_snapshot_t *snapshot)
+{
+    if (!cpu || !snapshot)
+        return CPU_ERROR_INVALID_ARGUMENT;
+
+    snapshot->size = 0;
+
+    snapshot_header_t header;
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.byte_order = SNAPSHOT_BYTE_ORDER;
+    header.size = 0; // Filled in last
+
+    uint8_t *at = snapshot_grow(snapshot, sizeof(header));
+
+    if (!at)
+        goto fail;
+
+    snapshot_cpu_t state;
+    memset(&state, 0, sizeof(state)); // Padding too: files compare equal
+    state.reg = cpu->reg;
+    state.irq_pending = atomic_load(&cpu->IRQ_pending);
+    state.nmi_pending = atomic_load(&cpu->NMI_pending);
+    state.cycle_count = cpu->clock.cycle_count;
+
+    if (!(at = snapshot_add_record(snapshot, SNAPSHOT_RECORD_CPU, 0, 0,
+                                   sizeof(state))))
+        goto fail;
+    memcpy(at, &state, sizeof(state));
+
+    bus_t *bus = cpu->bus;
+
+    for (int i = 0; i < bus->device_count; i++)
+    {
+        const bus_device_t *dev = &bus->devices[i];
+        memory_t *mem = dev->device;
+
+        if (mem->page_pointer)
+        {
+            unsigned first, last;
+            device_pages(dev, &first, &last);
+
+            for (unsigned page = first; page < last; page++)
+            {
+                uint16_t addr = (uint16_t)(page * SNAPSHOT_PAGE_SIZE);
+                const uint8_t *storage = mem->page_pointer(mem, addr, false);
+
+                if (!storage)
+                    continue;
+
+                if (!(at = snapshot_add_record(snapshot, SNAPSHOT_RECORD_PAGE,
+                                               (uint8_t)i, addr,
+                                               SNAPSHOT_PAGE_SIZE)))
+                    goto fail;
+                memcpy(at, storage, SNAPSHOT_PAGE_SIZE);
+            }
+        }
+
+        if (mem->save_state)
+        {
+            size_t length = mem->save_state(mem, NULL, 0);
+
+            if (!(at = snapshot_add_record(snapshot, SNAPSHOT_RECORD_DEVICE,
+                                           (uint8_t)i, dev->start_addr,
+                                           (uint32_t)length)))
+                goto fail;
+            mem->save_state(mem, at, length);
+        }
+    }
+
+    header.size = (uint32_t)snapshot->size;
+    memcpy(snapshot->data, &header, sizeof(header));
+
+    return CPU_SUCCESS;
+
+fail:
+    fprintf(stderr, "cpu_snapshot_save: Failed to allocate snapshot.\n");
+    snapshot->size = 0;
+    return CPU_ERROR_MEMORY_OVERFLOW;
+}
+
+/* Restoring */
+
+static bool header_valid(const uint8_t *data, size_t size)
+{
+    snapshot_header_t header;
+
+    if (!data || size < sizeof(header))
+        return false;
+
+    memcpy(&header, data, sizeof(header));
+
+    return memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) == 0 &&
+           header.version == SNAPSHOT_VERSION &&
+           header.byte_order == SNAPSHOT_BYTE_ORDER && header.size == size;
+}
+
+/* Whether a record fits this machine */
+static bool record_valid(cpu_6502_t *cpu, const snapshot_record_t *record)
+{
+    bus_t *bus = cpu->bus;
+
+    if (record->type == SNAPSHOT_RECORD_CPU)
+        return record->length == sizeof(snapshot_cpu_t);
+
+    if (record->device >= bus->device_count)
+        return false;
+
+    const bus_device_t *dev = &bus->devices[record->device];
+    memory_t *mem = dev->device;
+
+    if (record->type == SNAPSHOT_RECORD_DEVICE)
+        return mem->restore_state && record->addr == dev->start_addr;
+
+    if (record->type != SNAPSHOT_RECORD_PAGE ||
+        record->length != SNAPSHOT_PAGE_SIZE || !mem->page_pointer ||
+        record->addr % SNAPSHOT_PAGE_SIZE)
+        return false;
+
+    unsigned first, last, page = record->addr / SNAPSHOT_PAGE_SIZE;
+    device_pages(dev, &first, &last);
+
+    return page >= first && page < last &&
+           mem->page_pointer(mem, record->addr, false);
+}
+
+/* Walk the records, checking each one or applying it. Returns false on the
+ * first one that does not fit. */
+static bool snapshot_walk(cpu_6502_t *cpu, const cpu_snapshot_t *snapshot,
+                          bool apply)
+{
+    size_t offset = sizeof(snapshot_header_t);
+    bool checked_any = false;
+
+    while (offset < snapshot->size)
+    {
+        snapshot_record_t record;
+
+        if (snapshot->size - offset < sizeof(record))
+            return false;
+
+        memcpy(&record, snapshot->data + offset, sizeof(record));
+        offset += sizeof(record);
+
+        if (snapshot->size - offset < record.length)
+            return false;
+
+        const uint8_t *payload = snapshot->data + offset;
+        offset += record.length;
+
+        if (!apply)
+        {
+            // One CPU record, and it comes first
+            bool is_cpu = record.type == SNAPSHOT_RECORD_CPU;
+
+            if (!record_valid(cpu, &record) || is_cpu == checked_any)
+                return false;
+            checked_any = true;
+            continue;
+        }
+
+        memory_t *mem = cpu->bus->devices[record.device].device;
+
+        switch (record.type)
+        {
+        case SNAPSHOT_RECORD_CPU:
+            break; // Applied first by the caller
+        case SNAPSHOT_RECORD_PAGE:
+        {
+            uint8_t *storage = mem->page_pointer(mem, record.addr, false);
+
+            // Unchanged pages keep their decoded code
+            if (memcmp(storage, payload, SNAPSHOT_PAGE_SIZE) == 0)
+                break;
+
+            memcpy(storage, payload, SNAPSHOT_PAGE_SIZE);
+            for (int i = 0; i < SNAPSHOT_PAGE_SIZE; i++)
+                decode_cache_invalidate(cpu->decode_cache,
+                                        (uint16_t)(record.addr + i));
+            break;
+        }
+        default: // SNAPSHOT_RECORD_DEVICE
+            mem->restore_state(mem, payload, record.length);
+            break;
+        }
+    }
+
+    return apply || checked_any;
+}
+
+/* Puts the machine back in the state of a snapshot */
+cpu_status_t cpu_snapshot_restore(cpu_6502_t *cpu,
+                                  const cpu_snapshot_t *snapshot)
+{
+    if (!cpu || !snapshot || !header_valid(snapshot->data, snapshot->size) ||
+        !snapshot_walk(cpu, snapshot, false))
+        return CPU_ERROR_INVALID_ARGUMENT;
+
+    // The CPU record comes first, before the devices reschedule their
+    // events on the restored clock
+    snapshot_cpu_t state;
+    memcpy(&state,
+           snapshot->data + sizeof(snapshot_header_t) +
+               sizeof(snapshot_record_t),
+           sizeof(state));
+
+    cpu->reg = state.reg;
+
+    uint64_t old_cycle = cpu->clock.cycle_count;
+    clock_set_cycle(&cpu->clock, state.cycle_count);
+    scheduler_rebase(&cpu->scheduler, old_cycle, cpu->clock.cycle_count);
+
+    atomic_store(&cpu->IRQ_pending, state.irq_pending);
+    atomic_store(&cpu->NMI_pending, state.nmi_pending);
+    if (state.irq_pending || state.nmi_pending)
+        atomic_store(&cpu->attention, true);
+
+    // Devices drive their own IRQ lines again as they restore
+    snapshot_walk(cpu, snapshot, true);
+
+    atomic_store(&cpu->stop_requested, false);
+    cpu->stop_reason = CPU_STOP_BUDGET;
+    cpu->watch_hit = false;
+    cpu->idle.armed = false;
+    cpu->idle.pending = false;
+    cpu->pc_history_count = 0;
+
+    return CPU_SUCCESS;
+}
+
+/* Frees a snapshot's buffer and empties it */
+void cpu_snapshot_free(cpu_snapshot_t *snapshot)
+{
+    if (!snapshot)
+        return;
+
+    free(snapshot->data);
+    snapshot->data = NULL;
+    snapshot->size = 0;
+    snapshot->capacity = 0;
+}
+
+/* Files */
+
+/* Writes a snapshot to a file */
+cpu_status_t cpu_snapshot_write(const cpu_snapshot_t *snapshot,
+                                const char *filename)
+{
+    if (!snapshot || !filename || !snapshot->size)
+        return CPU_ERROR_INVALID_ARGUMENT;
+
+    FILE *file = fopen(filename, "wb");
+
+    if (!file)
+    {
+        perror("Error creating snapshot file");
+        return CPU_ERROR_FILE_NOT_FOUND;
+    }
+
+    size_t written = fwrite(snapshot->data, 1, snapshot->size, file);
+
+    if (fclose(file) != 0 || written != snapshot->size)
+    {
+        perror("Error writing snapshot file");
+        return CPU_ERROR_WRITE_FAILED;
+    }
+
+    return CPU_SUCCESS;
+}
+
+/* Reads a snapshot from a file */
+cpu_status_t cpu_snapshot_read(cpu_snapshot_t *snapshot, const char *filename)
+{
+    if (!snapshot || !filename)
+        return CPU_ERROR_INVALID_ARGUMENT;
+
+    FILE *file = fopen(filename, "rb");
+
+    if (!file)
+    {
+        perror("Error opening snapshot file");
+        return CPU_ERROR_FILE_NOT_FOUND;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long file_size = ftell(file);
+    rewind(file);
+
+    if (file_size < (long)sizeof(snapshot_header_t))
+    {
+        fclose(file);
+        return file_size < 0 ? CPU_ERROR_READ_FAILED
+                             : CPU_ERROR_INVALID_ARGUMENT;
+    }
+
+    snapshot->size = 0;
+
+    uint8_t *data = snapshot_grow(snapshot, (size_t)file_size);
+
+    if (!data)
+    {
+        fclose(file);
+        return CPU_ERROR_MEMORY_OVERFLOW;
+    }
+
+    size_t bytes_read = fread(data, 1, snapshot->size, file);
+    fclose(file);
+
+    if (bytes_read != snapshot->size)
+    {
+        perror("Error reading snapshot file");
+        snapshot->size = 0;
+        return CPU_ERROR_READ_FAILED;
+    }
+
+    if (!header_valid(snapshot->data, snapshot->size))
+    {
+        snapshot->size = 0;
+        return CPU_ERROR_INVALID_ARGUMENT;
+    }
+
+    return CPU_SUCCESS;
+}
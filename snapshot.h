@@ -0,0 +1,144 @@
+// snapshot.h
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "cpu_6502.h"
+
+/*
+ * Save states: the whole machine in one flat buffer.
+ *
+ * A snapshot holds the registers, pending interrupts and cycle count, every
+ * page of storage the bus devices expose through page_pointer (including
+ * pages another device shadows on the bus), and the state each device hands
+ * out through save_state. Storage is copied through the device's own page
+ * pointers, never through the bus, so neither saving nor restoring fires
+ * I/O side effects, write hooks or watchpoints.
+ *
+ * Layout, in host byte order: a snapshot_header_t, then records, each a
+ * snapshot_record_t followed by its payload:
+ *
+ *   SNAPSHOT_RECORD_CPU     snapshot_cpu_t
+ *   SNAPSHOT_RECORD_PAGE    256 bytes of storage of device `device` at `addr`
+ *   SNAPSHOT_RECORD_DEVICE  the bytes save_state returned for `device`,
+ *                           whose start address is `addr`
+ *
+ * A snapshot only restores into a machine with the same devices connected
+ * in the same order at the same addresses; the checks are made before
+ * anything is changed. The header's byte order mark rejects files written
+ * on a host of the other endianness.
+ *
+ * The clock's frequency and pacing mode are host settings and are not
+ * saved: a restore keeps the current ones, and pacing goes on from the
+ * restored cycle at the current time.
+ *
+ * Take and restore snapshots between cpu_run_cycles() calls on the thread
+ * that runs the CPU, when reg.P is up to date.
+ */
+
+#define SNAPSHOT_MAGIC "E65S"
+#define SNAPSHOT_VERSION 2
+#define SNAPSHOT_BYTE_ORDER 0x0102 // Reads back as $0201 on the other order
+#define SNAPSHOT_PAGE_SIZE 256
+
+/* Record types */
+#define SNAPSHOT_RECORD_CPU 1
+#define SNAPSHOT_RECORD_PAGE 2
+#define SNAPSHOT_RECORD_DEVICE 3
+
+/* Start of every snapshot */
+typedef struct
+{
+    char magic[4];       // SNAPSHOT_MAGIC, no terminator
+    uint16_t version;    // SNAPSHOT_VERSION
+    uint16_t byte_order; // SNAPSHOT_BYTE_ORDER
+    uint32_t size;       // Whole snapshot, this header included
+} snapshot_header_t;
+
+/* Start of every record */
+typedef struct
+{
+    uint8_t type;    // SNAPSHOT_RECORD_*
+    uint8_t device;  // Index on the bus (page and device records)
+    uint16_t addr;   // Page address, or the device's start address
+    uint32_t length; // Payload bytes that follow
+} snapshot_record_t;
+
+/* CPU record payload */
+typedef struct
+{
+    cpu_registers_t reg;
+    bool irq_pending;
+    bool nmi_pending;
+    uint64_t cycle_count;
+} snapshot_cpu_t;
+
+/* A snapshot; zero-initialize before first use */
+typedef struct
+{
+    uint8_t *data;
+    size_t size;     // 0 while empty
+    size_t capacity; // Bytes allocated, reused by the next save
+} cpu_snapshot_t;
+
+/**
+ * @brief Captures the machine into a snapshot, replacing its contents.
+ *
+ * @param cpu Pointer to the CPU; its bus provides the devices.
+ * @param snapshot Snapshot to fill; its buffer grows as needed.
+ * @return CPU_SUCCESS, or CPU_ERROR_MEMORY_OVERFLOW if the buffer could not
+ * grow (the snapshot is then empty).
+ */
+cpu_status_t cpu_snapshot_save(cpu_6502_t *cpu, cpu_snapshot_t *snapshot);
+
+/**
+ * @brief Puts the machine back in the state of a snapshot.
+ *
+ * Pending events keep the cycles they had left, as across cpu_reset();
+ * device events are rescheduled from the restored device state. Decoded and
+ * translated code for the storage that changed is dropped.
+ *
+ * @param cpu Pointer to the CPU.
+ * @param snapshot Snapshot to restore.
+ * @return CPU_SUCCESS, or CPU_ERROR_INVALID_ARGUMENT if the snapshot is
+ * malformed, from another version or byte order, or does not fit this
+ * machine; the machine is left untouched then.
+ */
+cpu_status_t cpu_snapshot_restore(cpu_6502_t *cpu,
+                                  const cpu_snapshot_t *snapshot);
+
+/**
+ * @brief Frees a snapshot's buffer and empties it.
+ *
+ * @param snapshot Pointer to the snapshot.
+ */
+void cpu_snapshot_free(cpu_snapshot_t *snapshot);
+
+/**
+ * @brief Writes a snapshot to a file.
+ *
+ * @param snapshot Snapshot to write.
+ * @param filename Path of the file, replaced if it exists.
+ * @return CPU_SUCCESS, CPU_ERROR_INVALID_ARGUMENT for an empty snapshot,
+ * CPU_ERROR_FILE_NOT_FOUND if the file cannot be created, or
+ * CPU_ERROR_WRITE_FAILED.
+ */
+cpu_status_t cpu_snapshot_write(const cpu_snapshot_t *snapshot,
+                                const char *filename);
+
+/**
+ * @brief Reads a snapshot from a file, replacing the snapshot's contents.
+ *
+ * Only the header is checked here; cpu_snapshot_restore() checks the rest.
+ *
+ * @param snapshot Snapshot to fill.
+ * @param filename Path of the file.
+ * @return CPU_SUCCESS, CPU_ERROR_FILE_NOT_FOUND, CPU_ERROR_READ_FAILED,
+ * CPU_ERROR_INVALID_ARGUMENT if it is not a snapshot, or
+ * CPU_ERROR_MEMORY_OVERFLOW.
+ */
+cpu_status_t cpu_snapshot_read(cpu_snapshot_t *snapshot, const char *filename);
+
+#endif // SNAPSHOT_H
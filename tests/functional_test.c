@@ -126,61 +126,65 @@ bool check_test_result(cpu_6502_t *cpu) {
     return true;
 }
 
+// Verifica se a instrução em pc desvia para si mesma (JMP * ou Bxx *)
+static bool is_trap(cpu_6502_t *cpu, uint16_t pc) {
+    uint8_t opcode = cpu_read(cpu, pc);
+
+    if (opcode == 0x4C) { // JMP absoluto
+        uint16_t target = cpu_read(cpu, pc + 1) | (cpu_read(cpu, pc + 2) << 8);
+        return target == pc;
+    }
+
+    // Desvios condicionais (xxx10000) com deslocamento -2
+    return (opcode & 0x1F) == 0x10 && cpu_read(cpu, pc + 1) == 0xFE;
+}
+
 // Função para executar o teste funcional com limite de ciclos
 bool run_functional_test(cpu_6502_t *cpu, uint32_t max_cycles) {
     printf("Executando teste funcional (máximo %u ciclos)...\n", max_cycles);
-    
-    uint32_t cycles = 0;
-    uint16_t last_pc = cpu->reg.PC;
-    int stall_count = 0;
-    
+
+    // Executa em fatias de ciclos; as condições de parada são verificadas
+    // entre fatias
+    const uint32_t slice_cycles = 10000;
+    uint64_t start_cycle = cpu->clock.cycle_count;
+    uint64_t cycles = 0;
+
     while (cycles < max_cycles) {
-        // Salvar PC anterior para detectar loops infinitos
-        uint16_t current_pc = cpu->reg.PC;
-        
-        // Executar uma instrução
-        cpu_status_t status = cpu_execute_instruction(cpu, NULL);
-        
+        cpu_status_t status = cpu_run_cycles(cpu, slice_cycles, NULL);
+        cycles = cpu->clock.cycle_count - start_cycle;
+
         if (status != CPU_SUCCESS) {
-            printf("Erro na execução: status %d no ciclo %u\n", status, cycles);
+            printf("Erro na execução: status %d no ciclo %llu\n", status,
+                   (unsigned long long)cycles);
             return false;
         }
-        
-        cycles++;
-        
-        // Verificar se o PC mudou (para detectar loops infinitos)
-        if (current_pc == last_pc) {
-            stall_count++;
-            if (stall_count > 1000) {
-                printf("Detectado possível loop infinito no endereço 0x%04X\n", current_pc);
-                return false;
-            }
-        } else {
-            stall_count = 0;
-            last_pc = current_pc;
+
+        uint16_t current_pc = cpu->reg.PC;
+
+        // Verificar se o programa ficou preso num laço infinito
+        if (is_trap(cpu, current_pc)) {
+            printf("Detectado possível loop infinito no endereço 0x%04X\n", current_pc);
+            return false;
         }
-        
+
         // Verificar se chegamos ao final do teste
         if (current_pc == 0x0000 || current_pc == 0xFFFF) {
             printf("PC chegou ao endereço 0x%04X, parando execução\n", current_pc);
             break;
         }
-        
+
         // Verificar se encontramos um BRK
-        uint8_t opcode = cpu_read(cpu, current_pc);
-        if (opcode == 0x00) { // BRK
+        if (cpu_read(cpu, current_pc) == 0x00) {
             printf("Encontrado BRK no endereço 0x%04X\n", current_pc);
             break;
         }
-        
-        // Mostrar progresso a cada 10000 ciclos
-        if (cycles % 10000 == 0) {
-            printf("Ciclos: %u, PC: 0x%04X, A: 0x%02X, X: 0x%02X, Y: 0x%02X\n", 
-                   cycles, current_pc, cpu->reg.A, cpu->reg.X, cpu->reg.Y);
-        }
+
+        // Mostrar progresso a cada fatia
+        printf("Ciclos: %llu, PC: 0x%04X, A: 0x%02X, X: 0x%02X, Y: 0x%02X\n",
+               (unsigned long long)cycles, current_pc, cpu->reg.A, cpu->reg.X, cpu->reg.Y);
     }
-    
-    printf("Execução concluída após %u ciclos\n", cycles);
+
+    printf("Execução concluída após %llu ciclos\n", (unsigned long long)cycles);
     return true;
 }
 
@@ -224,6 +228,9 @@ int main() {
         return 1;
     }
     
+    // Sem espera em tempo real: o resultado depende só dos ciclos
+    cpu_set_clock_mode(&cpu, CLOCK_MODE_VIRTUAL);
+
     // Criar RAM
     ram = memory_create_ram(0x10000);
     if (!ram) {
@@ -0,0 +1,762 @@
+// timeline.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "timeline.h"
+
+/* Replay outcomes */
+typedef enum
+{
+    REPLAY_DONE,  // Reached the target
+    REPLAY_HIT,   // Stopped at a breakpoint or watchpoint
+    REPLAY_ERROR  // cpu_run_cycles() failed
+} replay_result_t;
+
+static inline timeline_checkpoint_t *checkpoint_at(timeline_t *tl, int i)
+{
+    return &tl->checkpoints[(tl->first + i) % tl->capacity];
+}
+
+/* Buffers */
+
+static bool reserve(uint8_t **data, size_t *capacity, size_t size)
+{
+    if (size <= *capacity)
+        return true;
+
+    size_t grown = *capacity ? *capacity : 1024;
+
+    while (grown < size)
+        grown *= 2;
+
+    uint8_t *bigger = realloc(*data, grown);
+
+    if (!bigger)
+        return false;
+
+    *data = bigger;
+    *capacity = grown;
+    return true;
+}
+
+/* Make dst a copy of src */
+static bool snapshot_copy(cpu_snapshot_t *dst, const cpu_snapshot_t *src)
+{
+    if (!reserve(&dst->data, &dst->capacity, src->size))
+        return false;
+
+    memcpy(dst->data, src->data, src->size);
+    dst->size = src->size;
+    return true;
+}
+
+static void snapshot_swap(cpu_snapshot_t *a, cpu_snapshot_t *b)
+{
+    cpu_snapshot_t t = *a;
+
+    *a = *b;
+    *b = t;
+}
+
+/* Deltas */
+
+static bool delta_add(timeline_checkpoint_t *cp, size_t offset,
+                      const uint8_t *bytes, uint32_t length)
+{
+    uint32_t run[2] = {(uint32_t)offset, length};
+
+    if (!reserve(&cp->delta, &cp->delta_capacity,
+                 cp->delta_size + sizeof(run) + length))
+        return false;
+
+    memcpy(cp->delta + cp->delta_size, run, sizeof(run));
+    memcpy(cp->delta + cp->delta_size + sizeof(run), bytes, length);
+    cp->delta_size += sizeof(run) + length;
+    return true;
+}
+
+/* Store the records of next that differ from prev. Both must come from
+ * cpu_snapshot_save() on the same machine; false if they do not line up,
+ * or on allocation failure. */
+static bool delta_make(timeline_checkpoint_t *cp, const cpu_snapshot_t *prev,
+                       const cpu_snapshot_t *next)
+{
+    cp->delta_size = 0;
+
+    if (prev->size != next->size)
+        return false;
+
+    size_t offset = sizeof(snapshot_header_t);
+
+    while (offset < next->size)
+    {
+        snapshot_record_t record;
+
+        memcpy(&record, next->data + offset, sizeof(record));
+        if (memcmp(prev->data + offset, &record, sizeof(record)) != 0)
+            return false;
+        offset += sizeof(record);
+
+        if (memcmp(prev->data + offset, next->data + offset, record.length) !=
+                0 &&
+            !delta_add(cp, offset, next->data + offset, record.length))
+            return false;
+        offset += record.length;
+    }
+
+    return true;
+}
+
+static void delta_apply(const timeline_checkpoint_t *cp,
+                        cpu_snapshot_t *snapshot)
+{
+    size_t offset = 0;
+
+    while (offset < cp->delta_size)
+    {
+        uint32_t run[2];
+
+        memcpy(run, cp->delta + offset, sizeof(run));
+        offset += sizeof(run);
+        memcpy(snapshot->data + run[0], cp->delta + offset, run[1]);
+        offset += run[1];
+    }
+}
+
+/* Full state at checkpoint i, in scratch */
+static bool compose(timeline_t *tl, int i)
+{
+    if (!snapshot_copy(&tl->scratch, &tl->base))
+        return false;
+
+    for (int k = 1; k <= i; k++)
+        delta_apply(checkpoint_at(tl, k), &tl->scratch);
+
+    return true;
+}
+
+/* The Log */
+
+static bool log_event(timeline_t *tl, timeline_event_type_t type,
+                      uint8_t data)
+{
+    if (tl->event_count == tl->event_capacity)
+    {
+        size_t capacity = tl->event_capacity ? tl->event_capacity * 2 : 256;
+        timeline_event_t *events =
+            realloc(tl->events, capacity * sizeof(timeline_event_t));
+
+        if (!events)
+            return false;
+
+        tl->events = events;
+        tl->event_capacity = capacity;
+    }
+
+    timeline_event_t *event = &tl->events[tl->event_count++];
+
+    event->cycle = tl->cpu->clock.cycle_count;
+    event->type = (uint8_t)type;
+    event->data = data;
+    return true;
+}
+
+static inline uint64_t log_end(const timeline_t *tl)
+{
+    return tl->events_base + tl->event_count;
+}
+
+/* Forget the entries before the oldest checkpoint */
+static void log_trim(timeline_t *tl)
+{
+    uint64_t keep = checkpoint_at(tl, 0)->event_index;
+    size_t drop = (size_t)(keep - tl->events_base);
+
+    memmove(tl->events, tl->events + drop,
+            (tl->event_count - drop) * sizeof(timeline_event_t));
+    tl->event_count -= drop;
+    tl->events_base = keep;
+}
+
+/* Checkpoints */
+
+/* Keep what waits in the input ring. Its producer and consumer are both on
+ * this thread: read it by taking everything out and putting it back. */
+static void input_save(cpu_6502_t *cpu, timeline_checkpoint_t *cp)
+{
+    cp->input_count =
+        queue_dequeue_n(&cpu->input_queue, cp->input, sizeof(cp->input));
+    queue_enqueue_n(&cpu->input_queue, cp->input, cp->input_count);
+}
+
+static void input_restore(cpu_6502_t *cpu, const timeline_checkpoint_t *cp)
+{
+    queue_clear(&cpu->input_queue);
+    queue_enqueue_n(&cpu->input_queue, cp->input, cp->input_count);
+}
+
+/* Fold the oldest checkpoint into the next one and drop it */
+static void drop_oldest(timeline_t *tl)
+{
+    delta_apply(checkpoint_at(tl, 1), &tl->base);
+    checkpoint_at(tl, 1)->delta_size = 0;
+
+    tl->first = (tl->first + 1) % tl->capacity;
+    tl->count--;
+    log_trim(tl);
+}
+
+/* Take a checkpoint of the current state */
+static cpu_status_t checkpoint(timeline_t *tl)
+{
+    cpu_6502_t *cpu = tl->cpu;
+
+    if (cpu_snapshot_save(cpu, &tl->scratch) != CPU_SUCCESS)
+        return CPU_ERROR_MEMORY_OVERFLOW;
+
+    timeline_checkpoint_t *cp;
+
+    if (tl->count == 0)
+    {
+        cp = checkpoint_at(tl, 0);
+
+        snapshot_swap(&tl->base, &tl->scratch);
+        if (!snapshot_copy(&tl->latest, &tl->base))
+            return CPU_ERROR_MEMORY_OVERFLOW;
+    }
+    else
+    {
+        if (tl->count == tl->capacity)
+            drop_oldest(tl);
+
+        cp = checkpoint_at(tl, tl->count);
+
+        if (!delta_make(cp, &tl->latest, &tl->scratch))
+        {
+            // The machine changed shape, or memory ran out: start over
+            tl->count = 0;
+            return timeline_start(tl);
+        }
+
+        snapshot_swap(&tl->latest, &tl->scratch);
+    }
+
+    cp->cycle = cpu->clock.cycle_count;
+    cp->event_index = log_end(tl);
+    input_save(cpu, cp);
+
+    tl->count++;
+    tl->next_checkpoint = cp->cycle + tl->interval;
+
+    return CPU_SUCCESS;
+}
+
+/* Put the machine in the state of checkpoint i; scratch keeps the full
+ * snapshot */
+static cpu_status_t restore(timeline_t *tl, int i)
+{
+    cpu_6502_t *cpu = tl->cpu;
+    timeline_checkpoint_t *cp = checkpoint_at(tl, i);
+
+    if (!compose(tl, i))
+        return CPU_ERROR_MEMORY_OVERFLOW;
+
+    cpu_status_t status = cpu_snapshot_restore(cpu, &tl->scratch);
+
+    if (status != CPU_SUCCESS)
+        return status;
+
+    input_restore(cpu, cp);
+
+    return CPU_SUCCESS;
+}
+
+/* Newest checkpoint at or before cycle (before it if strict), or -1 */
+static int checkpoint_before(timeline_t *tl, uint64_t cycle, bool strict)
+{
+    for (int i = tl->count - 1; i >= 0; i--)
+    {
+        uint64_t at = checkpoint_at(tl, i)->cycle;
+
+        if (at < cycle || (!strict && at == cycle))
+            return i;
+    }
+
+    return -1;
+}
+
+/* Replay */
+
+/* What a replay changes on the CPU, to put back after it */
+typedef struct
+{
+    clock_mode_t mode;
+    double frequency;
+    bool idle_skip;
+} replay_pacing_t;
+
+/* The cycles being replayed were paid for in real time once already: run
+ * them in virtual time, and without idle skipping, which outside real time
+ * blocks waiting for input the log will deliver anyway (skipping is cycle
+ * exact, so the states are the same) */
+static replay_pacing_t replay_begin(timeline_t *tl)
+{
+    cpu_6502_t *cpu = tl->cpu;
+    replay_pacing_t pacing = {cpu->clock.mode, cpu->clock.frequency,
+                              cpu->idle.enabled};
+
+    tl->replaying = true;
+    cpu_set_clock_mode(cpu, CLOCK_MODE_VIRTUAL);
+    cpu_set_idle_skip(cpu, false);
+
+    return pacing;
+}
+
+/* Back to the caller's pacing; real time resumes from the new present */
+static void replay_end(timeline_t *tl, replay_pacing_t pacing)
+{
+    cpu_6502_t *cpu = tl->cpu;
+
+    cpu_set_idle_skip(cpu, pacing.idle_skip);
+    cpu_set_clock_frequency(cpu, pacing.frequency);
+    cpu_set_clock_mode(cpu, pacing.mode);
+    tl->replaying = false;
+}
+
+static void deliver(timeline_t *tl, const timeline_event_t *event)
+{
+    cpu_6502_t *cpu = tl->cpu;
+
+    switch (event->type)
+    {
+    case TIMELINE_INPUT:
+        queue_enqueue(&cpu->input_queue, event->data);
+        break;
+    case TIMELINE_IRQ:
+        cpu_inject_IRQ(cpu);
+        break;
+    default: // TIMELINE_NMI
+        cpu_inject_NMI(cpu);
+        break;
+    }
+}
+
+/* Run to the first instruction boundary at or after target, delivering the
+ * log from *next on as the cycles come. With hits set, return at each
+ * breakpoint (in breakpoints) and watchpoint stop instead of running on. */
+static replay_result_t replay_run(timeline_t *tl, uint64_t *next,
+                                  uint64_t target, breakpoint_t *breakpoints,
+                                  bool hits)
+{
+    cpu_6502_t *cpu = tl->cpu;
+
+    while (cpu->clock.cycle_count < target)
+    {
+        uint64_t now = cpu->clock.cycle_count;
+
+        while (*next < log_end(tl) &&
+               tl->events[*next - tl->events_base].cycle <= now)
+            deliver(tl, &tl->events[(*next)++ - tl->events_base]);
+
+        uint64_t end = target;
+
+        if (*next < log_end(tl) &&
+            tl->events[*next - tl->events_base].cycle < end)
+            end = tl->events[*next - tl->events_base].cycle;
+
+        if (cpu_run_cycles(cpu, end - now, hits ? breakpoints : NULL) !=
+                CPU_SUCCESS ||
+            cpu->stop_reason == CPU_STOP_ERROR)
+            return REPLAY_ERROR;
+
+        if (hits && (cpu->stop_reason == CPU_STOP_BREAKPOINT ||
+                     cpu->stop_reason == CPU_STOP_WATCHPOINT))
+            return REPLAY_HIT;
+    }
+
+    return REPLAY_DONE;
+}
+
+/* Make the state reached by replaying from checkpoint i the present: later
+ * checkpoints and the log from next on are dropped. scratch still holds
+ * checkpoint i in full, the base for the next delta. */
+static void make_present(timeline_t *tl, int i, uint64_t next)
+{
+    snapshot_swap(&tl->latest, &tl->scratch);
+    tl->count = i + 1;
+    tl->next_checkpoint = checkpoint_at(tl, i)->cycle + tl->interval;
+    tl->event_count = (size_t)(next - tl->events_base);
+}
+
+/* Restore checkpoint i and replay to target, then make that the present:
+ * later checkpoints and log entries are dropped. A target found as a
+ * breakpoint stop needs the breakpoints again to stop on the same cycle:
+ * an interrupt entry is only a stopping point for a breakpoint. */
+static cpu_status_t travel(timeline_t *tl, int i, uint64_t target,
+                           breakpoint_t *breakpoints)
+{
+    uint64_t next = checkpoint_at(tl, i)->event_index;
+    cpu_status_t status = restore(tl, i);
+    replay_result_t result;
+
+    if (status != CPU_SUCCESS)
+        return status;
+
+    while ((result = replay_run(tl, &next, target, breakpoints, true)) ==
+           REPLAY_HIT)
+        ; // Earlier stops: run on
+
+    if (result == REPLAY_ERROR)
+        status = CPU_ERROR_INVALID_OPCODE;
+
+    make_present(tl, i, next);
+
+    return status;
+}
+
+/* Keep the state a step-back search is about to step from, next being its
+ * log position; false if it could not be saved */
+static bool step_keep(timeline_t *tl, uint64_t next)
+{
+    cpu_6502_t *cpu = tl->cpu;
+
+    if (cpu_snapshot_save(cpu, &tl->step) != CPU_SUCCESS)
+        return false;
+
+    tl->step_at.cycle = cpu->clock.cycle_count;
+    tl->step_at.event_index = next;
+    input_save(cpu, &tl->step_at);
+
+    return true;
+}
+
+/* Go back to the state step_keep() kept, take the search's steps again up
+ * to target, and make that the present after checkpoint i */
+static cpu_status_t step_to(timeline_t *tl, int i, uint64_t target)
+{
+    cpu_6502_t *cpu = tl->cpu;
+    uint64_t next = tl->step_at.event_index;
+    cpu_status_t status = cpu_snapshot_restore(cpu, &tl->step);
+
+    if (status != CPU_SUCCESS)
+        return status;
+
+    input_restore(cpu, &tl->step_at);
+
+    while (cpu->clock.cycle_count < target)
+    {
+        if (replay_run(tl, &next, cpu->clock.cycle_count + 1, NULL, false) !=
+            REPLAY_DONE)
+        {
+            status = CPU_ERROR_INVALID_OPCODE;
+            break;
+        }
+    }
+
+    make_present(tl, i, next);
+
+    return status;
+}
+
+/* Run forward from the present, checkpointing on the way */
+static cpu_status_t run_forward(timeline_t *tl, uint64_t target)
+{
+    cpu_6502_t *cpu = tl->cpu;
+
+    while (cpu->clock.cycle_count < target)
+    {
+        uint64_t budget = target - cpu->clock.cycle_count;
+
+        if (budget > tl->interval)
+            budget = tl->interval;
+
+        if (cpu_run_cycles(cpu, budget, NULL) != CPU_SUCCESS ||
+            cpu->stop_reason == CPU_STOP_ERROR)
+            return CPU_ERROR_INVALID_OPCODE;
+
+        timeline_tick(tl);
+    }
+
+    return CPU_SUCCESS;
+}
+
+/* Timeline Interface */
+
+/* Creates an empty timeline for a CPU */
+timeline_t *timeline_create(cpu_6502_t *cpu, uint64_t interval, int capacity)
+{
+    if (!cpu || (capacity != 0 && capacity < 2))
+        return NULL;
+
+    timeline_t *tl = calloc(1, sizeof(timeline_t));
+
+    if (!tl)
+    {
+        fprintf(stderr, "timeline_create: Failed to allocate timeline.\n");
+        return NULL;
+    }
+
+    tl->cpu = cpu;
+    tl->interval = interval ? interval : TIMELINE_DEFAULT_INTERVAL;
+    tl->capacity = capacity ? capacity : TIMELINE_DEFAULT_CAPACITY;
+    tl->checkpoints = calloc((size_t)tl->capacity,
+                             sizeof(timeline_checkpoint_t));
+
+    if (!tl->checkpoints)
+    {
+        fprintf(stderr, "timeline_create: Failed to allocate checkpoints.\n");
+        free(tl);
+        return NULL;
+    }
+
+    return tl;
+}
+
+/* Frees a timeline */
+void timeline_destroy(timeline_t *tl)
+{
+    if (!tl)
+        return;
+
+    for (int i = 0; i < tl->capacity; i++)
+        free(tl->checkpoints[i].delta);
+
+    free(tl->checkpoints);
+    cpu_snapshot_free(&tl->base);
+    cpu_snapshot_free(&tl->latest);
+    cpu_snapshot_free(&tl->scratch);
+    cpu_snapshot_free(&tl->step);
+    free(tl->events);
+    free(tl);
+}
+
+/* Forgets the past and takes the first checkpoint now */
+cpu_status_t timeline_start(timeline_t *tl)
+{
+    if (!tl)
+        return CPU_ERROR_INVALID_ARGUMENT;
+
+    tl->first = 0;
+    tl->count = 0;
+    tl->events_base += tl->event_count;
+    tl->event_count = 0;
+
+    return checkpoint(tl);
+}
+
+/* Takes a checkpoint if one is due */
+void timeline_tick(timeline_t *tl)
+{
+    if (tl && (tl->count == 0 || tl->cpu->clock.cycle_count >=
+                                     tl->next_checkpoint))
+        checkpoint(tl);
+}
+
+/* Puts serial bytes in the CPU's input ring and logs them */
+size_t timeline_send_input(timeline_t *tl, const uint8_t *bytes, size_t count)
+{
+    size_t sent = 0;
+
+    while (sent < count && log_event(tl, TIMELINE_INPUT, bytes[sent]))
+    {
+        if (!queue_enqueue(&tl->cpu->input_queue, bytes[sent]))
+        {
+            tl->event_count--; // Full: not delivered after all
+            break;
+        }
+        sent++;
+    }
+
+    if (sent)
+        cpu_wake(tl->cpu);
+
+    return sent;
+}
+
+/* Injects an IRQ or NMI and logs it */
+void timeline_interrupt(timeline_t *tl, bool nmi)
+{
+    if (tl->replaying)
+        return;
+
+    log_event(tl, nmi ? TIMELINE_NMI : TIMELINE_IRQ, 0);
+
+    if (nmi)
+        cpu_inject_NMI(tl->cpu);
+    else
+        cpu_inject_IRQ(tl->cpu);
+}
+
+/* Moves the machine to a cycle */
+cpu_status_t timeline_goto(timeline_t *tl, uint64_t cycle)
+{
+    if (!tl || tl->count == 0)
+        return CPU_ERROR_INVALID_ARGUMENT;
+
+    if (cycle >= tl->cpu->clock.cycle_count)
+        return run_forward(tl, cycle);
+
+    int i = checkpoint_before(tl, cycle, false);
+
+    if (i < 0)
+        return CPU_ERROR_INVALID_ARGUMENT;
+
+    replay_pacing_t pacing = replay_begin(tl);
+    cpu_status_t status = travel(tl, i, cycle, NULL);
+    replay_end(tl, pacing);
+
+    return status;
+}
+
+/* Goes back to the instruction boundary before the current one */
+cpu_status_t timeline_step_back(timeline_t *tl)
+{
+    if (!tl || tl->count == 0)
+        return CPU_ERROR_INVALID_ARGUMENT;
+
+    cpu_6502_t *cpu = tl->cpu;
+    uint64_t now = cpu->clock.cycle_count;
+    int i = checkpoint_before(tl, now, true);
+
+    if (i < 0)
+        return CPU_ERROR_INVALID_ARGUMENT;
+
+    replay_pacing_t pacing = replay_begin(tl);
+
+    // Run up to a little before now, then one instruction at a time; if
+    // that overshoots, step all the way
+    uint64_t window = checkpoint_at(tl, i)->cycle + TIMELINE_STEP_WINDOW < now
+                          ? now - TIMELINE_STEP_WINDOW
+                          : 0;
+    uint64_t previous = 0;
+    bool kept = false;
+    cpu_status_t status = CPU_SUCCESS;
+
+    for (int attempt = 0; attempt < 2; attempt++, window = 0)
+    {
+        uint64_t next = checkpoint_at(tl, i)->event_index;
+        replay_result_t result = REPLAY_DONE;
+
+        if ((status = restore(tl, i)) != CPU_SUCCESS)
+            break;
+
+        if (window)
+            result = replay_run(tl, &next, window, NULL, false);
+
+        if (result == REPLAY_DONE && cpu->clock.cycle_count >= now)
+            continue;
+
+        // Going back to previous then only takes the steps again, not the
+        // replay up to the window
+        if (result == REPLAY_DONE && window)
+            kept = step_keep(tl, next);
+
+        previous = cpu->clock.cycle_count;
+
+        while (result == REPLAY_DONE &&
+               (result = replay_run(tl, &next, cpu->clock.cycle_count + 1,
+                                    NULL, false)) == REPLAY_DONE &&
+               cpu->clock.cycle_count < now)
+            previous = cpu->clock.cycle_count;
+
+        if (result == REPLAY_ERROR)
+            status = CPU_ERROR_INVALID_OPCODE;
+        break;
+    }
+
+    if (status == CPU_SUCCESS)
+        status = kept ? step_to(tl, i, previous)
+                      : travel(tl, i, previous, NULL);
+
+    replay_end(tl, pacing);
+    return status;
+}
+
+/* Goes back to the most recent breakpoint or watchpoint stop */
+cpu_status_t timeline_reverse_continue(timeline_t *tl,
+                                       breakpoint_t *breakpoints, bool *found)
+{
+    if (found)
+        *found = false;
+
+    if (!tl || tl->count == 0)
+        return CPU_ERROR_INVALID_ARGUMENT;
+
+    cpu_6502_t *cpu = tl->cpu;
+    uint64_t now = cpu->clock.cycle_count;
+    int newest = checkpoint_before(tl, now, true);
+    cpu_status_t status = CPU_SUCCESS;
+    bool hit = false;
+    uint64_t hit_cycle = 0;
+    replay_pacing_t pacing = replay_begin(tl);
+
+    // Search the stretches between checkpoints from the newest back; the
+    // last stop in the first stretch that has one is the one
+    for (int i = newest; i >= 0 && !hit && status == CPU_SUCCESS; i--)
+    {
+        uint64_t end = (i == newest) ? now : checkpoint_at(tl, i + 1)->cycle;
+        uint64_t next = checkpoint_at(tl, i)->event_index;
+
+        if ((status = restore(tl, i)) != CPU_SUCCESS)
+            break;
+
+        // A slice never stops at the PC it starts from
+        if (breakpoints && breakpoint_check(breakpoints, cpu->reg.PC))
+        {
+            hit = true;
+            hit_cycle = cpu->clock.cycle_count;
+        }
+
+        replay_result_t result;
+
+        while ((result = replay_run(tl, &next, end, breakpoints, true)) ==
+                   REPLAY_HIT &&
+               cpu->clock.cycle_count < end)
+        {
+            hit = true;
+            hit_cycle = cpu->clock.cycle_count;
+        }
+
+        if (result == REPLAY_ERROR)
+            status = CPU_ERROR_INVALID_OPCODE;
+    }
+
+    // Back to the stop, or to where we were
+    if (status == CPU_SUCCESS)
+    {
+        uint64_t target = hit ? hit_cycle : now;
+
+        status = travel(tl, checkpoint_before(tl, target, false), target,
+                        breakpoints);
+    }
+
+    replay_end(tl, pacing);
+
+    if (found)
+        *found = hit && status == CPU_SUCCESS;
+
+    return status;
+}
+
+/* Returns the oldest cycle the timeline can go back to */
+uint64_t timeline_oldest_cycle(const timeline_t *tl)
+{
+    if (tl->count == 0)
+        return tl->cpu->clock.cycle_count;
+
+    return tl->checkpoints[tl->first].cycle;
+}
+
+/* Returns the bytes the checkpoints and the log take up */
+size_t timeline_memory_used(const timeline_t *tl)
+{
+    size_t used = tl->base.capacity + tl->latest.capacity +
+                  tl->scratch.capacity + tl->step.capacity +
+                  tl->event_capacity * sizeof(timeline_event_t) +
+                  (size_t)tl->capacity * sizeof(timeline_checkpoint_t);
+
+    for (int i = 0; i < tl->capacity; i++)
+        used += tl->checkpoints[i].delta_capacity;
+
+    return used;
+}
@@ -0,0 +1,214 @@
+// timeline.h
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "cpu_6502.h"
+#include "queue.h"
+#include "snapshot.h"
+
+/*
+ * Reverse execution: checkpoints plus a log of everything the CPU cannot
+ * work out by itself, so any past cycle can be rebuilt by restoring the
+ * checkpoint before it and running forward again.
+ *
+ * A checkpoint is taken every `interval` cycles (timeline_tick). The oldest
+ * one kept is a full snapshot; each later one only stores the snapshot
+ * records (storage pages, device state, CPU) that changed since the one
+ * before, plus the serial input that was waiting in the CPU's input ring.
+ * At most `capacity` checkpoints are kept: when the ring is full, the
+ * oldest is folded into the next one and dropped, along with the log
+ * entries before it, so memory stays bounded.
+ *
+ * The log holds the serial bytes and the IRQ and NMI injections, stamped
+ * with the cycle they were delivered on. Both only reach the CPU through
+ * the timeline (timeline_send_input, timeline_interrupt) and only between
+ * cpu_run_cycles() calls or from scheduler callbacks, i.e. on instruction
+ * boundaries, where a replay can deliver them again on the same cycle.
+ * Everything else the machine does is a function of its state, so a replay
+ * runs through exactly the same states.
+ *
+ * Going back (timeline_goto, timeline_step_back, timeline_reverse_continue)
+ * replays from the nearest checkpoint and then drops the checkpoints and
+ * log entries after the new present: running on from there records a new
+ * future. Going past the present just runs the CPU. Replays run in virtual
+ * time with idle-loop skipping off, so they never sleep or block whatever
+ * the clock mode; the mode, frequency and skipping are put back after.
+ *
+ * Not covered: events host code put on the scheduler, and the host side of
+ * the rings (bytes already sent to the output ring stay sent; a replay
+ * sends them again). Changing the machine from outside (loading a program,
+ * setting PC, changing the clock frequency) must be followed by
+ * timeline_start(), which starts over from the current state.
+ *
+ * All functions run on the thread that runs the CPU.
+ */
+
+#define TIMELINE_DEFAULT_INTERVAL 1000000 // Cycles between checkpoints
+#define TIMELINE_DEFAULT_CAPACITY 64      // Checkpoints kept
+#define TIMELINE_STEP_WINDOW 64 // Cycles stepped one by one to find the
+                                // instruction before the present
+
+/* Logged events */
+typedef enum
+{
+    TIMELINE_INPUT, // Serial byte put in the input ring
+    TIMELINE_IRQ,
+    TIMELINE_NMI
+} timeline_event_type_t;
+
+typedef struct
+{
+    uint64_t cycle; // cycle_count when delivered
+    uint8_t type;   // timeline_event_type_t
+    uint8_t data;   // The byte, for TIMELINE_INPUT
+} timeline_event_t;
+
+/* A checkpoint */
+typedef struct
+{
+    uint64_t cycle;
+    uint64_t event_index; // Log entries delivered before it (absolute)
+
+    /* Changed snapshot records since the previous checkpoint: runs of
+     * {uint32_t offset, uint32_t length, bytes} into the full snapshot.
+     * Unused for the oldest checkpoint, which is tl->base. */
+    uint8_t *delta;
+    size_t delta_size, delta_capacity;
+
+    /* Input ring contents at the checkpoint */
+    uint8_t input[QUEUE_SIZE];
+    size_t input_count;
+} timeline_checkpoint_t;
+
+/* Timeline */
+typedef struct
+{
+    cpu_6502_t *cpu;
+    uint64_t interval;
+    int capacity;
+
+    timeline_checkpoint_t *checkpoints; // Ring of capacity entries
+    int first, count;
+    uint64_t next_checkpoint; // Cycle the next one is due
+
+    cpu_snapshot_t base;    // Full state at the oldest checkpoint
+    cpu_snapshot_t latest;  // Full state at the newest one
+    cpu_snapshot_t scratch; // Saves and rebuilt checkpoints
+
+    /* Where timeline_step_back() started stepping one instruction at a
+     * time: the state, and its cycle, log position and input ring */
+    cpu_snapshot_t step;
+    timeline_checkpoint_t step_at; // No delta
+
+    timeline_event_t *events; // Log entries from events_base on
+    size_t event_count, event_capacity;
+    uint64_t events_base; // Absolute index of events[0]
+
+    bool replaying; // Injections come from the log, not from callers
+} timeline_t;
+
+/**
+ * @brief Creates an empty timeline for a CPU.
+ *
+ * @param cpu CPU to record; must outlive the timeline.
+ * @param interval Cycles between checkpoints (0 for the default).
+ * @param capacity Checkpoints kept, at least 2 (0 for the default).
+ * @return Pointer to the timeline, or NULL on failure.
+ */
+timeline_t *timeline_create(cpu_6502_t *cpu, uint64_t interval, int capacity);
+
+/**
+ * @brief Frees a timeline.
+ *
+ * @param tl Pointer to the timeline.
+ */
+void timeline_destroy(timeline_t *tl);
+
+/**
+ * @brief Forgets the past and takes the first checkpoint now.
+ *
+ * @param tl Pointer to the timeline.
+ * @return CPU_SUCCESS, or CPU_ERROR_MEMORY_OVERFLOW (the timeline is then
+ * empty until the next attempt).
+ */
+cpu_status_t timeline_start(timeline_t *tl);
+
+/**
+ * @brief Takes a checkpoint if one is due. Call between cpu_run_cycles()
+ * calls; starts the timeline if it is empty.
+ *
+ * @param tl Pointer to the timeline.
+ */
+void timeline_tick(timeline_t *tl);
+
+/**
+ * @brief Puts serial bytes in the CPU's input ring and logs them.
+ *
+ * @param tl Pointer to the timeline.
+ * @param bytes Bytes to send.
+ * @param count Number of bytes.
+ * @return Bytes sent; fewer than count when the ring is full.
+ */
+size_t timeline_send_input(timeline_t *tl, const uint8_t *bytes, size_t count);
+
+/**
+ * @brief Injects an IRQ or NMI and logs it. Ignored while replaying, when
+ * the log decides which interrupts happen.
+ *
+ * @param tl Pointer to the timeline.
+ * @param nmi true for an NMI, false for an IRQ.
+ */
+void timeline_interrupt(timeline_t *tl, bool nmi);
+
+/**
+ * @brief Moves the machine to the first instruction boundary at or after a
+ * cycle, before the events logged for that cycle.
+ *
+ * @param tl Pointer to the timeline.
+ * @param cycle Target cycle, no older than the oldest checkpoint.
+ * @return CPU_SUCCESS, CPU_ERROR_INVALID_ARGUMENT if the cycle is no longer
+ * kept, or the error cpu_run_cycles() returned.
+ */
+cpu_status_t timeline_goto(timeline_t *tl, uint64_t cycle);
+
+/**
+ * @brief Goes back to the instruction boundary before the current one.
+ *
+ * @param tl Pointer to the timeline.
+ * @return As timeline_goto().
+ */
+cpu_status_t timeline_step_back(timeline_t *tl);
+
+/**
+ * @brief Goes back to the most recent breakpoint or watchpoint stop before
+ * the current cycle, or stays put if there is none in the timeline.
+ *
+ * @param tl Pointer to the timeline.
+ * @param breakpoints Breakpoints to look for, or NULL for watchpoints only.
+ * @param found Set to whether a stop was found.
+ * @return As timeline_goto().
+ */
+cpu_status_t timeline_reverse_continue(timeline_t *tl,
+                                       breakpoint_t *breakpoints, bool *found);
+
+/**
+ * @brief Returns the oldest cycle the timeline can go back to.
+ *
+ * @param tl Pointer to the timeline.
+ * @return The cycle of the oldest checkpoint, or the current cycle if there
+ * is none.
+ */
+uint64_t timeline_oldest_cycle(const timeline_t *tl);
+
+/**
+ * @brief Returns the bytes the checkpoints and the log take up.
+ *
+ * @param tl Pointer to the timeline.
+ * @return Bytes allocated.
+ */
+size_t timeline_memory_used(const timeline_t *tl);
+
+#endif // TIMELINE_H
@@ -0,0 +1,1082 @@
+// trace.c
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include "trace.h"
+
+/* Encoding */
+
+static uint8_t *put_varint(uint8_t *out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        *out++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = (uint8_t)value;
+    return out;
+}
+
+/* Small changes either way stay small */
+static uint64_t zigzag(int32_t value)
+{
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static int32_t unzigzag(uint64_t value)
+{
+    return (int32_t)((uint32_t)(value >> 1) ^ -(uint32_t)(value & 1));
+}
+
+/* Encode a record against the one before it */
+static uint8_t *encode_record(uint8_t *out, const trace_record_t *record,
+                              const trace_record_t *previous)
+{
+    uint8_t flags = (uint8_t)(record->access << 6);
+
+    flags |= (record->a != previous->a) ? TRACE_CHANGED_A : 0;
+    flags |= (record->x != previous->x) ? TRACE_CHANGED_X : 0;
+    flags |= (record->y != previous->y) ? TRACE_CHANGED_Y : 0;
+    flags |= (record->p != previous->p) ? TRACE_CHANGED_P : 0;
+    flags |= (record->sp != previous->sp) ? TRACE_CHANGED_SP : 0;
+
+    *out++ = flags;
+    *out++ = record->opcode;
+    out = put_varint(out, record->cycle - previous->cycle);
+    out = put_varint(out, zigzag((int32_t)record->pc - previous->pc));
+
+    if (flags & TRACE_CHANGED_A)
+        *out++ = record->a;
+    if (flags & TRACE_CHANGED_X)
+        *out++ = record->x;
+    if (flags & TRACE_CHANGED_Y)
+        *out++ = record->y;
+    if (flags & TRACE_CHANGED_P)
+        *out++ = record->p;
+    if (flags & TRACE_CHANGED_SP)
+        *out++ = record->sp;
+
+    if (record->access != TRACE_ACCESS_NONE)
+    {
+        out = put_varint(out, zigzag((int32_t)record->addr - previous->addr));
+        *out++ = record->value;
+    }
+
+    return out;
+}
+
+/* Encode a block and write it; false if the write failed */
+static bool write_block(tracer_t *tracer, const trace_block_t *block)
+{
+    trace_record_t previous;
+    uint8_t *out = tracer->encoded;
+
+    memset(&previous, 0, sizeof(previous));
+    previous.cycle = tracer->next_cycle;
+
+    for (uint32_t i = 0; i < block->count; i++)
+    {
+        const trace_record_t *record = &block->records[i];
+
+        // The addresses a record carries count from the last one it had
+        uint16_t addr = previous.addr;
+
+        out = encode_record(out, record, &previous);
+        previous = *record;
+        if (record->access == TRACE_ACCESS_NONE)
+            previous.addr = addr;
+    }
+
+    trace_block_header_t header = {tracer->next_cycle, block->count,
+                                   (uint32_t)(out - tracer->encoded)};
+
+    tracer->next_cycle = previous.cycle;
+
+    if (fwrite(&header, sizeof(header), 1, tracer->file) != 1 ||
+        fwrite(tracer->encoded, 1, header.size, tracer->file) != header.size)
+        return false;
+
+    tracer->bytes_written += sizeof(header) + header.size;
+    return true;
+}
+
+/* Writer Thread */
+
+static void *writer_thread(void *arg)
+{
+    tracer_t *tracer = (tracer_t *)arg;
+
+    pthread_mutex_lock(&tracer->mutex);
+
+    for (;;)
+    {
+        while (tracer->full_count == 0 && !tracer->closing)
+            pthread_cond_wait(&tracer->work, &tracer->mutex);
+
+        if (tracer->full_count == 0)
+            break; // Closing and nothing left
+
+        trace_block_t *block = tracer->full[0];
+        bool failed = tracer->failed;
+
+        // Encode and write without holding up the CPU thread
+        pthread_mutex_unlock(&tracer->mutex);
+
+        if (!failed && !write_block(tracer, block))
+            failed = true;
+
+        pthread_mutex_lock(&tracer->mutex);
+
+        tracer->failed = failed;
+        tracer->full_count--;
+        memmove(&tracer->full[0], &tracer->full[1],
+                tracer->full_count * sizeof(tracer->full[0]));
+
+        block->count = 0;
+        tracer->free[tracer->free_count++] = block;
+        pthread_cond_signal(&tracer->room);
+    }
+
+    pthread_mutex_unlock(&tracer->mutex);
+    return NULL;
+}
+
+/* Tracer */
+
+/* Creates a tracer writing to a file */
+tracer_t *tracer_create(const char *path)
+{
+    if (!path)
+        return NULL;
+
+    tracer_t *tracer = calloc(1, sizeof(tracer_t));
+
+    if (!tracer)
+        return NULL;
+
+    tracer->encoded = malloc((size_t)TRACE_BLOCK_RECORDS *
+                             TRACE_RECORD_MAX_BYTES);
+    bool allocated = tracer->encoded != NULL;
+
+    for (int i = 0; i < TRACE_BLOCKS && allocated; i++)
+    {
+        tracer->blocks[i] = calloc(1, sizeof(trace_block_t));
+        allocated = tracer->blocks[i] != NULL;
+    }
+
+    if (!allocated)
+    {
+        fprintf(stderr, "tracer_create: Failed to allocate buffers.\n");
+        goto fail;
+    }
+
+    tracer->file = fopen(path, "wb");
+
+    if (!tracer->file)
+    {
+        perror("Error creating trace file");
+        goto fail;
+    }
+
+    trace_file_header_t header;
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    header.version = TRACE_VERSION;
+    header.byte_order = TRACE_BYTE_ORDER;
+
+    if (fwrite(&header, sizeof(header), 1, tracer->file) != 1)
+    {
+        perror("Error writing trace file");
+        goto fail;
+    }
+    tracer->bytes_written = sizeof(header);
+
+    tracer->current = tracer->blocks[0];
+    for (int i = 1; i < TRACE_BLOCKS; i++)
+        tracer->free[tracer->free_count++] = tracer->blocks[i];
+
+    pthread_mutex_init(&tracer->mutex, NULL);
+    pthread_cond_init(&tracer->work, NULL);
+    pthread_cond_init(&tracer->room, NULL);
+
+    if (pthread_create(&tracer->writer, NULL, writer_thread, tracer) != 0)
+    {
+        fprintf(stderr, "tracer_create: Failed to start the writer.\n");
+        pthread_mutex_destroy(&tracer->mutex);
+        pthread_cond_destroy(&tracer->work);
+        pthread_cond_destroy(&tracer->room);
+        goto fail;
+    }
+
+    return tracer;
+
+fail:
+    if (tracer->file)
+        fclose(tracer->file);
+    for (int i = 0; i < TRACE_BLOCKS; i++)
+        free(tracer->blocks[i]);
+    free(tracer->encoded);
+    free(tracer);
+    return NULL;
+}
+
+/* Hands the current block to the writer thread and takes a free one */
+void tracer_submit(tracer_t *tracer)
+{
+    pthread_mutex_lock(&tracer->mutex);
+
+    tracer->full[tracer->full_count++] = tracer->current;
+    pthread_cond_signal(&tracer->work);
+
+    // Only wait when the writer is TRACE_BLOCKS - 1 blocks behind
+    while (tracer->free_count == 0)
+        pthread_cond_wait(&tracer->room, &tracer->mutex);
+
+    tracer->current = tracer->free[--tracer->free_count];
+
+    pthread_mutex_unlock(&tracer->mutex);
+}
+
+/* Writes out what is left and frees the tracer */
+cpu_status_t tracer_destroy(tracer_t *tracer)
+{
+    if (!tracer)
+        return CPU_ERROR_INVALID_ARGUMENT;
+
+    pthread_mutex_lock(&tracer->mutex);
+
+    if (tracer->current->count)
+        tracer->full[tracer->full_count++] = tracer->current;
+    tracer->closing = true;
+    pthread_cond_signal(&tracer->work);
+
+    pthread_mutex_unlock(&tracer->mutex);
+    pthread_join(tracer->writer, NULL);
+
+    bool failed = tracer->failed;
+
+    if (fclose(tracer->file) != 0)
+        failed = true;
+    if (failed)
+        fprintf(stderr, "tracer_destroy: Failed to write the trace.\n");
+
+    pthread_mutex_destroy(&tracer->mutex);
+    pthread_cond_destroy(&tracer->work);
+    pthread_cond_destroy(&tracer->room);
+
+    for (int i = 0; i < TRACE_BLOCKS; i++)
+        free(tracer->blocks[i]);
+    free(tracer->encoded);
+    free(tracer);
+
+    return failed ? CPU_ERROR_WRITE_FAILED : CPU_SUCCESS;
+}
+
+/* Reader */
+
+/* Opens a trace file for reading */
+cpu_status_t trace_reader_open(trace_reader_t *reader, const char *path)
+{
+    if (!reader || !path)
+        return CPU_ERROR_INVALID_ARGUMENT;
+
+    memset(reader, 0, sizeof(*reader));
+    reader->file = fopen(path, "rb");
+
+    if (!reader->file)
+    {
+        perror("Error opening trace file");
+        return CPU_ERROR_FILE_NOT_FOUND;
+    }
+
+    trace_file_header_t header;
+
+    if (fread(&header, sizeof(header), 1, reader->file) != 1 ||
+        memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != TRACE_VERSION ||
+        header.byte_order != TRACE_BYTE_ORDER)
+    {
+        fclose(reader->file);
+        reader->file = NULL;
+        return CPU_ERROR_INVALID_ARGUMENT;
+    }
+
+    return CPU_SUCCESS;
+}
+
+/* Read the next block; false at the end of the file or on an error */
+static bool read_block(trace_reader_t *reader)
+{
+    trace_block_header_t header;
+    size_t got = fread(&header, 1, sizeof(header), reader->file);
+
+    if (got != sizeof(header))
+    {
+        reader->error = got != 0; // A partial header is a truncated file
+        return false;
+    }
+
+    if (header.size > (size_t)header.records * TRACE_RECORD_MAX_BYTES ||
+        (header.records == 0) != (header.size == 0))
+    {
+        reader->error = true;
+        return false;
+    }
+
+    if (header.size > reader->capacity)
+    {
+        uint8_t *data = realloc(reader->data, header.size);
+
+        if (!data)
+        {
+            reader->error = true;
+            return false;
+        }
+        reader->data = data;
+        reader->capacity = header.size;
+    }
+
+    if (fread(reader->data, 1, header.size, reader->file) != header.size)
+    {
+        reader->error = true;
+        return false;
+    }
+
+    reader->size = header.size;
+    reader->offset = 0;
+    reader->left = header.records;
+
+    memset(&reader->previous, 0, sizeof(reader->previous));
+    reader->previous.cycle = header.first_cycle;
+
+    return true;
+}
+
+static bool get_byte(trace_reader_t *reader, uint8_t *byte)
+{
+    if (reader->offset == reader->size)
+        return false;
+
+    *byte = reader->data[reader->offset++];
+    return true;
+}
+
+static bool get_varint(trace_reader_t *reader, uint64_t *value)
+{
+    uint8_t byte;
+
+    *value = 0;
+
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        if (!get_byte(reader, &byte))
+            return false;
+
+        *value |= (uint64_t)(byte & 0x7F) << shift;
+
+        if (!(byte & 0x80))
+            return true;
+    }
+
+    return false;
+}
+
+/* Decodes the next record */
+bool trace_reader_next(trace_reader_t *reader, trace_record_t *record)
+{
+    if (!reader || !reader->file || reader->error)
+        return false;
+
+    while (reader->left == 0)
+        if (!read_block(reader))
+            return false;
+
+    trace_record_t next = reader->previous;
+    uint8_t flags = 0;
+    uint64_t delta = 0, pc = 0;
+    bool ok = get_byte(reader, &flags) && get_byte(reader, &next.opcode) &&
+              get_varint(reader, &delta) && get_varint(reader, &pc);
+
+    next.cycle += delta;
+    next.pc = (uint16_t)(next.pc + unzigzag(pc));
+    next.access = flags >> 6;
+
+    if (flags & TRACE_CHANGED_A)
+        ok = ok && get_byte(reader, &next.a);
+    if (flags & TRACE_CHANGED_X)
+        ok = ok && get_byte(reader, &next.x);
+    if (flags & TRACE_CHANGED_Y)
+        ok = ok && get_byte(reader, &next.y);
+    if (flags & TRACE_CHANGED_P)
+        ok = ok && get_byte(reader, &next.p);
+    if (flags & TRACE_CHANGED_SP)
+        ok = ok && get_byte(reader, &next.sp);
+
+    if (next.access != TRACE_ACCESS_NONE)
+    {
+        uint64_t addr;
+
+        ok = ok && get_varint(reader, &addr) && get_byte(reader, &next.value);
+        next.addr = (uint16_t)(next.addr + unzigzag(addr));
+    }
+
+    // The last block ends with its last record
+    if (!ok || next.access > TRACE_ACCESS_WRITE ||
+        (--reader->left == 0) != (reader->offset == reader->size))
+    {
+        reader->error = true;
+        return false;
+    }
+
+    reader->previous = next;
+    *record = next;
+
+    // Records without an access leave the address where it was, as the
+    // encoder does
+    if (next.access == TRACE_ACCESS_NONE)
+    {
+        record->addr = 0;
+        record->value = 0;
+    }
+
+    return true;
+}
+
+/* Closes a reader */
+void trace_reader_close(trace_reader_t *reader)
+{
+    if (!reader)
+        return;
+
+    if (reader->file)
+        fclose(reader->file);
+    free(reader->data);
+    memset(reader, 0, sizeof(*reader));
+}
+
+/* Formats a record as one line of text */
+void trace_format(const trace_record_t *record, char *buffer, size_t size)
+{
+    int length = snprintf(buffer, size,
+                          "%04X  %02X  A:%02X X:%02X Y:%02X P:%02X SP:%02X "
+                          "CYC:%llu",
+                          record->pc, record->opcode, record->a, record->x,
+                          record->y, record->p, record->sp,
+                          (unsigned long long)record->cycle);
+
+    if (record->access != TRACE_ACCESS_NONE && length > 0 &&
+        (size_t)length < size)
+        snprintf(buffer + length, size - length, "  %s $%04X=%02X",
+                 record->access == TRACE_ACCESS_WRITE ? "W" : "R",
+                 record->addr, record->value);
+}
+
+/* Comparing */
+
+/* A trace being compared: a binary trace or a text log */
+typedef struct
+{
+    trace_reader_t reader;
+    FILE *text;       // Text log, or NULL for a binary trace
+    uint64_t line;    // Lines read from the text log
+    unsigned fields;  // TRACE_FIELD_* it has
+    bool started;     // fields is known
+    uint64_t first_cycle;
+    bool error;
+} diff_source_t;
+
+/* A record reduced to the fields compared. No padding, so blocks of keys
+ * compare with memcmp(). */
+typedef struct
+{
+    uint32_t cycles_low, cycles_high; // Since the trace's first record
+    uint16_t pc, addr;
+    uint8_t opcode, a, x, y, p, sp, access, value;
+} trace_key_t;
+
+_Static_assert(sizeof(trace_key_t) == 20, "trace_key_t must have no padding");
+
+static cpu_status_t source_open(diff_source_t *source, const char *path)
+{
+    memset(source, 0, sizeof(*source));
+
+    cpu_status_t status = trace_reader_open(&source->reader, path);
+
+    if (status == CPU_SUCCESS)
+        source->fields = TRACE_FIELD_CYCLES | TRACE_FIELD_ACCESS;
+
+    if (status != CPU_ERROR_INVALID_ARGUMENT)
+        return status;
+
+    // Not a binary trace: read it as a text log
+    source->text = fopen(path, "r");
+
+    return source->text ? CPU_SUCCESS : CPU_ERROR_FILE_NOT_FOUND;
+}
+
+static void source_close(diff_source_t *source)
+{
+    if (source->text)
+        fclose(source->text);
+    else
+        trace_reader_close(&source->reader);
+}
+
+/* Parse "PC  OPCODE ... A:xx X:xx Y:xx P:xx SP:xx ... [CYC:n]" */
+static bool parse_log_line(const char *line, trace_record_t *record,
+                           bool *has_cycles)
+{
+    unsigned pc, opcode, a, x, y, p, sp;
+    unsigned long long cycle = 0;
+    const char *registers = strstr(line, "A:");
+
+    if (sscanf(line, "%4x %2x", &pc, &opcode) != 2 || !registers ||
+        sscanf(registers, "A:%2x X:%2x Y:%2x P:%2x SP:%2x", &a, &x, &y, &p,
+               &sp) != 5)
+        return false;
+
+    const char *cycles = strstr(registers, "CYC:");
+
+    *has_cycles = cycles && sscanf(cycles, "CYC:%llu", &cycle) == 1;
+
+    memset(record, 0, sizeof(*record));
+    record->cycle = cycle;
+    record->pc = (uint16_t)pc;
+    record->opcode = (uint8_t)opcode;
+    record->a = (uint8_t)a;
+    record->x = (uint8_t)x;
+    record->y = (uint8_t)y;
+    record->p = (uint8_t)p;
+    record->sp = (uint8_t)sp;
+
+    return true;
+}
+
+/* The next record; false at the end or on an error (source->error) */
+static bool source_next(diff_source_t *source, trace_record_t *record)
+{
+    if (source->error)
+        return false;
+
+    if (!source->text)
+    {
+        bool ok = trace_reader_next(&source->reader, record);
+
+        source->error = source->reader.error;
+        source->started = true;
+        return ok;
+    }
+
+    char line[512];
+
+    while (fgets(line, sizeof(line), source->text))
+    {
+        bool has_cycles;
+
+        source->line++;
+
+        if (strspn(line, " \t\r\n") == strlen(line))
+            continue; // Blank line
+
+        // The first line decides whether the log has cycle counts
+        if (!parse_log_line(line, record, &has_cycles) ||
+            (source->started &&
+             has_cycles != ((source->fields & TRACE_FIELD_CYCLES) != 0)))
+        {
+            source->error = true;
+            return false;
+        }
+
+        if (!source->started)
+            source->fields = has_cycles ? TRACE_FIELD_CYCLES : 0;
+        source->started = true;
+        return true;
+    }
+
+    return false;
+}
+
+/* Read up to max records */
+static size_t source_read(diff_source_t *source, trace_record_t *records,
+                          size_t max)
+{
+    size_t count = 0;
+
+    while (count < max && source_next(source, &records[count]))
+        count++;
+
+    return count;
+}
+
+static void make_keys(const trace_record_t *records, trace_key_t *keys,
+                      size_t count, uint64_t first_cycle, unsigned fields,
+                      uint8_t p_mask)
+{
+    memset(keys, 0, count * sizeof(*keys));
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const trace_record_t *record = &records[i];
+        trace_key_t *key = &keys[i];
+
+        if (fields & TRACE_FIELD_CYCLES)
+        {
+            uint64_t cycles = record->cycle - first_cycle;
+
+            key->cycles_low = (uint32_t)cycles;
+            key->cycles_high = (uint32_t)(cycles >> 32);
+        }
+
+        key->pc = record->pc;
+        key->opcode = record->opcode;
+        key->a = record->a;
+        key->x = record->x;
+        key->y = record->y;
+        key->p = record->p & p_mask;
+        key->sp = record->sp;
+
+        if (fields & TRACE_FIELD_ACCESS)
+        {
+            key->access = record->access;
+            key->addr = record->addr;
+            key->value = record->value;
+        }
+    }
+}
+
+/* Name the fields two keys differ in */
+static void describe_difference(const trace_key_t *a, const trace_key_t *b,
+                                char *buffer, size_t size)
+{
+    const struct
+    {
+        bool differs;
+        const char *name;
+    } fields[] = {
+        {a->pc != b->pc, "PC"},
+        {a->opcode != b->opcode, "opcode"},
+        {a->a != b->a, "A"},
+        {a->x != b->x, "X"},
+        {a->y != b->y, "Y"},
+        {a->p != b->p, "P"},
+        {a->sp != b->sp, "SP"},
+        {a->cycles_low != b->cycles_low || a->cycles_high != b->cycles_high,
+         "cycles"},
+        {a->access != b->access || a->addr != b->addr || a->value != b->value,
+         "access"},
+    };
+    size_t length = 0;
+
+    buffer[0] = '\0';
+
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++)
+        if (fields[i].differs && length < size)
+            length += snprintf(buffer + length, size - length, "%s%s",
+                               length ? ", " : "", fields[i].name);
+}
+
+/* One side of the report: the differing record and what follows it */
+static void report_side(FILE *report, char mark, diff_source_t *source,
+                        const trace_record_t *records, size_t count,
+                        size_t from, int context)
+{
+    trace_record_t record;
+    char line[128];
+
+    for (int k = 0; k <= context; k++)
+    {
+        if (from + k < count)
+            record = records[from + k];
+        else if (!source_next(source, &record))
+        {
+            if (k == 0)
+                fprintf(report, "%c (end of trace)\n", mark);
+            break;
+        }
+
+        trace_format(&record, line, sizeof(line));
+        fprintf(report, "%c %s\n", mark, line);
+    }
+}
+
+/* Compares two traces and reports the first difference */
+cpu_status_t trace_diff(const char *path_a, const char *path_b,
+                        const trace_diff_options_t *options,
+                        trace_diff_result_t *result)
+{
+    if (!path_a || !path_b || !options || !result)
+        return CPU_ERROR_INVALID_ARGUMENT;
+
+    memset(result, 0, sizeof(*result));
+
+    diff_source_t a, b;
+    cpu_status_t status = source_open(&a, path_a);
+
+    if (status != CPU_SUCCESS)
+        return status;
+
+    if ((status = source_open(&b, path_b)) != CPU_SUCCESS)
+    {
+        source_close(&a);
+        return status;
+    }
+
+    trace_record_t *records_a = malloc(TRACE_DIFF_BLOCK * sizeof(*records_a));
+    trace_record_t *records_b = malloc(TRACE_DIFF_BLOCK * sizeof(*records_b));
+    trace_key_t *keys_a = malloc(TRACE_DIFF_BLOCK * sizeof(*keys_a));
+    trace_key_t *keys_b = malloc(TRACE_DIFF_BLOCK * sizeof(*keys_b));
+
+    // The last records that matched, for the report
+    trace_record_t history[TRACE_DIFF_MAX_CONTEXT];
+    uint64_t kept = 0;
+    bool first = true;
+    int context = options->context;
+
+    if (context < 0)
+        context = 0;
+    if (context > TRACE_DIFF_MAX_CONTEXT)
+        context = TRACE_DIFF_MAX_CONTEXT;
+
+    if (!records_a || !records_b || !keys_a || !keys_b)
+        status = CPU_ERROR_MEMORY_OVERFLOW;
+
+    while (status == CPU_SUCCESS)
+    {
+        size_t count_a = source_read(&a, records_a, TRACE_DIFF_BLOCK);
+        size_t count_b = source_read(&b, records_b, TRACE_DIFF_BLOCK);
+
+        if (a.error || b.error)
+        {
+            diff_source_t *bad = a.error ? &a : &b;
+
+            if (bad->text)
+                fprintf(stderr, "Malformed log line %llu: %s\n",
+                        (unsigned long long)bad->line,
+                        a.error ? path_a : path_b);
+            else
+                fprintf(stderr, "Malformed trace file: %s\n",
+                        a.error ? path_a : path_b);
+            status = CPU_ERROR_INVALID_ARGUMENT;
+            break;
+        }
+
+        // Text logs only know what they have once read
+        if (first)
+        {
+            first = false;
+            if (count_a)
+                a.first_cycle = records_a[0].cycle;
+            if (count_b)
+                b.first_cycle = records_b[0].cycle;
+            result->fields = options->fields & a.fields & b.fields;
+        }
+
+        size_t count = count_a < count_b ? count_a : count_b;
+        size_t i = count;
+
+        make_keys(records_a, keys_a, count, a.first_cycle, result->fields,
+                  options->p_mask);
+        make_keys(records_b, keys_b, count, b.first_cycle, result->fields,
+                  options->p_mask);
+
+        // Whole blocks at once; record by record only to find the spot
+        if (memcmp(keys_a, keys_b, count * sizeof(trace_key_t)) != 0)
+            for (i = 0; memcmp(&keys_a[i], &keys_b[i], sizeof(trace_key_t)) == 0;
+                 i++)
+                ;
+
+        for (size_t k = (i > (size_t)context) ? i - context : 0;
+             context && k < i; k++)
+            history[kept++ % context] = records_a[k];
+
+        result->index += i;
+
+        if (i == count && count_a == count_b)
+        {
+            if (count == 0)
+                break; // Both ended together
+            continue;
+        }
+
+        result->diverged = true;
+        result->ended_a = i == count_a;
+        result->ended_b = i == count_b;
+        if (!result->ended_a)
+            result->a = records_a[i];
+        if (!result->ended_b)
+            result->b = records_b[i];
+
+        if (!options->report)
+            break;
+
+        FILE *report = options->report;
+        char fields[80] = "length";
+        char line[128];
+
+        if (!result->ended_a && !result->ended_b)
+            describe_difference(&keys_a[i], &keys_b[i], fields,
+                                sizeof(fields));
+
+        fprintf(report, "First difference at record %llu (%s):\n",
+                (unsigned long long)result->index, fields);
+
+        for (uint64_t k = kept > (uint64_t)context ? kept - context : 0;
+             k < kept; k++)
+        {
+            trace_format(&history[k % context], line, sizeof(line));
+            fprintf(report, "  %s\n", line);
+        }
+
+        report_side(report, '<', &a, records_a, count_a, i, context);
+        report_side(report, '>', &b, records_b, count_b, i, context);
+        break;
+    }
+
+    free(records_a);
+    free(records_b);
+    free(keys_a);
+    free(keys_b);
+    source_close(&a);
+    source_close(&b);
+
+    return status;
+}
+
+/* Trace Tool */
+
+/* Which records "print" shows */
+typedef struct
+{
+    bool has_pc;
+    uint16_t pc_low, pc_high; // Inclusive range
+    int opcode;               // -1 for any
+    bool has_addr;
+    uint16_t addr;            // Data address
+    uint64_t skip, count;     // Matching records to skip, then to print
+} trace_filter_t;
+
+static void print_tool_usage(void)
+{
+    fprintf(stderr,
+            "Usage: emu65 --trace print FILE [--pc ADDR[-ADDR]]\n"
+            "                   [--opcode OP] [--addr ADDR]\n"
+            "                   [--skip N] [--count N]\n"
+            "       emu65 --trace diff FILE FILE [--context N]\n"
+            "                   [--ignore-cycles] [--ignore-access]\n"
+            "                   [--p-mask MASK]\n"
+            "\n"
+            "  print  Shows the records that pass every filter given\n"
+            "  diff   Shows the first record where two traces differ, with\n"
+            "         N records around it (default 5); either FILE may be\n"
+            "         a nestest-style text log\n"
+            "\n"
+            "Numbers are decimal, 0x or $ prefixed hexadecimal.\n"
+            "Exit codes: 0 success or no difference, 1 the traces differ,\n"
+            "2 error.\n");
+}
+
+/* Parses a decimal, 0x or $ prefixed number no larger than max */
+bool trace_parse_number(const char *text, uint64_t max, uint64_t *value)
+{
+    int base = 10; // A leading zero is not octal
+    char *end;
+
+    if (text[0] == '$')
+    {
+        text++;
+        base = 16;
+    }
+    else if (text[0] == '0' && (text[1] == 'x' || text[1] == 'X'))
+    {
+        text += 2;
+        base = 16;
+    }
+
+    // strtoull() would take a sign, spaces or another 0x
+    if (!isxdigit((unsigned char)text[0]) ||
+        (base == 16 && (text[1] == 'x' || text[1] == 'X')))
+        return false;
+
+    unsigned long long parsed = strtoull(text, &end, base);
+
+    if (*end || parsed > max)
+        return false;
+
+    *value = parsed;
+    return true;
+}
+
+static bool parse_filter(int argc, char *argv[], trace_filter_t *filter)
+{
+    memset(filter, 0, sizeof(*filter));
+    filter->opcode = -1;
+    filter->count = UINT64_MAX;
+
+    for (int i = 0; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        uint64_t value, high;
+
+        if (i + 1 == argc)
+            return false;
+
+        const char *text = argv[++i];
+
+        if (strcmp(arg, "--pc") == 0)
+        {
+            char low[16];
+            const char *dash = strchr(text, '-');
+            size_t length = dash ? (size_t)(dash - text) : strlen(text);
+
+            if (length >= sizeof(low))
+                return false;
+
+            memcpy(low, text, length);
+            low[length] = '\0';
+
+            if (!trace_parse_number(low, 0xFFFF, &value) ||
+                (dash && !trace_parse_number(dash + 1, 0xFFFF, &high)))
+                return false;
+
+            filter->has_pc = true;
+            filter->pc_low = (uint16_t)value;
+            filter->pc_high = dash ? (uint16_t)high : (uint16_t)value;
+        }
+        else if (strcmp(arg, "--opcode") == 0 &&
+                 trace_parse_number(text, 0xFF, &value))
+            filter->opcode = (int)value;
+        else if (strcmp(arg, "--addr") == 0 &&
+                 trace_parse_number(text, 0xFFFF, &value))
+        {
+            filter->has_addr = true;
+            filter->addr = (uint16_t)value;
+        }
+        else if (strcmp(arg, "--skip") == 0 &&
+                 trace_parse_number(text, UINT64_MAX, &value))
+            filter->skip = value;
+        else if (strcmp(arg, "--count") == 0 &&
+                 trace_parse_number(text, UINT64_MAX, &value))
+            filter->count = value;
+        else
+            return false;
+    }
+
+    return true;
+}
+
+static bool filter_match(const trace_filter_t *filter,
+                         const trace_record_t *record)
+{
+    return (!filter->has_pc ||
+            (record->pc >= filter->pc_low && record->pc <= filter->pc_high)) &&
+           (filter->opcode < 0 || record->opcode == filter->opcode) &&
+           (!filter->has_addr || (record->access != TRACE_ACCESS_NONE &&
+                                  record->addr == filter->addr));
+}
+
+static int tool_print(const char *path, const trace_filter_t *filter)
+{
+    trace_reader_t reader;
+
+    if (trace_reader_open(&reader, path) != CPU_SUCCESS)
+    {
+        fprintf(stderr, "Not a trace file: %s\n", path);
+        return 2;
+    }
+
+    trace_record_t record;
+    uint64_t matched = 0, printed = 0;
+    char line[128];
+
+    while (printed < filter->count && trace_reader_next(&reader, &record))
+    {
+        if (!filter_match(filter, &record) || matched++ < filter->skip)
+            continue;
+
+        trace_format(&record, line, sizeof(line));
+        puts(line);
+        printed++;
+    }
+
+    bool error = reader.error;
+    trace_reader_close(&reader);
+
+    if (error)
+    {
+        fprintf(stderr, "Malformed trace file: %s\n", path);
+        return 2;
+    }
+
+    return 0;
+}
+
+static bool parse_diff_options(int argc, char *argv[],
+                               trace_diff_options_t *options)
+{
+    options->fields = TRACE_FIELD_CYCLES | TRACE_FIELD_ACCESS;
+    options->p_mask = 0xFF;
+    options->context = TRACE_DIFF_CONTEXT;
+    options->report = stdout;
+
+    for (int i = 0; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        uint64_t value;
+
+        if (strcmp(arg, "--ignore-cycles") == 0)
+            options->fields &= ~TRACE_FIELD_CYCLES;
+        else if (strcmp(arg, "--ignore-access") == 0)
+            options->fields &= ~TRACE_FIELD_ACCESS;
+        else if (i + 1 < argc && strcmp(arg, "--p-mask") == 0 &&
+                 trace_parse_number(argv[i + 1], 0xFF, &value))
+        {
+            options->p_mask = (uint8_t)value;
+            i++;
+        }
+        else if (i + 1 < argc && strcmp(arg, "--context") == 0 &&
+                 trace_parse_number(argv[i + 1], TRACE_DIFF_MAX_CONTEXT,
+                                    &value))
+        {
+            options->context = (int)value;
+            i++;
+        }
+        else
+            return false;
+    }
+
+    return true;
+}
+
+static int tool_diff(const char *path_a, const char *path_b,
+                     const trace_diff_options_t *options)
+{
+    trace_diff_result_t result;
+    cpu_status_t status = trace_diff(path_a, path_b, options, &result);
+
+    if (status != CPU_SUCCESS)
+        return 2;
+
+    if (!result.diverged)
+        printf("Traces match (%llu records).\n",
+               (unsigned long long)result.index);
+
+    return result.diverged ? 1 : 0;
+}
+
+/* Runs the trace tool */
+int trace_tool(int argc, char *argv[])
+{
+    trace_filter_t filter;
+
+    if (argc >= 2 && strcmp(argv[0], "print") == 0 &&
+        parse_filter(argc - 2, argv + 2, &filter))
+        return tool_print(argv[1], &filter);
+
+    trace_diff_options_t options;
+
+    if (argc >= 3 && strcmp(argv[0], "diff") == 0 &&
+        parse_diff_options(argc - 3, argv + 3, &options))
+        return tool_diff(argv[1], argv[2], &options);
+
+    print_tool_usage();
+    return 2;
+}
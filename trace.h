@@ -0,0 +1,302 @@
+// trace.h
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "cpu_6502.h"
+
+/*
+ * Binary execution traces.
+ *
+ * With a tracer set (cpu_set_tracer), the CPU records every instruction it
+ * executes: the registers and cycle count before it, the opcode, and the
+ * data byte it read or wrote. Records are appended to a block in memory
+ * that only the CPU thread touches; a full block goes to a writer thread,
+ * which encodes it and writes it out while the CPU fills the next one. The
+ * CPU only waits when all TRACE_BLOCKS blocks are waiting to be written.
+ *
+ * File layout, in host byte order: a trace_file_header_t, then blocks, each
+ * a trace_block_header_t followed by its records encoded against the record
+ * before them (the first against zero registers at first_cycle), so every
+ * block decodes on its own:
+ *
+ *   flags    byte: TRACE_CHANGED_* bits and the access kind in bits 6-7
+ *   opcode   byte
+ *   cycles   varint: cycles since the previous record
+ *   pc       zigzag varint: change from the previous PC
+ *   A X Y P SP, the ones flagged as changed, a byte each
+ *   addr     zigzag varint: change from the previous data address (only
+ *            with an access)
+ *   value    byte (only with an access)
+ *
+ * The data access is worked out from the addressing mode before the
+ * instruction runs, and the value is read back afterwards with bus_peek(),
+ * so tracing adds no bus accesses; for a store or read-modify-write it is
+ * the byte written. Stack, vector and operand fetches are not recorded.
+ * Immediate, relative and jump operands have no data access.
+ *
+ * Tracing always goes through the interpreter, like debug mode, and idle
+ * loops are not fast-forwarded while a tracer is set, so every iteration
+ * has its record.
+ *
+ * trace_diff() compares two traces record by record and reports the first
+ * one where they disagree. Either side may also be a text log with one
+ * instruction per line in the nestest style ("C000  4C F5 C5  JMP $C5F5
+ * ... A:00 X:00 Y:00 P:24 SP:FD ... CYC:7"), which is also what
+ * trace_format() prints. Text logs carry no data accesses, and the cycle
+ * count is optional. Records are decoded TRACE_DIFF_BLOCK at a time into
+ * keys without padding, holding only the fields compared, so a whole block
+ * is compared with one memcmp() and memory use does not grow with the
+ * traces.
+ */
+
+#define TRACE_MAGIC "E65T"
+#define TRACE_VERSION 1
+#define TRACE_BYTE_ORDER 0x0102 // Reads back as $0201 on the other order
+
+#define TRACE_BLOCK_RECORDS 16384 // Records per block
+#define TRACE_BLOCKS 4            // Blocks the CPU and the writer share
+
+/* Data access of an instruction */
+#define TRACE_ACCESS_NONE 0
+#define TRACE_ACCESS_READ 1
+#define TRACE_ACCESS_WRITE 2 // Stores and read-modify-write
+
+/* Registers stored in an encoded record (flag bits) */
+#define TRACE_CHANGED_A 0x01
+#define TRACE_CHANGED_X 0x02
+#define TRACE_CHANGED_Y 0x04
+#define TRACE_CHANGED_P 0x08
+#define TRACE_CHANGED_SP 0x10
+
+/* Longest encoded record: flags, opcode, 10-byte cycles, 3-byte PC, five
+ * registers, 3-byte address, value */
+#define TRACE_RECORD_MAX_BYTES 24
+
+#define TRACE_DIFF_BLOCK 4096      // Records compared per memcmp()
+#define TRACE_DIFF_CONTEXT 5       // Records shown around a difference
+#define TRACE_DIFF_MAX_CONTEXT 64
+
+/* Fields trace_diff() can compare besides PC, opcode and registers */
+#define TRACE_FIELD_CYCLES 0x01 // Cycles since each trace's first record
+#define TRACE_FIELD_ACCESS 0x02 // Data access kind, address and value
+
+/* One executed instruction */
+typedef struct
+{
+    uint64_t cycle; // cycle_count before the instruction
+    uint16_t pc;
+    uint16_t addr; // Data address, if access is not TRACE_ACCESS_NONE
+    uint8_t opcode;
+    uint8_t a, x, y, p, sp; // Before the instruction
+    uint8_t access;         // TRACE_ACCESS_*
+    uint8_t value;          // Byte at addr after the instruction
+} trace_record_t;
+
+/* Start of every trace file */
+typedef struct
+{
+    char magic[4];       // TRACE_MAGIC, no terminator
+    uint16_t version;    // TRACE_VERSION
+    uint16_t byte_order; // TRACE_BYTE_ORDER
+} trace_file_header_t;
+
+/* Start of every block */
+typedef struct
+{
+    uint64_t first_cycle; // Cycle the first record's delta counts from
+    uint32_t records;
+    uint32_t size; // Encoded bytes that follow
+} trace_block_header_t;
+
+/* A block of records on its way to the file */
+typedef struct
+{
+    trace_record_t records[TRACE_BLOCK_RECORDS];
+    uint32_t count;
+} trace_block_t;
+
+/* Tracer */
+typedef struct tracer
+{
+    FILE *file;
+
+    /* Being filled by the CPU thread */
+    trace_block_t *current;
+
+    /* Shared with the writer thread under mutex */
+    trace_block_t *blocks[TRACE_BLOCKS];
+    trace_block_t *full[TRACE_BLOCKS]; // Waiting to be written, oldest first
+    trace_block_t *free[TRACE_BLOCKS];
+    int full_count, free_count;
+    bool closing;
+    bool failed; // A write failed; later blocks are dropped
+    pthread_mutex_t mutex;
+    pthread_cond_t work; // A block is full, or closing
+    pthread_cond_t room; // A block is free
+    pthread_t writer;
+
+    /* Writer thread only */
+    uint8_t *encoded;
+    uint64_t next_cycle; // first_cycle of the next block
+
+    /* Statistics */
+    uint64_t records;       // Appended (CPU thread)
+    uint64_t bytes_written; // Written to the file (writer thread)
+} tracer_t;
+
+/* Reader */
+typedef struct
+{
+    FILE *file;
+    uint8_t *data; // The current block's encoded records
+    size_t capacity;
+    size_t size, offset;
+    uint32_t left; // Records left in the block
+    trace_record_t previous;
+    bool error; // Malformed or truncated file
+} trace_reader_t;
+
+/* How trace_diff() compares */
+typedef struct
+{
+    unsigned fields; // TRACE_FIELD_* to compare, when both traces have them
+    uint8_t p_mask;  // Status bits compared (0xFF for all)
+    int context;     // Records shown before and after the difference
+    FILE *report;    // Where the report goes, or NULL for none
+} trace_diff_options_t;
+
+/* What trace_diff() found */
+typedef struct
+{
+    bool diverged;
+    uint64_t index;    // Records that matched before the difference
+    bool ended_a;      // Trace A ended there (B went on)
+    bool ended_b;      // Trace B ended there (A went on)
+    trace_record_t a;  // The differing records, unless that side ended
+    trace_record_t b;
+    unsigned fields;   // TRACE_FIELD_* that were compared
+} trace_diff_result_t;
+
+/**
+ * @brief Creates a tracer writing to a file, and starts its writer thread.
+ *
+ * @param path Path of the trace file, replaced if it exists.
+ * @return Pointer to the tracer, or NULL on failure.
+ */
+tracer_t *tracer_create(const char *path);
+
+/**
+ * @brief Writes out what is left, stops the writer thread, closes the file
+ * and frees the tracer. Detach it from the CPU first.
+ *
+ * @param tracer Pointer to the tracer.
+ * @return CPU_SUCCESS, or CPU_ERROR_WRITE_FAILED if any write failed.
+ */
+cpu_status_t tracer_destroy(tracer_t *tracer);
+
+/**
+ * @brief Hands the current block to the writer thread and takes a free one.
+ * Called by tracer_append() when the block is full.
+ *
+ * @param tracer Pointer to the tracer.
+ */
+void tracer_submit(tracer_t *tracer);
+
+/**
+ * @brief Appends a record. CPU thread only.
+ *
+ * @param tracer Pointer to the tracer.
+ * @return Where to write the record.
+ */
+static inline trace_record_t *tracer_append(tracer_t *tracer)
+{
+    if (tracer->current->count == TRACE_BLOCK_RECORDS)
+        tracer_submit(tracer);
+
+    tracer->records++;
+    return &tracer->current->records[tracer->current->count++];
+}
+
+/**
+ * @brief Opens a trace file for reading.
+ *
+ * @param reader Reader to set up.
+ * @param path Path of the trace file.
+ * @return CPU_SUCCESS, CPU_ERROR_FILE_NOT_FOUND, or
+ * CPU_ERROR_INVALID_ARGUMENT if it is not a trace of this version and byte
+ * order.
+ */
+cpu_status_t trace_reader_open(trace_reader_t *reader, const char *path);
+
+/**
+ * @brief Decodes the next record.
+ *
+ * @param reader Pointer to the reader.
+ * @param record Filled in with the record.
+ * @return true for a record; false at the end of the trace, or on a
+ * malformed one (reader->error is set then).
+ */
+bool trace_reader_next(trace_reader_t *reader, trace_record_t *record);
+
+/**
+ * @brief Closes a reader.
+ *
+ * @param reader Pointer to the reader.
+ */
+void trace_reader_close(trace_reader_t *reader);
+
+/**
+ * @brief Formats a record as one line of text, without a newline.
+ *
+ * @param record Record to format.
+ * @param buffer Where the text goes.
+ * @param size Size of the buffer.
+ */
+void trace_format(const trace_record_t *record, char *buffer, size_t size);
+
+/**
+ * @brief Compares two traces and reports the first difference.
+ *
+ * Cycle counts are compared relative to each trace's first record, so
+ * traces that start on different cycles can still match.
+ *
+ * @param path_a Binary trace or text log.
+ * @param path_b Binary trace or text log.
+ * @param options How to compare.
+ * @param result Filled in with the outcome.
+ * @return CPU_SUCCESS, CPU_ERROR_FILE_NOT_FOUND, or
+ * CPU_ERROR_INVALID_ARGUMENT for a malformed trace or log (result then
+ * covers the records compared before it).
+ */
+cpu_status_t trace_diff(const char *path_a, const char *path_b,
+                        const trace_diff_options_t *options,
+                        trace_diff_result_t *result);
+
+/**
+ * @brief Parses a command-line number: decimal, or hexadecimal with a $ or
+ * 0x prefix. A leading zero is still decimal. Shared by the trace tool and
+ * the headless options.
+ *
+ * @param text The number, with nothing before or after it.
+ * @param max Largest value accepted.
+ * @param value Set to the number on success.
+ * @return true if text is a number no larger than max.
+ */
+bool trace_parse_number(const char *text, uint64_t max, uint64_t *value);
+
+/**
+ * @brief Runs the trace tool: "print FILE [filters]" or
+ * "diff FILE FILE [options]".
+ *
+ * @param argc Number of arguments.
+ * @param argv Arguments, the command first.
+ * @return 0 on success (diff: the traces match), 1 if the traces differ, 2
+ * on bad arguments or unreadable files.
+ */
+int trace_tool(int argc, char *argv[]);
+
+#endif // TRACE_H
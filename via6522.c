@@ -0,0 +1,793 @@
+// via6522.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "via6522.h"
+
+#define VIA_T2_WRAP 0x10000u // T2 keeps counting down through $FFFF
+
+/* PCR input modes for CA2/CB2 (bits 3-1 / 7-5) */
+#define PCR_C2_OUTPUT 0x04     // Modes 4-7: output, no input flag
+#define PCR_C2_INDEPENDENT 0x01 // Port access leaves the flag alone
+#define PCR_C2_POSITIVE 0x02    // Flag on a rising edge
+
+static inline uint64_t via_now(const via6522_t *via)
+{
+    return via->cpu->clock.cycle_count;
+}
+
+/* Timer Values
+ *
+ * Pure functions of the cycle count, usable by peek without catching up. */
+
+/* Timer 1: counts down to the underflow, shows $FFFF for one cycle, then
+ * reloads from the latch every latch + 2 cycles */
+static uint16_t t1_value(const via6522_t *via, uint64_t now)
+{
+    const via_timer_t *t = &via->t1;
+
+    if (now < t->underflow)
+    {
+        if (now < t->base_cycle)
+            return 0xFFFF; // The cycle of the last underflow
+        return (uint16_t)(t->base_value - (now - t->base_cycle));
+    }
+
+    uint64_t phase = (now - t->underflow) % ((uint64_t)via->t1_latch + 2);
+
+    return phase ? (uint16_t)(via->t1_latch - (phase - 1)) : 0xFFFF;
+}
+
+/* Timer 2: counts down and wraps through $FFFF without reloading; frozen
+ * while ACR selects PB6 pulse counting, which is not modelled */
+static uint16_t t2_value(const via6522_t *via, uint64_t now)
+{
+    const via_timer_t *t = &via->t2;
+
+    if (via->acr & VIA_ACR_T2_PULSES)
+        return t->base_value;
+
+    return (uint16_t)(t->base_value - (now - t->base_cycle));
+}
+
+/* Whether the shift register mode runs on its own clock (T2 or phi2) */
+static inline bool sr_clocked(uint8_t mode)
+{
+    return mode == 1 || mode == 2 || mode == 4 || mode == 5 || mode == 6;
+}
+
+/* Cycles per shifted bit; CB1 toggles once per half bit */
+static uint64_t sr_bit_period(const via6522_t *via)
+{
+    uint8_t mode = VIA_ACR_SR_MODE(via->acr);
+
+    if (mode == 2 || mode == 6)
+        return 2;
+
+    return 2 * ((uint64_t)via->t2_latch_low + 2);
+}
+
+/* Bits shifted since sr_start, capped at the rest of the byte except in
+ * free-running mode */
+static uint64_t sr_bits(const via6522_t *via, uint64_t now)
+{
+    if (!via->sr_period)
+        return 0;
+
+    uint64_t bits = (now - via->sr_start) / via->sr_period;
+
+    if (VIA_ACR_SR_MODE(via->acr) != 4 && bits > 8u - via->sr_done)
+        bits = 8u - via->sr_done;
+
+    return bits;
+}
+
+/* Shift register contents after the bits shifted so far */
+static uint8_t sr_value(const via6522_t *via, uint64_t now)
+{
+    uint64_t bits = sr_bits(via, now);
+    uint8_t mode = VIA_ACR_SR_MODE(via->acr);
+    uint8_t sr = via->sr;
+
+    if (mode >= 4)
+    {
+        // Shifting out recirculates bit 7 into bit 0
+        unsigned n = (unsigned)(bits % 8);
+        return n ? (uint8_t)((sr << n) | (sr >> (8 - n))) : sr;
+    }
+
+    // Shifting in takes CB2 as it is now
+    uint8_t cb2 = (via->control_lines >> VIA_CB2) & 1;
+
+    for (uint64_t i = 0; i < bits; i++)
+        sr = (uint8_t)((sr << 1) | cb2);
+
+    return sr;
+}
+
+/* Flags as they stand at now, including underflows and shifts whose event
+ * has not run yet */
+static uint8_t ifr_value(const via6522_t *via, uint64_t now)
+{
+    uint8_t ifr = via->ifr;
+
+    if (via->t1.interrupt && now >= via->t1.underflow)
+        ifr |= VIA_IRQ_T1;
+    if (via->t2.interrupt && !(via->acr & VIA_ACR_T2_PULSES) &&
+        now >= via->t2.underflow)
+        ifr |= VIA_IRQ_T2;
+    if (via->sr_period && VIA_ACR_SR_MODE(via->acr) != 4 &&
+        via->sr_done + sr_bits(via, now) == 8)
+        ifr |= VIA_IRQ_SR;
+
+    return ifr;
+}
+
+/* Catching Up */
+
+static void t1_catch_up(via6522_t *via, uint64_t now)
+{
+    via_timer_t *t = &via->t1;
+
+    if (now < t->underflow)
+        return;
+
+    if (t->interrupt)
+        via->ifr |= VIA_IRQ_T1;
+    if (!(via->acr & VIA_ACR_T1_FREE_RUN))
+        t->interrupt = false; // One-shot: once per load
+
+    // Skip to the last underflow at or before now and restart from there
+    uint64_t period = (uint64_t)via->t1_latch + 2;
+    uint64_t last = t->underflow + (now - t->underflow) / period * period;
+
+    t->base_cycle = last + 1;
+    t->base_value = via->t1_latch;
+    t->underflow = last + period;
+}
+
+static void t2_catch_up(via6522_t *via, uint64_t now)
+{
+    via_timer_t *t = &via->t2;
+
+    if ((via->acr & VIA_ACR_T2_PULSES) || now < t->underflow)
+        return;
+
+    if (t->interrupt)
+        via->ifr |= VIA_IRQ_T2;
+    t->interrupt = false; // Always one-shot
+
+    t->underflow += ((now - t->underflow) / VIA_T2_WRAP + 1) * VIA_T2_WRAP;
+}
+
+static void sr_catch_up(via6522_t *via, uint64_t now)
+{
+    if (!via->sr_period)
+        return;
+
+    uint64_t bits = sr_bits(via, now);
+
+    via->sr = sr_value(via, now);
+    via->sr_start += bits * via->sr_period;
+
+    if (VIA_ACR_SR_MODE(via->acr) == 4)
+        return; // Free-running: never done
+
+    via->sr_done += (uint8_t)bits;
+
+    if (via->sr_done == 8)
+    {
+        via->ifr |= VIA_IRQ_SR;
+        via->sr_period = 0; // Done
+    }
+}
+
+/* Drive the CPU's IRQ line from IFR & IER */
+static void update_irq(via6522_t *via)
+{
+    bool active = (via->ifr & via->ier & 0x7F) != 0;
+
+    if (active != via->irq_asserted)
+    {
+        via->irq_asserted = active;
+        cpu_set_irq_source(via->cpu, via->irq_source, active);
+    }
+}
+
+/* Bring flags and counters up to now */
+static void via_update(via6522_t *via)
+{
+    uint64_t now = via_now(via);
+
+    t1_catch_up(via, now);
+    t2_catch_up(via, now);
+    sr_catch_up(via, now);
+    update_irq(via);
+}
+
+/* Scheduled Events */
+
+static void t1_event(void *context, uint64_t cycle);
+static void t2_event(void *context, uint64_t cycle);
+static void sr_event(void *context, uint64_t cycle);
+
+/* Put the next flag-setting cycle of a timer on the scheduler */
+static void schedule_timer(via6522_t *via, via_timer_t *t,
+                           scheduler_callback_t callback)
+{
+    cpu_cancel_event(via->cpu, t->event);
+    t->event = SCHEDULER_NO_EVENT;
+
+    if (t->interrupt && !(t == &via->t2 && (via->acr & VIA_ACR_T2_PULSES)))
+        t->event = cpu_schedule(via->cpu, t->underflow, callback, via);
+}
+
+static void schedule_sr(via6522_t *via)
+{
+    cpu_cancel_event(via->cpu, via->sr_event);
+    via->sr_event = SCHEDULER_NO_EVENT;
+
+    if (via->sr_period && VIA_ACR_SR_MODE(via->acr) != 4)
+        via->sr_event = cpu_schedule(
+            via->cpu, via->sr_start + (8u - via->sr_done) * via->sr_period,
+            sr_event, via);
+}
+
+static void t1_event(void *context, uint64_t cycle)
+{
+    via6522_t *via = (via6522_t *)context;
+
+    (void)cycle;
+    via->t1.event = SCHEDULER_NO_EVENT;
+    via_update(via);
+    schedule_timer(via, &via->t1, t1_event); // Free-run: next underflow
+}
+
+static void t2_event(void *context, uint64_t cycle)
+{
+    via6522_t *via = (via6522_t *)context;
+
+    (void)cycle;
+    via->t2.event = SCHEDULER_NO_EVENT;
+    via_update(via);
+}
+
+static void sr_event(void *context, uint64_t cycle)
+{
+    via6522_t *via = (via6522_t *)context;
+
+    (void)cycle;
+    via->sr_event = SCHEDULER_NO_EVENT;
+    via_update(via);
+}
+
+/* Start or restart the 8-bit shift (on any SR access) */
+static void sr_restart(via6522_t *via, uint64_t now)
+{
+    via->sr_period = 0;
+    via->sr_done = 0;
+
+    if (sr_clocked(VIA_ACR_SR_MODE(via->acr)))
+    {
+        via->sr_start = now;
+        via->sr_period = sr_bit_period(via);
+    }
+
+    schedule_sr(via);
+}
+
+/* Load a timer counter and start it */
+static void timer_load(via_timer_t *t, uint16_t value, uint64_t now)
+{
+    t->base_cycle = now;
+    t->base_value = value;
+    t->underflow = now + value + 1;
+    t->interrupt = true;
+}
+
+/* Port A/B access clears CA1/CB1 and, unless independent, CA2/CB2 */
+static void clear_port_flags(via6522_t *via, bool port_b)
+{
+    uint8_t c2_mode = port_b ? (via->pcr >> 5) : (via->pcr >> 1);
+    uint8_t flags = port_b ? VIA_IRQ_CB1 : VIA_IRQ_CA1;
+
+    if ((c2_mode & PCR_C2_OUTPUT) || !(c2_mode & PCR_C2_INDEPENDENT))
+        flags |= port_b ? VIA_IRQ_CB2 : VIA_IRQ_CA2;
+
+    via->ifr &= ~flags;
+}
+
+/* Memory Interface */
+
+static uint8_t via_read(memory_t *mem, uint16_t addr)
+{
+    via6522_t *via = (via6522_t *)mem->context;
+    uint64_t now = via_now(via);
+    uint8_t value;
+
+    via_update(via);
+
+    switch (addr & 0x0F)
+    {
+    case VIA_ORB:
+        clear_port_flags(via, true);
+        value = (via->orb & via->ddrb) | (via->irb & ~via->ddrb);
+        break;
+    case VIA_ORA:
+        clear_port_flags(via, false);
+        // fall through
+    case VIA_ORA_NH:
+        value = (via->ora & via->ddra) | (via->ira & ~via->ddra);
+        break;
+    case VIA_DDRB:
+        value = via->ddrb;
+        break;
+    case VIA_DDRA:
+        value = via->ddra;
+        break;
+    case VIA_T1CL:
+        via->ifr &= ~VIA_IRQ_T1;
+        value = t1_value(via, now) & 0xFF;
+        break;
+    case VIA_T1CH:
+        value = t1_value(via, now) >> 8;
+        break;
+    case VIA_T1LL:
+        value = via->t1_latch & 0xFF;
+        break;
+    case VIA_T1LH:
+        value = via->t1_latch >> 8;
+        break;
+    case VIA_T2CL:
+        via->ifr &= ~VIA_IRQ_T2;
+        value = t2_value(via, now) & 0xFF;
+        break;
+    case VIA_T2CH:
+        value = t2_value(via, now) >> 8;
+        break;
+    case VIA_SR:
+        value = via->sr;
+        via->ifr &= ~VIA_IRQ_SR;
+        sr_restart(via, now);
+        break;
+    case VIA_ACR:
+        value = via->acr;
+        break;
+    case VIA_PCR:
+        value = via->pcr;
+        break;
+    case VIA_IFR:
+        value = via->ifr | ((via->ifr & via->ier & 0x7F) ? VIA_IRQ_ANY : 0);
+        break;
+    default: // VIA_IER
+        value = via->ier | 0x80;
+        break;
+    }
+
+    update_irq(via);
+    return value;
+}
+
+static void via_write(memory_t *mem, uint16_t addr, uint8_t data)
+{
+    via6522_t *via = (via6522_t *)mem->context;
+    uint64_t now = via_now(via);
+
+    via_update(via);
+
+    switch (addr & 0x0F)
+    {
+    case VIA_ORB:
+        clear_port_flags(via, true);
+        via->orb = data;
+        break;
+    case VIA_ORA:
+        clear_port_flags(via, false);
+        // fall through
+    case VIA_ORA_NH:
+        via->ora = data;
+        break;
+    case VIA_DDRB:
+        via->ddrb = data;
+        break;
+    case VIA_DDRA:
+        via->ddra = data;
+        break;
+    case VIA_T1CL:
+    case VIA_T1LL:
+        via->t1_latch = (via->t1_latch & 0xFF00) | data;
+        break;
+    case VIA_T1CH:
+        via->t1_latch = (uint16_t)((via->t1_latch & 0x00FF) | (data << 8));
+        via->ifr &= ~VIA_IRQ_T1;
+        timer_load(&via->t1, via->t1_latch, now);
+        schedule_timer(via, &via->t1, t1_event);
+        break;
+    case VIA_T1LH:
+        via->t1_latch = (uint16_t)((via->t1_latch & 0x00FF) | (data << 8));
+        via->ifr &= ~VIA_IRQ_T1;
+        break;
+    case VIA_T2CL:
+        via->t2_latch_low = data;
+        break;
+    case VIA_T2CH:
+        via->ifr &= ~VIA_IRQ_T2;
+        timer_load(&via->t2, (uint16_t)(via->t2_latch_low | (data << 8)),
+                   now);
+        schedule_timer(via, &via->t2, t2_event);
+        break;
+    case VIA_SR:
+        via->sr = data;
+        via->ifr &= ~VIA_IRQ_SR;
+        sr_restart(via, now);
+        break;
+    case VIA_ACR:
+    {
+        // Freeze or restart T2 at its current value when counting changes
+        uint16_t t2 = t2_value(via, now);
+
+        via->acr = data;
+        via->t2.base_cycle = now;
+        via->t2.base_value = t2;
+        via->t2.underflow = now + t2 + 1;
+
+        // Free-run interrupts on every underflow; a one-shot keeps whatever
+        // its last load left (armed, or already fired)
+        if (data & VIA_ACR_T1_FREE_RUN)
+            via->t1.interrupt = true;
+
+        schedule_timer(via, &via->t1, t1_event);
+        schedule_timer(via, &via->t2, t2_event);
+
+        if (!sr_clocked(VIA_ACR_SR_MODE(data)))
+        {
+            via->sr_period = 0;
+            schedule_sr(via);
+        }
+        break;
+    }
+    case VIA_PCR:
+        via->pcr = data;
+        break;
+    case VIA_IFR:
+        via->ifr &= ~(data & 0x7F);
+        break;
+    default: // VIA_IER
+        if (data & 0x80)
+            via->ier |= data & 0x7F;
+        else
+            via->ier &= ~(data & 0x7F);
+        break;
+    }
+
+    update_irq(via);
+}
+
+/* Register values without side effects (memory views) */
+static uint8_t via_peek(memory_t *mem, uint16_t addr)
+{
+    const via6522_t *via = (const via6522_t *)mem->context;
+    uint64_t now = via_now(via);
+
+    switch (addr & 0x0F)
+    {
+    case VIA_ORB:
+        return (via->orb & via->ddrb) | (via->irb & ~via->ddrb);
+    case VIA_ORA:
+    case VIA_ORA_NH:
+        return (via->ora & via->ddra) | (via->ira & ~via->ddra);
+    case VIA_DDRB:
+        return via->ddrb;
+    case VIA_DDRA:
+        return via->ddra;
+    case VIA_T1CL:
+        return t1_value(via, now) & 0xFF;
+    case VIA_T1CH:
+        return t1_value(via, now) >> 8;
+    case VIA_T1LL:
+        return via->t1_latch & 0xFF;
+    case VIA_T1LH:
+        return via->t1_latch >> 8;
+    case VIA_T2CL:
+        return t2_value(via, now) & 0xFF;
+    case VIA_T2CH:
+        return t2_value(via, now) >> 8;
+    case VIA_SR:
+        return sr_value(via, now);
+    case VIA_ACR:
+        return via->acr;
+    case VIA_PCR:
+        return via->pcr;
+    case VIA_IFR:
+    {
+        uint8_t ifr = ifr_value(via, now);
+        return ifr | ((ifr & via->ier & 0x7F) ? VIA_IRQ_ANY : 0);
+    }
+    default:
+        return via->ier | 0x80;
+    }
+}
+
+/* Snapshots */
+
+/* A timer in a snapshot: cycles relative to the CPU's cycle_count */
+typedef struct
+{
+    uint64_t base_cycle;
+    uint64_t underflow;
+    uint16_t base_value;
+    bool interrupt;
+} via_timer_state_t;
+
+/* Architectural state in a snapshot: no host pointers, no event ids */
+typedef struct
+{
+    uint8_t ora, orb;
+    uint8_t ddra, ddrb;
+    uint8_t ira, irb;
+    uint8_t control_lines;
+    uint8_t acr, pcr;
+    uint8_t ifr, ier;
+    uint16_t t1_latch;
+    uint8_t t2_latch_low;
+    via_timer_state_t t1, t2;
+    uint8_t sr;
+    uint8_t sr_done;
+    uint64_t sr_start; // Relative, like the timers
+    uint64_t sr_period;
+} via_state_t;
+
+/* Deadlines are kept modulo 2^64 from now, so past and future cycles both
+ * come back exactly once the CPU record has restored cycle_count */
+static void save_timer(const via_timer_t *t, uint64_t now,
+                       via_timer_state_t *state)
+{
+    state->base_cycle = t->base_cycle - now;
+    state->underflow = t->underflow - now;
+    state->base_value = t->base_value;
+    state->interrupt = t->interrupt;
+}
+
+static void restore_timer(via_timer_t *t, uint64_t now,
+                          const via_timer_state_t *state)
+{
+    t->base_cycle = now + state->base_cycle;
+    t->underflow = now + state->underflow;
+    t->base_value = state->base_value;
+    t->interrupt = state->interrupt;
+}
+
+static size_t via_save_state(memory_t *mem, void *buffer, size_t size)
+{
+    const via6522_t *via = (const via6522_t *)mem->context;
+    uint64_t now = via_now(via);
+    via_state_t state;
+
+    if (size < sizeof(state))
+        return sizeof(state);
+
+    memset(&state, 0, sizeof(state)); // Padding too: saves compare equal
+    state.ora = via->ora;
+    state.orb = via->orb;
+    state.ddra = via->ddra;
+    state.ddrb = via->ddrb;
+    state.ira = via->ira;
+    state.irb = via->irb;
+    state.control_lines = via->control_lines;
+    state.acr = via->acr;
+    state.pcr = via->pcr;
+    state.ifr = via->ifr;
+    state.ier = via->ier;
+    state.t1_latch = via->t1_latch;
+    state.t2_latch_low = via->t2_latch_low;
+    save_timer(&via->t1, now, &state.t1);
+    save_timer(&via->t2, now, &state.t2);
+    state.sr = via->sr;
+    state.sr_done = via->sr_done;
+    state.sr_start = via->sr_start - now;
+    state.sr_period = via->sr_period;
+
+    memcpy(buffer, &state, sizeof(state));
+    return sizeof(state);
+}
+
+/* Registers, counters and shift state come from the snapshot; the CPU, the
+ * IRQ line and the scheduled events stay this VIA's own, and the events are
+ * put back where the restored state wants them */
+static bool via_restore_state(memory_t *mem, const void *buffer, size_t size)
+{
+    via6522_t *via = (via6522_t *)mem->context;
+    uint64_t now = via_now(via);
+    via_state_t state;
+
+    if (size != sizeof(state))
+        return false;
+
+    memcpy(&state, buffer, sizeof(state));
+    via->ora = state.ora;
+    via->orb = state.orb;
+    via->ddra = state.ddra;
+    via->ddrb = state.ddrb;
+    via->ira = state.ira;
+    via->irb = state.irb;
+    via->control_lines = state.control_lines;
+    via->acr = state.acr;
+    via->pcr = state.pcr;
+    via->ifr = state.ifr;
+    via->ier = state.ier;
+    via->t1_latch = state.t1_latch;
+    via->t2_latch_low = state.t2_latch_low;
+    restore_timer(&via->t1, now, &state.t1);
+    restore_timer(&via->t2, now, &state.t2);
+    via->sr = state.sr;
+    via->sr_done = state.sr_done;
+    via->sr_start = now + state.sr_start;
+    via->sr_period = state.sr_period;
+
+    schedule_timer(via, &via->t1, t1_event);
+    schedule_timer(via, &via->t2, t2_event);
+    schedule_sr(via);
+    update_irq(via);
+
+    return true;
+}
+
+/* Creates a VIA attached to a CPU */
+memory_t *memory_create_via(cpu_6502_t *cpu)
+{
+    if (!cpu)
+        return NULL;
+
+    via6522_t *via = calloc(1, sizeof(via6522_t));
+
+    if (!via)
+    {
+        fprintf(stderr, "memory_create_via: Failed to allocate VIA.\n");
+        return NULL;
+    }
+
+    memory_t *memory = malloc(sizeof(memory_t));
+
+    if (!memory)
+    {
+        fprintf(stderr, "memory_create_via: Failed to allocate memory "
+                        "structure.\n");
+        free(via);
+        return NULL;
+    }
+
+    via->cpu = cpu;
+    via->irq_source = cpu_add_irq_source(cpu);
+    via->ira = 0xFF; // Unconnected inputs float high
+    via->irb = 0xFF;
+    via->control_lines = 0x0F;
+    via->t1.event = SCHEDULER_NO_EVENT;
+    via->t2.event = SCHEDULER_NO_EVENT;
+    via->sr_event = SCHEDULER_NO_EVENT;
+
+    memory->read = via_read;
+    memory->write = via_write;
+    memory->page_pointer = NULL; // Every access has side effects
+    memory->context = via;
+    memory->peek = via_peek;
+    memory->save_state = via_save_state;
+    memory->restore_state = via_restore_state;
+
+    via_reset(memory);
+
+    return memory;
+}
+
+/* Cancels the VIA's events, releases its IRQ line and frees it */
+void memory_destroy_via(memory_t *mem)
+{
+    if (!mem)
+        return;
+
+    via6522_t *via = (via6522_t *)mem->context;
+
+    if (via)
+    {
+        cpu_cancel_event(via->cpu, via->t1.event);
+        cpu_cancel_event(via->cpu, via->t2.event);
+        cpu_cancel_event(via->cpu, via->sr_event);
+        cpu_set_irq_source(via->cpu, via->irq_source, false);
+        free(via);
+    }
+
+    free(mem);
+}
+
+/* Applies the RESET line */
+void via_reset(memory_t *mem)
+{
+    if (!mem)
+        return;
+
+    via6522_t *via = (via6522_t *)mem->context;
+    uint64_t now = via_now(via);
+
+    via->ora = via->orb = 0;
+    via->ddra = via->ddrb = 0;
+    via->acr = via->pcr = 0;
+    via->ifr = via->ier = 0;
+
+    // Counters keep their values but restart on the new time base
+    timer_load(&via->t1, via->t1.base_value, now);
+    timer_load(&via->t2, via->t2.base_value, now);
+    via->t1.interrupt = false;
+    via->t2.interrupt = false;
+    schedule_timer(via, &via->t1, t1_event);
+    schedule_timer(via, &via->t2, t2_event);
+
+    via->sr_period = 0;
+    schedule_sr(via);
+
+    update_irq(via);
+}
+
+/* Sets the levels the outside world drives on port A or B */
+void via_set_port_input(memory_t *mem, int port, uint8_t value)
+{
+    if (!mem)
+        return;
+
+    via6522_t *via = (via6522_t *)mem->context;
+
+    if (port == 0)
+        via->ira = value;
+    else
+        via->irb = value;
+}
+
+/* Drives a control line; the edge selected in PCR sets its flag */
+void via_set_control_line(memory_t *mem, via_line_t line, bool level)
+{
+    if (!mem)
+        return;
+
+    via6522_t *via = (via6522_t *)mem->context;
+    bool old = (via->control_lines >> line) & 1;
+
+    if (old == level)
+        return;
+
+    via_update(via);
+
+    if (level)
+        via->control_lines |= 1u << line;
+    else
+        via->control_lines &= ~(1u << line);
+
+    bool positive;
+
+    switch (line)
+    {
+    case VIA_CA1:
+        positive = via->pcr & 0x01;
+        if (level == positive)
+            via->ifr |= VIA_IRQ_CA1;
+        break;
+    case VIA_CB1:
+        positive = via->pcr & 0x10;
+        if (level == positive)
+            via->ifr |= VIA_IRQ_CB1;
+        break;
+    case VIA_CA2:
+    case VIA_CB2:
+    {
+        uint8_t mode = (line == VIA_CA2) ? (via->pcr >> 1) & 0x07
+                                         : (via->pcr >> 5) & 0x07;
+
+        if (mode & PCR_C2_OUTPUT)
+            break; // Output: the pin is not an input
+
+        positive = mode & PCR_C2_POSITIVE;
+        if (level == positive)
+            via->ifr |= (line == VIA_CA2) ? VIA_IRQ_CA2 : VIA_IRQ_CB2;
+        break;
+    }
+    }
+
+    update_irq(via);
+}
@@ -0,0 +1,167 @@
+// via6522.h
+#ifndef VIA6522_H
+#define VIA6522_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "cpu_6502.h"
+#include "memory.h"
+
+/*
+ * MOS 6522 Versatile Interface Adapter as a memory_t device.
+ *
+ * The sixteen registers repeat every 16 bytes of whatever range the device
+ * is connected at. Timers are never ticked: each keeps the counter value it
+ * had at a base cycle, and any register access computes the current value
+ * from the CPU's cycle_count. The cycles at which Timer 1, Timer 2 and the
+ * shift register raise their interrupt flags are put on the CPU's event
+ * scheduler, so IRQs are taken at the exact instruction boundary whether or
+ * not the program polls the VIA. IFR & IER drives one of the CPU's
+ * level-triggered IRQ lines.
+ *
+ * Timing follows the NMOS part: a timer loaded with N underflows N + 1.5
+ * cycles after the load (counted here as N + 1, the half cycle being below
+ * instruction resolution) and, in free-run mode, reloads from the latch
+ * every N + 2 cycles. Register accesses happen at the cycle_count the core
+ * reports during the instruction.
+ *
+ * Port pins are host-driven inputs (via_set_port_input) combined with the
+ * output registers through DDRA/DDRB. CA1, CA2, CB1 and CB2 inputs raise
+ * their flags on the edge selected in PCR. Not modelled: PB7 output from
+ * Timer 1, Timer 2 pulse counting on PB6, handshake outputs on CA2/CB2, and
+ * shifting under an external CB1 clock.
+ */
+
+#define VIA_BASE_ADDR 0x8000 // Where emu65 maps the VIA ($8000-$800F)
+
+/* Register offsets */
+#define VIA_ORB 0x0  // Output/input register B
+#define VIA_ORA 0x1  // Output/input register A (with handshake)
+#define VIA_DDRB 0x2 // Data direction B (1 = output)
+#define VIA_DDRA 0x3 // Data direction A
+#define VIA_T1CL 0x4 // Timer 1 counter low (read clears T1 flag) / latch low
+#define VIA_T1CH 0x5 // Timer 1 counter high (write loads and starts T1)
+#define VIA_T1LL 0x6 // Timer 1 latch low
+#define VIA_T1LH 0x7 // Timer 1 latch high
+#define VIA_T2CL 0x8 // Timer 2 counter low (read clears T2 flag) / latch low
+#define VIA_T2CH 0x9 // Timer 2 counter high (write loads and starts T2)
+#define VIA_SR 0xA   // Shift register
+#define VIA_ACR 0xB  // Auxiliary control
+#define VIA_PCR 0xC  // Peripheral control
+#define VIA_IFR 0xD  // Interrupt flags
+#define VIA_IER 0xE  // Interrupt enable
+#define VIA_ORA_NH 0xF // Register A without handshake
+
+/* IFR / IER bits */
+#define VIA_IRQ_CA2 0x01
+#define VIA_IRQ_CA1 0x02
+#define VIA_IRQ_SR 0x04
+#define VIA_IRQ_CB2 0x08
+#define VIA_IRQ_CB1 0x10
+#define VIA_IRQ_T2 0x20
+#define VIA_IRQ_T1 0x40
+#define VIA_IRQ_ANY 0x80
+
+/* ACR fields */
+#define VIA_ACR_T1_FREE_RUN 0x40 // Timer 1 reloads and interrupts continuously
+#define VIA_ACR_T2_PULSES 0x20   // Timer 2 counts PB6 pulses
+#define VIA_ACR_SR_MODE(acr) (((acr) >> 2) & 0x07)
+
+/* Control lines for via_set_control_line */
+typedef enum
+{
+    VIA_CA1 = 0,
+    VIA_CA2,
+    VIA_CB1,
+    VIA_CB2
+} via_line_t;
+
+/* A running counter: value at base_cycle, then one count down per cycle */
+typedef struct
+{
+    uint64_t base_cycle;
+    uint16_t base_value;
+    uint64_t underflow;  // Cycle of the next underflow
+    bool interrupt;      // Next underflow sets the flag (one-shot: once)
+    uint32_t event;      // Scheduled underflow, or SCHEDULER_NO_EVENT
+} via_timer_t;
+
+/* VIA Structure */
+typedef struct
+{
+    cpu_6502_t *cpu; // Clock, scheduler and IRQ line
+    int irq_source;  // CPU IRQ line, or -1 if none was free
+    bool irq_asserted;
+
+    /* Ports */
+    uint8_t ora, orb;
+    uint8_t ddra, ddrb;
+    uint8_t ira, irb;        // Host-driven pin levels
+    uint8_t control_lines;   // Current CA1, CA2, CB1, CB2 levels (bit = line)
+
+    /* Control and interrupts */
+    uint8_t acr, pcr;
+    uint8_t ifr, ier; // Bit 7 of ifr is derived, never stored
+
+    /* Timer 1 */
+    uint16_t t1_latch;
+    via_timer_t t1;
+
+    /* Timer 2 */
+    uint8_t t2_latch_low;
+    via_timer_t t2;
+
+    /* Shift register: one bit per sr_period cycles from sr_start, after
+     * sr_done of the 8 bits were already applied to sr */
+    uint8_t sr;
+    uint8_t sr_done;
+    uint64_t sr_start;
+    uint64_t sr_period; // 0 while not shifting
+    uint32_t sr_event;
+} via6522_t;
+
+/**
+ * @brief Creates a VIA attached to a CPU's clock, scheduler and IRQ input.
+ *
+ * @param cpu CPU the VIA interrupts; must outlive the device.
+ * @return Pointer to the device, or NULL on failure.
+ */
+memory_t *memory_create_via(cpu_6502_t *cpu);
+
+/**
+ * @brief Cancels the VIA's events, releases its IRQ line and frees it.
+ *
+ * @param mem Pointer to the device.
+ */
+void memory_destroy_via(memory_t *mem);
+
+/**
+ * @brief Applies the RESET line: clears IFR, IER, ACR, PCR, the data
+ * direction and output registers and stops the timer interrupts; counters,
+ * latches and the shift register keep their values.
+ *
+ * Call after cpu_reset(), which restarts cycle_count.
+ *
+ * @param mem Pointer to the device.
+ */
+void via_reset(memory_t *mem);
+
+/**
+ * @brief Sets the levels the outside world drives on port A or B.
+ *
+ * @param mem Pointer to the device.
+ * @param port 0 for port A, 1 for port B.
+ * @param value Pin levels.
+ */
+void via_set_port_input(memory_t *mem, int port, uint8_t value);
+
+/**
+ * @brief Drives CA1, CA2, CB1 or CB2; the active edge (PCR) sets its flag.
+ *
+ * @param mem Pointer to the device.
+ * @param line Control line.
+ * @param level New level.
+ */
+void via_set_control_line(memory_t *mem, via_line_t line, bool level);
+
+#endif // VIA6522_H